@@ -0,0 +1,402 @@
+// Compare the interleaved and split layouts, kernel by kernel (including the
+// window multiply fused with conversion from native integer formats), and for
+// the whole short-time DFT of complex and real-valued inputs. Then time the
+// synthetic signal generators.
+
+#include "spconstants.h"
+#include "spgen.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+#include "spsignal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of samples processed per timing, across repetitions.
+#define SPECTREL_BENCH_NUM_SAMPLES (1 << 26)
+
+// Keep results alive, so that the compiler can't remove the work.
+static volatile double spectrel_bench_sink;
+
+typedef struct
+{
+    size_t num_samples;
+    fftw_complex *samples;
+    int16_t *samples_cs16;
+    int8_t *samples_cs8;
+    fftw_complex *window;
+    fftw_complex *out;
+    double *real;
+    double *imag;
+    double *power;
+    float *power_db;
+} spectrel_bench_t;
+
+typedef void (*spectrel_bench_kernel_t)(spectrel_bench_t *b);
+
+static void spectrel_bench_window(spectrel_bench_t *b)
+{
+    spectrel_multiply_window(b->samples, b->window, b->out, b->num_samples);
+    spectrel_bench_sink = creal(b->out[0]);
+}
+
+static void spectrel_bench_window_split(spectrel_bench_t *b)
+{
+    spectrel_multiply_window_split(
+        b->samples, b->window, b->real, b->imag, b->num_samples);
+    spectrel_bench_sink = b->real[0];
+}
+
+static void spectrel_bench_window_cs16(spectrel_bench_t *b)
+{
+    spectrel_convert_window(b->samples_cs16,
+                            SPECTREL_FORMAT_CS16,
+                            1.0 / 32768,
+                            b->window,
+                            b->out,
+                            b->num_samples);
+    spectrel_bench_sink = creal(b->out[0]);
+}
+
+static void spectrel_bench_window_split_cs16(spectrel_bench_t *b)
+{
+    spectrel_convert_window_split(b->samples_cs16,
+                                  SPECTREL_FORMAT_CS16,
+                                  1.0 / 32768,
+                                  b->window,
+                                  b->real,
+                                  b->imag,
+                                  b->num_samples);
+    spectrel_bench_sink = b->real[0];
+}
+
+static void spectrel_bench_window_cs8(spectrel_bench_t *b)
+{
+    spectrel_convert_window(b->samples_cs8,
+                            SPECTREL_FORMAT_CS8,
+                            1.0 / 128,
+                            b->window,
+                            b->out,
+                            b->num_samples);
+    spectrel_bench_sink = creal(b->out[0]);
+}
+
+static void spectrel_bench_window_split_cs8(spectrel_bench_t *b)
+{
+    spectrel_convert_window_split(b->samples_cs8,
+                                  SPECTREL_FORMAT_CS8,
+                                  1.0 / 128,
+                                  b->window,
+                                  b->real,
+                                  b->imag,
+                                  b->num_samples);
+    spectrel_bench_sink = b->real[0];
+}
+
+static void spectrel_bench_power(spectrel_bench_t *b)
+{
+    spectrel_compute_power(b->samples, b->power, b->num_samples);
+    spectrel_bench_sink = b->power[0];
+}
+
+static void spectrel_bench_power_split(spectrel_bench_t *b)
+{
+    spectrel_compute_split_power(b->real, b->imag, b->power, b->num_samples);
+    spectrel_bench_sink = b->power[0];
+}
+
+static void spectrel_bench_power_db(spectrel_bench_t *b)
+{
+    spectrel_compute_power_db(b->samples, b->power_db, b->num_samples);
+    spectrel_bench_sink = b->power_db[0];
+}
+
+static void spectrel_bench_power_db_split(spectrel_bench_t *b)
+{
+    spectrel_compute_split_power_db(
+        b->real, b->imag, b->power_db, b->num_samples);
+    spectrel_bench_sink = b->power_db[0];
+}
+
+// Time a kernel, in nanoseconds per sample.
+static double spectrel_time_kernel(spectrel_bench_kernel_t kernel,
+                                   spectrel_bench_t *b)
+{
+    size_t num_repeats = SPECTREL_BENCH_NUM_SAMPLES / b->num_samples;
+    kernel(b);
+    uint64_t start = spectrel_get_time_ns();
+    for (size_t i = 0; i < num_repeats; i++)
+    {
+        kernel(b);
+    }
+    uint64_t elapsed = spectrel_get_time_ns() - start;
+    return (double)elapsed / (num_repeats * b->num_samples);
+}
+
+// Time the short-time DFT of a buffer, in nanoseconds per input sample.
+static double spectrel_time_stfft(const spectrel_signal_t *signal,
+                                  const size_t window_size,
+                                  const spectrel_layout_t layout,
+                                  const bool is_real)
+{
+    spectrel_plan plan = spectrel_make_plan(window_size, layout, is_real);
+    spectrel_signal_t *window = spectrel_make_window(window_size);
+    if (!plan || !window)
+    {
+        spectrel_free_plan(plan);
+        spectrel_free_signal(window);
+        return -1;
+    }
+
+    size_t num_repeats = SPECTREL_BENCH_NUM_SAMPLES / signal->num_samples / 4;
+    num_repeats = num_repeats ? num_repeats : 1;
+    uint64_t start = spectrel_get_time_ns();
+    for (size_t i = 0; i < num_repeats; i++)
+    {
+        spectrel_spectrogram_t *s =
+            spectrel_stfft(plan, window, signal, window_size / 2, 1e6, NULL);
+        if (!s)
+        {
+            break;
+        }
+        spectrel_free_spectrogram(s);
+    }
+    uint64_t elapsed = spectrel_get_time_ns() - start;
+
+    spectrel_free_signal(window);
+    spectrel_free_plan(plan);
+    return (double)elapsed / (num_repeats * signal->num_samples);
+}
+
+// Time a generator of synthetic signals, in nanoseconds per sample.
+static double spectrel_time_generator(const spectrel_component_t *components,
+                                      const size_t num_components,
+                                      const double noise_power,
+                                      spectrel_signal_t *signal)
+{
+    spectrel_generator_params_t params = {.frequency = 400e6,
+                                          .sample_rate = 10e6,
+                                          .noise_power = noise_power,
+                                          .seed = 1,
+                                          .components = components,
+                                          .num_components = num_components};
+    spectrel_generator g = spectrel_make_generator(&params);
+    if (!g)
+    {
+        return -1;
+    }
+
+    size_t num_repeats = SPECTREL_BENCH_NUM_SAMPLES / signal->num_samples;
+    spectrel_generate(g, signal);
+    uint64_t start = spectrel_get_time_ns();
+    for (size_t i = 0; i < num_repeats; i++)
+    {
+        spectrel_generate(g, signal);
+    }
+    uint64_t elapsed = spectrel_get_time_ns() - start;
+    spectrel_bench_sink = creal(signal->samples[0]);
+
+    spectrel_free_generator(g);
+    return (double)elapsed / (num_repeats * signal->num_samples);
+}
+
+// Time a cosine evaluated per sample, as the generators once did.
+static double spectrel_time_cosine(spectrel_signal_t *signal)
+{
+    size_t num_repeats = SPECTREL_BENCH_NUM_SAMPLES / signal->num_samples / 8;
+    uint64_t start = spectrel_get_time_ns();
+    for (size_t i = 0; i < num_repeats; i++)
+    {
+        for (size_t n = 0; n < signal->num_samples; n++)
+        {
+            signal->samples[n] = cos(2 * M_PI * 0.123 * (double)n + i);
+        }
+    }
+    uint64_t elapsed = spectrel_get_time_ns() - start;
+    spectrel_bench_sink = creal(signal->samples[0]);
+    return (double)elapsed / (num_repeats * signal->num_samples);
+}
+
+static void spectrel_report_generator(const char *name,
+                                      const size_t num_samples,
+                                      const double time)
+{
+    printf("%-10s %8zu %14.3f %14.2f\n", name, num_samples, time, 1 / time);
+}
+
+static void spectrel_report(const char *name,
+                            const size_t num_samples,
+                            const double interleaved,
+                            const double split)
+{
+    printf("%-10s %8zu %14.3f %14.3f %9.2fx\n",
+           name,
+           num_samples,
+           interleaved,
+           split,
+           interleaved / split);
+}
+
+// Free the buffers of a benchmark. Unallocated buffers are NULL.
+static void spectrel_free_bench(spectrel_bench_t *b)
+{
+    fftw_free(b->samples);
+    fftw_free(b->samples_cs16);
+    fftw_free(b->samples_cs8);
+    fftw_free(b->window);
+    fftw_free(b->out);
+    fftw_free(b->real);
+    fftw_free(b->imag);
+    fftw_free(b->power);
+    fftw_free(b->power_db);
+}
+
+int main(void)
+{
+    const size_t sizes[] = {256, 1024, 4096, 16384};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    size_t max_size = sizes[num_sizes - 1];
+
+    spectrel_bench_t b = {0};
+    b.samples = fftw_malloc(sizeof(fftw_complex) * max_size);
+    b.samples_cs16 = fftw_malloc(2 * sizeof(int16_t) * max_size);
+    b.samples_cs8 = fftw_malloc(2 * sizeof(int8_t) * max_size);
+    b.window = fftw_malloc(sizeof(fftw_complex) * max_size);
+    b.out = fftw_malloc(sizeof(fftw_complex) * max_size);
+    b.real = fftw_malloc(sizeof(double) * max_size);
+    b.imag = fftw_malloc(sizeof(double) * max_size);
+    b.power = fftw_malloc(sizeof(double) * max_size);
+    b.power_db = fftw_malloc(sizeof(float) * max_size);
+    if (!b.samples || !b.samples_cs16 || !b.samples_cs8 || !b.window ||
+        !b.out || !b.real || !b.imag || !b.power || !b.power_db)
+    {
+        fprintf(stderr, "malloc failed: bench\n");
+        spectrel_free_bench(&b);
+        return SPECTREL_FAILURE;
+    }
+    srand(1);
+    for (size_t n = 0; n < max_size; n++)
+    {
+        b.samples[n] = (rand() / (double)RAND_MAX - 0.5) +
+                       (rand() / (double)RAND_MAX - 0.5) * I;
+        b.window[n] = 0.5 + 0.25 * I;
+        b.real[n] = creal(b.samples[n]);
+        b.imag[n] = cimag(b.samples[n]);
+        b.samples_cs16[2 * n] = (int16_t)(b.real[n] * 32767);
+        b.samples_cs16[2 * n + 1] = (int16_t)(b.imag[n] * 32767);
+        b.samples_cs8[2 * n] = (int8_t)(b.real[n] * 127);
+        b.samples_cs8[2 * n + 1] = (int8_t)(b.imag[n] * 127);
+    }
+
+    printf("%-10s %8s %14s %14s %10s\n",
+           "Kernel",
+           "Samples",
+           "Interleaved",
+           "Split",
+           "Speedup");
+    printf("%-10s %8s %14s %14s\n", "", "", "[ns/sample]", "[ns/sample]");
+    for (size_t i = 0; i < num_sizes; i++)
+    {
+        b.num_samples = sizes[i];
+        spectrel_report("window",
+                        b.num_samples,
+                        spectrel_time_kernel(spectrel_bench_window, &b),
+                        spectrel_time_kernel(spectrel_bench_window_split, &b));
+        spectrel_report(
+            "win_cs16",
+            b.num_samples,
+            spectrel_time_kernel(spectrel_bench_window_cs16, &b),
+            spectrel_time_kernel(spectrel_bench_window_split_cs16, &b));
+        spectrel_report(
+            "win_cs8",
+            b.num_samples,
+            spectrel_time_kernel(spectrel_bench_window_cs8, &b),
+            spectrel_time_kernel(spectrel_bench_window_split_cs8, &b));
+        spectrel_report("power",
+                        b.num_samples,
+                        spectrel_time_kernel(spectrel_bench_power, &b),
+                        spectrel_time_kernel(spectrel_bench_power_split, &b));
+        spectrel_report(
+            "power_db",
+            b.num_samples,
+            spectrel_time_kernel(spectrel_bench_power_db, &b),
+            spectrel_time_kernel(spectrel_bench_power_db_split, &b));
+    }
+
+    // The whole short-time DFT, over a buffer of the default size.
+    spectrel_signal_t *signal = spectrel_make_signal(
+        SPECTREL_DEFAULT_BUFFER_SIZE, SPECTREL_EMPTY_SIGNAL, NULL);
+    if (!signal)
+    {
+        spectrel_free_bench(&b);
+        return SPECTREL_FAILURE;
+    }
+    for (size_t n = 0; n < signal->num_samples; n++)
+    {
+        signal->samples[n] = b.samples[n % max_size];
+    }
+    for (size_t i = 0; i < num_sizes; i++)
+    {
+        spectrel_report(
+            "stfft",
+            sizes[i],
+            spectrel_time_stfft(
+                signal, sizes[i], SPECTREL_LAYOUT_INTERLEAVED, false),
+            spectrel_time_stfft(
+                signal, sizes[i], SPECTREL_LAYOUT_SPLIT, false));
+    }
+    for (size_t i = 0; i < num_sizes; i++)
+    {
+        spectrel_report(
+            "stfft_real",
+            sizes[i],
+            spectrel_time_stfft(
+                signal, sizes[i], SPECTREL_LAYOUT_INTERLEAVED, true),
+            spectrel_time_stfft(
+                signal, sizes[i], SPECTREL_LAYOUT_SPLIT, true));
+    }
+
+    // Each generator, filling a buffer of the default size.
+    const spectrel_component_t tone = {.type = SPECTREL_TONE,
+                                       .frequency = 1.25e6};
+    const spectrel_component_t chirp = {.type = SPECTREL_LINEAR_CHIRP,
+                                        .frequency = -4e6,
+                                        .stop_frequency = 4e6,
+                                        .duration = 0.01};
+    const spectrel_component_t exp_chirp = {.type = SPECTREL_EXPONENTIAL_CHIRP,
+                                            .frequency = -4e6,
+                                            .stop_frequency = 4e6,
+                                            .duration = 0.01};
+    const spectrel_component_t pulse = {.type = SPECTREL_PULSE,
+                                        .frequency = -2e6,
+                                        .duration = 1e-3,
+                                        .period = 4e-3};
+    const spectrel_component_t dispersed = {
+        .type = SPECTREL_DISPERSED_PULSE, .dm = 10, .period = 0.1};
+    const spectrel_component_t mixture[] = {tone, chirp, pulse, dispersed};
+    size_t N = signal->num_samples;
+    printf("\n%-10s %8s %14s %14s\n", "Generator", "Samples", "", "");
+    printf("%-10s %8s %14s %14s\n", "", "", "[ns/sample]", "[GS/s]");
+    spectrel_report_generator("cos", N, spectrel_time_cosine(signal));
+    spectrel_report_generator(
+        "tone", N, spectrel_time_generator(&tone, 1, 0, signal));
+    spectrel_report_generator(
+        "chirp", N, spectrel_time_generator(&chirp, 1, 0, signal));
+    spectrel_report_generator(
+        "exp_chirp", N, spectrel_time_generator(&exp_chirp, 1, 0, signal));
+    spectrel_report_generator(
+        "pulse", N, spectrel_time_generator(&pulse, 1, 0, signal));
+    spectrel_report_generator(
+        "dispersed", N, spectrel_time_generator(&dispersed, 1, 0, signal));
+    spectrel_report_generator(
+        "noise", N, spectrel_time_generator(NULL, 0, 1, signal));
+    spectrel_report_generator(
+        "mixture", N, spectrel_time_generator(mixture, 4, 1, signal));
+
+    spectrel_free_signal(signal);
+    spectrel_free_bench(&b);
+    return SPECTREL_SUCCESS;
+}
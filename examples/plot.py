@@ -3,14 +3,38 @@
 Usage:
     python3 examples/plot.py -f 2025-10-21T22:36:10Z_rtlsdr.cf64 -w 1024
     python3 examples/plot.py -f recordings/2025-10-21T23:17:03Z_hackrf.cf64 -w 1024
+    python3 examples/plot.py -f recordings/2025-10-21T23:17:03Z_hackrf.q8 -w 1024
+
+The whole recording is plotted. For large recordings, use `spectrel-read` to
+preview a downsampled region instead.
 """
 
 import argparse
+import os
 import numpy as np
 import matplotlib.pyplot as plt
 import matplotlib.colors as clr
 
 
+def read_quantised(file_path: str, num_samples_per_spectrum: int, code_dtype) -> np.ndarray:
+    """Reconstruct the log-power, in dB, of each sample in a quantised recording.
+
+    Each spectrum is stored as a 32-bit float offset and scale, followed by one
+    code per sample. The reconstruction error is at most half the scale.
+    """
+    record = np.dtype(
+        [
+            ("offset", np.float32),
+            ("scale", np.float32),
+            ("codes", code_dtype, (num_samples_per_spectrum,)),
+        ]
+    )
+    spectrums = np.memmap(file_path, dtype=record, mode="r")
+    return spectrums["offset"][:, None] + spectrums["scale"][:, None] * spectrums[
+        "codes"
+    ].astype(np.float32)
+
+
 def main() -> None:
     # Parse command line arguments
     parser = argparse.ArgumentParser()
@@ -18,17 +42,27 @@ def main() -> None:
     parser.add_argument("-w", type=int)
     args = parser.parse_args()
     file_path, num_samples_per_spectrum = args.f, args.w
+    encoding = os.path.splitext(file_path)[1].lstrip(".")
 
-    # The spectrograms are stored in column (spectrum) major ordering. Each sample
-    # corresponds to a complex DFT amplitude, 64 bits per component.
-    samples = np.fromfile(file_path, dtype=np.complex128)
-    num_spectrums = len(samples) // num_samples_per_spectrum
-    spectrogram = samples.reshape(num_spectrums, num_samples_per_spectrum)
-    spectrogram = np.fft.fftshift(spectrogram, axes=1).T
+    plt.figure(figsize=(10, 8))
+    if encoding in ("q8", "q16"):
+        # Each spectrum is stored as quantised log-power.
+        code_dtype = np.uint8 if encoding == "q8" else np.uint16
+        spectrogram = read_quantised(file_path, num_samples_per_spectrum, code_dtype)
+        spectrogram = np.fft.fftshift(spectrogram, axes=1).T
+        plt.pcolormesh(spectrogram, cmap="gnuplot2")
+    else:
+        # The spectrograms are stored in column (spectrum) major ordering. Each sample
+        # corresponds to a complex DFT amplitude, 64 bits per component.
+        samples = np.memmap(file_path, dtype=np.complex128, mode="r")
+        num_spectrums = len(samples) // num_samples_per_spectrum
+        spectrogram = samples[: num_spectrums * num_samples_per_spectrum].reshape(
+            num_spectrums, num_samples_per_spectrum
+        )
+        spectrogram = np.fft.fftshift(spectrogram, axes=1).T
+        plt.pcolormesh(np.abs(spectrogram), cmap="gnuplot2", norm=clr.LogNorm())
 
     # Plot the spectrogram.
-    plt.figure(figsize=(10, 8))
-    plt.pcolormesh(np.abs(spectrogram), cmap="gnuplot2", norm=clr.LogNorm())
     plt.axis("off")
     plt.tight_layout(pad=0)
     plt.show()
@@ -0,0 +1,121 @@
+"""A basic script to follow spectrums published by Spectrel to shared memory.
+
+Usage:
+    spectrel -r rtlsdr -f 95800000 -s 250000 -b 250000 -g 30 -T 60 -m /spectrel
+    python3 examples/shm.py -m /spectrel
+"""
+
+import argparse
+import mmap
+import struct
+import time
+from datetime import datetime, timezone
+import numpy as np
+
+
+# The header at the start of the shared memory, up to (not including) the write
+# index, which is stored at WRITE_INDEX_OFFSET, and the configuration count,
+# which is odd while the configuration changes.
+HEADER = struct.Struct("=8sIIQQddQQQ")
+WRITE_INDEX_OFFSET = 128
+CONFIGURATION_OFFSET = 136
+# Each slot starts with the index of the spectrum it holds, then its time in
+# nanoseconds since the Unix epoch (UTC), padded to 32 bytes.
+SLOT_TIME_OFFSET = 8
+SLOT_SAMPLES_OFFSET = 32
+INVALID_INDEX = 2**64 - 1
+
+
+def read_u64(buffer: mmap.mmap, offset: int) -> int:
+    return struct.unpack_from("=Q", buffer, offset)[0]
+
+
+def read_configuration(path: str) -> tuple:
+    """Map the shared memory, and read a consistent copy of its header."""
+    while True:
+        # The shared memory only grows, so map it again to see all of it.
+        with open(path, "rb") as f:
+            buffer = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        configuration = read_u64(buffer, CONFIGURATION_OFFSET)
+        header = HEADER.unpack_from(buffer)
+        frequencies = np.frombuffer(
+            buffer, dtype=np.float64, count=header[3], offset=header[7]
+        ).copy()
+        if configuration % 2 == 0 and configuration == read_u64(
+            buffer, CONFIGURATION_OFFSET
+        ):
+            return buffer, configuration, header, frequencies
+        buffer.close()
+        time.sleep(0.01)
+
+
+def main() -> None:
+    # Parse command line arguments
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-m", type=str)
+    args = parser.parse_args()
+
+    path = f"/dev/shm/{args.m.lstrip('/')}"
+    buffer, configuration, header, frequencies = read_configuration(path)
+    (
+        magic,
+        version,
+        num_slots,
+        num_samples,
+        window_hop,
+        sample_rate,
+        center_frequency,
+        frequencies_offset,
+        slots_offset,
+        slot_size,
+    ) = header
+    if magic != b"SPECSHM\0" or version != 3:
+        raise ValueError("Not a Spectrel shared memory ring")
+
+    # Start from the most recent spectrum, and skip ahead if overwritten.
+    next_index = read_u64(buffer, WRITE_INDEX_OFFSET)
+    while True:
+        # Take up a new configuration. Every slot was dropped with the old one.
+        if read_u64(buffer, CONFIGURATION_OFFSET) != configuration:
+            buffer.close()
+            buffer, configuration, header, frequencies = read_configuration(path)
+            _, _, num_slots, num_samples, _, _, center_frequency = header[:7]
+            slots_offset, slot_size = header[8:]
+            print(f"Center frequency: {center_frequency:.1f} [Hz]")
+
+        write_index = read_u64(buffer, WRITE_INDEX_OFFSET)
+        if write_index - next_index > num_slots:
+            next_index = write_index - num_slots // 2
+        if next_index == write_index:
+            time.sleep(0.01)
+            continue
+
+        # Copy the spectrum out, then check it wasn't overwritten meanwhile.
+        slot = slots_offset + (next_index % num_slots) * slot_size
+        if read_u64(buffer, slot) != next_index:
+            next_index += 1
+            continue
+        samples = np.frombuffer(
+            buffer,
+            dtype=np.complex128,
+            count=num_samples,
+            offset=slot + SLOT_SAMPLES_OFFSET,
+        ).copy()
+        time_ns = struct.unpack_from("=q", buffer, slot + SLOT_TIME_OFFSET)[0]
+        if (
+            read_u64(buffer, slot) == next_index
+            and read_u64(buffer, CONFIGURATION_OFFSET) == configuration
+        ):
+            power = 10 * np.log10(np.abs(samples) ** 2 + 1e-20)
+            peak = np.argmax(power)
+            utc = datetime.fromtimestamp(time_ns / 1e9, tz=timezone.utc)
+            print(
+                f"Spectrum {next_index} at {utc.isoformat()}: "
+                f"peak of {power[peak]:.1f} [dB] "
+                f"at {center_frequency + frequencies[peak]:.1f} [Hz]"
+            )
+        next_index += 1
+
+
+if __name__ == "__main__":
+    main()
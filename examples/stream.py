@@ -0,0 +1,68 @@
+"""A basic script to subscribe to spectrums streamed live by Spectrel.
+
+Usage:
+    spectrel -r rtlsdr -f 95800000 -s 250000 -b 250000 -g 30 -T 60 -u /tmp/spectrel.sock -D 4
+    python3 examples/stream.py -u /tmp/spectrel.sock
+"""
+
+import argparse
+import socket
+import struct
+import numpy as np
+
+
+# The header sent by the server as soon as a subscriber connects, and again,
+# in place of a record, whenever the configuration changes.
+HEADER = struct.Struct("=8sIIdd")
+HEADER_INDEX = 2**64 - 1
+
+
+def read_exactly(sock: socket.socket, num_bytes: int) -> bytes:
+    data = bytearray()
+    while len(data) < num_bytes:
+        chunk = sock.recv(num_bytes - len(data))
+        if not chunk:
+            raise ConnectionError("The server closed the connection")
+        data.extend(chunk)
+    return bytes(data)
+
+
+def main() -> None:
+    # Parse command line arguments
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-u", type=str)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(args.u)
+    index = HEADER_INDEX
+    while True:
+        if index == HEADER_INDEX:
+            magic, decimation, num_samples, sample_rate, center_frequency = (
+                HEADER.unpack(read_exactly(sock, HEADER.size))
+            )
+            if magic != b"SPECSR2\0":
+                raise ValueError("Not a Spectrel stream")
+            print(
+                f"Decimation: {decimation}, samples per spectrum: {num_samples}, "
+                f"center frequency: {center_frequency:.1f} [Hz]"
+            )
+            frequencies = center_frequency + np.fft.fftfreq(
+                num_samples, d=1 / sample_rate
+            )
+
+        # Each record is the index of the spectrum, followed by the log-power
+        # of each sample in dB, unless the index announces a new header.
+        index = struct.unpack("=Q", read_exactly(sock, 8))[0]
+        if index == HEADER_INDEX:
+            continue
+        power = np.frombuffer(read_exactly(sock, 4 * num_samples), dtype=np.float32)
+        peak = np.argmax(power)
+        print(
+            f"Spectrum {index}: peak of {power[peak]:.1f} [dB] "
+            f"at {frequencies[peak]:.1f} [Hz]"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,85 @@
+#ifndef SPARENA_H
+#define SPARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief An opaque pointer to an arena, a single mapping from which buffers
+ * are carved without calling the allocator.
+ *
+ * The arena is backed by hugepages where possible, to cut TLB misses, and is
+ * bound to the NUMA node of the thread which makes it. Every page is faulted
+ * in up front, so allocating from the arena never touches the kernel. Memory
+ * is released by rewinding the arena, rather than buffer by buffer.
+ */
+typedef struct spectrel_arena_t *spectrel_arena;
+
+/**
+ * @brief Map and pre-fault an arena. Hugepages reserved with MAP_HUGETLB are
+ * tried first, then transparent hugepages with madvise, then normal pages.
+ *
+ * The arena is made by, and should be used from, the thread which consumes
+ * its buffers: pages are bound to the NUMA node that thread is running on
+ * where the kernel supports it, and are faulted in from it in any case.
+ *
+ * @param num_bytes The number of bytes needed. The mapping is rounded up to a
+ * whole number of hugepages.
+ * @return An opaque pointer to the newly initialised arena.
+ */
+spectrel_arena spectrel_make_arena(const size_t num_bytes);
+
+/**
+ * @brief Unmap the arena. Every buffer allocated from it is invalidated.
+ * @param arena The arena.
+ */
+void spectrel_free_arena(spectrel_arena arena);
+
+/**
+ * @brief Allocate a buffer from the arena, aligned to a cache line.
+ * @param arena The arena, or NULL.
+ * @param num_bytes The size of the buffer, in bytes.
+ * @return The buffer, or NULL if the arena is NULL or full. Callers fall back
+ * to the heap, and a full arena is counted in the metrics.
+ */
+void *spectrel_arena_alloc(spectrel_arena arena, const size_t num_bytes);
+
+/**
+ * @brief Get the number of bytes allocated from the arena so far, to rewind
+ * it to later.
+ * @param arena The arena.
+ * @return The number of bytes in use, including padding.
+ */
+size_t spectrel_get_arena_used(spectrel_arena arena);
+
+/**
+ * @brief Get the number of bytes the arena can hold, which may be more than
+ * it was made with, since the mapping is rounded up to whole pages.
+ * @param arena The arena.
+ * @return The capacity of the arena, in bytes.
+ */
+size_t spectrel_get_arena_capacity(spectrel_arena arena);
+
+/**
+ * @brief Release every buffer allocated since the arena had the given number
+ * of bytes in use.
+ * @param arena The arena.
+ * @param used As returned by spectrel_get_arena_used.
+ */
+void spectrel_rewind_arena(spectrel_arena arena, const size_t used);
+
+/**
+ * @brief Get the number of bytes a buffer takes up in an arena, including
+ * padding, for sizing arenas.
+ * @param num_bytes The size of the buffer, in bytes.
+ * @return The number of bytes it takes up.
+ */
+size_t spectrel_get_arena_size(const size_t num_bytes);
+
+/**
+ * @brief Print how the arena is backed, and where.
+ * @param arena The arena.
+ */
+void spectrel_describe_arena(spectrel_arena arena);
+
+#endif // SPARENA_H
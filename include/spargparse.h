@@ -1,21 +1,93 @@
 #ifndef SPARGPARSE_H
 #define SPARGPARSE_H
 
+#include "spconstants.h"
+#include "sppath.h"
+#include "sprfi.h"
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A capture job, read from a section of a config file. Settings not
+ * given in the section are taken from those before the first section.
+ */
+typedef struct
+{
+    char *name;                   // The name of the section.
+    double frequency;             // [Hz]
+    double gain;                  // [dB]
+    double duration;              // [s] (zero to record until stopped)
+    int window_size;              // [#samples]
+    int window_hop;               // [#samples]
+    spectrel_encoding_t encoding; // The encoding of the recording.
+    int start_time; // Time of day to start, in seconds past midnight UTC, or
+                    // -1 to start as soon as the previous job finishes.
+} spectrel_job_t;
+
+/**
+ * @brief An extra resolution, computed from the same buffers as the recording
+ * and written to a recording of its own.
+ */
+typedef struct
+{
+    int window_size; // [#samples]
+    int window_hop;  // [#samples]
+} spectrel_resolution_t;
+
 /**
  * @brief Structure to hold configurable parameters.
  */
 typedef struct
 {
-    char *dir;          // -d (directory)
-    char *driver;       // -r (receiver/driver)
-    double frequency;   // -f (frequency)   [Hz]
-    double sample_rate; // -s (sample rate) [Hz]
-    double bandwidth;   // -b (bandwidth)   [Hz]
-    double gain;        // -g (gain)        [dB]
-    double duration;    // -T (duration)    [s]
-    int window_size;    // -w (window size) [#samples]
-    int window_hop;     // -h (window hop)  [#samples]
-    int buffer_size;    // -B (buffer size) [#samples]
+    char *dir;                    // -d (directory)
+    char *driver;                 // -r (receiver/driver)
+    double frequency;             // -f (frequency)   [Hz]
+    double sample_rate;           // -s (sample rate) [Hz]
+    double bandwidth;             // -b (bandwidth)   [Hz]
+    double gain;                  // -g (gain)        [dB]
+    double duration;              // -T (duration)    [s]
+    int window_size;              // -w (window size) [#samples]
+    int window_hop;               // -h (window hop)  [#samples]
+    int buffer_size;              // -B (buffer size) [#samples]
+    spectrel_encoding_t encoding; // -e (encoding)
+    spectrel_layout_t layout;     // -L (layout)
+    bool is_real_input;           // -I (input)
+    int num_pyramid_levels;       // -P (pyramid levels)
+    char *socket_path;            // -u (stream socket)
+    int stream_decimation;        // -D (stream decimation)
+    char *shm_name;               // -m (shared memory)
+    char *control_path;           // -c (control socket)
+    char *config_path;            // -C (config file)
+    char *metrics_path;           // -M (metrics textfile)
+    int metrics_port;             // -p (metrics port)
+    char *tune_path;              // -A (autotune)
+    bool lock_memory;             // -l (lock memory)
+    int realtime_priority;        // -R (real-time priority, zero for none)
+    char *cpus;                   // -x (recording thread CPUs)
+    char *background_cpus;        // -X (background thread CPUs)
+    spectrel_writer_backend_t writer; // -W (writer)
+    int writes_in_flight;         // -Q (writes in flight)
+    double dm_min;                // -y (DM range) [pc cm^-3]
+    double dm_max;                // -y (DM range, zero for no search)
+    double snr_threshold;         // -Y (SNR threshold)
+    int dedisp_threads;           // -j (dedispersion threads)
+    double stats_interval;        // -S (statistics interval, zero for none) [s]
+    double rfi_threshold;         // -k (RFI threshold, zero for none) [sigma]
+    int rfi_block_size;           // -K (RFI block size) [#spectrums]
+    spectrel_rfi_action_t rfi_action; // -z (RFI action)
+    spectrel_resolution_t resolutions[SPECTREL_MAX_RESOLUTIONS]; // -V
+    size_t num_resolutions;       // The number of extra resolutions.
+    double track_frequencies[SPECTREL_MAX_TRACKED_FREQUENCIES]; // -F [Hz]
+    size_t num_track_frequencies; // The number of tracked frequencies.
+    int track_hop;                // -H (track hop) [#samples]
+    double zoom_start;            // -Z (zoom interval) [Hz]
+    double zoom_stop;             // -Z (zoom interval) [Hz]
+    int zoom_num_bins;            // -Z (zoom bins, zero for no zoom)
+    spectrel_job_t *jobs;         // Jobs from the config file, in order.
+    size_t num_jobs;              // The number of jobs.
+    bool repeat_jobs;             // Whether to repeat the jobs, once done.
 } spectrel_args_t;
 
 /**
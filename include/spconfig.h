@@ -0,0 +1,36 @@
+#ifndef SPCONFIG_H
+#define SPCONFIG_H
+
+/**
+ * @brief Called for the start of each section, and each key-value pair, in a
+ * config file.
+ * @param data As passed to spectrel_read_config.
+ * @param section The name of the section, or an empty string for keys before
+ * the first section.
+ * @param key The key, or NULL at the start of a section.
+ * @param value The value, or NULL at the start of a section.
+ * @return Zero for success, or an error code to stop reading.
+ */
+typedef int (*spectrel_config_handler_t)(void *data,
+                                         const char *section,
+                                         const char *key,
+                                         const char *value);
+
+/**
+ * @brief Read an INI-style config file.
+ *
+ * Each line is blank, a comment starting with '#' or ';', a section header
+ * such as "[name]", or a key-value pair such as "key = value". Comments may
+ * also follow a value, if separated from it by whitespace. Whitespace around
+ * names, keys and values is ignored.
+ *
+ * @param path The path to the config file.
+ * @param handler Called for each section and key-value pair, in order.
+ * @param data Passed through to the handler.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_read_config(const char *path,
+                         spectrel_config_handler_t handler,
+                         void *data);
+
+#endif // SPCONFIG_H
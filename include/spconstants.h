@@ -22,7 +22,8 @@
 #define SPECTREL_NUM_CHARS_ISO_8601 20
 
 /**
- * The default device buffer format.
+ * The format samples are streamed in, if the native format of the device is
+ * not supported.
  */
 #define SPECTREL_DEFAULT_FORMAT "CF64"
 
@@ -46,4 +47,306 @@
  */
 #define SPECTREL_DEFAULT_DIRECTORY "."
 
+/**
+ * The default encoding for spectrograms written to file.
+ */
+#define SPECTREL_DEFAULT_ENCODING "cf64"
+
+/**
+ * The default backend recordings are written with.
+ */
+#define SPECTREL_DEFAULT_WRITER "stdio"
+
+/**
+ * The default number of buffers an asynchronous writer may have in flight.
+ */
+#define SPECTREL_DEFAULT_WRITES_IN_FLIGHT 8
+
+/**
+ * The size of each buffer in an asynchronous writer's pool, in bytes.
+ */
+#define SPECTREL_WRITER_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * The longest a partly filled writer buffer is held before it is submitted,
+ * in milliseconds.
+ */
+#define SPECTREL_WRITER_MAX_AGE 1000
+
+/**
+ * The default signal-to-noise ratio a dispersed pulse must reach to be
+ * reported as a candidate.
+ */
+#define SPECTREL_DEFAULT_SNR_THRESHOLD 6.0
+
+/**
+ * The default number of threads searching for dispersed pulses.
+ */
+#define SPECTREL_DEFAULT_DEDISP_THREADS 1
+
+/**
+ * The most threads which may search for dispersed pulses.
+ */
+#define SPECTREL_MAX_DEDISP_THREADS 64
+
+/**
+ * The number of spectrums dedispersed at once. Candidates are found at most
+ * a block, plus the dispersion delay across the band, after they arrive.
+ */
+#define SPECTREL_DEDISP_BLOCK_SIZE 1024
+
+/**
+ * The number of spectrums summed at once in the dedispersion inner loops, so
+ * that the partial sums stay in the L1 cache.
+ */
+#define SPECTREL_DEDISP_TILE_SIZE 256
+
+/**
+ * The widest boxcar pulses are searched with, in spectrums. Boxcars of every
+ * power of two up to it are used.
+ */
+#define SPECTREL_DEDISP_MAX_WIDTH 32
+
+/**
+ * The most dispersion measures which may be searched. Wider ranges are
+ * searched more coarsely.
+ */
+#define SPECTREL_MAX_DM_TRIALS 4096
+
+/**
+ * The most candidates each searching thread may report per block.
+ */
+#define SPECTREL_DEDISP_MAX_CANDIDATES 1024
+
+/**
+ * The dispersion constant, in s MHz^2 pc^-1 cm^3.
+ */
+#define SPECTREL_DISPERSION_CONSTANT 4.148808e3
+
+/**
+ * The weight each block is given in the running baseline of each spectral
+ * component, which pulses are measured against.
+ */
+#define SPECTREL_DEDISP_BASELINE_WEIGHT 0.25
+
+/**
+ * The largest number of extra resolutions computed from each buffer.
+ */
+#define SPECTREL_MAX_RESOLUTIONS 8
+
+/**
+ * The default number of spectrums the spectral kurtosis is estimated over.
+ */
+#define SPECTREL_DEFAULT_RFI_BLOCK_SIZE 256
+
+/**
+ * The default action taken on spectral components flagged as interference.
+ */
+#define SPECTREL_DEFAULT_RFI_ACTION "flag"
+
+/**
+ * The largest number of frequencies tracked with the sliding DFT.
+ */
+#define SPECTREL_MAX_TRACKED_FREQUENCIES 64
+
+/**
+ * The default number of samples between the outputs of the sliding DFT.
+ */
+#define SPECTREL_DEFAULT_TRACK_HOP 1
+
+/**
+ * The default layout of complex values in the DSP chain, "interleaved" or
+ * "split". It may be overridden at build time, by defining it in CFLAGS.
+ */
+#ifndef SPECTREL_DEFAULT_LAYOUT
+#define SPECTREL_DEFAULT_LAYOUT "interleaved"
+#endif
+
+/**
+ * The default number of rows and columns in a preview of a recording.
+ */
+#define SPECTREL_DEFAULT_PREVIEW_SIZE 512
+
+/**
+ * The default number of pyramid levels written alongside a recording.
+ */
+#define SPECTREL_DEFAULT_PYRAMID_LEVELS 0
+
+/**
+ * The largest number of pyramid levels written alongside a recording.
+ */
+#define SPECTREL_MAX_PYRAMID_LEVELS 16
+
+/**
+ * The default decimation of spectrums streamed to subscribers.
+ */
+#define SPECTREL_DEFAULT_SERVER_DECIMATION 1
+
+/**
+ * The largest number of subscribers streamed to at once.
+ */
+#define SPECTREL_MAX_SUBSCRIBERS 16
+
+/**
+ * The number of records held for subscribers. A subscriber which falls behind
+ * by more than half of them is disconnected.
+ */
+#define SPECTREL_SERVER_RING_SIZE 256
+
+/**
+ * The max time the server waits for activity before checking if it should
+ * stop, in milliseconds.
+ */
+#define SPECTREL_SERVER_POLL_TIMEOUT 100
+
+/**
+ * The maximum number of clients connected to the control socket at once.
+ */
+#define SPECTREL_MAX_CONTROLLERS 4
+
+/**
+ * The maximum length of a command or reply on the control socket, in bytes.
+ */
+#define SPECTREL_CONTROL_LINE_SIZE 256
+
+/**
+ * How often, in milliseconds, a paused recording checks whether it should
+ * stop.
+ */
+#define SPECTREL_CONTROL_POLL_TIMEOUT 100
+
+/**
+ * The maximum length of a line in a config file, in bytes.
+ */
+#define SPECTREL_CONFIG_LINE_SIZE 1024
+
+/**
+ * The number of seconds in a day, ignoring leap seconds.
+ */
+#define SPECTREL_SECONDS_PER_DAY 86400
+
+/**
+ * The number of spectrums held in the shared memory ring.
+ */
+#define SPECTREL_DEFAULT_SHM_SLOTS 1024
+
+/**
+ * The size of a cache line, in bytes.
+ */
+#define SPECTREL_CACHE_LINE_SIZE 64
+
+/**
+ * The size of a hugepage, in bytes. Arenas are mapped in multiples of it.
+ */
+#define SPECTREL_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * The most NUMA nodes an arena may be bound to.
+ */
+#define SPECTREL_MAX_NUMA_NODES 64
+
+/**
+ * How much of the recording thread's stack is faulted in before streaming, in
+ * bytes.
+ */
+#define SPECTREL_PREFAULT_STACK_SIZE (256 * 1024)
+
+/**
+ * How often the metrics textfile is rewritten, in milliseconds.
+ */
+#define SPECTREL_METRICS_INTERVAL 5000
+
+/**
+ * The size of the buffer the metrics are formatted into, in bytes.
+ */
+#define SPECTREL_METRICS_BUFFER_SIZE 65536
+
+/**
+ * The number of finite buckets in each latency histogram.
+ */
+#define SPECTREL_METRICS_NUM_BUCKETS 12
+
+/**
+ * The maximum number of pending connections to the metrics port.
+ */
+#define SPECTREL_METRICS_BACKLOG 8
+
+/**
+ * The max time a metrics scrape may wait on a slow client, in seconds.
+ */
+#define SPECTREL_METRICS_CLIENT_TIMEOUT 1
+
+/**
+ * The smallest buffer size tried when autotuning.
+ */
+#define SPECTREL_AUTOTUNE_MIN_BUFFER_SIZE 1024
+
+/**
+ * The largest buffer size tried when autotuning.
+ */
+#define SPECTREL_AUTOTUNE_MAX_BUFFER_SIZE 1048576
+
+/**
+ * The format samples are streamed in when autotuning, which is the native
+ * format of most receivers.
+ */
+#define SPECTREL_AUTOTUNE_FORMAT "CS16"
+
+/**
+ * The stretch of signal processed for each candidate when autotuning, in
+ * seconds at the sample rate.
+ */
+#define SPECTREL_AUTOTUNE_DURATION 0.5
+
+/**
+ * The fewest buffers processed for each candidate when autotuning.
+ */
+#define SPECTREL_AUTOTUNE_MIN_BUFFERS 8
+
+/**
+ * How far below the best headroom a smaller buffer may fall and still be
+ * chosen when autotuning, as a fraction of the best.
+ */
+#define SPECTREL_AUTOTUNE_TOLERANCE 0.05
+
+/**
+ * The smallest power resolved when converting to decibels (-200 dB).
+ */
+#define SPECTREL_MIN_POWER 1e-20
+
+/**
+ * The number of samples in each block a synthetic signal is generated in. The
+ * samples of a block are computed together, each in a lane of its own.
+ */
+#define SPECTREL_GENERATOR_LANES 64
+
+/**
+ * The most samples generated from one exact phase, before the phase of a
+ * synthetic signal is recomputed rather than carried by recurrence.
+ */
+#define SPECTREL_GENERATOR_CHUNK 4096
+
+/**
+ * The fewest samples generated from one exact phase, however quickly the
+ * frequency of a synthetic signal curves.
+ */
+#define SPECTREL_GENERATOR_MIN_CHUNK 64
+
+/**
+ * The largest phase error, in radians, allowed for the frequency of a
+ * synthetic signal to be taken as changing linearly over a chunk.
+ */
+#define SPECTREL_GENERATOR_PHASE_TOLERANCE 1e-4
+
+/**
+ * The number of Gaussian values synthetic noise is drawn from. It must be a
+ * power of two, of at most 2^16.
+ */
+#define SPECTREL_NOISE_TABLE_SIZE 4096
+
+/**
+ * The most components a synthetic signal may be made up of.
+ */
+#define SPECTREL_MAX_COMPONENTS 16
+
 #endif // SPCONSTANTS_H
\ No newline at end of file
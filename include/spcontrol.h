@@ -0,0 +1,89 @@
+#ifndef SPCONTROL_H
+#define SPCONTROL_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A command received over the control socket.
+ */
+typedef enum
+{
+    SPECTREL_COMMAND_FREQUENCY, // Retune the receiver.
+    SPECTREL_COMMAND_GAIN,      // Change the receiver gain.
+    SPECTREL_COMMAND_WINDOW,    // Change the window size and hop.
+    SPECTREL_COMMAND_ROTATE,    // Start a new recording.
+    SPECTREL_COMMAND_PAUSE,     // Stop reading samples, until resumed.
+    SPECTREL_COMMAND_RESUME,    // Start reading samples again.
+    SPECTREL_COMMAND_STOP,      // Stop recording, and exit.
+    SPECTREL_COMMAND_STATUS,    // Describe the current configuration.
+} spectrel_command_type_t;
+
+/**
+ * @brief A parsed command, and anything prepared in advance to apply it.
+ */
+typedef struct
+{
+    spectrel_command_type_t type;
+    double value;              // The frequency [Hz], or gain [dB].
+    size_t window_size;        // The new window size [#samples].
+    size_t window_hop;         // The new window hop [#samples].
+    spectrel_plan plan;        // Planned for the new window size.
+    spectrel_signal_t *window; // The window function for the new size.
+} spectrel_command_t;
+
+/**
+ * @brief An opaque pointer to a control structure, which accepts commands over
+ * a Unix domain socket.
+ *
+ * Commands are lines of text, such as "frequency 95.8e6", "gain 20", "window
+ * 2048 1024", "rotate", "pause", "resume", "stop" or "status". Each command is
+ * answered with a line starting "ok" or "error". Commands are parsed, and new
+ * plans are made, on a background thread. They are then handed one at a time
+ * to the recording thread, which applies them between buffers.
+ */
+typedef struct spectrel_control_t *spectrel_control;
+
+/**
+ * @brief Listen for commands on a Unix domain socket.
+ * @param socket_path The path to bind the socket to. Any existing file at
+ * the path is replaced.
+ * @param layout The layout to plan new window sizes in.
+ * @param is_real Whether new window sizes are planned for real-valued inputs.
+ * @return An opaque pointer to the newly initialised control structure.
+ */
+spectrel_control spectrel_make_control(const char *socket_path,
+                                       const spectrel_layout_t layout,
+                                       const bool is_real);
+
+/**
+ * @brief Disconnect all clients, stop listening for commands and release any
+ * resources managed by the control structure.
+ * @param control The control structure.
+ */
+void spectrel_free_control(spectrel_control control);
+
+/**
+ * @brief Take the next command, if there is one. Every command taken must be
+ * completed with spectrel_complete_command before the next can be taken. The
+ * caller takes ownership of the plan and window of the command.
+ * @param control The control structure.
+ * @param command Pointer to where the command will be written.
+ * @param timeout The maximum time to wait for a command, in milliseconds.
+ * @return True if a command was taken, otherwise false.
+ */
+bool spectrel_take_command(spectrel_control control,
+                           spectrel_command_t *command,
+                           const int timeout);
+
+/**
+ * @brief Complete the command which was last taken, and reply to the client
+ * which sent it.
+ * @param control The control structure.
+ * @param reply The reply, without a trailing newline.
+ */
+void spectrel_complete_command(spectrel_control control, const char *reply);
+
+#endif // SPCONTROL_H
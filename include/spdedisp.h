@@ -0,0 +1,121 @@
+#ifndef SPDEDISP_H
+#define SPDEDISP_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every candidate file.
+ */
+#define SPECTREL_CANDIDATES_MAGIC "SPECCND"
+
+/**
+ * @brief The header at the start of every candidate file.
+ *
+ * It is followed by one record per candidate, in the order the candidates
+ * arrived. The dispersion measures searched are dm_min + k * dm_step, for k
+ * from zero to num_dms - 1.
+ */
+typedef struct
+{
+    char magic[8];              // SPECTREL_CANDIDATES_MAGIC
+    double dm_min;              // The smallest DM searched, in pc cm^-3.
+    double dm_step;             // The spacing of the DMs searched.
+    uint64_t num_dms;           // The number of DMs searched.
+    double frequency;           // The highest frequency searched, in Hz,
+                                // which candidate times refer to.
+    double spectrum_interval;   // The time between spectrums, in seconds.
+    double snr_threshold;       // The SNR candidates must reach.
+} spectrel_candidates_header_t;
+
+/**
+ * @brief A record in a candidate file: a dispersed pulse.
+ */
+typedef struct
+{
+    int64_t time;        // The time the pulse started at the highest
+                         // frequency, in nanoseconds since the Unix epoch
+                         // (UTC), or zero if unknown.
+    uint64_t index;      // The index of the spectrum the pulse started in,
+                         // counted from the start of the recording.
+    float dm;            // The dispersion measure, in pc cm^-3.
+    float snr;           // The signal-to-noise ratio.
+    uint32_t width;      // The width of the pulse, in spectrums.
+    uint32_t num_merged; // The number of detections, at neighbouring DMs and
+                         // times, merged into the candidate.
+} spectrel_candidate_record_t;
+
+/**
+ * @brief Parameters for a dedispersion search.
+ */
+typedef struct
+{
+    double frequency;     // The centre frequency, in Hz.
+    double sample_rate;   // The sample rate, in Hz.
+    size_t window_size;   // The window size, in samples.
+    size_t window_hop;    // The window hop, in samples.
+    bool is_real;         // Whether the input signal is real-valued.
+    double dm_min;        // The smallest DM to search, in pc cm^-3.
+    double dm_max;        // The largest DM to search, in pc cm^-3.
+    double snr_threshold; // The SNR candidates must reach.
+    size_t num_threads;   // The number of threads searching.
+} spectrel_dedisp_params_t;
+
+/**
+ * @brief An opaque pointer to a dedisperser structure, which searches the
+ * spectrums of a recording for dispersed pulses.
+ *
+ * The power of each spectral component is normalised against a running
+ * baseline, then summed along the dispersion sweep of each DM with a subband
+ * algorithm: components are first summed within subbands at a coarse grid of
+ * DMs, then subbands are summed at each DM searched. Each dedispersed series
+ * is searched with boxcars of increasing width. Detections at neighbouring
+ * DMs and times are merged, and the strongest is written to <path>.cand.
+ *
+ * Spectrums are staged by the recording thread, and searched a block at a time
+ * by background threads. If they fall behind, blocks are dropped rather than
+ * delaying the recording.
+ */
+typedef struct spectrel_dedisperser_t *spectrel_dedisperser;
+
+/**
+ * @brief Start searching a recording for dispersed pulses. The DMs searched
+ * are spaced so that the sweeps of neighbouring DMs differ by at most one
+ * spectrum across the band.
+ * @param path The path of the file the spectrogram is written to.
+ * @param params The parameters of the search.
+ * @return An opaque pointer to the newly initialised dedisperser structure.
+ */
+spectrel_dedisperser
+spectrel_make_dedisperser(const char *path,
+                          const spectrel_dedisp_params_t *params);
+
+/**
+ * @brief Stop the search, close the candidate file, and release any resources
+ * managed by the dedisperser. A staged block is searched first, but spectrums
+ * which have not filled a block are discarded.
+ * @param dedisperser The dedisperser.
+ */
+void spectrel_free_dedisperser(spectrel_dedisperser dedisperser);
+
+/**
+ * @brief Stage each spectrum of the spectrogram for the search, handing a
+ * block to the searching threads whenever one is full.
+ * @param dedisperser The dedisperser.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code if writing candidates has
+ * failed.
+ */
+int spectrel_dedisperse(spectrel_dedisperser dedisperser,
+                        const spectrel_spectrogram_t *s);
+
+/**
+ * @brief Print the DMs searched, and how.
+ * @param dedisperser The dedisperser.
+ */
+void spectrel_describe_dedisperser(spectrel_dedisperser dedisperser);
+
+#endif // SPDEDISP_H
@@ -1,11 +1,31 @@
 #ifndef SPECTREL_H
 #define SPECTREL_H
 
+#include "sparena.h"
 #include "spargparse.h"
+#include "spconfig.h"
 #include "spconstants.h"
+#include "spcontrol.h"
+#include "spdedisp.h"
+#include "spengine.h"
 #include "sperror.h"
+#include "spgen.h"
+#include "spkernel.h"
+#include "spmetrics.h"
 #include "sppath.h"
+#include "sppyramid.h"
+#include "spquant.h"
+#include "spreader.h"
+#include "sprealtime.h"
 #include "spreceiver.h"
+#include "sprfi.h"
+#include "spserver.h"
+#include "spshm.h"
+#include "spstats.h"
 #include "spsignal.h"
+#include "sptimes.h"
+#include "sptrack.h"
+#include "sptune.h"
+#include "spwriter.h"
 
 #endif // SPECTREL_H
\ No newline at end of file
@@ -0,0 +1,215 @@
+#ifndef SPENGINE_H
+#define SPENGINE_H
+
+#include "spreceiver.h"
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The version of the streaming API. It is raised whenever a change would break
+ * a program built against an earlier version.
+ */
+#define SPECTREL_ENGINE_API_VERSION 2
+
+/**
+ * @brief Get the version of the streaming API the library was built with, so
+ * that programs loading it at run time can check it matches the version they
+ * were written against.
+ * @return The value of SPECTREL_ENGINE_API_VERSION in the library.
+ */
+int spectrel_get_engine_api_version(void);
+
+/**
+ * @brief Parameters for a capture engine.
+ */
+typedef struct
+{
+    const char *driver;                  // An SDR driver supported by Soapy.
+    spectrel_receiver_params_t receiver; // How the receiver is tuned.
+    size_t window_size;                  // The window size, in samples.
+    size_t window_hop;                   // The window hop, in samples.
+    size_t buffer_size;                  // The number of samples read at a
+                                         // time.
+    spectrel_layout_t layout;            // The layout of the spectrograms.
+    bool is_real;                        // Whether the input is real-valued.
+} spectrel_engine_params_t;
+
+/**
+ * @brief An opaque pointer to a frame handed to a callback: the spectrogram of
+ * one buffer.
+ *
+ * The frame, and the arrays got from it, are borrowed from the engine. They
+ * are valid only until the callback returns, and must be copied to be kept
+ * any longer.
+ */
+typedef struct spectrel_frame_t *spectrel_frame;
+
+/**
+ * @brief Called with each frame, on the thread running the engine.
+ * @param frame The frame, borrowed for the duration of the call.
+ * @param user_data As passed to spectrel_set_frame_callback.
+ * @return Zero to carry on, or non-zero to stop the engine.
+ */
+typedef int (*spectrel_frame_callback_t)(spectrel_frame frame,
+                                         void *user_data);
+
+/**
+ * @brief Get the index of the first spectrum in the frame, counted from when
+ * the engine was made.
+ * @param frame The frame.
+ * @return The index of the first spectrum.
+ */
+uint64_t spectrel_get_frame_index(spectrel_frame frame);
+
+/**
+ * @brief Get the time of the first spectrum in the frame.
+ * @param frame The frame.
+ * @return The time, in nanoseconds since the Unix epoch (UTC), or zero if it
+ * is not known.
+ */
+int64_t spectrel_get_frame_time(spectrel_frame frame);
+
+/**
+ * @brief Get the centre frequency the frame was captured at.
+ * @param frame The frame.
+ * @return The centre frequency, in Hz.
+ */
+double spectrel_get_frame_frequency(spectrel_frame frame);
+
+/**
+ * @brief Get the sample rate the frame was captured at.
+ * @param frame The frame.
+ * @return The sample rate, in Hz.
+ */
+double spectrel_get_frame_sample_rate(spectrel_frame frame);
+
+/**
+ * @brief Get the number of samples the window advances between spectrums.
+ * @param frame The frame.
+ * @return The window hop, in samples.
+ */
+size_t spectrel_get_frame_window_hop(spectrel_frame frame);
+
+/**
+ * @brief Get the number of spectrums in the frame.
+ * @param frame The frame.
+ * @return The number of spectrums.
+ */
+size_t spectrel_get_frame_num_spectrums(spectrel_frame frame);
+
+/**
+ * @brief Get the number of samples in each spectrum of the frame.
+ * @param frame The frame.
+ * @return The number of samples per spectrum.
+ */
+size_t spectrel_get_frame_num_samples_per_spectrum(spectrel_frame frame);
+
+/**
+ * @brief Get how the DFT amplitudes of the frame are laid out.
+ * @param frame The frame.
+ * @return The layout, which decides whether spectrel_get_frame_samples, or
+ * spectrel_get_frame_real and spectrel_get_frame_imag, hold the amplitudes.
+ */
+spectrel_layout_t spectrel_get_frame_layout(spectrel_frame frame);
+
+/**
+ * @brief Get the DFT amplitudes of the frame, in the interleaved layout.
+ * @param frame The frame.
+ * @return The amplitudes, in spectrum major order, or NULL in the split
+ * layout.
+ */
+const fftw_complex *spectrel_get_frame_samples(spectrel_frame frame);
+
+/**
+ * @brief Get the real parts of the DFT amplitudes of the frame, in the split
+ * layout.
+ * @param frame The frame.
+ * @return The real parts, in spectrum major order, or NULL in the
+ * interleaved layout.
+ */
+const double *spectrel_get_frame_real(spectrel_frame frame);
+
+/**
+ * @brief Get the imaginary parts of the DFT amplitudes of the frame, in the
+ * split layout.
+ * @param frame The frame.
+ * @return The imaginary parts, in spectrum major order, or NULL in the
+ * interleaved layout.
+ */
+const double *spectrel_get_frame_imag(spectrel_frame frame);
+
+/**
+ * @brief Get the time of each spectrum in the frame, relative to the first.
+ * @param frame The frame.
+ * @return The times, in seconds, one per spectrum.
+ */
+const double *spectrel_get_frame_times(spectrel_frame frame);
+
+/**
+ * @brief Get the baseband frequency of each sample in the spectrums of the
+ * frame, in the order they are output by the DFT.
+ * @param frame The frame.
+ * @return The frequencies, in Hz, one per sample.
+ */
+const double *spectrel_get_frame_frequencies(spectrel_frame frame);
+
+/**
+ * @brief An opaque pointer to a capture engine, which reads buffers from a
+ * receiver and computes their spectrograms, handing each to a callback
+ * in-process instead of writing it to disk.
+ *
+ * Every buffer is allocated when the engine is made, from an arena, and each
+ * frame's spectrogram is carved out of the same arena and reclaimed once the
+ * callback returns, so nothing is allocated from the heap while it runs.
+ * Frames are computed in place, and handed to the callback without being
+ * copied.
+ */
+typedef struct spectrel_engine_t *spectrel_engine;
+
+/**
+ * @brief Open the receiver, and plan the short-time DFT.
+ * @param params The parameters of the engine.
+ * @return An opaque pointer to the newly initialised engine.
+ */
+spectrel_engine spectrel_make_engine(const spectrel_engine_params_t *params);
+
+/**
+ * @brief Close the receiver, and release any resources managed by the engine.
+ * It must not be running.
+ * @param engine The engine.
+ */
+void spectrel_free_engine(spectrel_engine engine);
+
+/**
+ * @brief Register the callback each frame is handed to, replacing any
+ * registered before. It must not be called while the engine is running.
+ * @param engine The engine.
+ * @param callback The callback, or NULL to discard frames.
+ * @param user_data Passed to each call of the callback.
+ */
+void spectrel_set_frame_callback(spectrel_engine engine,
+                                 spectrel_frame_callback_t callback,
+                                 void *user_data);
+
+/**
+ * @brief Stream from the receiver on the calling thread, handing a frame to
+ * the callback for each buffer, until the number of buffers has been read,
+ * the callback returns non-zero, or spectrel_stop_engine is called.
+ * @param engine The engine.
+ * @param num_buffers The number of buffers to read, or zero for no limit.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_run_engine(spectrel_engine engine, const size_t num_buffers);
+
+/**
+ * @brief Ask a running engine to stop once the current buffer is done. It may
+ * be called from any thread, including from the callback. If the engine is
+ * not running, the next run stops before reading anything.
+ * @param engine The engine.
+ */
+void spectrel_stop_engine(spectrel_engine engine);
+
+#endif // SPENGINE_H
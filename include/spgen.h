@@ -0,0 +1,114 @@
+#ifndef SPGEN_H
+#define SPGEN_H
+
+#include "spsignal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A supported component of a synthetic signal.
+ */
+typedef enum
+{
+    SPECTREL_TONE,              // A tone at the frequency.
+    SPECTREL_LINEAR_CHIRP,      // A sweep from the frequency to the stop
+                                // frequency, linear in frequency, repeated
+                                // every duration.
+    SPECTREL_EXPONENTIAL_CHIRP, // As for a linear chirp, but the absolute
+                                // frequency changes by the same factor in
+                                // equal times.
+    SPECTREL_PULSE,             // A tone at the frequency, on for the
+                                // duration once every period.
+    SPECTREL_DISPERSED_PULSE,   // An impulse dispersed by the dispersion
+                                // measure, which sweeps down the band from
+                                // the top once every period.
+} spectrel_component_type_t;
+
+/**
+ * @brief A component of a synthetic signal.
+ */
+typedef struct
+{
+    spectrel_component_type_t type;
+    double frequency;      // The baseband frequency, or the frequency a chirp
+                           // starts from, in Hz.
+    double stop_frequency; // The baseband frequency a chirp sweeps to, in Hz.
+    double duration;       // The duration of a sweep or pulse, in seconds.
+    double period;         // The time from one pulse to the next, in seconds.
+    double dm;             // The dispersion measure, in pc cm^-3.
+    double snr;            // The power, relative to the power of the noise or
+                           // to one if there is none, in dB.
+} spectrel_component_t;
+
+/**
+ * @brief Parameters for a generator of synthetic signals.
+ */
+typedef struct
+{
+    double frequency;   // The center frequency, in Hz.
+    double sample_rate; // The sample rate, in Hz.
+    double noise_power; // The power of the complex Gaussian noise, or zero.
+    uint64_t seed;      // The seed the noise is hashed with.
+    const spectrel_component_t *components;
+    size_t num_components;
+} spectrel_generator_params_t;
+
+/**
+ * @brief An opaque pointer to a generator, which synthesises a mixture of
+ * tones, chirps and pulses in Gaussian noise, quickly enough to stand in for
+ * a receiver at high rates.
+ *
+ * No sine or cosine is evaluated per sample. The phase of each component is
+ * carried from sample to sample by complex recurrences, in blocks of
+ * SPECTREL_GENERATOR_LANES samples at a time, and recomputed exactly every
+ * chunk, so rounding errors never compound. Over each chunk, the frequency is
+ * taken to change linearly, which is exact for tones and linear chirps, and
+ * chunks are shortened until it is accurate for the others. The noise is
+ * hashed from the index of each sample, and drawn from a table, so that it
+ * too is vectorised, and does not depend on how it is split into buffers.
+ */
+typedef struct spectrel_generator_t *spectrel_generator;
+
+/**
+ * @brief Make a generator, which starts at sample zero.
+ * @param params The parameters of the generator.
+ * @return An opaque pointer to the newly initialised generator.
+ */
+spectrel_generator
+spectrel_make_generator(const spectrel_generator_params_t *params);
+
+/**
+ * @brief Release any resources managed by the generator.
+ * @param generator The generator.
+ */
+void spectrel_free_generator(spectrel_generator generator);
+
+/**
+ * @brief Fill a signal with the next samples from the generator, carrying on
+ * from where the last signal left off.
+ * @param generator The generator.
+ * @param signal The signal, which must be held in the CF64 format.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_generate(spectrel_generator generator, spectrel_signal_t *signal);
+
+/**
+ * @brief Add a tone or linear chirp to samples, whose phase is
+ * phase + frequency * n + rate * n * n / 2 cycles at sample n.
+ * @param samples The samples, which the chirp is added to.
+ * @param num_samples The number of samples.
+ * @param amplitude The amplitude of the chirp.
+ * @param phase The phase of the first sample, in cycles.
+ * @param frequency The frequency at the first sample, in cycles per sample.
+ * @param rate The rate the frequency changes at, in cycles per sample per
+ * sample. Zero for a tone.
+ */
+void spectrel_add_chirp(fftw_complex *samples,
+                        const size_t num_samples,
+                        const double amplitude,
+                        const double phase,
+                        const double frequency,
+                        const double rate);
+
+#endif // SPGEN_H
@@ -0,0 +1,308 @@
+#ifndef SPKERNEL_H
+#define SPKERNEL_H
+
+#include "spsignal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+// Include <complex.h> before <fftw.3> so that fftw_complex is the native
+// double-precision complex.
+#include <complex.h>
+#include <fftw3.h>
+
+/**
+ * @brief Multiply samples by a window, elementwise.
+ * @param samples The complex samples.
+ * @param window The complex window.
+ * @param out Pointer to where the windowed samples will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_multiply_window(const fftw_complex *samples,
+                              const fftw_complex *window,
+                              fftw_complex *out,
+                              const size_t num_samples);
+
+/**
+ * @brief Multiply samples by a window, elementwise, keeping only the real part
+ * of the result.
+ * @param samples The complex samples.
+ * @param window The complex window.
+ * @param out Pointer to where the real part of the windowed samples will be
+ * written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_multiply_window_real(const fftw_complex *samples,
+                                   const fftw_complex *window,
+                                   double *out,
+                                   const size_t num_samples);
+
+/**
+ * @brief Multiply samples by a window, elementwise, writing the result in the
+ * split layout.
+ * @param samples The complex samples.
+ * @param window The complex window.
+ * @param real Pointer to where the real part of the windowed samples will be
+ * written.
+ * @param imag Pointer to where the imaginary part of the windowed samples will
+ * be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_multiply_window_split(const fftw_complex *samples,
+                                    const fftw_complex *window,
+                                    double *real,
+                                    double *imag,
+                                    const size_t num_samples);
+
+/**
+ * @brief Convert samples from their format to double precision, scale them
+ * and multiply them by a window, elementwise, in a single pass.
+ * @param samples The complex samples, in the given format.
+ * @param format The format of the samples.
+ * @param scale The factor converting samples in the format to sample values.
+ * It is ignored for samples in the CF64 format.
+ * @param window The complex window.
+ * @param out Pointer to where the windowed samples will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_convert_window(const void *samples,
+                             const spectrel_format_t format,
+                             const double scale,
+                             const fftw_complex *window,
+                             fftw_complex *out,
+                             const size_t num_samples);
+
+/**
+ * @brief As for spectrel_convert_window, writing the result in the split
+ * layout.
+ * @param samples The complex samples, in the given format.
+ * @param format The format of the samples.
+ * @param scale The factor converting samples in the format to sample values.
+ * @param window The complex window.
+ * @param real Pointer to where the real part of the windowed samples will be
+ * written.
+ * @param imag Pointer to where the imaginary part of the windowed samples will
+ * be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_convert_window_split(const void *samples,
+                                   const spectrel_format_t format,
+                                   const double scale,
+                                   const fftw_complex *window,
+                                   double *real,
+                                   double *imag,
+                                   const size_t num_samples);
+
+/**
+ * @brief As for spectrel_convert_window, keeping only the real part of the
+ * result.
+ * @param samples The complex samples, in the given format.
+ * @param format The format of the samples.
+ * @param scale The factor converting samples in the format to sample values.
+ * @param window The complex window.
+ * @param out Pointer to where the real part of the windowed samples will be
+ * written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_convert_window_real(const void *samples,
+                                  const spectrel_format_t format,
+                                  const double scale,
+                                  const fftw_complex *window,
+                                  double *out,
+                                  const size_t num_samples);
+
+/**
+ * @brief Compute the power of each sample, |x|^2.
+ * @param samples The complex samples.
+ * @param power Pointer to where the power of each sample will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_compute_power(const fftw_complex *samples,
+                            double *power,
+                            const size_t num_samples);
+
+/**
+ * @brief Compute the power of each sample in decibels, 10 log10(|x|^2).
+ *
+ * The logarithm is evaluated with a branch-free series approximation so that
+ * the loop vectorises. The approximation error is at most about 3e-9 dB
+ * (bounded by 5e-9 dB), so the result is accurate to float precision. Powers
+ * below SPECTREL_MIN_POWER are clamped to it.
+ *
+ * @param samples The complex samples.
+ * @param power_db Pointer to where the power of each sample will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_compute_power_db(const fftw_complex *samples,
+                               float *power_db,
+                               const size_t num_samples);
+
+/**
+ * @brief Compute the power of each sample given in the split layout, |x|^2.
+ * @param real The real part of the samples.
+ * @param imag The imaginary part of the samples.
+ * @param power Pointer to where the power of each sample will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_compute_split_power(const double *real,
+                                  const double *imag,
+                                  double *power,
+                                  const size_t num_samples);
+
+/**
+ * @brief Compute the power of each sample given in the split layout in
+ * decibels, 10 log10(|x|^2), as for spectrel_compute_power_db.
+ * @param real The real part of the samples.
+ * @param imag The imaginary part of the samples.
+ * @param power_db Pointer to where the power of each sample will be written.
+ * @param num_samples The number of samples.
+ */
+void spectrel_compute_split_power_db(const double *real,
+                                     const double *imag,
+                                     float *power_db,
+                                     const size_t num_samples);
+
+/**
+ * @brief Accumulate the power of each sample into running central moments,
+ * with Welford's update extended to the fourth moment.
+ *
+ * Moments are kept per sample, in separate arrays, and every sample shares the
+ * same count, so the update is the same arithmetic at every index and the loop
+ * vectorises. Before the first power is accumulated, the moments must be zero.
+ *
+ * @param power The power of each sample.
+ * @param count The number of powers accumulated, including this one.
+ * @param mean The running mean of each sample.
+ * @param m2 The running sum of squared deviations from the mean.
+ * @param m3 The running sum of cubed deviations from the mean.
+ * @param m4 The running sum of deviations from the mean to the fourth power.
+ * @param min The running min of each sample.
+ * @param max The running max of each sample.
+ * @param num_samples The number of samples.
+ */
+void spectrel_accumulate_moments(const double *power,
+                                 const size_t count,
+                                 double *mean,
+                                 double *m2,
+                                 double *m3,
+                                 double *m4,
+                                 double *min,
+                                 double *max,
+                                 const size_t num_samples);
+
+/**
+ * @brief Accumulate the power of each sample, and its square, into running
+ * sums.
+ * @param power The power of each sample.
+ * @param sum The running sum of the power of each sample.
+ * @param sum_squares The running sum of the squared power of each sample.
+ * @param num_samples The number of samples.
+ */
+void spectrel_accumulate_power_sums(const double *power,
+                                    double *sum,
+                                    double *sum_squares,
+                                    const size_t num_samples);
+
+/**
+ * @brief Slide the DFT of a window along by each of a run of samples, for a
+ * few bins at once. The accumulators hold the DFT of the window, modulated so
+ * that each bin is updated by the change in the window multiplied by a
+ * twiddle, without a rotating phasor whose rounding errors would compound.
+ *
+ * The twiddles are laid out one row per position in the window, with a column
+ * for each bin, so that every bin is updated together.
+ *
+ * @param delta_real The real part of the change in the window at each sample:
+ * the new sample less the sample it replaces.
+ * @param delta_imag The imaginary part of the change at each sample.
+ * @param twiddle_real The real part of the twiddle of each bin, for each
+ * sample of the run, one row after another.
+ * @param twiddle_imag The imaginary part of the twiddles, laid out likewise.
+ * @param acc_real The real part of the accumulator of each bin.
+ * @param acc_imag The imaginary part of the accumulator of each bin.
+ * @param num_bins The number of bins.
+ * @param num_samples The number of samples in the run.
+ */
+void spectrel_slide_dft(const double *delta_real,
+                        const double *delta_imag,
+                        const double *twiddle_real,
+                        const double *twiddle_imag,
+                        double *acc_real,
+                        double *acc_imag,
+                        const size_t num_bins,
+                        const size_t num_samples);
+
+/**
+ * @brief Add a tone to a run of samples, in blocks of SPECTREL_GENERATOR_LANES
+ * samples. Each sample is the phasor of its block multiplied by the phasor of
+ * its lane, and the phasor of each block is that of the last rotated by the
+ * step, so that no sine or cosine is evaluated per sample, and the samples of
+ * a block are computed together.
+ * @param samples The samples, which the tone is added to.
+ * @param lane_real The real part of the phasor of each lane: the rotation
+ * from the first sample of a block to each of its samples.
+ * @param lane_imag The imaginary part of the phasor of each lane.
+ * @param phasor The phasor of the first block.
+ * @param step The rotation from one block to the next.
+ * @param amplitude The amplitude of the tone.
+ * @param num_samples The number of samples.
+ */
+void spectrel_add_tone_blocks(fftw_complex *samples,
+                              const double *lane_real,
+                              const double *lane_imag,
+                              const fftw_complex phasor,
+                              const fftw_complex step,
+                              const double amplitude,
+                              const size_t num_samples);
+
+/**
+ * @brief Add a linear chirp to a run of samples, in blocks of
+ * SPECTREL_GENERATOR_LANES samples. As for spectrel_add_tone_blocks, except
+ * that, since the phase of a linear chirp is quadratic in time, the step is
+ * itself rotated by the curve from one block to the next, and the phasor of
+ * each lane is turned.
+ * @param samples The samples, which the chirp is added to.
+ * @param lane_real The real part of the phasor of each lane, for the first
+ * block. It is left turned past the last block.
+ * @param lane_imag The imaginary part of the phasor of each lane.
+ * @param turn_real The real part of the rotation of the phasor of each lane,
+ * from one block to the next.
+ * @param turn_imag The imaginary part of the rotation of each lane.
+ * @param phasor The phasor of the first block.
+ * @param step The rotation from the first block to the next.
+ * @param curve The rotation of the step from one block to the next.
+ * @param amplitude The amplitude of the chirp.
+ * @param num_samples The number of samples.
+ */
+void spectrel_add_chirp_blocks(fftw_complex *samples,
+                               double *lane_real,
+                               double *lane_imag,
+                               const double *turn_real,
+                               const double *turn_imag,
+                               const fftw_complex phasor,
+                               const fftw_complex step,
+                               const fftw_complex curve,
+                               const double amplitude,
+                               const size_t num_samples);
+
+/**
+ * @brief Fill a run of samples with complex noise. Each sample is hashed from
+ * its index, so that the noise does not depend on how it is split into runs,
+ * and each of its parts is the sum of two values drawn from the table.
+ * @param samples The samples, which are overwritten.
+ * @param table SPECTREL_NOISE_TABLE_SIZE values, of zero mean and unit
+ * variance.
+ * @param key The key the noise is hashed with.
+ * @param index The index of the first sample, counted from the start of the
+ * noise.
+ * @param scale The standard deviation of each part of each sample, divided by
+ * the square root of two.
+ * @param num_samples The number of samples.
+ */
+void spectrel_fill_noise(fftw_complex *samples,
+                         const double *table,
+                         const uint64_t key,
+                         const uint64_t index,
+                         const double scale,
+                         const size_t num_samples);
+
+#endif // SPKERNEL_H
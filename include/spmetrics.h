@@ -0,0 +1,124 @@
+#ifndef SPMETRICS_H
+#define SPMETRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A monotonically increasing count.
+ */
+typedef enum
+{
+    SPECTREL_COUNTER_SAMPLES_READ,  // Samples read from the receiver.
+    SPECTREL_COUNTER_OVERFLOWS,     // Times the receiver dropped samples.
+    SPECTREL_COUNTER_FRAMES,        // Spectrums computed.
+    SPECTREL_COUNTER_BYTES_WRITTEN, // Bytes written to recordings.
+    SPECTREL_COUNTER_ARENA_MISSES,  // Buffers allocated from the heap, since
+                                    // the arena was full.
+    SPECTREL_COUNTER_WRITER_STALLS, // Times the recording thread waited for
+                                    // a free writer buffer.
+    SPECTREL_COUNTER_CANDIDATES,    // Transient candidates found.
+    SPECTREL_COUNTER_DEDISP_DROPS,  // Blocks of spectrums not dedispersed,
+                                    // since the search fell behind.
+    SPECTREL_NUM_COUNTERS,
+} spectrel_counter_t;
+
+/**
+ * @brief A value which may go up and down.
+ */
+typedef enum
+{
+    SPECTREL_GAUGE_STREAMING,      // Whether samples are being read.
+    SPECTREL_GAUGE_SUBSCRIBERS,    // Subscribers to the stream socket.
+    SPECTREL_GAUGE_SUBSCRIBER_LAG, // The most records queued for a subscriber.
+    SPECTREL_GAUGE_ARENA_BYTES,    // The size of the arena.
+    SPECTREL_GAUGE_ARENA_USED,     // The most bytes allocated from the arena.
+    SPECTREL_GAUGE_ARENA_HUGEPAGES, // 2 if the arena is backed by reserved
+                                    // hugepages, 1 if transparent, else 0.
+    SPECTREL_GAUGE_ARENA_NODE,      // The arena's NUMA node, or -1.
+    SPECTREL_GAUGE_READ_INTERVAL_MAX, // The longest time between reads.
+    SPECTREL_GAUGE_WRITES_IN_FLIGHT,  // Writer buffers being written.
+    SPECTREL_GAUGE_RFI_FLAGGED,       // Samples flagged in the last block.
+    SPECTREL_NUM_GAUGES,
+} spectrel_gauge_t;
+
+/**
+ * @brief A distribution of durations.
+ */
+typedef enum
+{
+    SPECTREL_HISTOGRAM_READ,    // Reading each buffer from the receiver.
+    SPECTREL_HISTOGRAM_STFFT,   // Computing the spectrogram of each buffer.
+    SPECTREL_HISTOGRAM_WRITE,   // Writing each spectrogram to the recording.
+    SPECTREL_HISTOGRAM_PUBLISH, // Publishing each spectrogram to consumers.
+    SPECTREL_HISTOGRAM_FFT,     // Computing each spectrum, on average.
+    SPECTREL_HISTOGRAM_READ_INTERVAL, // Between successive reads.
+    SPECTREL_HISTOGRAM_DEDISP,        // Dedispersing each block.
+    SPECTREL_NUM_HISTOGRAMS,
+} spectrel_histogram_t;
+
+/**
+ * @brief Add to a counter. Safe to call from any thread, without locking.
+ * @param counter The counter.
+ * @param value The amount to add.
+ */
+void spectrel_add_counter(const spectrel_counter_t counter,
+                          const uint64_t value);
+
+/**
+ * @brief Set a gauge. Safe to call from any thread, without locking.
+ * @param gauge The gauge.
+ * @param value The new value.
+ */
+void spectrel_set_gauge(const spectrel_gauge_t gauge, const int64_t value);
+
+/**
+ * @brief Record a duration in a histogram. Safe to call from any thread,
+ * without locking.
+ * @param histogram The histogram.
+ * @param duration The duration, in nanoseconds.
+ */
+void spectrel_observe(const spectrel_histogram_t histogram,
+                      const uint64_t duration);
+
+/**
+ * @brief Get the time on a monotonic clock, for timing durations.
+ * @return The time, in nanoseconds.
+ */
+uint64_t spectrel_get_time_ns(void);
+
+/**
+ * @brief Format every metric in the Prometheus text exposition format.
+ * @param buffer Pointer to where the text will be written.
+ * @param size The size of the buffer, in bytes.
+ * @return The length of the text, which is truncated if it is at least the
+ * size of the buffer.
+ */
+size_t spectrel_format_metrics(char *buffer, const size_t size);
+
+/**
+ * @brief An opaque pointer to an exporter structure, which makes the metrics
+ * available to a Prometheus server.
+ */
+typedef struct spectrel_exporter_t *spectrel_exporter;
+
+/**
+ * @brief Export the metrics from a background thread.
+ * @param textfile_path If not NULL, the metrics are periodically written to
+ * this file, for the node exporter's textfile collector. The file is replaced
+ * atomically.
+ * @param port If not zero, the metrics are served over HTTP on this port, on
+ * the loopback interface.
+ * @return An opaque pointer to the newly initialised exporter structure.
+ */
+spectrel_exporter spectrel_make_exporter(const char *textfile_path,
+                                         const int port);
+
+/**
+ * @brief Write the metrics one last time, stop the exporter and release any
+ * resources managed by it.
+ * @param exporter The exporter.
+ */
+void spectrel_free_exporter(spectrel_exporter exporter);
+
+#endif // SPMETRICS_H
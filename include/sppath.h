@@ -1,6 +1,8 @@
 #ifndef SPPATH_H
 #define SPPATH_H
 
+#include "spwriter.h"
+
 #include <stdio.h>
 #include <time.h>
 
@@ -13,29 +15,62 @@
 int spectrel_make_dir(const char *dir);
 
 /**
- * @brief A file to store 64-bit complex samples in the binary format.
+ * @brief A supported on-disk encoding for spectrograms.
+ */
+typedef enum
+{
+    SPECTREL_ENCODING_CF64,    // Complex DFT amplitudes, 64 bits per component.
+    SPECTREL_ENCODING_Q8,      // Log-power, quantised to 8 bits per bin.
+    SPECTREL_ENCODING_Q16,     // Log-power, quantised to 16 bits per bin.
+    SPECTREL_ENCODING_PYRAMID, // Mean and max log-power, decimated. These are
+                               // only written alongside another encoding.
+} spectrel_encoding_t;
+
+/**
+ * @brief Parse the name of an encoding, as it appears in the file extension.
+ * @param name The name of the encoding. Examples: "cf64", "q8", "q16".
+ * @param encoding Pointer to where the parsed encoding will be written.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_parse_encoding(const char *name, spectrel_encoding_t *encoding);
+
+/**
+ * @brief Get the name of an encoding, as it appears in the file extension.
+ * @param encoding The encoding.
+ * @return The name of the encoding, or NULL if it is not recognised.
+ */
+const char *spectrel_get_encoding_name(const spectrel_encoding_t encoding);
+
+/**
+ * @brief A file to store spectrograms in the binary format.
  */
 typedef struct
 {
     FILE *file;
     char *path;
+    spectrel_encoding_t encoding;
+    spectrel_writer writer; // If not NULL, spectrograms are written through
+                            // it rather than with fwrite.
 } spectrel_file_t;
 
 /**
  * @brief Open a new file stream, with the input time
  * embedded in the file name. The file will be created with path:
  *
- * <dir>/<timestamp>_<driver>.cf64
+ * <dir>/<timestamp>_<driver>.<encoding>
  *
  * where the timestamp is UTC and ISO 8601 standard compliant.
  *
  * @param dir The parent directory for the file.
  * @param t Elapsed time since the unix epoch.
  * @param driver An SDR driver supported by Soapy.
+ * @param encoding How spectrograms are encoded in the file.
  * @return A file struct.
  */
-spectrel_file_t *
-spectrel_open_file(const char *dir, const time_t *t, const char *driver);
+spectrel_file_t *spectrel_open_file(const char *dir,
+                                    const time_t *t,
+                                    const char *driver,
+                                    const spectrel_encoding_t encoding);
 
 /**
  * @brief Close a file, and release any resources managed by it.
@@ -0,0 +1,67 @@
+#ifndef SPPYRAMID_H
+#define SPPYRAMID_H
+
+#include "spsignal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every pyramid level file.
+ */
+#define SPECTREL_PYRAMID_MAGIC "SPECPYR"
+
+/**
+ * @brief The header at the start of every pyramid level file.
+ *
+ * It is followed by one record per decimated spectrum. Each record holds the
+ * mean log-power of each sample, followed by the max log-power of each sample,
+ * as 32-bit floats in dB. Samples are stored in the order they are output by
+ * the DFT.
+ */
+typedef struct
+{
+    char magic[8];                     // SPECTREL_PYRAMID_MAGIC
+    uint32_t level;                    // The level, starting from one.
+    uint32_t decimation;               // 2^level, in both time and frequency.
+    uint64_t num_samples_per_spectrum; // The number of samples per spectrum.
+} spectrel_pyramid_header_t;
+
+/**
+ * @brief An opaque pointer to a pyramid structure, which maintains
+ * progressively decimated copies of a spectrogram in side files.
+ */
+typedef struct spectrel_pyramid_t *spectrel_pyramid;
+
+/**
+ * @brief Create the side files for each level of the pyramid. Level k is
+ * written to <path>.p<k>, and is decimated by 2^k in both time and frequency.
+ * @param path The path of the file the full resolution spectrogram is
+ * written to.
+ * @param num_samples_per_spectrum The number of samples in each spectrum. Must
+ * be divisible by 2^num_levels.
+ * @param num_levels The number of levels.
+ * @return An opaque pointer to the newly initialised pyramid structure.
+ */
+spectrel_pyramid spectrel_make_pyramid(const char *path,
+                                       const size_t num_samples_per_spectrum,
+                                       const size_t num_levels);
+
+/**
+ * @brief Close the side files, and release any resources managed by the
+ * pyramid. Spectrums which have not been completely pooled are discarded.
+ * @param pyramid The pyramid.
+ */
+void spectrel_free_pyramid(spectrel_pyramid pyramid);
+
+/**
+ * @brief Pool each spectrum of the spectrogram into every level of the
+ * pyramid, writing decimated spectrums as soon as they are complete.
+ * @param pyramid The pyramid.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_update_pyramid(spectrel_pyramid pyramid,
+                            const spectrel_spectrogram_t *s);
+
+#endif // SPPYRAMID_H
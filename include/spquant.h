@@ -0,0 +1,97 @@
+#ifndef SPQUANT_H
+#define SPQUANT_H
+
+#include "sppath.h"
+#include "spsignal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The header stored before the codes of each quantised spectrum.
+ *
+ * The log-power of each spectral component is reconstructed as
+ *
+ * offset + scale * code [dB]
+ *
+ * where the offset is the smallest log-power in the spectrum, and the scale is
+ * the spacing between quantisation levels. The reconstruction error is at
+ * most half the scale (plus float rounding), which is the dynamic range of the
+ * spectrum divided by 510 for 8-bit codes, or 131070 for 16-bit codes.
+ */
+typedef struct
+{
+    float offset; // The log-power of code zero. [dB]
+    float scale;  // The spacing between quantisation levels. [dB]
+} spectrel_quantised_header_t;
+
+/**
+ * @brief Quantise log-power values to 8-bit codes.
+ * @param power_db The log-power of each spectral component, in dB.
+ * @param num_samples The number of spectral components.
+ * @param header Pointer to where the offset and scale will be written.
+ * @param codes Pointer to where the codes will be written.
+ */
+void spectrel_quantise_u8(const float *power_db,
+                          const size_t num_samples,
+                          spectrel_quantised_header_t *header,
+                          uint8_t *codes);
+
+/**
+ * @brief Quantise log-power values to 16-bit codes.
+ * @param power_db The log-power of each spectral component, in dB.
+ * @param num_samples The number of spectral components.
+ * @param header Pointer to where the offset and scale will be written.
+ * @param codes Pointer to where the codes will be written.
+ */
+void spectrel_quantise_u16(const float *power_db,
+                           const size_t num_samples,
+                           spectrel_quantised_header_t *header,
+                           uint16_t *codes);
+
+/**
+ * @brief Reconstruct log-power values from 8-bit codes.
+ * @param header The offset and scale stored with the codes.
+ * @param codes The codes.
+ * @param num_samples The number of spectral components.
+ * @param power_db Pointer to where the log-power, in dB, will be written.
+ */
+void spectrel_dequantise_u8(const spectrel_quantised_header_t *header,
+                            const uint8_t *codes,
+                            const size_t num_samples,
+                            float *power_db);
+
+/**
+ * @brief Reconstruct log-power values from 16-bit codes.
+ * @param header The offset and scale stored with the codes.
+ * @param codes The codes.
+ * @param num_samples The number of spectral components.
+ * @param power_db Pointer to where the log-power, in dB, will be written.
+ */
+void spectrel_dequantise_u16(const spectrel_quantised_header_t *header,
+                             const uint16_t *codes,
+                             const size_t num_samples,
+                             float *power_db);
+
+/**
+ * @brief Get the number of bytes taken by one quantised spectrum on disk,
+ * including the header.
+ * @param encoding Either SPECTREL_ENCODING_Q8 or SPECTREL_ENCODING_Q16.
+ * @param num_samples_per_spectrum The number of samples in each spectrum.
+ * @return The number of bytes, or zero if the encoding is not quantised.
+ */
+size_t spectrel_get_quantised_spectrum_size(
+    const spectrel_encoding_t encoding, const size_t num_samples_per_spectrum);
+
+/**
+ * @brief Write a spectrogram to file as quantised log-power. Each spectrum is
+ * stored as a header, followed by one code per spectral component.
+ *
+ * @param s The spectrogram structure.
+ * @param f The file to write to. The encoding must be quantised.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_write_quantised_spectrogram(spectrel_spectrogram_t *s,
+                                         spectrel_file_t *f);
+
+#endif // SPQUANT_H
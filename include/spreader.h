@@ -0,0 +1,177 @@
+#ifndef SPREADER_H
+#define SPREADER_H
+
+#include "sppath.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief An opaque pointer to a reader structure, which maps a recorded
+ * spectrogram into memory without loading it.
+ */
+typedef struct spectrel_reader_t *spectrel_reader;
+
+/**
+ * @brief How samples are combined when a preview is downsampled.
+ */
+typedef enum
+{
+    SPECTREL_PREVIEW_SAMPLE, // Take the first sample in each cell. Only the
+                             // spectrums that are sampled are read from disk.
+    SPECTREL_PREVIEW_MEAN,   // Take the mean log-power in each cell.
+    SPECTREL_PREVIEW_MAX,    // Take the max log-power in each cell.
+} spectrel_preview_mode_t;
+
+/**
+ * @brief A rectangular region of a spectrogram, and the resolution at which it
+ * should be previewed.
+ *
+ * Samples are indexed in order of increasing frequency (as if the spectrums
+ * were fftshifted), so that a contiguous range of samples is a contiguous
+ * range of frequencies.
+ */
+typedef struct
+{
+    size_t start_spectrum; // The first spectrum in the region.
+    size_t end_spectrum;   // One past the last spectrum in the region.
+    size_t start_sample;   // The first sample in the region.
+    size_t end_sample;     // One past the last sample in the region.
+    size_t num_rows;       // The number of spectrums in the preview.
+    size_t num_columns;    // The number of samples in each preview spectrum.
+    spectrel_preview_mode_t mode;
+} spectrel_slice_t;
+
+/**
+ * @brief Open a recorded spectrogram for reading. The encoding is inferred from
+ * the file extension. Pyramid levels (<path>.p<k>) are also supported, in
+ * which case the mean log-power is read unless a preview asks for the max.
+ * Whether the input was real-valued, and when each spectrum was captured,
+ * are read from the timestamp file, <path>.times, if there is one.
+ * @param path The path to the recording.
+ * @param window_size The window size used to record the file. Each spectrum
+ * holds that many samples, or window_size / 2 + 1 if the input was
+ * real-valued. Ignored for pyramid levels, which record the number of samples
+ * in their header.
+ * @return An opaque pointer to the newly initialised reader structure.
+ */
+spectrel_reader spectrel_open_reader(const char *path,
+                                     const size_t window_size);
+
+/**
+ * @brief Unmap the recording, and release any resources managed by the reader.
+ * @param reader The reader.
+ */
+void spectrel_close_reader(spectrel_reader reader);
+
+/**
+ * @brief Get the number of complete spectrums in the recording.
+ * @param reader The reader.
+ * @return The number of spectrums.
+ */
+size_t spectrel_get_num_spectrums(spectrel_reader reader);
+
+/**
+ * @brief Get the number of samples in each spectrum of the recording.
+ * @param reader The reader.
+ * @return The number of samples per spectrum.
+ */
+size_t spectrel_get_num_samples_per_spectrum(spectrel_reader reader);
+
+/**
+ * @brief Get the encoding of the recording.
+ * @param reader The reader.
+ * @return The encoding.
+ */
+spectrel_encoding_t spectrel_get_reader_encoding(spectrel_reader reader);
+
+/**
+ * @brief Get the factor by which the recording is decimated, in both time and
+ * frequency, relative to the spectrogram it was made from.
+ * @param reader The reader.
+ * @return One for full resolution recordings, or 2^k for pyramid level k.
+ */
+size_t spectrel_get_reader_decimation(spectrel_reader reader);
+
+/**
+ * @brief Get whether the recording is of a real-valued input, so that each
+ * spectrum holds only the non-negative frequencies, in ascending order.
+ * @param reader The reader.
+ * @return True for half spectrums, or false for whole spectrums in the order
+ * output by the DFT.
+ */
+bool spectrel_is_reader_real(spectrel_reader reader);
+
+/**
+ * @brief Get the sample rate the recording was made at, from its timestamp
+ * file.
+ * @param reader The reader.
+ * @return The sample rate, in Hz, or zero if there is no timestamp file.
+ */
+double spectrel_get_reader_sample_rate(spectrel_reader reader);
+
+/**
+ * @brief Get the window hop the recording was made with, from its timestamp
+ * file. For pyramid levels, this is the hop of the recording they were made
+ * from, before decimation.
+ * @param reader The reader.
+ * @return The window hop, in samples, or zero if there is no timestamp file.
+ */
+size_t spectrel_get_reader_window_hop(spectrel_reader reader);
+
+/**
+ * @brief Get whether the time each spectrum was captured is known, from the
+ * timestamp file of the recording.
+ * @param reader The reader.
+ * @return True if spectrel_get_reader_time can be used.
+ */
+bool spectrel_has_reader_times(spectrel_reader reader);
+
+/**
+ * @brief Get the time a spectrum was captured, from the timestamp file of the
+ * recording. Unlike assuming spectrums are evenly spaced, this accounts for
+ * samples dropped between buffers.
+ * @param reader The reader.
+ * @param index The index of the spectrum.
+ * @return The time of the spectrum, in nanoseconds since the Unix epoch
+ * (UTC), or zero if it is not known.
+ */
+int64_t spectrel_get_reader_time(spectrel_reader reader, const size_t index);
+
+/**
+ * @brief Get a pointer to a spectrum, as it is encoded in the recording. The
+ * pointer is valid until the reader is closed.
+ * @param reader The reader.
+ * @param index The index of the spectrum.
+ * @return A pointer into the mapped recording, or NULL if out of range.
+ */
+const void *spectrel_get_spectrum(spectrel_reader reader, const size_t index);
+
+/**
+ * @brief Decode the log-power of each sample in a spectrum, in order of
+ * increasing frequency.
+ * @param reader The reader.
+ * @param index The index of the spectrum.
+ * @param power_db Pointer to where the log-power, in dB, will be written. Must
+ * hold the number of samples per spectrum.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_read_power_db(spectrel_reader reader,
+                           const size_t index,
+                           float *power_db);
+
+/**
+ * @brief Downsample a region of the recording to a preview of log-power
+ * values, in dB. Only the spectrums in the region are touched.
+ * @param reader The reader.
+ * @param slice The region, and the resolution of the preview.
+ * @param preview Pointer to where the preview will be written, in row
+ * (spectrum) major order. Must hold num_rows * num_columns values.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_read_preview(spectrel_reader reader,
+                          const spectrel_slice_t *slice,
+                          float *preview);
+
+#endif // SPREADER_H
@@ -0,0 +1,66 @@
+#ifndef SPREALTIME_H
+#define SPREALTIME_H
+
+#include <pthread.h>
+
+/**
+ * @brief Check a list of CPUs, such as "2", "2,3" or "0-3,6".
+ * @param cpus The list of CPUs.
+ * @return Zero if the list is valid and names only CPUs on this host, or an
+ * error code otherwise.
+ */
+int spectrel_check_cpus(const char *cpus);
+
+/**
+ * @brief Pin the calling thread to a list of CPUs.
+ * @param cpus The list of CPUs, as for spectrel_check_cpus.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_pin_thread(const char *cpus);
+
+/**
+ * @brief Run the calling thread under the SCHED_FIFO policy, so that it is
+ * only preempted by threads of a higher real-time priority. This needs
+ * CAP_SYS_NICE, or an RLIMIT_RTPRIO of at least the priority.
+ * @param priority The real-time priority, from 1 (lowest) to 99.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_set_realtime_priority(const int priority);
+
+/**
+ * @brief Lock every page the process has mapped, and will map, into memory,
+ * so that it is never paged out. Freed memory is kept by the allocator rather
+ * than returned to the kernel, so that allocating it again does not fault.
+ * This needs CAP_IPC_LOCK, or a large enough RLIMIT_MEMLOCK.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_lock_memory(void);
+
+/**
+ * @brief Fault in the stack of the calling thread, to the depth it will be
+ * used to, so that growing it later does not fault.
+ */
+void spectrel_prefault_stack(void);
+
+/**
+ * @brief Set the CPUs background threads run on. Threads started by the
+ * control socket, the stream socket and the metrics exporter are moved onto
+ * them, so that they do not compete with the recording thread.
+ * Call this before pinning the recording thread.
+ * @param cpus The list of CPUs, as for spectrel_check_cpus, or NULL for the
+ * CPUs the process may run on when this is called.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_set_background_cpus(const char *cpus);
+
+/**
+ * @brief Demote a newly started background thread, so that it runs under the
+ * normal policy and on the background CPUs, even if the thread which started
+ * it has been given a real-time priority or pinned. Until background CPUs are
+ * set, the thread is left on the CPUs it was started on. Failures are
+ * reported, but do not stop the thread.
+ * @param thread The background thread.
+ */
+void spectrel_demote_thread(pthread_t thread);
+
+#endif // SPREALTIME_H
@@ -38,6 +38,19 @@ int spectrel_free_receiver(spectrel_receiver receiver);
 spectrel_receiver spectrel_make_receiver(const char *driver,
                                          spectrel_receiver_params_t *params);
 
+/**
+ * @brief Create a buffer to read samples from the receiver into. It holds
+ * samples in the format they are streamed in, which is the native format of
+ * the device where it is supported.
+ * @param receiver The receiver structure.
+ * @param num_samples The number of samples in the buffer.
+ * @param arena The arena to allocate the buffer from, or NULL.
+ * @return The buffer.
+ */
+spectrel_signal_t *spectrel_make_stream_buffer(spectrel_receiver receiver,
+                                               const size_t num_samples,
+                                               spectrel_arena arena);
+
 /**
  * @brief Get the current configured parameters for a receiver.
  * @param receiver The receiver structure to be queried.
@@ -48,7 +61,26 @@ int spectrel_get_parameters(spectrel_receiver receiver,
                             spectrel_receiver_params_t *params);
 
 /**
- * @brief Activate a stream, to prepare for reading.
+ * @brief Retune the receiver, first checking the frequency is in range. This
+ * may be called while the stream is active.
+ * @param receiver The receiver structure.
+ * @param frequency The center frequency, in Hz.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_set_frequency(spectrel_receiver receiver, const double frequency);
+
+/**
+ * @brief Set the gain of the receiver, first checking it is in range. This
+ * may be called while the stream is active.
+ * @param receiver The receiver structure.
+ * @param gain The gain, in dB.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_set_gain(spectrel_receiver receiver, const double gain);
+
+/**
+ * @brief Activate a stream, to prepare for reading. The times of the samples
+ * read are anchored to the system clock (UTC) here.
  * @param receiver A pointer to the receiver structure.
  * @return Zero for success, or an error code on failure.
  */
@@ -65,10 +97,18 @@ int spectrel_deactivate_stream(spectrel_receiver receiver);
  * @brief Fill the buffer with samples from the receiver.
  * @param receiver A pointer to the receiver structure.
  * @param buffer A pointer to the buffer to fill with samples from the
- * receiver.
+ * receiver, made by spectrel_make_stream_buffer.
+ * @param time Pointer to where the time of the first sample is written, in
+ * nanoseconds since the Unix epoch (UTC). It is taken from the hardware clock
+ * if the device has one, otherwise it is inferred by counting samples since
+ * the stream was activated. If the receiver drops samples part way through,
+ * the samples already read are discarded and the buffer is filled again, so
+ * it never spans the gap.
  * @return Zero for success, or an error code on failure.
  */
-int spectrel_read_stream(spectrel_receiver receiver, spectrel_signal_t *buffer);
+int spectrel_read_stream(spectrel_receiver receiver,
+                         spectrel_signal_t *buffer,
+                         int64_t *time);
 
 /**
  * @brief Print properties of the receiver, and the values of it's configured
@@ -0,0 +1,125 @@
+#ifndef SPRFI_H
+#define SPRFI_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every mask file.
+ */
+#define SPECTREL_MASK_MAGIC "SPECMSK"
+
+/**
+ * @brief The header at the start of every mask file.
+ *
+ * It is followed by one record per block. Each record is a
+ * spectrel_mask_record_t, followed by the mask: one bit per sample, set if the
+ * sample was flagged, packed least significant bit first into
+ * (num_samples_per_spectrum + 7) / 8 bytes. Samples are in the order they are
+ * output by the DFT.
+ */
+typedef struct
+{
+    char magic[8];                     // SPECTREL_MASK_MAGIC
+    uint64_t num_samples_per_spectrum; // The number of samples per spectrum.
+    uint64_t num_spectrums_per_block;  // The number of spectrums per block.
+    double threshold; // How far the spectral kurtosis of a sample must be
+                      // from one to be flagged, in standard deviations.
+} spectrel_mask_header_t;
+
+/**
+ * @brief The start of each record in a mask file.
+ */
+typedef struct
+{
+    uint64_t index;       // The index of the first spectrum in the block,
+                          // counted from the start of the recording.
+    uint32_t num_flagged; // The number of samples flagged.
+    uint32_t reserved;    // Zero.
+} spectrel_mask_record_t;
+
+/**
+ * @brief What is done to the samples which are flagged.
+ */
+typedef enum
+{
+    SPECTREL_RFI_FLAG,        // Flagged in the mask file, but left untouched.
+    SPECTREL_RFI_ZERO,        // Set to zero.
+    SPECTREL_RFI_INTERPOLATE, // Scaled to the power interpolated, in
+                              // frequency, between the nearest samples
+                              // which are not flagged.
+} spectrel_rfi_action_t;
+
+/**
+ * @brief Parse the name of an RFI action.
+ * @param name The name of the action: "flag", "zero" or "interpolate".
+ * @param action Pointer to where the parsed action will be written.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_parse_rfi_action(const char *name, spectrel_rfi_action_t *action);
+
+/**
+ * @brief Get the name of an RFI action.
+ * @param action The action.
+ * @return The name, or NULL if the action is not recognised.
+ */
+const char *spectrel_get_rfi_action_name(const spectrel_rfi_action_t action);
+
+/**
+ * @brief An opaque pointer to an RFI flagger, which flags samples affected by
+ * interference with the spectral kurtosis estimator.
+ *
+ * The spectral kurtosis of each sample is estimated over blocks of spectrums.
+ * It is one for Gaussian noise, below one for steady interference, such as a
+ * carrier, and above one for intermittent interference. Samples are flagged
+ * when it strays from one by more than the threshold. The mask of each block
+ * is applied to the spectrums of the next, so that masking adds no latency.
+ */
+typedef struct spectrel_rfi_t *spectrel_rfi;
+
+/**
+ * @brief Create the side file for the masks, <path>.mask.
+ *
+ * Flagged samples are interpolated from their neighbours in frequency, so
+ * across DC for the spectrums of complex-valued inputs, whose samples are in
+ * the order output by the DFT.
+ *
+ * @param path The path of the file the spectrogram is written to.
+ * @param num_samples_per_spectrum The number of samples in each spectrum.
+ * @param is_real If true, the spectrums are of real-valued inputs, and hold
+ * only the non-negative frequencies, in ascending order.
+ * @param num_spectrums_per_block The number of spectrums in each block, at
+ * least 2.
+ * @param threshold How far the spectral kurtosis must be from one for a
+ * sample to be flagged, in standard deviations.
+ * @param action What is done to the samples which are flagged.
+ * @return An opaque pointer to the newly initialised flagger.
+ */
+spectrel_rfi spectrel_make_rfi(const char *path,
+                               const size_t num_samples_per_spectrum,
+                               const bool is_real,
+                               const size_t num_spectrums_per_block,
+                               const double threshold,
+                               const spectrel_rfi_action_t action);
+
+/**
+ * @brief Close the side file, and release any resources managed by the
+ * flagger. Spectrums which have not filled a block are discarded.
+ * @param rfi The flagger.
+ */
+void spectrel_free_rfi(spectrel_rfi rfi);
+
+/**
+ * @brief Accumulate each spectrum of the spectrogram into the current block,
+ * then mask it with the mask of the last block, writing the mask of the
+ * current block once it is complete.
+ * @param rfi The flagger.
+ * @param s The spectrogram, which is masked in place.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_flag_rfi(spectrel_rfi rfi, spectrel_spectrogram_t *s);
+
+#endif // SPRFI_H
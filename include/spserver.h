@@ -0,0 +1,115 @@
+#ifndef SPSERVER_H
+#define SPSERVER_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of the header sent to each subscriber. The
+ * last is the version, so that subscribers expecting a header without the
+ * center frequency are not misled.
+ */
+#define SPECTREL_SERVER_MAGIC "SPECSR2"
+
+/**
+ * The index of a record which holds a new header, rather than a spectrum.
+ */
+#define SPECTREL_SERVER_HEADER_INDEX UINT64_MAX
+
+/**
+ * @brief The header sent to each subscriber as soon as it connects.
+ *
+ * It is followed by one record per decimated spectrum: the index of the
+ * spectrum as a 64-bit unsigned integer, then the log-power of each sample as
+ * 32-bit floats in dB. Samples are sent in the order they are output by the
+ * DFT. If a subscriber falls too far behind, it is disconnected.
+ *
+ * When the configuration changes, subscribers stay connected, and are sent the
+ * index SPECTREL_SERVER_HEADER_INDEX followed by a new header. The records
+ * after it follow the new header.
+ */
+typedef struct
+{
+    char magic[8];                     // SPECTREL_SERVER_MAGIC
+    uint32_t decimation;               // Decimation in time and frequency.
+    uint32_t num_samples_per_spectrum; // The number of samples per spectrum.
+    double sample_rate;                // The sample rate, in Hz.
+    double center_frequency;           // The center frequency, in Hz.
+} spectrel_server_header_t;
+
+/**
+ * @brief An opaque pointer to a server structure, which streams decimated
+ * power spectrums to local subscribers over a Unix domain socket.
+ */
+typedef struct spectrel_server_t *spectrel_server;
+
+/**
+ * @brief Check that spectrums can be pooled by the decimation without any
+ * cell straddling the wrap from the positive to the negative frequencies.
+ * @param num_samples_per_spectrum The number of samples in each spectrum.
+ * @param decimation The factor by which spectrums are mean pooled.
+ * @return True if both the number of samples, and the number of samples up
+ * to the first negative frequency, are divisible by the decimation.
+ */
+bool spectrel_is_valid_decimation(const size_t num_samples_per_spectrum,
+                                  const size_t decimation);
+
+/**
+ * @brief Listen for subscribers on a Unix domain socket. Subscribers are
+ * served from a background thread.
+ * @param socket_path The path to bind the socket to. Any existing file at
+ * the path is replaced.
+ * @param num_samples_per_spectrum The number of samples in each spectrum
+ * published to the server. Must be valid for the decimation, as checked by
+ * spectrel_is_valid_decimation.
+ * @param decimation The factor by which spectrums are mean pooled, in both
+ * time and frequency.
+ * @param sample_rate The sample rate, in Hz.
+ * @param center_frequency The center frequency, in Hz.
+ * @return An opaque pointer to the newly initialised server structure.
+ */
+spectrel_server spectrel_make_server(const char *socket_path,
+                                     const size_t num_samples_per_spectrum,
+                                     const size_t decimation,
+                                     const double sample_rate,
+                                     const double center_frequency);
+
+/**
+ * @brief Change the configuration of the spectrums published to the server,
+ * keeping subscribers connected. Each is sent the new header once it has
+ * finished the record it is part way through. Spectrums published before the
+ * change, but not yet sent, are dropped.
+ * @param server The server.
+ * @param num_samples_per_spectrum The number of samples in each spectrum
+ * published to the server. Must be valid for the decimation, as checked by
+ * spectrel_is_valid_decimation.
+ * @param sample_rate The sample rate, in Hz.
+ * @param center_frequency The center frequency, in Hz.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_reconfigure_server(spectrel_server server,
+                                const size_t num_samples_per_spectrum,
+                                const double sample_rate,
+                                const double center_frequency);
+
+/**
+ * @brief Disconnect all subscribers, stop the server and release any
+ * resources managed by it.
+ * @param server The server.
+ */
+void spectrel_free_server(spectrel_server server);
+
+/**
+ * @brief Publish each spectrum of the spectrogram to the subscribers. This
+ * never blocks on subscribers, and returns immediately if there are none.
+ * @param server The server.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_publish_spectrogram(spectrel_server server,
+                                 const spectrel_spectrogram_t *s);
+
+#endif // SPSERVER_H
@@ -0,0 +1,193 @@
+#ifndef SPSHM_H
+#define SPSHM_H
+
+#include "spsignal.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of the shared memory.
+ */
+#define SPECTREL_SHM_MAGIC "SPECSHM"
+
+/**
+ * The version of the shared memory layout.
+ */
+#define SPECTREL_SHM_VERSION 3
+
+/**
+ * Marks a slot which is being written.
+ */
+#define SPECTREL_SHM_INVALID_INDEX UINT64_MAX
+
+/**
+ * @brief The header at the start of the shared memory.
+ *
+ * The frequency axis (one double per sample, in Hz relative to the center
+ * frequency) starts at frequencies_offset bytes. The ring of slots starts at
+ * slots_offset bytes, each slot_size bytes long. The write index is on its own
+ * cache line, so that polling it does not contend with the other fields.
+ *
+ * The ring outlives changes to the configuration (such as the center
+ * frequency or window). The configuration count is odd while the header, the
+ * frequency axis and the layout of the ring are rewritten, and even once they
+ * are consistent again. Every slot is invalidated when the configuration
+ * changes, and the shared memory only ever grows, so a reader which sees the
+ * count change need only reread the header (and remap, if it grew).
+ */
+typedef struct
+{
+    char magic[8];                     // SPECTREL_SHM_MAGIC
+    uint32_t version;                  // SPECTREL_SHM_VERSION
+    uint32_t num_slots;                // The number of slots in the ring.
+    uint64_t num_samples_per_spectrum; // The number of spectral components.
+    uint64_t window_hop;               // The window hop.
+    double sample_rate;                // The sample rate, in Hz.
+    double center_frequency;           // The center frequency, in Hz.
+    uint64_t frequencies_offset;       // The offset of the frequency axis.
+    uint64_t slots_offset;             // The offset of the first slot.
+    uint64_t slot_size;                // The size of each slot.
+    uint8_t reserved[56];
+    _Atomic uint64_t write_index;   // The number of spectrums published.
+    _Atomic uint64_t configuration; // Odd while the configuration changes.
+    uint8_t padding[48];
+} spectrel_shm_header_t;
+
+/**
+ * @brief The header at the start of each slot in the ring, followed by the
+ * complex DFT amplitudes of the spectrum.
+ *
+ * Spectrum n is written to slot n % num_slots. The index is set to
+ * SPECTREL_SHM_INVALID_INDEX while the slot is written, then to n. A reader
+ * has a consistent spectrum if the index is n both before and after reading.
+ */
+typedef struct
+{
+    _Atomic uint64_t index; // The index of the spectrum held in the slot.
+    int64_t time; // The time of the spectrum, in nanoseconds since the Unix
+                  // epoch (UTC), or zero if it is not known.
+    uint64_t reserved[2];
+} spectrel_shm_slot_t;
+
+/**
+ * @brief An opaque pointer to a shared memory ring, which publishes
+ * spectrums to other processes.
+ */
+typedef struct spectrel_shm_t *spectrel_shm;
+
+/**
+ * @brief Create and map a named POSIX shared memory ring. Any existing shared
+ * memory with the same name is replaced.
+ * @param name The name of the shared memory, such as "/spectrel".
+ * @param num_slots The number of spectrums held in the ring.
+ * @param window_size The window size.
+ * @param is_real If true, each spectrum holds only the non-redundant spectral
+ * components of a real-valued input.
+ * @param window_hop The window hop.
+ * @param sample_rate The sample rate, in Hz.
+ * @param center_frequency The center frequency, in Hz.
+ * @return An opaque pointer to the newly initialised shared memory ring.
+ */
+spectrel_shm spectrel_make_shm(const char *name,
+                               const size_t num_slots,
+                               const size_t window_size,
+                               const bool is_real,
+                               const size_t window_hop,
+                               const double sample_rate,
+                               const double center_frequency);
+
+/**
+ * @brief Change the configuration the ring describes, without unlinking it,
+ * so that readers stay attached. The spectrums in the ring are dropped, and
+ * the write index carries on from where it was.
+ * @param shm The shared memory ring, which must have been made.
+ * @param window_size The window size.
+ * @param is_real If true, each spectrum holds only the non-redundant spectral
+ * components of a real-valued input.
+ * @param window_hop The window hop.
+ * @param sample_rate The sample rate, in Hz.
+ * @param center_frequency The center frequency, in Hz.
+ * @return Zero for success, or an error code on failure, in which case the
+ * configuration is unchanged.
+ */
+int spectrel_reconfigure_shm(spectrel_shm shm,
+                             const size_t window_size,
+                             const bool is_real,
+                             const size_t window_hop,
+                             const double sample_rate,
+                             const double center_frequency);
+
+/**
+ * @brief Unmap the shared memory, and release any resources managed by it. If
+ * the ring was made (rather than opened), it is also unlinked. Readers which
+ * still have it mapped are unaffected.
+ * @param shm The shared memory ring.
+ */
+void spectrel_free_shm(spectrel_shm shm);
+
+/**
+ * @brief Publish each spectrum of the spectrogram to the ring. This never
+ * waits on readers.
+ * @param shm The shared memory ring.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_publish_shm(spectrel_shm shm, const spectrel_spectrogram_t *s);
+
+/**
+ * @brief Map an existing shared memory ring for reading.
+ * @param name The name of the shared memory.
+ * @return An opaque pointer to the mapped ring, or NULL on failure.
+ */
+spectrel_shm spectrel_open_shm(const char *name);
+
+/**
+ * @brief Take up a change to the configuration of a ring opened for reading,
+ * remapping it if it grew. Until then, every read fails once the
+ * configuration has changed.
+ * @param shm The shared memory ring.
+ * @return Zero for success, whether or not the configuration changed, or an
+ * error code if it is being changed right now (so try again) or could not be
+ * remapped.
+ */
+int spectrel_refresh_shm(spectrel_shm shm);
+
+/**
+ * @brief Get the header of a mapped shared memory ring. The header may move
+ * when the ring is refreshed.
+ * @param shm The shared memory ring.
+ * @return The header.
+ */
+const spectrel_shm_header_t *spectrel_get_shm_header(spectrel_shm shm);
+
+/**
+ * @brief Get the number of spectrums published to the ring so far.
+ * @param shm The shared memory ring.
+ * @return The write index.
+ */
+uint64_t spectrel_get_shm_write_index(spectrel_shm shm);
+
+/**
+ * @brief Start reading a spectrum in place, without copying it.
+ * @param shm The shared memory ring.
+ * @param index The index of the spectrum.
+ * @return A pointer to the samples of the spectrum, or NULL if it has not been
+ * published yet, has already been overwritten, or the configuration has
+ * changed since the ring was opened or last refreshed.
+ */
+const fftw_complex *spectrel_begin_shm_read(spectrel_shm shm,
+                                            const uint64_t index);
+
+/**
+ * @brief Finish reading a spectrum in place.
+ * @param shm The shared memory ring.
+ * @param index The index of the spectrum.
+ * @return True if the spectrum was not overwritten, nor the configuration
+ * changed, while it was read, in which case whatever was read is consistent.
+ */
+bool spectrel_end_shm_read(spectrel_shm shm, const uint64_t index);
+
+#endif // SPSHM_H
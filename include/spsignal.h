@@ -1,21 +1,65 @@
 #ifndef SPSIGNAL_H
 #define SPSIGNAL_H
 
+#include "sparena.h"
 #include "sppath.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 // Include <complex.h> before <fftw.3> so that fftw_complex is the native
 // double-precision complex.
 #include <complex.h>
 #include <fftw3.h>
 
+/**
+ * @brief A format complex samples may be held in, named as in SoapySDR.
+ */
+typedef enum
+{
+    SPECTREL_FORMAT_CF64, // Double-precision floats.
+    SPECTREL_FORMAT_CF32, // Single-precision floats.
+    SPECTREL_FORMAT_CS16, // Signed 16-bit integers.
+    SPECTREL_FORMAT_CS8,  // Signed 8-bit integers.
+} spectrel_format_t;
+
+/**
+ * @brief Parse the name of a sample format.
+ * @param name The name of the format, such as "CS16".
+ * @param format Pointer to where the parsed format will be written.
+ * @return Zero for success, or an error code if the format is not supported.
+ * No error is printed, so that callers may fall back to another format.
+ */
+int spectrel_parse_format(const char *name, spectrel_format_t *format);
+
+/**
+ * @brief Get the name of a sample format.
+ * @param format The format.
+ * @return The name, or NULL if the format is not recognised.
+ */
+const char *spectrel_get_format_name(const spectrel_format_t format);
+
+/**
+ * @brief Get the size of a sample in a given format.
+ * @param format The format.
+ * @return The size of one complex sample, in bytes.
+ */
+size_t spectrel_get_sample_size(const spectrel_format_t format);
+
 /**
  * @brief A discrete, complex-valued signal.
  */
 typedef struct
 {
-    size_t num_samples;    /** The number of samples in the signal. */
-    fftw_complex *samples; /** The sample values. */
+    size_t num_samples;       /** The number of samples in the signal. */
+    fftw_complex *samples;    /** The sample values. NULL unless the format
+                                  is CF64. */
+    spectrel_format_t format; /** The format the samples are held in. */
+    void *data;               /** The samples, in their format. */
+    double scale;             /** The factor converting samples in their
+                                  format to sample values. */
+    spectrel_arena arena;     /** The arena the samples were allocated from,
+                                  or NULL if they are on the heap. */
 } spectrel_signal_t;
 
 /**
@@ -48,6 +92,30 @@ typedef struct
     double value;
 } spectrel_constant_params_t;
 
+/**
+ * @brief How complex values are laid out in memory.
+ */
+typedef enum
+{
+    SPECTREL_LAYOUT_INTERLEAVED, // Real and imaginary parts alternate.
+    SPECTREL_LAYOUT_SPLIT,       // Real and imaginary parts in separate arrays.
+} spectrel_layout_t;
+
+/**
+ * @brief Parse the name of a layout.
+ * @param name The name of the layout: "interleaved" or "split".
+ * @param layout Pointer to where the parsed layout will be written.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_parse_layout(const char *name, spectrel_layout_t *layout);
+
+/**
+ * @brief Get the name of a layout.
+ * @param layout The layout.
+ * @return The name, or NULL if the layout is not recognised.
+ */
+const char *spectrel_get_layout_name(const spectrel_layout_t layout);
+
 /**
  * @brief The spectrogram of a signal in units of DFT amplitude.
  */
@@ -56,12 +124,25 @@ typedef struct
     size_t num_spectrums; /** The number of spectrums in the spectrogram. */
     size_t num_samples_per_spectrum; /** The number of samples in each
                                          spectrum. */
+    spectrel_layout_t layout; /** How the DFT amplitudes are laid out. */
     fftw_complex *samples; /** The DFT amplitude of each spectral component,
-                               stored as a flat array. */
+                               stored as a flat array. NULL in the split
+                               layout. */
+    double *real;          /** The real part of each DFT amplitude, stored as a
+                               flat array. NULL in the interleaved layout. */
+    double *imag;          /** The imaginary part of each DFT amplitude, stored
+                               as a flat array. NULL in the interleaved
+                               layout. */
     double *times;       /** The physical times assigned to each spectrum in the
-                             spectrogram. */
+                             spectrogram, relative to the first. */
+    int64_t time;        /** The absolute time of the first spectrum, in
+                             nanoseconds since the Unix epoch (UTC), or zero
+                             if unknown. */
     double *frequencies; /** The baseband frequencies assigned to each spectral
                              component. */
+    spectrel_arena arena; /** The arena the spectrogram and its members were
+                              allocated from, or NULL if they are on the
+                              heap. */
 } spectrel_spectrogram_t;
 
 /**
@@ -92,6 +173,30 @@ spectrel_make_signal(const size_t num_samples,
                      const spectrel_signal_type_t signal_type,
                      void *params);
 
+/**
+ * @brief Make the window applied to each spectrum of a short-time DFT.
+ * @param window_size The number of samples in the window.
+ * @return The window.
+ */
+spectrel_signal_t *spectrel_make_window(const size_t window_size);
+
+/**
+ * @brief Allocate a signal held in a given format, such as the native format
+ * of a receiver. The samples are converted as they are windowed, so there is
+ * no separate conversion pass.
+ * @param num_samples The number of samples in the signal.
+ * @param format The format the samples are held in.
+ * @param scale The factor converting samples in the format to sample values.
+ * Signals in the CF64 format are never scaled, so it is ignored for them.
+ * @param arena The arena to allocate the samples from, or NULL. If the arena is
+ * full, the samples are allocated from the heap.
+ * @return The signal, with every sample zero.
+ */
+spectrel_signal_t *spectrel_make_native_signal(const size_t num_samples,
+                                               const spectrel_format_t format,
+                                               const double scale,
+                                               spectrel_arena arena);
+
 /**
  * @brief An opaque structure encapsulating the information to carry out an
  * in-place 1D DFT on a buffer.
@@ -109,11 +214,74 @@ typedef struct spectrel_plan_t *spectrel_plan;
 void spectrel_free_plan(spectrel_plan p);
 
 /**
- * @brief Plan an in-place 1D DFT on a buffer.
+ * @brief Plan an in-place 1D DFT on a buffer. Plans may be made and freed from
+ * any thread.
  * @param buffer_size The number of samples in the buffer.
+ * @param layout The layout of the buffer, and of the spectrograms computed
+ * with the plan. The split layout is transformed with FFTW's split-array guru
+ * interface.
+ * @param is_real If true, only the real part of the windowed buffer is
+ * transformed, and spectrograms computed with the plan hold only the
+ * buffer_size / 2 + 1 non-redundant spectral components.
  * @return The plan.
  */
-spectrel_plan spectrel_make_plan(const size_t buffer_size);
+spectrel_plan spectrel_make_plan(const size_t buffer_size,
+                                 const spectrel_layout_t layout,
+                                 const bool is_real);
+
+/**
+ * @brief Plan a zoom DFT, which evaluates the DFT of each window on a dense
+ * grid of frequencies over an interval, rather than over the whole band, with
+ * the chirp-z transform (Bluestein's algorithm). Spectrograms computed with
+ * the plan hold num_bins spectral components, at start_frequency + k *
+ * (stop_frequency - start_frequency) / num_bins, in ascending order.
+ *
+ * Each window costs two DFTs of a little over window_size + num_bins samples,
+ * planned as by spectrel_make_plan, whatever the spacing of the grid. The DFT
+ * of a window zero-padded to sample_rate / spacing samples would give the
+ * same values, at far greater cost when the interval is narrow.
+ *
+ * @param window_size The number of samples in each window.
+ * @param layout The layout of the spectrograms computed with the plan.
+ * @param is_real If true, only the real part of the windowed buffer is
+ * transformed.
+ * @param sample_rate The sample rate of the signal.
+ * @param start_frequency The lowest baseband frequency evaluated, in Hz.
+ * @param stop_frequency The end of the interval evaluated, in Hz, which is
+ * itself excluded.
+ * @param num_bins The number of frequencies evaluated.
+ * @return The plan.
+ */
+spectrel_plan spectrel_make_zoom_plan(const size_t window_size,
+                                      const spectrel_layout_t layout,
+                                      const bool is_real,
+                                      const double sample_rate,
+                                      const double start_frequency,
+                                      const double stop_frequency,
+                                      const size_t num_bins);
+
+/**
+ * @brief Get the number of spectral components in each spectrum of the DFT.
+ * @param window_size The number of samples in each window.
+ * @param is_real If true, the input is real-valued and only the non-redundant
+ * spectral components are kept.
+ * @return The number of spectral components.
+ */
+size_t spectrel_get_num_bins(const size_t window_size, const bool is_real);
+
+/**
+ * @brief Compute the baseband frequency of each spectral component, in the
+ * order they are output by the DFT.
+ * @param frequencies Pointer to where the frequencies will be written.
+ * @param window_size The number of samples in each window.
+ * @param sample_rate The sample rate of the signal.
+ * @param is_real If true, the input is real-valued and only the non-negative
+ * frequencies are written, as given by spectrel_get_num_bins.
+ */
+void spectrel_compute_frequencies(double *frequencies,
+                                  const size_t window_size,
+                                  const double sample_rate,
+                                  const bool is_real);
 
 /**
  * @brief Print properties of the spectrogram, and the values of each
@@ -125,7 +293,9 @@ void spectrel_describe_spectrogram(const spectrel_spectrogram_t *spectrogram);
 /**
  * @brief Frees memory used by a spectrogram.
  *
- * This frees all the underlying memory and clears the members.
+ * This frees all the underlying memory and clears the members. A spectrogram
+ * allocated from an arena, along with its members, is released by rewinding
+ * the arena instead.
  *
  * @param signal Pointer to the spectrogram to free.
  */
@@ -141,20 +311,98 @@ void spectrel_free_spectrogram(spectrel_spectrogram_t *spectrogram);
  * @param p  A pre-planned FFTW plan for in-place transforms on the buffer.
  * @param buffer An empty buffer, used for repeated in-place DFTs.
  * @param window The window function, same length as the buffer.
- * @param signal The input signal.
+ * @param signal The input signal, in any format. Samples are converted as
+ * they are windowed.
  * @param window_hop The number of samples the window advances per frame.
  * @param sample_rate The sample rate of the signal.
+ * @param arena The arena to allocate the spectrogram from, or NULL. If the
+ * arena is full, the spectrogram is allocated from the heap.
  * @return A spectrogram containing the amplitude of each spectral component.
  */
 spectrel_spectrogram_t *spectrel_stfft(spectrel_plan p,
                                        const spectrel_signal_t *window,
                                        const spectrel_signal_t *signal,
                                        const size_t window_hop,
-                                       const double sample_rate);
+                                       const double sample_rate,
+                                       spectrel_arena arena);
+
+/**
+ * @brief Get the number of bytes a spectrogram computed by spectrel_stfft
+ * takes up in an arena, for sizing arenas.
+ * @param signal_size The number of samples in the signal.
+ * @param window_size The number of samples in each window.
+ * @param window_hop The number of samples the window advances per frame.
+ * @param layout The layout of the spectrogram.
+ * @param is_real If true, the input is real-valued.
+ * @return The number of bytes.
+ */
+size_t spectrel_get_stfft_size(const size_t signal_size,
+                               const size_t window_size,
+                               const size_t window_hop,
+                               const spectrel_layout_t layout,
+                               const bool is_real);
+
+/**
+ * @brief As for spectrel_get_stfft_size, for a spectrogram computed with a
+ * zoom plan.
+ * @param signal_size The number of samples in the signal.
+ * @param window_size The number of samples in each window.
+ * @param window_hop The number of samples the window advances per frame.
+ * @param num_bins The number of frequencies the zoom plan evaluates.
+ * @param layout The layout of the spectrogram.
+ * @return The number of bytes.
+ */
+size_t spectrel_get_zoom_stfft_size(const size_t signal_size,
+                                    const size_t window_size,
+                                    const size_t window_hop,
+                                    const size_t num_bins,
+                                    const spectrel_layout_t layout);
+
+/**
+ * @brief Copy a spectrum out of a spectrogram, in the interleaved layout.
+ * @param s The spectrogram.
+ * @param n The index of the spectrum.
+ * @param samples Pointer to where the DFT amplitudes will be written.
+ */
+void spectrel_copy_spectrum(const spectrel_spectrogram_t *s,
+                            const size_t n,
+                            fftw_complex *samples);
+
+/**
+ * @brief Compute the power of each sample in a spectrum, whatever the layout
+ * of the spectrogram.
+ * @param s The spectrogram.
+ * @param n The index of the spectrum.
+ * @param power Pointer to where the power of each sample will be written.
+ */
+void spectrel_compute_spectrum_power(const spectrel_spectrogram_t *s,
+                                     const size_t n,
+                                     double *power);
+
+/**
+ * @brief Compute the power of each sample in a spectrum in decibels, whatever
+ * the layout of the spectrogram.
+ * @param s The spectrogram.
+ * @param n The index of the spectrum.
+ * @param power_db Pointer to where the power of each sample will be written.
+ */
+void spectrel_compute_spectrum_power_db(const spectrel_spectrogram_t *s,
+                                        const size_t n,
+                                        float *power_db);
+
+/**
+ * @brief Get the absolute time of a spectrum in a spectrogram.
+ * @param s The spectrogram.
+ * @param n The index of the spectrum.
+ * @return The time, in nanoseconds since the Unix epoch (UTC).
+ */
+int64_t spectrel_get_spectrum_time(const spectrel_spectrogram_t *s,
+                                   const size_t n);
 
 /**
  * @brief Write a spectrogram to file in column (spectrum) major order. Only the
- * spectrums are saved, any metadata is discarded.
+ * spectrums are saved, any metadata is discarded. The spectrums are encoded
+ * according to the encoding of the file.
  *
  * @param s The spectrogram structure.
  * @param f The file to write to.
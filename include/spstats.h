@@ -0,0 +1,85 @@
+#ifndef SPSTATS_H
+#define SPSTATS_H
+
+#include "spsignal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every statistics file.
+ */
+#define SPECTREL_STATS_MAGIC "SPECSTA"
+
+/**
+ * @brief The header at the start of every statistics file.
+ *
+ * It is followed by one frame per interval. Each frame is a
+ * spectrel_stats_frame_t, followed by the mean, variance, min, max and
+ * kurtosis of the power of each sample over the interval, in that order, as
+ * num_samples_per_spectrum 32-bit floats each. Powers are in units of DFT
+ * amplitude squared, and samples are stored in the order they are output by
+ * the DFT.
+ */
+typedef struct
+{
+    char magic[8];                     // SPECTREL_STATS_MAGIC
+    uint64_t num_samples_per_spectrum; // The number of samples per spectrum.
+    uint64_t num_spectrums_per_frame;  // The number of spectrums in each
+                                       // interval.
+    double spectrum_interval;          // The time between spectrums, in
+                                       // seconds.
+} spectrel_stats_header_t;
+
+/**
+ * @brief The start of each frame in a statistics file.
+ */
+typedef struct
+{
+    int64_t time;           // The time of the first spectrum in the interval,
+                            // in nanoseconds since the Unix epoch (UTC), or
+                            // zero if unknown.
+    uint64_t index;         // The index of the first spectrum in the interval,
+                            // counted from the start of the recording.
+    uint64_t num_spectrums; // The number of spectrums in the interval. Less
+                            // than in the header only for the last frame.
+} spectrel_stats_frame_t;
+
+/**
+ * @brief An opaque pointer to a statistics structure, which accumulates the
+ * statistics of each sample over fixed intervals, and writes them to a side
+ * file.
+ */
+typedef struct spectrel_stats_t *spectrel_stats;
+
+/**
+ * @brief Create the side file for the statistics, <path>.stats.
+ * @param path The path of the file the spectrogram is written to.
+ * @param num_samples_per_spectrum The number of samples in each spectrum.
+ * @param num_spectrums_per_frame The number of spectrums in each interval.
+ * @param spectrum_interval The time between spectrums, in seconds.
+ * @return An opaque pointer to the newly initialised statistics structure.
+ */
+spectrel_stats spectrel_make_stats(const char *path,
+                                   const size_t num_samples_per_spectrum,
+                                   const size_t num_spectrums_per_frame,
+                                   const double spectrum_interval);
+
+/**
+ * @brief Write the frame for the last, partial, interval, then close the side
+ * file and release any resources managed by the statistics structure.
+ * @param stats The statistics structure.
+ */
+void spectrel_free_stats(spectrel_stats stats);
+
+/**
+ * @brief Accumulate each spectrum of the spectrogram, writing a frame each
+ * time an interval is complete.
+ * @param stats The statistics structure.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_update_stats(spectrel_stats stats,
+                          const spectrel_spectrogram_t *s);
+
+#endif // SPSTATS_H
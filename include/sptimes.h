@@ -0,0 +1,79 @@
+#ifndef SPTIMES_H
+#define SPTIMES_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every timestamp file. They were SPECTIM
+ * before the header recorded whether the input was real-valued, so that
+ * shorter, older headers are not misread.
+ */
+#define SPECTREL_TIMES_MAGIC "SPECTI2"
+
+/**
+ * @brief The header at the start of every timestamp file.
+ *
+ * It is followed by one record per spectrogram written to the recording. The
+ * time of spectrum n in a spectrogram is the time in its record, plus
+ * n * window_hop / sample_rate.
+ */
+typedef struct
+{
+    char magic[8];       // SPECTREL_TIMES_MAGIC
+    uint64_t window_hop; // The window hop, in samples.
+    double sample_rate;  // The sample rate, in Hz.
+    uint64_t is_real;    // Non-zero if the input was real-valued, so that
+                         // each spectrum holds only the window_size / 2 + 1
+                         // non-negative frequencies, in ascending order.
+} spectrel_times_header_t;
+
+/**
+ * @brief A record in a timestamp file.
+ */
+typedef struct
+{
+    int64_t time;           // The time of the first spectrum, in nanoseconds
+                            // since the Unix epoch (UTC).
+    uint64_t num_spectrums; // The number of spectrums in the spectrogram.
+} spectrel_times_record_t;
+
+/**
+ * @brief An opaque pointer to a timestamp file structure, which records when
+ * each spectrum in a recording was captured.
+ */
+typedef struct spectrel_times_t *spectrel_times;
+
+/**
+ * @brief Create the timestamp file for a recording, at <path>.times.
+ * @param path The path of the file the spectrogram is written to.
+ * @param window_hop The number of samples the window advances per spectrum.
+ * @param sample_rate The sample rate of the signal.
+ * @param is_real Whether the input was real-valued, so that the recording
+ * holds half spectrums.
+ * @return An opaque pointer to the newly initialised timestamp structure.
+ */
+spectrel_times spectrel_make_times(const char *path,
+                                   const size_t window_hop,
+                                   const double sample_rate,
+                                   const bool is_real);
+
+/**
+ * @brief Close the timestamp file, and release any resources managed by it.
+ * @param times The timestamp file.
+ */
+void spectrel_free_times(spectrel_times times);
+
+/**
+ * @brief Record the time of a spectrogram written to the recording.
+ * @param times The timestamp file.
+ * @param s The spectrogram.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_write_times(spectrel_times times,
+                         const spectrel_spectrogram_t *s);
+
+#endif // SPTIMES_H
@@ -0,0 +1,104 @@
+#ifndef SPTRACK_H
+#define SPTRACK_H
+
+#include "spsignal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The magic bytes at the start of every track file.
+ */
+#define SPECTREL_TRACK_MAGIC "SPECTRK"
+
+/**
+ * @brief The header at the start of every track file.
+ *
+ * It is followed by the frequency of each tracked bin, as num_bins doubles in
+ * Hz, then by one record per buffer. Each record is a spectrel_track_record_t,
+ * followed by num_outputs outputs of num_bins complex values each, as pairs of
+ * 32-bit floats. Output k of the recording is the DFT of the window ending at
+ * sample (k + 1) * window_hop - 1, in the same units as the spectrogram.
+ * Windows which start before the recording are zero-padded.
+ */
+typedef struct
+{
+    char magic[8];        // SPECTREL_TRACK_MAGIC
+    uint64_t num_bins;    // The number of bins tracked.
+    uint64_t window_size; // The window size, in samples.
+    uint64_t window_hop;  // The number of samples between outputs.
+    double sample_rate;   // The sample rate, in Hz.
+} spectrel_track_header_t;
+
+/**
+ * @brief The start of each record in a track file.
+ */
+typedef struct
+{
+    int64_t time;         // The time of the last sample in the window of the
+                          // first output, in nanoseconds since the Unix
+                          // epoch (UTC), or zero if unknown.
+    uint64_t index;       // The index of the first output, counted from the
+                          // start of the recording.
+    uint64_t num_outputs; // The number of outputs in the record.
+} spectrel_track_record_t;
+
+/**
+ * @brief Parameters for tracking a few frequencies.
+ */
+typedef struct
+{
+    double frequency;          // The centre frequency, in Hz.
+    double sample_rate;        // The sample rate, in Hz.
+    size_t window_size;        // The window size, in samples.
+    size_t window_hop;         // The number of samples between outputs.
+    size_t buffer_size;        // The number of samples in each buffer.
+    bool is_real;              // Whether the input signal is real-valued.
+    const double *frequencies; // The frequencies to track, in Hz.
+    size_t num_frequencies;    // The number of frequencies to track.
+} spectrel_track_params_t;
+
+/**
+ * @brief An opaque pointer to a tracker, which follows the DFT bins nearest a
+ * few chosen frequencies at every sample, or every few, with a sliding DFT.
+ *
+ * The DFT of each bin is updated by the change in the window at each sample,
+ * with the modulated sliding DFT (Duda, 2010), so that each sample costs a
+ * complex multiply-add per bin whatever the window size. Bins are updated
+ * together, so that the update is vectorised across them. The window is the
+ * boxcar window of the spectrogram, and windows span buffers.
+ */
+typedef struct spectrel_tracker_t *spectrel_tracker;
+
+/**
+ * @brief Create the side file for the tracked bins, <path>.track.
+ * @param path The path of the file the spectrogram is written to.
+ * @param params The parameters of the tracker.
+ * @return An opaque pointer to the newly initialised tracker.
+ */
+spectrel_tracker spectrel_make_tracker(const char *path,
+                                       const spectrel_track_params_t *params);
+
+/**
+ * @brief Close the side file, and release any resources managed by the
+ * tracker.
+ * @param tracker The tracker.
+ */
+void spectrel_free_tracker(spectrel_tracker tracker);
+
+/**
+ * @brief Slide the DFT of each tracked bin along a buffer of samples, and
+ * write a record of its outputs.
+ * @param tracker The tracker.
+ * @param buffer The buffer, in any format, holding the number of samples the
+ * tracker was made for.
+ * @param buffer_time The time of the first sample in the buffer, in
+ * nanoseconds since the Unix epoch (UTC), or zero if unknown.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_track(spectrel_tracker tracker,
+                   const spectrel_signal_t *buffer,
+                   const int64_t buffer_time);
+
+#endif // SPTRACK_H
@@ -0,0 +1,53 @@
+#ifndef SPTUNE_H
+#define SPTUNE_H
+
+#include "spargparse.h"
+#include "spsignal.h"
+
+#include <stddef.h>
+
+/**
+ * @brief The settings chosen by autotuning, and how they performed.
+ */
+typedef struct
+{
+    size_t buffer_size;       // The buffer size, in samples.
+    spectrel_layout_t layout; // The layout of the DSP chain.
+    double headroom; // The rate samples were processed at, as a multiple of
+                     // the sample rate.
+} spectrel_tuning_t;
+
+/**
+ * @brief Benchmark the DSP chain, from filling a buffer through to writing the
+ * spectrogram, for each candidate buffer size and layout, and choose the
+ * settings with the most headroom.
+ *
+ * Samples come from a synthetic source rather than the receiver, so that the
+ * chain is timed as fast as it can run. The source is held in
+ * SPECTREL_AUTOTUNE_FORMAT, and copied into buffers in that format, so that
+ * samples are converted as they are windowed, as when recording.
+ * Spectrograms are written to a scratch file in the output directory, which is
+ * removed afterwards. Larger buffers amortise more overhead but use more
+ * cache, so the smallest buffer within SPECTREL_AUTOTUNE_TOLERANCE of the best
+ * headroom is chosen.
+ *
+ * @param args The parsed arguments. The sample rate, window size, window hop,
+ * encoding, input and directory are used, the buffer size and layout are
+ * tuned.
+ * @param tuning Pointer to where the chosen settings will be written.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_autotune(const spectrel_args_t *args, spectrel_tuning_t *tuning);
+
+/**
+ * @brief Write tuned settings to a config file, which may be passed to -C.
+ * @param path The path to the config file. Any existing file is replaced.
+ * @param args The parsed arguments the settings were tuned for.
+ * @param tuning The tuned settings.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_write_tuning(const char *path,
+                          const spectrel_args_t *args,
+                          const spectrel_tuning_t *tuning);
+
+#endif // SPTUNE_H
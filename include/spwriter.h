@@ -0,0 +1,90 @@
+#ifndef SPWRITER_H
+#define SPWRITER_H
+
+#include <stddef.h>
+
+/**
+ * @brief How recordings are written.
+ */
+typedef enum
+{
+    SPECTREL_WRITER_STDIO,    // Written with fwrite, by the recording thread.
+    SPECTREL_WRITER_THREAD,   // Written with pwrite, by a background thread.
+    SPECTREL_WRITER_IO_URING, // Submitted to the kernel through io_uring.
+} spectrel_writer_backend_t;
+
+/**
+ * @brief Parse the name of a writer backend.
+ * @param name The name of the backend: "stdio", "thread" or "io_uring".
+ * @param backend Pointer to where the parsed backend will be written.
+ * @return Zero for success, or an error code on failure.
+ */
+int spectrel_parse_writer_backend(const char *name,
+                                  spectrel_writer_backend_t *backend);
+
+/**
+ * @brief Get the name of a writer backend.
+ * @param backend The backend.
+ * @return The name, or NULL if the backend is not recognised.
+ */
+const char *
+spectrel_get_writer_backend_name(const spectrel_writer_backend_t backend);
+
+/**
+ * @brief An opaque pointer to an asynchronous writer.
+ *
+ * Data is encoded straight into large buffers from a fixed pool. Each buffer
+ * is submitted once it is full, and returned to the pool once it has been
+ * written, so the recording thread only waits if every buffer is in flight.
+ * Writes are appended to the file, at increasing offsets.
+ */
+typedef struct spectrel_writer_t *spectrel_writer;
+
+/**
+ * @brief Start writing a file asynchronously.
+ * @param fd The file descriptor, open for writing, and empty.
+ * @param backend SPECTREL_WRITER_IO_URING or SPECTREL_WRITER_THREAD. If
+ * io_uring is not available, the thread backend is used instead.
+ * @param num_in_flight The most buffers which may be being written at once.
+ * @return An opaque pointer to the newly initialised writer.
+ */
+spectrel_writer spectrel_make_writer(const int fd,
+                                     const spectrel_writer_backend_t backend,
+                                     const size_t num_in_flight);
+
+/**
+ * @brief Wait for every write to complete, then release any resources
+ * managed by the writer. The file descriptor is left open.
+ * @param writer The writer.
+ * @return Zero if every write succeeded, or an error code otherwise.
+ */
+int spectrel_free_writer(spectrel_writer writer);
+
+/**
+ * @brief Get the backend a writer is actually using.
+ * @param writer The writer.
+ * @return The backend.
+ */
+spectrel_writer_backend_t spectrel_get_writer_backend(spectrel_writer writer);
+
+/**
+ * @brief Reserve space at the end of the file, to encode data into. The space
+ * must be filled before the next call on the writer.
+ * @param writer The writer.
+ * @param num_bytes The number of bytes to reserve, at most
+ * SPECTREL_WRITER_BUFFER_SIZE.
+ * @return Pointer to the space, or NULL if an earlier write failed.
+ */
+void *spectrel_reserve_write(spectrel_writer writer, const size_t num_bytes);
+
+/**
+ * @brief Submit the buffer being filled if it has been held for longer than
+ * SPECTREL_WRITER_MAX_AGE, so that quiet recordings still reach the disk.
+ * Completed writes are reaped, without waiting.
+ * @param writer The writer.
+ * @return Zero if every write so far has succeeded, or an error code
+ * otherwise.
+ */
+int spectrel_commit_writes(spectrel_writer writer);
+
+#endif // SPWRITER_H
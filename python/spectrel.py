@@ -0,0 +1,542 @@
+"""Python bindings for libspectrel, over ctypes.
+
+Spectrograms are exposed as NumPy arrays which view the memory libspectrel
+computed them in, or the recording it mapped, without copying. Every call
+into the library releases the GIL, so capture and the short-time DFT run
+alongside other Python threads.
+
+Build the library first, with `make`. It is found through the SPECTREL_LIBRARY
+environment variable, then beside this module's parent directory (the root of
+the repository), then on the library search path.
+
+Usage:
+    import spectrel
+
+    def on_frame(frame):
+        power = np.abs(frame.spectrogram) ** 2  # Only valid during the call.
+        print(frame.index, frame.time, power.max())
+
+    with spectrel.Engine("rtlsdr", 95.8e6, 2e6, 2e6, 30) as engine:
+        engine.run(on_frame, num_buffers=100)
+"""
+
+import ctypes
+import ctypes.util
+import os
+from typing import Callable, Optional
+
+import numpy as np
+
+# The version of the streaming API these bindings are written against.
+ENGINE_API_VERSION = 2
+
+LAYOUT_INTERLEAVED, LAYOUT_SPLIT = 0, 1
+FORMAT_CF64, FORMAT_CF32 = 0, 1
+ENCODING_CF64, ENCODING_Q8, ENCODING_Q16, ENCODING_PYRAMID = 0, 1, 2, 3
+
+
+class _ReceiverParams(ctypes.Structure):
+    _fields_ = [
+        ("frequency", ctypes.c_double),
+        ("sample_rate", ctypes.c_double),
+        ("bandwidth", ctypes.c_double),
+        ("gain", ctypes.c_double),
+    ]
+
+
+class _EngineParams(ctypes.Structure):
+    _fields_ = [
+        ("driver", ctypes.c_char_p),
+        ("receiver", _ReceiverParams),
+        ("window_size", ctypes.c_size_t),
+        ("window_hop", ctypes.c_size_t),
+        ("buffer_size", ctypes.c_size_t),
+        ("layout", ctypes.c_int),
+        ("is_real", ctypes.c_bool),
+    ]
+
+
+class _Signal(ctypes.Structure):
+    _fields_ = [
+        ("num_samples", ctypes.c_size_t),
+        ("samples", ctypes.c_void_p),
+        ("format", ctypes.c_int),
+        ("data", ctypes.c_void_p),
+        ("scale", ctypes.c_double),
+        ("arena", ctypes.c_void_p),
+    ]
+
+
+class _Spectrogram(ctypes.Structure):
+    _fields_ = [
+        ("num_spectrums", ctypes.c_size_t),
+        ("num_samples_per_spectrum", ctypes.c_size_t),
+        ("layout", ctypes.c_int),
+        ("samples", ctypes.c_void_p),
+        ("real", ctypes.c_void_p),
+        ("imag", ctypes.c_void_p),
+        ("times", ctypes.c_void_p),
+        ("time", ctypes.c_int64),
+        ("frequencies", ctypes.c_void_p),
+        ("arena", ctypes.c_void_p),
+    ]
+
+
+_FrameCallback = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p)
+
+
+def _load_library() -> ctypes.CDLL:
+    candidates = [
+        os.environ.get("SPECTREL_LIBRARY"),
+        os.path.join(
+            os.path.dirname(os.path.abspath(__file__)), "..", "libspectrel.so"
+        ),
+        ctypes.util.find_library("spectrel"),
+    ]
+    for candidate in candidates:
+        if candidate and (os.path.sep not in candidate or os.path.exists(candidate)):
+            break
+    else:
+        raise OSError("libspectrel.so not found, build it with `make`")
+
+    # Functions of a CDLL release the GIL for the duration of each call.
+    lib = ctypes.CDLL(candidate)
+    signatures = {
+        "spectrel_get_engine_api_version": (ctypes.c_int, []),
+        "spectrel_make_engine": (ctypes.c_void_p, [ctypes.POINTER(_EngineParams)]),
+        "spectrel_free_engine": (None, [ctypes.c_void_p]),
+        "spectrel_set_frame_callback": (
+            None,
+            [ctypes.c_void_p, _FrameCallback, ctypes.c_void_p],
+        ),
+        "spectrel_run_engine": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_size_t]),
+        "spectrel_stop_engine": (None, [ctypes.c_void_p]),
+        "spectrel_get_frame_index": (ctypes.c_uint64, [ctypes.c_void_p]),
+        "spectrel_get_frame_time": (ctypes.c_int64, [ctypes.c_void_p]),
+        "spectrel_get_frame_frequency": (ctypes.c_double, [ctypes.c_void_p]),
+        "spectrel_get_frame_sample_rate": (ctypes.c_double, [ctypes.c_void_p]),
+        "spectrel_get_frame_window_hop": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "spectrel_get_frame_num_spectrums": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "spectrel_get_frame_num_samples_per_spectrum": (
+            ctypes.c_size_t,
+            [ctypes.c_void_p],
+        ),
+        "spectrel_get_frame_layout": (ctypes.c_int, [ctypes.c_void_p]),
+        "spectrel_get_frame_samples": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "spectrel_get_frame_real": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "spectrel_get_frame_imag": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "spectrel_get_frame_times": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "spectrel_get_frame_frequencies": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "spectrel_make_plan": (
+            ctypes.c_void_p,
+            [ctypes.c_size_t, ctypes.c_int, ctypes.c_bool],
+        ),
+        "spectrel_make_zoom_plan": (
+            ctypes.c_void_p,
+            [
+                ctypes.c_size_t,
+                ctypes.c_int,
+                ctypes.c_bool,
+                ctypes.c_double,
+                ctypes.c_double,
+                ctypes.c_double,
+                ctypes.c_size_t,
+            ],
+        ),
+        "spectrel_free_plan": (None, [ctypes.c_void_p]),
+        "spectrel_stfft": (
+            ctypes.POINTER(_Spectrogram),
+            [
+                ctypes.c_void_p,
+                ctypes.POINTER(_Signal),
+                ctypes.POINTER(_Signal),
+                ctypes.c_size_t,
+                ctypes.c_double,
+                ctypes.c_void_p,
+            ],
+        ),
+        "spectrel_free_spectrogram": (None, [ctypes.POINTER(_Spectrogram)]),
+        "spectrel_open_reader": (ctypes.c_void_p, [ctypes.c_char_p, ctypes.c_size_t]),
+        "spectrel_close_reader": (None, [ctypes.c_void_p]),
+        "spectrel_get_num_spectrums": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "spectrel_get_num_samples_per_spectrum": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "spectrel_get_reader_encoding": (ctypes.c_int, [ctypes.c_void_p]),
+        "spectrel_get_reader_decimation": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "spectrel_is_reader_real": (ctypes.c_bool, [ctypes.c_void_p]),
+        "spectrel_get_spectrum": (ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_size_t]),
+        "spectrel_read_power_db": (
+            ctypes.c_int,
+            [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p],
+        ),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    # The structures are laid out as in the version the bindings are written
+    # against, so any other would be misread.
+    version = lib.spectrel_get_engine_api_version()
+    if version != ENGINE_API_VERSION:
+        raise OSError(
+            f"libspectrel has streaming API version {version}, but these "
+            f"bindings need version {ENGINE_API_VERSION}"
+        )
+    return lib
+
+
+_lib = _load_library()
+
+
+class _Handle:
+    """Owns an object allocated by libspectrel, and frees it once nothing
+    refers to it, including any array viewing its memory."""
+
+    def __init__(self, pointer, free):
+        self.pointer = pointer
+        self._free = free
+
+    def __del__(self):
+        if self.pointer:
+            self._free(self.pointer)
+            self.pointer = None
+
+
+class _View:
+    """Exposes memory owned by libspectrel to NumPy, keeping its owner alive
+    for as long as any array views it."""
+
+    def __init__(self, owner, address: int, dtype, shape: tuple, writable: bool):
+        self._owner = owner
+        dtype = np.dtype(dtype)
+        self.__array_interface__ = {
+            # The second entry is the read-only flag.
+            "data": (address, not writable),
+            "typestr": dtype.str,
+            "descr": dtype.descr,
+            "shape": shape,
+            "version": 3,
+        }
+
+
+def _view(
+    owner, address: Optional[int], dtype, shape: tuple, writable: bool = True
+) -> np.ndarray:
+    """View memory owned by libspectrel. Memory which is mapped read-only, such
+    as a recording, must not be viewed as writable, since writing to it
+    faults."""
+    if not address:
+        raise ValueError("No memory to view")
+    return np.asarray(_View(owner, address, dtype, shape, writable))
+
+
+class Spectrogram:
+    """A spectrogram computed by libspectrel, viewed in place.
+
+    In the interleaved layout, `spectrogram` is a complex array of shape
+    (num_spectrums, num_samples_per_spectrum). In the split layout, `real` and
+    `imag` are float arrays of that shape instead. Samples are in the order
+    they are output by the DFT.
+    """
+
+    def __init__(self, pointer, owner=None):
+        # Without an owner, the spectrogram is freed once neither it nor any
+        # of its arrays remain.
+        if owner is None:
+            owner = _Handle(pointer, _lib.spectrel_free_spectrogram)
+        s = pointer.contents
+        self._view_arrays(
+            owner,
+            s.num_spectrums,
+            s.num_samples_per_spectrum,
+            s.layout,
+            s.time,
+            s.samples,
+            s.real,
+            s.imag,
+            s.times,
+            s.frequencies,
+        )
+
+    def _view_arrays(
+        self,
+        owner,
+        num_spectrums: int,
+        num_samples_per_spectrum: int,
+        layout: int,
+        time: int,
+        samples: Optional[int],
+        real: Optional[int],
+        imag: Optional[int],
+        times: Optional[int],
+        frequencies: Optional[int],
+    ):
+        self._owner = owner
+        self.num_spectrums = num_spectrums
+        self.num_samples_per_spectrum = num_samples_per_spectrum
+        self.layout = layout
+        self.time = time
+        shape = (num_spectrums, num_samples_per_spectrum)
+        if layout == LAYOUT_INTERLEAVED:
+            self.spectrogram = _view(owner, samples, np.complex128, shape)
+            self.real, self.imag = self.spectrogram.real, self.spectrogram.imag
+        else:
+            self.spectrogram = None
+            self.real = _view(owner, real, np.float64, shape)
+            self.imag = _view(owner, imag, np.float64, shape)
+        self.times = _view(owner, times, np.float64, (num_spectrums,))
+        self.frequencies = _view(
+            owner, frequencies, np.float64, (num_samples_per_spectrum,)
+        )
+
+
+class Frame(Spectrogram):
+    """The spectrogram of one buffer, handed to an engine's callback.
+
+    It is borrowed from the engine, and its arrays are only valid until the
+    callback returns: copy them to keep them any longer.
+    """
+
+    def __init__(self, frame: int):
+        # The frame is opaque, so its arrays are got through accessors. They
+        # are borrowed, so nothing is freed once they are no longer viewed.
+        self._view_arrays(
+            None,
+            _lib.spectrel_get_frame_num_spectrums(frame),
+            _lib.spectrel_get_frame_num_samples_per_spectrum(frame),
+            _lib.spectrel_get_frame_layout(frame),
+            _lib.spectrel_get_frame_time(frame),
+            _lib.spectrel_get_frame_samples(frame),
+            _lib.spectrel_get_frame_real(frame),
+            _lib.spectrel_get_frame_imag(frame),
+            _lib.spectrel_get_frame_times(frame),
+            _lib.spectrel_get_frame_frequencies(frame),
+        )
+        self.index = _lib.spectrel_get_frame_index(frame)
+        self.frequency = _lib.spectrel_get_frame_frequency(frame)
+        self.sample_rate = _lib.spectrel_get_frame_sample_rate(frame)
+        self.window_hop = _lib.spectrel_get_frame_window_hop(frame)
+
+
+class Engine:
+    """Reads buffers from a receiver, and computes their spectrograms, handing
+    each to a callback in-process."""
+
+    def __init__(
+        self,
+        driver: str,
+        frequency: float,
+        sample_rate: float,
+        bandwidth: float,
+        gain: float,
+        window_size: int = 1024,
+        window_hop: int = 512,
+        buffer_size: int = 65536,
+        layout: int = LAYOUT_INTERLEAVED,
+        is_real: bool = False,
+    ):
+        params = _EngineParams(
+            driver.encode(),
+            _ReceiverParams(frequency, sample_rate, bandwidth, gain),
+            window_size,
+            window_hop,
+            buffer_size,
+            layout,
+            is_real,
+        )
+        self._engine = _lib.spectrel_make_engine(ctypes.byref(params))
+        if not self._engine:
+            raise RuntimeError("Failed to make the engine")
+        self._callback = None
+        self._error = None
+
+    def run(self, callback: Callable[[Frame], Optional[bool]], num_buffers: int = 0):
+        """Stream from the receiver on the calling thread, without holding the
+        GIL, until the number of buffers has been read (or, if zero, without
+        limit), the callback returns True, or the engine is stopped. Any
+        exception raised by the callback stops the engine, and is raised
+        again here."""
+
+        def on_frame(frame, user_data):
+            try:
+                return 1 if callback(Frame(frame)) else 0
+            except BaseException as error:
+                self._error = error
+                return 1
+
+        # Keep a reference to the trampoline for as long as C may call it.
+        self._callback = _FrameCallback(on_frame)
+        _lib.spectrel_set_frame_callback(self._engine, self._callback, None)
+        self._error = None
+        status = _lib.spectrel_run_engine(self._engine, num_buffers)
+        if self._error is not None:
+            raise self._error
+        if status != 0:
+            raise RuntimeError("Failed to run the engine")
+
+    def stop(self):
+        """Stop the engine once the current buffer is done. Safe to call from
+        any thread, or from the callback."""
+        _lib.spectrel_stop_engine(self._engine)
+
+    def close(self):
+        if self._engine:
+            _lib.spectrel_free_engine(self._engine)
+            self._engine = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+
+class Plan:
+    """A plan for the short-time DFT, as made by `spectrel_make_plan`, or by
+    `spectrel_make_zoom_plan` if given a zoom of (start, stop, num_bins) in
+    baseband Hz."""
+
+    def __init__(
+        self,
+        window_size: int,
+        layout: int = LAYOUT_INTERLEAVED,
+        is_real: bool = False,
+        zoom: Optional[tuple] = None,
+        sample_rate: float = 1.0,
+    ):
+        if zoom is None:
+            self._plan = _lib.spectrel_make_plan(window_size, layout, is_real)
+        else:
+            start, stop, num_bins = zoom
+            self._plan = _lib.spectrel_make_zoom_plan(
+                window_size, layout, is_real, sample_rate, start, stop, num_bins
+            )
+        if not self._plan:
+            raise RuntimeError("Failed to make the plan")
+        self.window_size = window_size
+
+    def close(self):
+        if self._plan:
+            _lib.spectrel_free_plan(self._plan)
+            self._plan = None
+
+    def __del__(self):
+        self.close()
+
+
+def _as_signal(samples: np.ndarray) -> _Signal:
+    # Complex samples in double or single precision are read in place.
+    formats = {
+        np.dtype(np.complex128): FORMAT_CF64,
+        np.dtype(np.complex64): FORMAT_CF32,
+    }
+    if samples.dtype not in formats or not samples.flags.c_contiguous:
+        raise TypeError("Samples must be a contiguous complex128 or complex64 array")
+    address = samples.ctypes.data
+    is_cf64 = formats[samples.dtype] == FORMAT_CF64
+    return _Signal(
+        samples.size,
+        address if is_cf64 else None,
+        formats[samples.dtype],
+        address,
+        1.0,
+        None,
+    )
+
+
+def stfft(
+    plan: Plan,
+    samples: np.ndarray,
+    window_hop: int,
+    sample_rate: float,
+    window: Optional[np.ndarray] = None,
+) -> Spectrogram:
+    """Compute the short-time DFT of a signal, without holding the GIL. The
+    samples are read in place, as are those of the window (a boxcar by
+    default). Arrays which are not contiguous complex128 or complex64 are
+    converted first."""
+    if samples.dtype not in (np.complex128, np.complex64):
+        samples = samples.astype(np.complex128)
+    samples = np.ascontiguousarray(samples)
+    if window is None:
+        window = np.ones(plan.window_size, dtype=np.complex128)
+    window = np.ascontiguousarray(window, dtype=np.complex128)
+    if window.size != plan.window_size or samples.size < plan.window_size:
+        raise ValueError("The window must match the plan, and fit in the signal")
+
+    signal, window_signal = _as_signal(samples), _as_signal(window)
+    pointer = _lib.spectrel_stfft(
+        plan._plan,
+        ctypes.byref(window_signal),
+        ctypes.byref(signal),
+        window_hop,
+        sample_rate,
+        None,
+    )
+    if not pointer:
+        raise RuntimeError("Failed to compute the short-time DFT")
+    return Spectrogram(pointer)
+
+
+class Reader:
+    """A recording mapped into memory, as by `spreader.h`.
+
+    `spectrums` views every complete spectrum where it lies in the mapping.
+    For cf64 recordings, it is a complex array of shape (num_spectrums,
+    num_samples_per_spectrum). For q8 and q16 recordings, it is a record array
+    with fields "offset", "scale" and "codes". For pyramid levels, it has
+    fields "mean" and "max", of log-power in dB. Recordings of real-valued
+    inputs (`is_real`) hold window_size // 2 + 1 samples per spectrum, from DC
+    up.
+    """
+
+    def __init__(self, path: str, window_size: int = 0):
+        reader = _lib.spectrel_open_reader(path.encode(), window_size)
+        if not reader:
+            raise RuntimeError(f"Failed to open {path}")
+        # The mapping stays open until neither the reader nor any of its views
+        # remain.
+        self._handle = _Handle(reader, _lib.spectrel_close_reader)
+        self._reader = reader
+        self.num_spectrums = _lib.spectrel_get_num_spectrums(self._reader)
+        self.num_samples_per_spectrum = _lib.spectrel_get_num_samples_per_spectrum(
+            self._reader
+        )
+        self.encoding = _lib.spectrel_get_reader_encoding(self._reader)
+        self.decimation = _lib.spectrel_get_reader_decimation(self._reader)
+        self.is_real = _lib.spectrel_is_reader_real(self._reader)
+
+        M = self.num_samples_per_spectrum
+        if self.encoding == ENCODING_CF64:
+            dtype, shape = np.complex128, (self.num_spectrums, M)
+        elif self.encoding == ENCODING_PYRAMID:
+            dtype = np.dtype([("mean", np.float32, (M,)), ("max", np.float32, (M,))])
+            shape = (self.num_spectrums,)
+        else:
+            codes = np.uint8 if self.encoding == ENCODING_Q8 else np.uint16
+            dtype = np.dtype(
+                [("offset", np.float32), ("scale", np.float32), ("codes", codes, (M,))]
+            )
+            shape = (self.num_spectrums,)
+        self.spectrums = (
+            _view(
+                self._handle,
+                _lib.spectrel_get_spectrum(self._reader, 0),
+                dtype,
+                shape,
+                writable=False,
+            )
+            if self.num_spectrums > 0
+            else np.empty(shape, dtype=dtype)
+        )
+
+    def read_power_db(self, index: int) -> np.ndarray:
+        """Decode the log-power of a spectrum, in dB, in order of increasing
+        frequency."""
+        power_db = np.empty(self.num_samples_per_spectrum, dtype=np.float32)
+        if _lib.spectrel_read_power_db(self._reader, index, power_db.ctypes.data) != 0:
+            raise IndexError(index)
+        return power_db
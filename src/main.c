@@ -2,10 +2,21 @@
 #include "spectrel.h"
 
 #include <math.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+// Set on SIGINT or SIGTERM, so that the recording stops cleanly.
+static volatile sig_atomic_t is_interrupted = 0;
+
+static void spectrel_interrupt(int signum)
+{
+    is_interrupted = 1;
+}
+
 int exit_failure()
 {
     return SPECTREL_FAILURE;
@@ -17,16 +28,691 @@ int exit_success()
     return SPECTREL_SUCCESS;
 }
 
+// Everything that spectrograms are written to. The recording (the file, and
+// its pyramid, and the files for the zoom and extra resolutions) is reopened
+// when it is rotated, and when the configuration changes, so that each
+// describes one configuration. The server and shared memory stay up, so that
+// their subscribers stay attached, and tell them of the change in-band.
+typedef struct
+{
+    spectrel_file_t *file;
+    spectrel_pyramid pyramid;
+    spectrel_dedisperser dedisperser;
+    spectrel_stats stats;
+    spectrel_rfi rfi;
+    spectrel_tracker tracker;
+    spectrel_times times;
+    spectrel_plan zoom_plan;
+    spectrel_file_t *zoom_file;
+    spectrel_times zoom_times;
+    spectrel_file_t *resolution_files[SPECTREL_MAX_RESOLUTIONS];
+    spectrel_times resolution_times[SPECTREL_MAX_RESOLUTIONS];
+    spectrel_server server;
+    spectrel_shm shm;
+    time_t start_time; // When the recording was opened.
+} spectrel_outputs_t;
+
+static void spectrel_close_recording(spectrel_outputs_t *outputs)
+{
+    if (outputs->zoom_times)
+    {
+        spectrel_free_times(outputs->zoom_times);
+        outputs->zoom_times = NULL;
+    }
+    if (outputs->zoom_file)
+    {
+        spectrel_close_file(outputs->zoom_file);
+        outputs->zoom_file = NULL;
+    }
+    for (size_t i = 0; i < SPECTREL_MAX_RESOLUTIONS; i++)
+    {
+        if (outputs->resolution_times[i])
+        {
+            spectrel_free_times(outputs->resolution_times[i]);
+            outputs->resolution_times[i] = NULL;
+        }
+        if (outputs->resolution_files[i])
+        {
+            spectrel_close_file(outputs->resolution_files[i]);
+            outputs->resolution_files[i] = NULL;
+        }
+    }
+    if (outputs->times)
+    {
+        spectrel_free_times(outputs->times);
+        outputs->times = NULL;
+    }
+    if (outputs->pyramid)
+    {
+        spectrel_free_pyramid(outputs->pyramid);
+        outputs->pyramid = NULL;
+    }
+    if (outputs->dedisperser)
+    {
+        spectrel_free_dedisperser(outputs->dedisperser);
+        outputs->dedisperser = NULL;
+    }
+    if (outputs->stats)
+    {
+        spectrel_free_stats(outputs->stats);
+        outputs->stats = NULL;
+    }
+    if (outputs->rfi)
+    {
+        spectrel_free_rfi(outputs->rfi);
+        outputs->rfi = NULL;
+    }
+    if (outputs->tracker)
+    {
+        spectrel_free_tracker(outputs->tracker);
+        outputs->tracker = NULL;
+    }
+    if (outputs->file)
+    {
+        spectrel_close_file(outputs->file);
+        outputs->file = NULL;
+    }
+}
+
+// Open a file to dump spectrograms to, under the name given in place of the
+// driver's.
+static spectrel_file_t *spectrel_open_stream(const spectrel_args_t *args,
+                                             const time_t *now,
+                                             const char *name)
+{
+    spectrel_file_t *file =
+        spectrel_open_file(args->dir, now, name, args->encoding);
+    if (!file)
+        return NULL;
+
+    // Optionally, write the recording asynchronously, so that the recording
+    // thread never waits on the disk.
+    if (args->writer != SPECTREL_WRITER_STDIO)
+    {
+        file->writer = spectrel_make_writer(
+            fileno(file->file), args->writer, (size_t)args->writes_in_flight);
+        if (!file->writer)
+        {
+            spectrel_close_file(file);
+            return NULL;
+        }
+        if (spectrel_get_writer_backend(file->writer) != args->writer)
+            printf("Writer: io_uring is not available, writing from a "
+                   "thread\n");
+    }
+    return file;
+}
+
+static int spectrel_open_recording(spectrel_outputs_t *outputs,
+                                   const spectrel_args_t *args,
+                                   const spectrel_receiver_params_t *params)
+{
+    // Open the file to dump the spectrogram to. File names only resolve
+    // seconds, so a recording rotated within a second is stamped a second
+    // later rather than overwriting the last.
+    time_t now = time(NULL);
+    if (outputs->start_time && now <= outputs->start_time)
+        now = outputs->start_time + 1;
+    outputs->start_time = now;
+    outputs->file = spectrel_open_stream(args, &now, args->driver);
+    if (!outputs->file)
+        return SPECTREL_FAILURE;
+
+    // Open a file for the zoom spectrogram.
+    if (outputs->zoom_plan)
+    {
+        size_t num_chars_name = strlen(args->driver) + strlen("_zoom") + 1;
+        char *name = malloc(num_chars_name);
+        if (!name)
+        {
+            spectrel_print_error("malloc failed: name");
+            return SPECTREL_FAILURE;
+        }
+        snprintf(name, num_chars_name, "%s_zoom", args->driver);
+        outputs->zoom_file = spectrel_open_stream(args, &now, name);
+        free(name);
+        if (!outputs->zoom_file)
+            return SPECTREL_FAILURE;
+        // Zoom spectrums are never halved, whatever the input.
+        outputs->zoom_times = spectrel_make_times(outputs->zoom_file->path,
+                                                  args->window_hop,
+                                                  params->sample_rate,
+                                                  false);
+        if (!outputs->zoom_times)
+            return SPECTREL_FAILURE;
+    }
+
+    // Open a file for each extra resolution, named after its window.
+    for (size_t i = 0; i < args->num_resolutions; i++)
+    {
+        const spectrel_resolution_t *resolution = &args->resolutions[i];
+        size_t num_chars_name = strlen(args->driver) + strlen("_w_h") + 20 + 1;
+        char *name = malloc(num_chars_name);
+        if (!name)
+        {
+            spectrel_print_error("malloc failed: name");
+            return SPECTREL_FAILURE;
+        }
+        snprintf(name,
+                 num_chars_name,
+                 "%s_w%d_h%d",
+                 args->driver,
+                 resolution->window_size,
+                 resolution->window_hop);
+        outputs->resolution_files[i] = spectrel_open_stream(args, &now, name);
+        free(name);
+        if (!outputs->resolution_files[i])
+            return SPECTREL_FAILURE;
+        outputs->resolution_times[i] =
+            spectrel_make_times(outputs->resolution_files[i]->path,
+                                resolution->window_hop,
+                                params->sample_rate,
+                                args->is_real_input);
+        if (!outputs->resolution_times[i])
+            return SPECTREL_FAILURE;
+    }
+
+    // Record when each spectrum was captured, alongside the recording.
+    outputs->times = spectrel_make_times(outputs->file->path,
+                                         args->window_hop,
+                                         params->sample_rate,
+                                         args->is_real_input);
+    if (!outputs->times)
+        return SPECTREL_FAILURE;
+
+    // Optionally, flag interference, and mask it before anything is written.
+    if (args->rfi_threshold > 0)
+    {
+        outputs->rfi = spectrel_make_rfi(
+            outputs->file->path,
+            spectrel_get_num_bins(args->window_size, args->is_real_input),
+            args->is_real_input,
+            args->rfi_block_size,
+            args->rfi_threshold,
+            args->rfi_action);
+        if (!outputs->rfi)
+            return SPECTREL_FAILURE;
+    }
+
+    // Optionally, maintain decimated copies of the spectrogram for overviews.
+    if (args->num_pyramid_levels > 0)
+    {
+        outputs->pyramid = spectrel_make_pyramid(outputs->file->path,
+                                                 args->window_size,
+                                                 args->num_pyramid_levels);
+        if (!outputs->pyramid)
+            return SPECTREL_FAILURE;
+    }
+
+    // Optionally, search for dispersed pulses as they arrive.
+    if (args->dm_max > 0)
+    {
+        spectrel_dedisp_params_t dedisp_params = {
+            .frequency = params->frequency,
+            .sample_rate = params->sample_rate,
+            .window_size = args->window_size,
+            .window_hop = args->window_hop,
+            .is_real = args->is_real_input,
+            .dm_min = args->dm_min,
+            .dm_max = args->dm_max,
+            .snr_threshold = args->snr_threshold,
+            .num_threads = args->dedisp_threads};
+        outputs->dedisperser =
+            spectrel_make_dedisperser(outputs->file->path, &dedisp_params);
+        if (!outputs->dedisperser)
+            return SPECTREL_FAILURE;
+        spectrel_describe_dedisperser(outputs->dedisperser);
+    }
+
+    // Optionally, summarise each spectral component over fixed intervals.
+    if (args->stats_interval > 0)
+    {
+        double spectrum_interval = args->window_hop / params->sample_rate;
+        long long num_spectrums =
+            llround(args->stats_interval / spectrum_interval);
+        outputs->stats = spectrel_make_stats(
+            outputs->file->path,
+            spectrel_get_num_bins(args->window_size, args->is_real_input),
+            num_spectrums > 1 ? (size_t)num_spectrums : 1,
+            spectrum_interval);
+        if (!outputs->stats)
+            return SPECTREL_FAILURE;
+    }
+
+    // Optionally, follow a few frequencies at every sample, or every few.
+    if (args->num_track_frequencies > 0)
+    {
+        spectrel_track_params_t track_params = {
+            .frequency = params->frequency,
+            .sample_rate = params->sample_rate,
+            .window_size = args->window_size,
+            .window_hop = args->track_hop,
+            .buffer_size = args->buffer_size,
+            .is_real = args->is_real_input,
+            .frequencies = args->track_frequencies,
+            .num_frequencies = args->num_track_frequencies};
+        outputs->tracker =
+            spectrel_make_tracker(outputs->file->path, &track_params);
+        if (!outputs->tracker)
+            return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static void spectrel_close_outputs(spectrel_outputs_t *outputs)
+{
+    if (outputs->shm)
+    {
+        spectrel_free_shm(outputs->shm);
+        outputs->shm = NULL;
+    }
+    if (outputs->server)
+    {
+        spectrel_free_server(outputs->server);
+        outputs->server = NULL;
+    }
+    spectrel_close_recording(outputs);
+    if (outputs->zoom_plan)
+    {
+        spectrel_free_plan(outputs->zoom_plan);
+        outputs->zoom_plan = NULL;
+    }
+}
+
+// Whether the zoom interval lies within the band received at a centre
+// frequency.
+static bool spectrel_is_zoom_in_band(const spectrel_args_t *args,
+                                     const double frequency,
+                                     const double sample_rate)
+{
+    return args->zoom_num_bins < 1 ||
+           (args->zoom_start - frequency >= -sample_rate / 2 &&
+            args->zoom_stop - frequency <= sample_rate / 2);
+}
+
+static int spectrel_open_outputs(spectrel_outputs_t *outputs,
+                                 const spectrel_args_t *args,
+                                 const spectrel_receiver_params_t *params)
+{
+    // Optionally, zoom in on an interval of frequencies. The plan depends on
+    // the centre frequency and window, so is remade whenever they change.
+    if (args->zoom_num_bins > 0)
+    {
+        if (!spectrel_is_zoom_in_band(
+                args, params->frequency, params->sample_rate))
+        {
+            spectrel_print_error("Zoom interval is outside the band at %.1f "
+                                 "[Hz]",
+                                 params->frequency);
+            return SPECTREL_FAILURE;
+        }
+        outputs->zoom_plan =
+            spectrel_make_zoom_plan(args->window_size,
+                                    args->layout,
+                                    args->is_real_input,
+                                    params->sample_rate,
+                                    args->zoom_start - params->frequency,
+                                    args->zoom_stop - params->frequency,
+                                    args->zoom_num_bins);
+        if (!outputs->zoom_plan)
+            return SPECTREL_FAILURE;
+    }
+
+    if (spectrel_open_recording(outputs, args, params) != 0)
+        return SPECTREL_FAILURE;
+
+    // Optionally, stream decimated spectrums to local subscribers.
+    if (args->socket_path && outputs->server)
+    {
+        if (spectrel_reconfigure_server(outputs->server,
+                                        args->window_size,
+                                        params->sample_rate,
+                                        params->frequency) != 0)
+            return SPECTREL_FAILURE;
+    }
+    else if (args->socket_path)
+    {
+        outputs->server = spectrel_make_server(args->socket_path,
+                                               args->window_size,
+                                               args->stream_decimation,
+                                               params->sample_rate,
+                                               params->frequency);
+        if (!outputs->server)
+            return SPECTREL_FAILURE;
+    }
+
+    // Optionally, publish every spectrum to a shared memory ring.
+    if (args->shm_name && outputs->shm)
+    {
+        if (spectrel_reconfigure_shm(outputs->shm,
+                                     args->window_size,
+                                     args->is_real_input,
+                                     args->window_hop,
+                                     params->sample_rate,
+                                     params->frequency) != 0)
+            return SPECTREL_FAILURE;
+    }
+    else if (args->shm_name)
+    {
+        outputs->shm = spectrel_make_shm(args->shm_name,
+                                         SPECTREL_DEFAULT_SHM_SLOTS,
+                                         args->window_size,
+                                         args->is_real_input,
+                                         args->window_hop,
+                                         params->sample_rate,
+                                         params->frequency);
+        if (!outputs->shm)
+            return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Reopen the recording for a new configuration, and tell the server and
+// shared memory of it.
+static int spectrel_reopen_outputs(spectrel_outputs_t *outputs,
+                                   const spectrel_args_t *args,
+                                   const spectrel_receiver_params_t *params)
+{
+    spectrel_close_recording(outputs);
+    if (outputs->zoom_plan)
+    {
+        spectrel_free_plan(outputs->zoom_plan);
+        outputs->zoom_plan = NULL;
+    }
+    return spectrel_open_outputs(outputs, args, params);
+}
+
+static int spectrel_write_outputs(spectrel_outputs_t *outputs,
+                                  spectrel_spectrogram_t *spectrogram)
+{
+    uint64_t start = spectrel_get_time_ns();
+    if (outputs->rfi && spectrel_flag_rfi(outputs->rfi, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    if (spectrel_write_spectrogram(spectrogram, outputs->file) != 0)
+        return SPECTREL_FAILURE;
+    if (spectrel_write_times(outputs->times, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    if (outputs->pyramid &&
+        spectrel_update_pyramid(outputs->pyramid, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    if (outputs->dedisperser &&
+        spectrel_dedisperse(outputs->dedisperser, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    if (outputs->stats &&
+        spectrel_update_stats(outputs->stats, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    uint64_t written = spectrel_get_time_ns();
+    spectrel_observe(SPECTREL_HISTOGRAM_WRITE, written - start);
+
+    if (outputs->server &&
+        spectrel_publish_spectrogram(outputs->server, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    if (outputs->shm && spectrel_publish_shm(outputs->shm, spectrogram) != 0)
+        return SPECTREL_FAILURE;
+    spectrel_observe(SPECTREL_HISTOGRAM_PUBLISH,
+                     spectrel_get_time_ns() - written);
+    return SPECTREL_SUCCESS;
+}
+
+// Compute the zoom spectrogram of the buffer, over the same window as the
+// main spectrogram, and write it to its own recording.
+static int spectrel_write_zoom(spectrel_outputs_t *outputs,
+                               const spectrel_args_t *args,
+                               const spectrel_signal_t *window,
+                               const spectrel_signal_t *buffer,
+                               const int64_t buffer_time,
+                               const double sample_rate,
+                               spectrel_arena arena)
+{
+    size_t mark = spectrel_get_arena_used(arena);
+    spectrel_spectrogram_t *spectrogram = spectrel_stfft(outputs->zoom_plan,
+                                                         window,
+                                                         buffer,
+                                                         args->window_hop,
+                                                         sample_rate,
+                                                         arena);
+    if (!spectrogram)
+        return SPECTREL_FAILURE;
+    spectrogram->time = buffer_time;
+    spectrel_add_counter(SPECTREL_COUNTER_FRAMES, spectrogram->num_spectrums);
+
+    int status = SPECTREL_SUCCESS;
+    if (spectrel_write_spectrogram(spectrogram, outputs->zoom_file) != 0 ||
+        spectrel_write_times(outputs->zoom_times, spectrogram) != 0)
+        status = SPECTREL_FAILURE;
+    spectrel_free_spectrogram(spectrogram);
+    spectrel_rewind_arena(arena, mark);
+    return status;
+}
+
+// Compute the spectrogram of the buffer at each extra resolution, and write it
+// to its own recording. They are computed one at a time, so that the arena
+// only ever holds one of them.
+static int spectrel_write_resolutions(spectrel_outputs_t *outputs,
+                                      const spectrel_args_t *args,
+                                      spectrel_plan *plans,
+                                      spectrel_signal_t **windows,
+                                      const spectrel_signal_t *buffer,
+                                      const int64_t buffer_time,
+                                      const double sample_rate,
+                                      spectrel_arena arena)
+{
+    for (size_t i = 0; i < args->num_resolutions; i++)
+    {
+        size_t mark = spectrel_get_arena_used(arena);
+        spectrel_spectrogram_t *spectrogram =
+            spectrel_stfft(plans[i],
+                           windows[i],
+                           buffer,
+                           args->resolutions[i].window_hop,
+                           sample_rate,
+                           arena);
+        if (!spectrogram)
+            return SPECTREL_FAILURE;
+        spectrogram->time = buffer_time;
+        spectrel_add_counter(SPECTREL_COUNTER_FRAMES,
+                             spectrogram->num_spectrums);
+
+        int status = SPECTREL_SUCCESS;
+        if (spectrel_write_spectrogram(spectrogram,
+                                       outputs->resolution_files[i]) != 0 ||
+            spectrel_write_times(outputs->resolution_times[i], spectrogram) !=
+                0)
+            status = SPECTREL_FAILURE;
+        spectrel_free_spectrogram(spectrogram);
+        spectrel_rewind_arena(arena, mark);
+        if (status != SPECTREL_SUCCESS)
+            return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Size the space needed for the spectrogram of each buffer with a window,
+// along with the scratch space used to write it, and then the same again for
+// the largest extra resolution or zoom, which are computed while the first is
+// held.
+static size_t spectrel_get_window_bytes(const spectrel_args_t *args,
+                                        const size_t window_size,
+                                        const size_t window_hop)
+{
+    size_t stfft_size = spectrel_get_stfft_size(args->buffer_size,
+                                                window_size,
+                                                window_hop,
+                                                args->layout,
+                                                args->is_real_input);
+    size_t resolution_size = 0;
+    for (size_t i = 0; i < args->num_resolutions; i++)
+    {
+        size_t size = spectrel_get_stfft_size(args->buffer_size,
+                                              args->resolutions[i].window_size,
+                                              args->resolutions[i].window_hop,
+                                              args->layout,
+                                              args->is_real_input);
+        resolution_size = size > resolution_size ? size : resolution_size;
+    }
+    if (args->zoom_num_bins > 0)
+    {
+        size_t size = spectrel_get_zoom_stfft_size(args->buffer_size,
+                                                   window_size,
+                                                   window_hop,
+                                                   args->zoom_num_bins,
+                                                   args->layout);
+        resolution_size = size > resolution_size ? size : resolution_size;
+    }
+    return 2 * stfft_size + 2 * resolution_size;
+}
+
+// Size the arena to hold the stream buffer, whatever its format, and the
+// space needed by the largest window of any job.
+static size_t spectrel_get_arena_bytes(const spectrel_args_t *args)
+{
+    size_t window_bytes =
+        spectrel_get_window_bytes(args, args->window_size, args->window_hop);
+    for (size_t i = 0; i < args->num_jobs; i++)
+    {
+        size_t job_bytes = spectrel_get_window_bytes(
+            args, args->jobs[i].window_size, args->jobs[i].window_hop);
+        window_bytes = job_bytes > window_bytes ? job_bytes : window_bytes;
+    }
+    return spectrel_get_arena_size(sizeof(fftw_complex) * args->buffer_size) +
+           window_bytes;
+}
+
+// Check a new window works with every output, and fits in the arena, before
+// switching to it.
+static bool spectrel_is_valid_window(const spectrel_args_t *args,
+                                     const size_t window_size,
+                                     const size_t window_hop,
+                                     const size_t arena_bytes)
+{
+    if (window_size < 1 || window_size > (size_t)args->buffer_size ||
+        window_hop < 1)
+        return false;
+    if (args->socket_path &&
+        !spectrel_is_valid_decimation(window_size,
+                                      (size_t)args->stream_decimation))
+        return false;
+    if (args->num_pyramid_levels > 0 &&
+        window_size % ((size_t)1 << args->num_pyramid_levels))
+        return false;
+    size_t buffer_bytes =
+        spectrel_get_arena_size(sizeof(fftw_complex) * args->buffer_size);
+    return buffer_bytes +
+               spectrel_get_window_bytes(args, window_size, window_hop) <=
+           arena_bytes;
+}
+
+// Plan every job up front, so that switching between jobs is immediate. Jobs
+// with the same window size share a plan.
+static int spectrel_plan_jobs(const spectrel_args_t *args,
+                              const size_t arena_bytes,
+                              spectrel_plan *plans,
+                              spectrel_signal_t **windows)
+{
+    for (size_t i = 0; i < args->num_jobs; i++)
+    {
+        const spectrel_job_t *job = &args->jobs[i];
+        if (!spectrel_is_valid_window(
+                args, job->window_size, job->window_hop, arena_bytes))
+        {
+            spectrel_print_error("Invalid window for job %s", job->name);
+            return SPECTREL_FAILURE;
+        }
+        for (size_t j = 0; j < i && !plans[i]; j++)
+        {
+            if (args->jobs[j].window_size == job->window_size)
+            {
+                plans[i] = plans[j];
+                windows[i] = windows[j];
+            }
+        }
+        if (plans[i])
+            continue;
+
+        plans[i] = spectrel_make_plan(
+            job->window_size, args->layout, args->is_real_input);
+        windows[i] = spectrel_make_window(job->window_size);
+        if (!plans[i] || !windows[i])
+            return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static void spectrel_free_job_plans(const spectrel_args_t *args,
+                                    spectrel_plan *plans,
+                                    spectrel_signal_t **windows)
+{
+    for (size_t i = 0; i < args->num_jobs; i++)
+    {
+        bool is_shared = false;
+        for (size_t j = 0; j < i; j++)
+        {
+            is_shared = is_shared || plans[j] == plans[i];
+        }
+        if (!is_shared)
+        {
+            spectrel_free_plan(plans[i]);
+            spectrel_free_signal(windows[i]);
+        }
+    }
+    free(plans);
+    free(windows);
+}
+
+// The time a job should start at, or zero to start it immediately. A time of
+// day which has already passed today is taken to mean tomorrow.
+static time_t spectrel_get_start_time(const spectrel_job_t *job)
+{
+    if (job->start_time < 0)
+        return 0;
+    time_t now = time(NULL);
+    time_t start_time = now - now % SPECTREL_SECONDS_PER_DAY + job->start_time;
+    return start_time < now ? start_time + SPECTREL_SECONDS_PER_DAY
+                            : start_time;
+}
+
+// Reconfigure the receiver for a job, and reopen the outputs to match.
+static int spectrel_start_job(const spectrel_job_t *job,
+                              spectrel_args_t *args,
+                              spectrel_receiver receiver,
+                              spectrel_receiver_params_t *params,
+                              spectrel_outputs_t *outputs)
+{
+    printf("Starting job: %s\n", job->name);
+    if (spectrel_set_frequency(receiver, job->frequency) != 0 ||
+        spectrel_set_gain(receiver, job->gain) != 0)
+        return SPECTREL_FAILURE;
+    params->frequency = job->frequency;
+    params->gain = job->gain;
+    args->frequency = job->frequency;
+    args->gain = job->gain;
+    args->duration = job->duration;
+    args->window_size = job->window_size;
+    args->window_hop = job->window_hop;
+    args->encoding = job->encoding;
+    return spectrel_reopen_outputs(outputs, args, params);
+}
+
 int main(int argc, char *argv[])
 {
     // Initialise the program.
     spectrel_args_t *args = NULL;
     spectrel_receiver receiver = NULL;
+    spectrel_arena arena = NULL;
+    size_t arena_bytes = 0;
     spectrel_signal_t *buffer = NULL;
+    size_t frame_mark = 0;
     spectrel_plan plan = NULL;
     spectrel_signal_t *window = NULL;
-    spectrel_file_t *file = NULL;
+    spectrel_plan *job_plans = NULL;
+    spectrel_signal_t **job_windows = NULL;
+    spectrel_plan resolution_plans[SPECTREL_MAX_RESOLUTIONS] = {0};
+    spectrel_signal_t *resolution_windows[SPECTREL_MAX_RESOLUTIONS] = {0};
+    spectrel_outputs_t outputs = {0};
+    spectrel_control control = NULL;
+    spectrel_exporter exporter = NULL;
     spectrel_spectrogram_t *spectrogram = NULL;
+    bool is_streaming = false;
     int status = SPECTREL_FAILURE;
 
     args = spectrel_parse_args(argc, argv);
@@ -34,82 +720,421 @@ int main(int argc, char *argv[])
         goto cleanup;
     spectrel_describe_args(args);
 
-    // Initialise the receiver.
+    // Optionally, tune the buffer size and layout for this host, then exit.
+    if (args->tune_path)
+    {
+        spectrel_tuning_t tuning;
+        if (spectrel_autotune(args, &tuning) != 0)
+            goto cleanup;
+        if (spectrel_write_tuning(args->tune_path, args, &tuning) != 0)
+            goto cleanup;
+        printf("Tuned: buffer size %zu, %s layout, %.1fx headroom\n",
+               tuning.buffer_size,
+               spectrel_get_layout_name(tuning.layout),
+               tuning.headroom);
+        status = SPECTREL_SUCCESS;
+        goto cleanup;
+    }
+
+    // Pin the recording thread before anything is allocated, so that the
+    // arena is placed on its NUMA node. Background threads are kept off it.
+    if (spectrel_set_background_cpus(args->background_cpus) != 0)
+        goto cleanup;
+    if (args->cpus && spectrel_pin_thread(args->cpus) != 0)
+        goto cleanup;
+
+    // Stop cleanly when interrupted, so that sockets and shared memory are
+    // removed.
+    struct sigaction action = {.sa_handler = spectrel_interrupt};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // Optionally, export metrics on the health of the recording.
+    if (args->metrics_path || args->metrics_port)
+    {
+        exporter = spectrel_make_exporter(args->metrics_path,
+                                          args->metrics_port);
+        if (!exporter)
+            goto cleanup;
+    }
+
+    // Initialise the receiver. With jobs, it is kept open between them.
     spectrel_receiver_params_t receiver_params = {.frequency = args->frequency,
                                                   .sample_rate =
                                                       args->sample_rate,
                                                   .bandwidth = args->bandwidth,
                                                   .gain = args->gain};
+    if (args->num_jobs > 0)
+    {
+        receiver_params.frequency = args->jobs[0].frequency;
+        receiver_params.gain = args->jobs[0].gain;
+    }
     receiver = spectrel_make_receiver(args->driver, &receiver_params);
     if (!receiver)
         goto cleanup;
 
     spectrel_describe_receiver(receiver);
 
-    // Create a reusable buffer to read samples from the receiver into.
-    buffer =
-        spectrel_make_signal(args->buffer_size, SPECTREL_EMPTY_SIGNAL, NULL);
-    if (!buffer)
+    // Allocate every large buffer up front, from an arena local to this
+    // thread, so that nothing is allocated as samples are processed.
+    arena = spectrel_make_arena(spectrel_get_arena_bytes(args));
+    if (!arena)
         goto cleanup;
+    arena_bytes = spectrel_get_arena_capacity(arena);
 
-    // Plan the short-time DFT.
-    plan = spectrel_make_plan(args->window_size);
-    if (!plan)
-        goto cleanup;
+    spectrel_describe_arena(arena);
 
-    // TODO: Generalise the window (right now, the boxcar window is
-    // enforced).
-    spectrel_constant_params_t window_params = {1.0};
-    window = spectrel_make_signal(
-        args->window_size, SPECTREL_CONSTANT_SIGNAL, (void *)&window_params);
-    if (!window)
+    // Create a reusable buffer to read samples from the receiver into. Each
+    // spectrogram is allocated after it, and released by rewinding to it.
+    buffer = spectrel_make_stream_buffer(receiver, args->buffer_size, arena);
+    if (!buffer)
         goto cleanup;
+    frame_mark = spectrel_get_arena_used(arena);
+
+    // Plan the short-time DFT. With jobs, the plans for every job are made up
+    // front, and the plan in use is borrowed from them.
+    if (args->num_jobs > 0)
+    {
+        job_plans = calloc(args->num_jobs, sizeof(spectrel_plan));
+        job_windows = calloc(args->num_jobs, sizeof(spectrel_signal_t *));
+        if (!job_plans || !job_windows)
+        {
+            free(job_plans);
+            free(job_windows);
+            job_plans = NULL;
+            job_windows = NULL;
+            goto cleanup;
+        }
+        if (spectrel_plan_jobs(args, arena_bytes, job_plans, job_windows) != 0)
+            goto cleanup;
+    }
+    else
+    {
+        plan = spectrel_make_plan(
+            args->window_size, args->layout, args->is_real_input);
+        if (!plan)
+            goto cleanup;
+
+        window = spectrel_make_window(args->window_size);
+        if (!window)
+            goto cleanup;
+    }
+
+    // Plan each extra resolution, which is computed from the same buffers.
+    for (size_t i = 0; i < args->num_resolutions; i++)
+    {
+        resolution_plans[i] =
+            spectrel_make_plan(args->resolutions[i].window_size,
+                               args->layout,
+                               args->is_real_input);
+        resolution_windows[i] =
+            spectrel_make_window(args->resolutions[i].window_size);
+        if (!resolution_plans[i] || !resolution_windows[i])
+            goto cleanup;
+    }
 
     // Elapsed time is inferred by sample counting.
     size_t num_samples_elapsed = 0;
     double sample_interval = 1 / receiver_params.sample_rate;
     size_t num_samples_total = ceil(args->duration / sample_interval);
 
-    // Open the file to dump the spectrogram to.
-    time_t now = time(NULL);
+    // Open everything the spectrograms are written to. With jobs, they are
+    // opened as each job starts.
     if (spectrel_make_dir(args->dir) != 0)
         goto cleanup;
-    file = spectrel_open_file(args->dir, &now, args->driver);
+    if (args->num_jobs == 0 &&
+        spectrel_open_outputs(&outputs, args, &receiver_params) != 0)
+        goto cleanup;
+
+    // Optionally, accept commands to reconfigure the recording as it runs.
+    if (args->control_path)
+    {
+        control = spectrel_make_control(
+            args->control_path, args->layout, args->is_real_input);
+        if (!control)
+            goto cleanup;
+    }
 
-    // Prepare to read samples.
-    if (spectrel_activate_stream(receiver) != 0)
+    // Harden the recording thread once everything is allocated: lock every
+    // page into memory, fault in the stack, and take a real-time priority.
+    if (args->lock_memory && spectrel_lock_memory() != 0)
+        goto cleanup;
+    spectrel_prefault_stack();
+    if (args->realtime_priority &&
+        spectrel_set_realtime_priority(args->realtime_priority) != 0)
         goto cleanup;
 
-    // Record spectrograms until the user-specified duration has elapsed.
-    while (num_samples_elapsed < num_samples_total)
+    // Record spectrograms until the user-specified duration has elapsed, or
+    // until told to stop. Without a duration, record indefinitely. With jobs,
+    // run each for its duration in turn.
+    size_t num_jobs_started = 0;
+    const spectrel_job_t *job = NULL;
+    time_t job_start_time = 0;
+    bool is_waiting = false;
+    bool is_paused = false;
+    bool is_stopped = false;
+    uint64_t last_read = 0;
+    uint64_t max_read_interval = 0;
+    while (!is_stopped && !is_interrupted)
     {
+        bool is_done =
+            args->duration > 0 && num_samples_elapsed >= num_samples_total;
+        if (args->num_jobs == 0 && is_done)
+            break;
+
+        // Move on to the next job once the last is done, then wait for it to
+        // be due.
+        if (args->num_jobs > 0 && (!job || is_done) && !is_waiting)
+        {
+            if (num_jobs_started == args->num_jobs && !args->repeat_jobs)
+                break;
+            job = &args->jobs[num_jobs_started % args->num_jobs];
+            job_start_time = spectrel_get_start_time(job);
+            is_waiting = true;
+        }
+        if (is_waiting && time(NULL) >= job_start_time)
+        {
+            if (spectrel_start_job(
+                    job, args, receiver, &receiver_params, &outputs) != 0)
+                goto cleanup;
+            plan = job_plans[num_jobs_started % args->num_jobs];
+            window = job_windows[num_jobs_started % args->num_jobs];
+            num_samples_total = ceil(args->duration / sample_interval);
+            num_samples_elapsed = 0;
+            num_jobs_started += 1;
+            is_waiting = false;
+        }
+
+        // Stop reading samples while paused, or waiting for a job.
+        bool is_idle = is_paused || is_waiting;
+        if (is_idle && is_streaming)
+        {
+            if (spectrel_deactivate_stream(receiver) != 0)
+                goto cleanup;
+            is_streaming = false;
+            spectrel_set_gauge(SPECTREL_GAUGE_STREAMING, 0);
+        }
+        if (is_idle && !control)
+        {
+            struct timespec interval = {
+                .tv_nsec = SPECTREL_CONTROL_POLL_TIMEOUT * 1000000L};
+            nanosleep(&interval, NULL);
+        }
+
+        // Apply commands between buffers. While idle, wait for them.
+        spectrel_command_t command;
+        while (!is_stopped && control &&
+               spectrel_take_command(
+                   control,
+                   &command,
+                   is_idle ? SPECTREL_CONTROL_POLL_TIMEOUT : 0))
+        {
+            char reply[SPECTREL_CONTROL_LINE_SIZE] = "ok";
+            bool has_failed = false;
+            switch (command.type)
+            {
+            case SPECTREL_COMMAND_FREQUENCY:
+                if (!spectrel_is_zoom_in_band(
+                        args, command.value, receiver_params.sample_rate))
+                {
+                    snprintf(reply, sizeof(reply), "error: zoom out of band");
+                    break;
+                }
+                if (spectrel_set_frequency(receiver, command.value) != 0)
+                {
+                    snprintf(reply, sizeof(reply), "error: invalid frequency");
+                    break;
+                }
+                receiver_params.frequency = command.value;
+                args->frequency = command.value;
+                has_failed =
+                    spectrel_reopen_outputs(&outputs, args, &receiver_params);
+                break;
+            case SPECTREL_COMMAND_GAIN:
+                if (spectrel_set_gain(receiver, command.value) != 0)
+                {
+                    snprintf(reply, sizeof(reply), "error: invalid gain");
+                    break;
+                }
+                receiver_params.gain = command.value;
+                args->gain = command.value;
+                break;
+            case SPECTREL_COMMAND_WINDOW:
+                // With jobs, the plan in use is borrowed from the jobs.
+                if (args->num_jobs > 0 ||
+                    !spectrel_is_valid_window(args,
+                                              command.window_size,
+                                              command.window_hop,
+                                              arena_bytes))
+                {
+                    spectrel_free_plan(command.plan);
+                    spectrel_free_signal(command.window);
+                    snprintf(reply,
+                             sizeof(reply),
+                             args->num_jobs > 0 ? "error: set by the job"
+                                                : "error: invalid window");
+                    break;
+                }
+                // Swap in the plan made by the control thread.
+                spectrel_free_plan(plan);
+                spectrel_free_signal(window);
+                plan = command.plan;
+                window = command.window;
+                args->window_size = (int)command.window_size;
+                args->window_hop = (int)command.window_hop;
+                has_failed =
+                    spectrel_reopen_outputs(&outputs, args, &receiver_params);
+                break;
+            case SPECTREL_COMMAND_ROTATE:
+                if (outputs.file)
+                {
+                    spectrel_close_recording(&outputs);
+                    has_failed = spectrel_open_recording(
+                        &outputs, args, &receiver_params);
+                }
+                break;
+            case SPECTREL_COMMAND_PAUSE:
+                is_paused = true;
+                break;
+            case SPECTREL_COMMAND_RESUME:
+                is_paused = false;
+                break;
+            case SPECTREL_COMMAND_STOP:
+                is_stopped = true;
+                break;
+            case SPECTREL_COMMAND_STATUS:
+                snprintf(reply,
+                         sizeof(reply),
+                         "ok frequency=%.1f gain=%.1f window_size=%d "
+                         "window_hop=%d paused=%d job=%s waiting=%d file=%s",
+                         receiver_params.frequency,
+                         receiver_params.gain,
+                         args->window_size,
+                         args->window_hop,
+                         is_paused,
+                         job ? job->name : "none",
+                         is_waiting,
+                         outputs.file ? outputs.file->path : "none");
+                break;
+            }
+            if (has_failed)
+            {
+                spectrel_complete_command(control, "error: failed, stopping");
+                goto cleanup;
+            }
+            spectrel_complete_command(control, reply);
+        }
+        if (is_paused || is_waiting || is_stopped)
+        {
+            continue;
+        }
+        if (!is_streaming)
+        {
+            if (spectrel_activate_stream(receiver) != 0)
+                goto cleanup;
+            is_streaming = true;
+            spectrel_set_gauge(SPECTREL_GAUGE_STREAMING, 1);
+            last_read = 0;
+        }
+
         if (spectrogram)
         {
             spectrel_free_spectrogram(spectrogram);
             spectrogram = NULL;
+            spectrel_rewind_arena(arena, frame_mark);
         }
-        if (spectrel_read_stream(receiver, buffer) != 0)
+        uint64_t start = spectrel_get_time_ns();
+        int64_t buffer_time;
+        if (spectrel_read_stream(receiver, buffer, &buffer_time) != 0)
         {
+            // The read may have been cut short by the interrupt.
+            if (is_interrupted)
+                break;
             goto cleanup;
         }
+        uint64_t read = spectrel_get_time_ns();
+        spectrel_observe(SPECTREL_HISTOGRAM_READ, read - start);
+
+        // Track the jitter between reads, which should stay near the time a
+        // buffer takes to arrive.
+        if (last_read)
+        {
+            uint64_t interval = read - last_read;
+            spectrel_observe(SPECTREL_HISTOGRAM_READ_INTERVAL, interval);
+            if (interval > max_read_interval)
+            {
+                max_read_interval = interval;
+                spectrel_set_gauge(SPECTREL_GAUGE_READ_INTERVAL_MAX,
+                                   (int64_t)interval);
+            }
+        }
+        last_read = read;
+
         spectrogram = spectrel_stfft(plan,
                                      window,
                                      buffer,
                                      args->window_hop,
-                                     receiver_params.sample_rate);
+                                     receiver_params.sample_rate,
+                                     arena);
         if (!spectrogram)
         {
             goto cleanup;
         }
+        spectrogram->time = buffer_time;
+        uint64_t transformed = spectrel_get_time_ns();
+        spectrel_observe(SPECTREL_HISTOGRAM_STFFT, transformed - read);
+        if (spectrogram->num_spectrums > 0)
+        {
+            spectrel_observe(SPECTREL_HISTOGRAM_FFT,
+                             (transformed - read) /
+                                 spectrogram->num_spectrums);
+        }
+        spectrel_add_counter(SPECTREL_COUNTER_FRAMES,
+                             spectrogram->num_spectrums);
 
-        // Write the spectrogram to the file
-        if (spectrel_write_spectrogram(spectrogram, file) != 0)
+        // Write the spectrogram to each output.
+        if (spectrel_write_outputs(&outputs, spectrogram) != 0)
+        {
+            goto cleanup;
+        }
+        if (outputs.zoom_plan &&
+            spectrel_write_zoom(&outputs,
+                                args,
+                                window,
+                                buffer,
+                                buffer_time,
+                                receiver_params.sample_rate,
+                                arena) != 0)
+        {
+            goto cleanup;
+        }
+        if (spectrel_write_resolutions(&outputs,
+                                       args,
+                                       resolution_plans,
+                                       resolution_windows,
+                                       buffer,
+                                       buffer_time,
+                                       receiver_params.sample_rate,
+                                       arena) != 0)
+        {
+            goto cleanup;
+        }
+        if (outputs.tracker &&
+            spectrel_track(outputs.tracker, buffer, buffer_time) != 0)
         {
             goto cleanup;
         }
 
         num_samples_elapsed += args->buffer_size;
     }
+    if (max_read_interval)
+    {
+        printf("Jitter: %.3f [ms] max interval between reads, %.3f [ms] "
+               "per buffer\n",
+               max_read_interval * 1e-6,
+               args->buffer_size * sample_interval * 1e3);
+    }
     status = SPECTREL_SUCCESS;
 
 cleanup:
@@ -118,10 +1143,26 @@ cleanup:
         spectrel_free_spectrogram(spectrogram);
         spectrogram = NULL;
     }
-    if (file)
+    if (control)
+    {
+        spectrel_free_control(control);
+        control = NULL;
+    }
+    spectrel_close_outputs(&outputs);
+    if (job_plans)
+    {
+        spectrel_free_job_plans(args, job_plans, job_windows);
+        job_plans = NULL;
+        job_windows = NULL;
+        plan = NULL;
+        window = NULL;
+    }
+    for (size_t i = 0; i < SPECTREL_MAX_RESOLUTIONS; i++)
     {
-        spectrel_close_file(file);
-        file = NULL;
+        if (resolution_windows[i])
+            spectrel_free_signal(resolution_windows[i]);
+        if (resolution_plans[i])
+            spectrel_free_plan(resolution_plans[i]);
     }
     if (window)
     {
@@ -138,16 +1179,30 @@ cleanup:
         spectrel_free_signal(buffer);
         buffer = NULL;
     }
+    if (arena)
+    {
+        spectrel_free_arena(arena);
+        arena = NULL;
+    }
     if (receiver)
     {
-        spectrel_deactivate_stream(receiver);
+        if (is_streaming)
+        {
+            spectrel_deactivate_stream(receiver);
+            spectrel_set_gauge(SPECTREL_GAUGE_STREAMING, 0);
+        }
         spectrel_free_receiver(receiver);
         receiver = NULL;
     }
+    if (exporter)
+    {
+        spectrel_free_exporter(exporter);
+        exporter = NULL;
+    }
     if (args)
     {
         spectrel_free_args(args);
         args = NULL;
     }
     return (status == SPECTREL_SUCCESS) ? exit_success() : exit_failure();
-}
\ No newline at end of file
+}
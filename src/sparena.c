@@ -0,0 +1,223 @@
+#include "sparena.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief How an arena is backed.
+ */
+typedef enum
+{
+    SPECTREL_PAGES_NORMAL,      // Normal pages.
+    SPECTREL_PAGES_TRANSPARENT, // Transparent hugepages, if the kernel
+                                // finds them.
+    SPECTREL_PAGES_RESERVED,    // Hugepages reserved with MAP_HUGETLB.
+} spectrel_pages_t;
+
+struct spectrel_arena_t
+{
+    char *data;
+    size_t num_bytes; // The size of the mapping.
+    size_t used;      // The bytes allocated so far.
+    size_t peak;      // The most bytes allocated at once.
+    spectrel_pages_t pages;
+    int node; // The NUMA node the arena is bound to, or -1 if unbound.
+};
+
+static size_t spectrel_round_up(const size_t num_bytes, const size_t multiple)
+{
+    return (num_bytes + multiple - 1) / multiple * multiple;
+}
+
+size_t spectrel_get_arena_size(const size_t num_bytes)
+{
+    return spectrel_round_up(num_bytes, SPECTREL_CACHE_LINE_SIZE);
+}
+
+// Map memory aligned to a hugepage, so that transparent hugepages can back
+// all of it. The mapping is over-sized, then trimmed at both ends.
+static void *spectrel_map_aligned(const size_t num_bytes)
+{
+    size_t num_mapped = num_bytes + SPECTREL_HUGEPAGE_SIZE;
+    char *data = mmap(NULL,
+                      num_mapped,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    char *aligned = (char *)spectrel_round_up((uintptr_t)data,
+                                              SPECTREL_HUGEPAGE_SIZE);
+    if (aligned > data)
+    {
+        munmap(data, aligned - data);
+    }
+    size_t tail = (data + num_mapped) - (aligned + num_bytes);
+    if (tail > 0)
+    {
+        munmap(aligned + num_bytes, tail);
+    }
+    return aligned;
+}
+
+// Prefer the NUMA node of the calling thread, without depending on libnuma.
+// The policy is a preference rather than a binding, so that running short on
+// the node falls back to another rather than failing the fault. Kernels
+// without NUMA support refuse, which leaves the pages to be placed where they
+// are first touched: also on the calling thread's node.
+static int spectrel_bind_arena(spectrel_arena arena)
+{
+    unsigned int cpu;
+    unsigned int node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+    {
+        return -1;
+    }
+    unsigned long mask[SPECTREL_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] =
+        {0};
+    if (node >= SPECTREL_MAX_NUMA_NODES)
+    {
+        return -1;
+    }
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind,
+                arena->data,
+                arena->num_bytes,
+                MPOL_PREFERRED,
+                mask,
+                (unsigned long)SPECTREL_MAX_NUMA_NODES,
+                0) != 0)
+    {
+        return -1;
+    }
+    return (int)node;
+}
+
+void spectrel_free_arena(spectrel_arena arena)
+{
+    if (arena)
+    {
+        if (arena->data)
+        {
+            munmap(arena->data, arena->num_bytes);
+            arena->data = NULL;
+        }
+        free(arena);
+    }
+}
+
+spectrel_arena spectrel_make_arena(const size_t num_bytes)
+{
+    // Prepare arena structure with safe initial values.
+    spectrel_arena arena = calloc(1, sizeof(*arena));
+    if (!arena)
+    {
+        spectrel_print_error("malloc failed: arena");
+        return NULL;
+    }
+    arena->num_bytes = spectrel_round_up(num_bytes ? num_bytes : 1,
+                                         SPECTREL_HUGEPAGE_SIZE);
+
+    // Reserved hugepages are only available if the administrator has set
+    // some aside, so fall back to asking for transparent hugepages.
+    arena->data = mmap(NULL,
+                       arena->num_bytes,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                       -1,
+                       0);
+    if (arena->data != MAP_FAILED)
+    {
+        arena->pages = SPECTREL_PAGES_RESERVED;
+    }
+    else
+    {
+        arena->data = spectrel_map_aligned(arena->num_bytes);
+        if (!arena->data)
+        {
+            spectrel_free_arena(arena);
+            spectrel_print_error("mmap failed: %s", strerror(errno));
+            return NULL;
+        }
+        arena->pages =
+            madvise(arena->data, arena->num_bytes, MADV_HUGEPAGE) == 0
+                ? SPECTREL_PAGES_TRANSPARENT
+                : SPECTREL_PAGES_NORMAL;
+    }
+
+    // Bind, then fault in every page, so that allocating from the arena
+    // never faults.
+    arena->node = spectrel_bind_arena(arena);
+    memset(arena->data, 0, arena->num_bytes);
+
+    spectrel_set_gauge(SPECTREL_GAUGE_ARENA_BYTES, (int64_t)arena->num_bytes);
+    spectrel_set_gauge(SPECTREL_GAUGE_ARENA_USED, 0);
+    spectrel_set_gauge(SPECTREL_GAUGE_ARENA_HUGEPAGES, arena->pages);
+    spectrel_set_gauge(SPECTREL_GAUGE_ARENA_NODE, arena->node);
+    return arena;
+}
+
+void *spectrel_arena_alloc(spectrel_arena arena, const size_t num_bytes)
+{
+    if (!arena)
+    {
+        return NULL;
+    }
+    size_t size = spectrel_get_arena_size(num_bytes);
+    if (size > arena->num_bytes - arena->used)
+    {
+        spectrel_add_counter(SPECTREL_COUNTER_ARENA_MISSES, 1);
+        return NULL;
+    }
+    void *buffer = arena->data + arena->used;
+    arena->used += size;
+    if (arena->used > arena->peak)
+    {
+        arena->peak = arena->used;
+        spectrel_set_gauge(SPECTREL_GAUGE_ARENA_USED, (int64_t)arena->peak);
+    }
+    return buffer;
+}
+
+size_t spectrel_get_arena_used(spectrel_arena arena)
+{
+    return arena ? arena->used : 0;
+}
+
+size_t spectrel_get_arena_capacity(spectrel_arena arena)
+{
+    return arena ? arena->num_bytes : 0;
+}
+
+void spectrel_rewind_arena(spectrel_arena arena, const size_t used)
+{
+    if (arena && used <= arena->used)
+    {
+        arena->used = used;
+    }
+}
+
+void spectrel_describe_arena(spectrel_arena arena)
+{
+    const char *pages[] = {"normal", "transparent hugepages", "hugepages"};
+    printf("Arena: %zu [bytes], %s", arena->num_bytes, pages[arena->pages]);
+    if (arena->node >= 0)
+    {
+        printf(", NUMA node %d", arena->node);
+    }
+    printf("\n");
+}
@@ -1,10 +1,13 @@
 #include "spargparse.h"
+#include "spconfig.h"
 #include "spconstants.h"
 #include "sperror.h"
+#include "sprealtime.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 extern char *optarg;
@@ -15,13 +18,456 @@ static void spectrel_print_usage(char *argv[])
     fprintf(stderr,
             "Usage: %s -r <receiver> -f <frequency> -s <sample_rate> -b "
             "<bandwidth> -g <gain> -T <duration> [-d directory] [-w "
-            "window_size] [-h window_hop] [-B buffer_size]\n",
+            "window_size] [-h window_hop] [-B buffer_size] [-e encoding] "
+            "[-L layout] [-I input] [-P pyramid_levels] [-u socket_path] "
+            "[-D stream_decimation] [-m shm_name] [-c control_socket] "
+            "[-M metrics_path] [-p metrics_port] [-l] [-R priority] "
+            "[-x cpus] [-X background_cpus] [-W writer] "
+            "[-Q writes_in_flight] [-y dm_min:dm_max] [-Y snr_threshold] "
+            "[-j dedisp_threads] [-S stats_interval] [-k rfi_threshold] "
+            "[-K rfi_block_size] [-z rfi_action] [-V size:hop[,...]] "
+            "[-F frequency[,...]] [-H track_hop] [-Z start:stop:bins]\n"
+            "       %s -C <config_file> [options]\n"
+            "       %s -A <tune_path> -s <sample_rate> [options]\n",
+            argv[0],
+            argv[0],
             argv[0]);
 }
 
+static int spectrel_parse_double(const char *value, double *out)
+{
+    char *endptr;
+    *out = strtod(value, &endptr);
+    if (*endptr != '\0' || endptr == value)
+    {
+        spectrel_print_error("strtod failed: Could not cast %s as double",
+                             value);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_parse_int(const char *value, int *out)
+{
+    char *endptr;
+    *out = (int)strtol(value, &endptr, 10);
+    if (*endptr != '\0' || endptr == value)
+    {
+        spectrel_print_error("strtol failed: Could not cast %s as int", value);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_parse_string(const char *value, char **out)
+{
+    char *s = strdup(value);
+    if (!s)
+    {
+        spectrel_print_error("strdup failed: %s", value);
+        return SPECTREL_FAILURE;
+    }
+    free(*out);
+    *out = s;
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_parse_bool(const char *value, bool *out)
+{
+    if (strcasecmp(value, "yes") == 0 || strcasecmp(value, "true") == 0 ||
+        strcmp(value, "1") == 0)
+    {
+        *out = true;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcasecmp(value, "no") == 0 || strcasecmp(value, "false") == 0 ||
+        strcmp(value, "0") == 0)
+    {
+        *out = false;
+        return SPECTREL_SUCCESS;
+    }
+    spectrel_print_error("Could not cast %s as bool", value);
+    return SPECTREL_FAILURE;
+}
+
+// Parse the kind of input samples, "complex" or "real".
+static int spectrel_parse_input(const char *value, bool *is_real)
+{
+    if (strcmp(value, "complex") == 0)
+    {
+        *is_real = false;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcmp(value, "real") == 0)
+    {
+        *is_real = true;
+        return SPECTREL_SUCCESS;
+    }
+    spectrel_print_error("Unrecognised input: %s", value);
+    return SPECTREL_FAILURE;
+}
+
+// Parse a range of dispersion measures, as min:max.
+static int spectrel_parse_dm_range(const char *value,
+                                   double *dm_min,
+                                   double *dm_max)
+{
+    double min, max;
+    char trailing;
+    if (sscanf(value, "%lf:%lf%c", &min, &max, &trailing) != 2 || min < 0 ||
+        max <= min)
+    {
+        spectrel_print_error("Could not parse %s as a DM range", value);
+        return SPECTREL_FAILURE;
+    }
+    *dm_min = min;
+    *dm_max = max;
+    return SPECTREL_SUCCESS;
+}
+
+// Parse a list of extra resolutions, as size:hop[,size:hop...].
+static int spectrel_parse_resolutions(const char *value,
+                                      spectrel_resolution_t *resolutions,
+                                      size_t *num_resolutions)
+{
+    size_t num_parsed = 0;
+    const char *item = value;
+    while (*item != '\0')
+    {
+        int size, hop, num_chars;
+        if (num_parsed == SPECTREL_MAX_RESOLUTIONS ||
+            sscanf(item, "%d:%d%n", &size, &hop, &num_chars) != 2 ||
+            size < 1 || hop < 1 ||
+            (item[num_chars] != ',' && item[num_chars] != '\0'))
+        {
+            spectrel_print_error("Could not parse %s as at most %d "
+                                 "resolutions",
+                                 value,
+                                 SPECTREL_MAX_RESOLUTIONS);
+            return SPECTREL_FAILURE;
+        }
+        resolutions[num_parsed].window_size = size;
+        resolutions[num_parsed].window_hop = hop;
+        num_parsed += 1;
+        item += num_chars + (item[num_chars] == ',');
+    }
+    *num_resolutions = num_parsed;
+    return SPECTREL_SUCCESS;
+}
+
+// Parse a list of frequencies to track, as frequency[,frequency...].
+static int spectrel_parse_frequencies(const char *value,
+                                      double *frequencies,
+                                      size_t *num_frequencies)
+{
+    size_t num_parsed = 0;
+    const char *item = value;
+    while (*item != '\0')
+    {
+        char *endptr;
+        double frequency = strtod(item, &endptr);
+        if (num_parsed == SPECTREL_MAX_TRACKED_FREQUENCIES ||
+            endptr == item || (*endptr != ',' && *endptr != '\0'))
+        {
+            spectrel_print_error("Could not parse %s as at most %d "
+                                 "frequencies",
+                                 value,
+                                 SPECTREL_MAX_TRACKED_FREQUENCIES);
+            return SPECTREL_FAILURE;
+        }
+        frequencies[num_parsed] = frequency;
+        num_parsed += 1;
+        item = endptr + (*endptr == ',');
+    }
+    *num_frequencies = num_parsed;
+    return SPECTREL_SUCCESS;
+}
+
+// Parse a zoom interval, as start:stop:bins.
+static int spectrel_parse_zoom(const char *value,
+                               double *start,
+                               double *stop,
+                               int *num_bins)
+{
+    int num_chars = 0;
+    int num_parsed =
+        sscanf(value, "%lf:%lf:%d%n", start, stop, num_bins, &num_chars);
+    if (num_parsed != 3 || value[num_chars] != '\0' || *stop <= *start ||
+        *num_bins < 1)
+    {
+        spectrel_print_error("Could not parse %s as a zoom interval", value);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Parse a time of day, HH:MM or HH:MM:SS, as seconds past midnight.
+static int spectrel_parse_time_of_day(const char *value, int *out)
+{
+    int hours, minutes, seconds = 0;
+    char trailing;
+    int num_parsed = sscanf(
+        value, "%d:%d:%d%c", &hours, &minutes, &seconds, &trailing);
+    if ((num_parsed != 2 && num_parsed != 3) || hours < 0 || hours > 23 ||
+        minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59)
+    {
+        spectrel_print_error("Could not parse %s as HH:MM[:SS]", value);
+        return SPECTREL_FAILURE;
+    }
+    *out = hours * 3600 + minutes * 60 + seconds;
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_load_config(spectrel_args_t *args, const char *path);
+
+// Set the argument for a command line option.
+static int spectrel_set_arg(spectrel_args_t *args,
+                            const int opt,
+                            const char *value)
+{
+    switch (opt)
+    {
+    case 'd':
+        return spectrel_parse_string(value, &args->dir);
+    case 'r':
+        return spectrel_parse_string(value, &args->driver);
+    case 'f':
+        return spectrel_parse_double(value, &args->frequency);
+    case 's':
+        return spectrel_parse_double(value, &args->sample_rate);
+    case 'b':
+        return spectrel_parse_double(value, &args->bandwidth);
+    case 'g':
+        return spectrel_parse_double(value, &args->gain);
+    case 'T':
+        return spectrel_parse_double(value, &args->duration);
+    case 'w':
+        return spectrel_parse_int(value, &args->window_size);
+    case 'h':
+        return spectrel_parse_int(value, &args->window_hop);
+    case 'B':
+        return spectrel_parse_int(value, &args->buffer_size);
+    case 'e':
+        return spectrel_parse_encoding(value, &args->encoding);
+    case 'L':
+        return spectrel_parse_layout(value, &args->layout);
+    case 'I':
+        return spectrel_parse_input(value, &args->is_real_input);
+    case 'P':
+        return spectrel_parse_int(value, &args->num_pyramid_levels);
+    case 'u':
+        return spectrel_parse_string(value, &args->socket_path);
+    case 'D':
+        return spectrel_parse_int(value, &args->stream_decimation);
+    case 'm':
+        return spectrel_parse_string(value, &args->shm_name);
+    case 'c':
+        return spectrel_parse_string(value, &args->control_path);
+    case 'C':
+        if (spectrel_parse_string(value, &args->config_path) != 0)
+            return SPECTREL_FAILURE;
+        return spectrel_load_config(args, value);
+    case 'M':
+        return spectrel_parse_string(value, &args->metrics_path);
+    case 'p':
+        return spectrel_parse_int(value, &args->metrics_port);
+    case 'A':
+        return spectrel_parse_string(value, &args->tune_path);
+    case 'l':
+        // On the command line, the option is a flag.
+        if (!value)
+        {
+            args->lock_memory = true;
+            return SPECTREL_SUCCESS;
+        }
+        return spectrel_parse_bool(value, &args->lock_memory);
+    case 'R':
+        return spectrel_parse_int(value, &args->realtime_priority);
+    case 'x':
+        if (spectrel_check_cpus(value) != 0)
+            return SPECTREL_FAILURE;
+        return spectrel_parse_string(value, &args->cpus);
+    case 'X':
+        if (spectrel_check_cpus(value) != 0)
+            return SPECTREL_FAILURE;
+        return spectrel_parse_string(value, &args->background_cpus);
+    case 'W':
+        return spectrel_parse_writer_backend(value, &args->writer);
+    case 'Q':
+        return spectrel_parse_int(value, &args->writes_in_flight);
+    case 'y':
+        return spectrel_parse_dm_range(value, &args->dm_min, &args->dm_max);
+    case 'Y':
+        return spectrel_parse_double(value, &args->snr_threshold);
+    case 'j':
+        return spectrel_parse_int(value, &args->dedisp_threads);
+    case 'S':
+        return spectrel_parse_double(value, &args->stats_interval);
+    case 'k':
+        return spectrel_parse_double(value, &args->rfi_threshold);
+    case 'K':
+        return spectrel_parse_int(value, &args->rfi_block_size);
+    case 'z':
+        return spectrel_parse_rfi_action(value, &args->rfi_action);
+    case 'V':
+        return spectrel_parse_resolutions(
+            value, args->resolutions, &args->num_resolutions);
+    case 'F':
+        return spectrel_parse_frequencies(
+            value, args->track_frequencies, &args->num_track_frequencies);
+    case 'H':
+        return spectrel_parse_int(value, &args->track_hop);
+    case 'Z':
+        return spectrel_parse_zoom(value,
+                                   &args->zoom_start,
+                                   &args->zoom_stop,
+                                   &args->zoom_num_bins);
+    default:
+        return SPECTREL_FAILURE;
+    }
+}
+
+// Config file keys for each command line option.
+static const struct
+{
+    const char *key;
+    int opt;
+} spectrel_config_keys[] = {
+    {"dir", 'd'},
+    {"receiver", 'r'},
+    {"frequency", 'f'},
+    {"sample_rate", 's'},
+    {"bandwidth", 'b'},
+    {"gain", 'g'},
+    {"duration", 'T'},
+    {"window_size", 'w'},
+    {"window_hop", 'h'},
+    {"buffer_size", 'B'},
+    {"encoding", 'e'},
+    {"layout", 'L'},
+    {"input", 'I'},
+    {"pyramid_levels", 'P'},
+    {"socket_path", 'u'},
+    {"stream_decimation", 'D'},
+    {"shm_name", 'm'},
+    {"control_socket", 'c'},
+    {"metrics_path", 'M'},
+    {"metrics_port", 'p'},
+    {"lock_memory", 'l'},
+    {"realtime_priority", 'R'},
+    {"cpus", 'x'},
+    {"background_cpus", 'X'},
+    {"writer", 'W'},
+    {"writes_in_flight", 'Q'},
+    {"dm_range", 'y'},
+    {"snr_threshold", 'Y'},
+    {"dedisp_threads", 'j'},
+    {"stats_interval", 'S'},
+    {"rfi_threshold", 'k'},
+    {"rfi_block_size", 'K'},
+    {"rfi_action", 'z'},
+    {"resolutions", 'V'},
+    {"track_frequencies", 'F'},
+    {"track_hop", 'H'},
+    {"zoom", 'Z'},
+};
+
+// Start a new job, with the settings given so far as defaults.
+static int spectrel_add_job(spectrel_args_t *args, const char *name)
+{
+    if (*name == '\0')
+    {
+        return SPECTREL_FAILURE;
+    }
+    spectrel_job_t *jobs =
+        realloc(args->jobs, (args->num_jobs + 1) * sizeof(spectrel_job_t));
+    if (!jobs)
+    {
+        spectrel_print_error("realloc failed: jobs");
+        return SPECTREL_FAILURE;
+    }
+    args->jobs = jobs;
+
+    spectrel_job_t *job = &args->jobs[args->num_jobs];
+    *job = (spectrel_job_t){.frequency = args->frequency,
+                            .gain = args->gain,
+                            .duration = args->duration,
+                            .window_size = args->window_size,
+                            .window_hop = args->window_hop,
+                            .encoding = args->encoding,
+                            .start_time = -1};
+    job->name = strdup(name);
+    if (!job->name)
+    {
+        spectrel_print_error("strdup failed: %s", name);
+        return SPECTREL_FAILURE;
+    }
+    args->num_jobs += 1;
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_set_job_arg(spectrel_job_t *job,
+                                const char *key,
+                                const char *value)
+{
+    if (strcmp(key, "frequency") == 0)
+        return spectrel_parse_double(value, &job->frequency);
+    if (strcmp(key, "gain") == 0)
+        return spectrel_parse_double(value, &job->gain);
+    if (strcmp(key, "duration") == 0)
+        return spectrel_parse_double(value, &job->duration);
+    if (strcmp(key, "window_size") == 0)
+        return spectrel_parse_int(value, &job->window_size);
+    if (strcmp(key, "window_hop") == 0)
+        return spectrel_parse_int(value, &job->window_hop);
+    if (strcmp(key, "encoding") == 0)
+        return spectrel_parse_encoding(value, &job->encoding);
+    if (strcmp(key, "start") == 0)
+        return spectrel_parse_time_of_day(value, &job->start_time);
+    return SPECTREL_FAILURE;
+}
+
+// Keys before the first section set the defaults, each section is a job.
+static int spectrel_handle_config(void *data,
+                                  const char *section,
+                                  const char *key,
+                                  const char *value)
+{
+    spectrel_args_t *args = data;
+    if (!key)
+    {
+        return spectrel_add_job(args, section);
+    }
+    if (*section != '\0')
+    {
+        return spectrel_set_job_arg(
+            &args->jobs[args->num_jobs - 1], key, value);
+    }
+
+    if (strcmp(key, "repeat") == 0)
+    {
+        return spectrel_parse_bool(value, &args->repeat_jobs);
+    }
+    for (size_t i = 0;
+         i < sizeof(spectrel_config_keys) / sizeof(spectrel_config_keys[0]);
+         i++)
+    {
+        if (strcmp(key, spectrel_config_keys[i].key) == 0)
+        {
+            return spectrel_set_arg(args, spectrel_config_keys[i].opt, value);
+        }
+    }
+    return SPECTREL_FAILURE;
+}
+
+static int spectrel_load_config(spectrel_args_t *args, const char *path)
+{
+    return spectrel_read_config(path, spectrel_handle_config, args);
+}
+
 spectrel_args_t *spectrel_parse_args(int argc, char *argv[])
 {
-    spectrel_args_t *args = malloc(1 * sizeof(spectrel_args_t));
+    spectrel_args_t *args = calloc(1, sizeof(spectrel_args_t));
     if (!args)
         return NULL;
 
@@ -29,6 +475,44 @@ spectrel_args_t *spectrel_parse_args(int argc, char *argv[])
     args->window_size = SPECTREL_DEFAULT_WINDOW_SIZE;
     args->window_hop = SPECTREL_DEFAULT_WINDOW_HOP;
     args->buffer_size = SPECTREL_DEFAULT_BUFFER_SIZE;
+    spectrel_parse_encoding(SPECTREL_DEFAULT_ENCODING, &args->encoding);
+    if (spectrel_parse_layout(SPECTREL_DEFAULT_LAYOUT, &args->layout) != 0)
+    {
+        spectrel_free_args(args);
+        return NULL;
+    }
+    args->num_pyramid_levels = SPECTREL_DEFAULT_PYRAMID_LEVELS;
+    args->socket_path = NULL;
+    args->stream_decimation = SPECTREL_DEFAULT_SERVER_DECIMATION;
+    args->shm_name = NULL;
+    args->control_path = NULL;
+    args->config_path = NULL;
+    args->metrics_path = NULL;
+    args->metrics_port = 0;
+    args->tune_path = NULL;
+    args->lock_memory = false;
+    args->realtime_priority = 0;
+    args->cpus = NULL;
+    args->background_cpus = NULL;
+    spectrel_parse_writer_backend(SPECTREL_DEFAULT_WRITER, &args->writer);
+    args->writes_in_flight = SPECTREL_DEFAULT_WRITES_IN_FLIGHT;
+    args->dm_min = 0;
+    args->dm_max = 0;
+    args->snr_threshold = SPECTREL_DEFAULT_SNR_THRESHOLD;
+    args->dedisp_threads = SPECTREL_DEFAULT_DEDISP_THREADS;
+    args->stats_interval = 0;
+    args->rfi_threshold = 0;
+    args->rfi_block_size = SPECTREL_DEFAULT_RFI_BLOCK_SIZE;
+    spectrel_parse_rfi_action(SPECTREL_DEFAULT_RFI_ACTION, &args->rfi_action);
+    args->num_resolutions = 0;
+    args->num_track_frequencies = 0;
+    args->track_hop = SPECTREL_DEFAULT_TRACK_HOP;
+    args->zoom_start = 0;
+    args->zoom_stop = 0;
+    args->zoom_num_bins = 0;
+    args->jobs = NULL;
+    args->num_jobs = 0;
+    args->repeat_jobs = false;
     args->dir = strdup(SPECTREL_DEFAULT_DIRECTORY);
     if (!args->dir)
     {
@@ -36,125 +520,129 @@ spectrel_args_t *spectrel_parse_args(int argc, char *argv[])
         return NULL;
     }
 
+    // Options are applied in order, so options given after a config file
+    // override it.
     int opt;
-    while ((opt = getopt(argc, argv, "d:r:f:s:b:g:T:w:h:B:")) != -1)
+    const char *optstring = "d:r:f:s:b:g:T:w:h:B:e:L:I:P:u:D:m:c:C:M:p:A:lR:"
+                            "x:X:W:Q:y:Y:j:S:k:K:z:V:F:H:Z:";
+    while ((opt = getopt(argc, argv, optstring)) != -1)
     {
-        char *endptr;
-        switch (opt)
+        if (opt == '?')
         {
-        case 'd':
-            free(args->dir);
-            args->dir = strdup(optarg);
-            if (!args->dir)
-            {
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'r':
-            args->driver = strdup(optarg);
-            if (!args->driver)
-            {
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'f':
-            args->frequency = strtod(optarg, &endptr);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error(
-                    "strtod failed: Could not cast %s as double", optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 's':
-            args->sample_rate = strtod(optarg, &endptr);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error(
-                    "strtod failed: Could not cast %s as double", optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'b':
-            args->bandwidth = strtod(optarg, &endptr);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error(
-                    "strtod failed: Could not cast %s as double", optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'g':
-            args->gain = strtod(optarg, &endptr);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error(
-                    "strtod failed: Could not cast %s as double", optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'T':
-            args->duration = strtod(optarg, &endptr);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error(
-                    "strtod failed: Could not cast %s as double", optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'w':
-            args->window_size = (int)strtol(optarg, &endptr, 10);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error("strtol failed: Could not cast %s as int",
-                                     optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'h':
-            args->window_hop = (int)strtol(optarg, &endptr, 10);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error("strtol failed: Could not cast %s as int",
-                                     optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        case 'B':
-            args->buffer_size = (int)strtol(optarg, &endptr, 10);
-            if (*endptr != '\0')
-            {
-                spectrel_print_error("strtol failed: Could not cast %s as int",
-                                     optarg);
-                spectrel_free_args(args);
-                return NULL;
-            }
-            break;
-        default:
             spectrel_print_usage(argv);
             spectrel_free_args(args);
             return NULL;
         }
+        if (spectrel_set_arg(args, opt, optarg) != 0)
+        {
+            spectrel_free_args(args);
+            return NULL;
+        }
     }
 
-    // Check required arguments
-    if (!args->driver || args->frequency == 0 || args->sample_rate == 0 ||
-        args->bandwidth == 0 || args->gain == 0 || args->duration == 0)
+    // Check required arguments. With jobs, each job has its own frequency,
+    // gain and duration. Under control, the duration is optional. Autotuning
+    // uses a synthetic source, so needs only the sample rate.
+    bool is_tuning = args->tune_path && args->sample_rate != 0;
+    bool has_receiver =
+        args->driver && args->sample_rate != 0 && args->bandwidth != 0;
+    bool has_jobs = args->num_jobs > 0;
+    for (size_t i = 0; i < args->num_jobs; i++)
+    {
+        if (args->jobs[i].frequency == 0)
+        {
+            spectrel_print_error("Job %s has no frequency", args->jobs[i].name);
+            has_jobs = false;
+        }
+    }
+    if (!is_tuning &&
+        (!has_receiver ||
+         (!has_jobs &&
+          (args->frequency == 0 || args->gain == 0 ||
+           (args->duration == 0 && !args->control_path)))))
     {
         spectrel_print_usage(argv);
         spectrel_free_args(args);
         return NULL;
     }
 
+    if (args->writes_in_flight < 1)
+    {
+        spectrel_print_error("At least one write must be allowed in flight");
+        spectrel_free_args(args);
+        return NULL;
+    }
+
+    if (args->dedisp_threads < 1 ||
+        args->dedisp_threads > SPECTREL_MAX_DEDISP_THREADS)
+    {
+        spectrel_print_error("Dedispersion threads must be from 1 to %d",
+                             SPECTREL_MAX_DEDISP_THREADS);
+        spectrel_free_args(args);
+        return NULL;
+    }
+
+    if (args->stats_interval < 0)
+    {
+        spectrel_print_error("Statistics interval must not be negative");
+        spectrel_free_args(args);
+        return NULL;
+    }
+
+    if (args->rfi_threshold < 0 || args->rfi_block_size < 2)
+    {
+        spectrel_print_error("RFI threshold must not be negative, and blocks "
+                             "must hold at least 2 spectrums");
+        spectrel_free_args(args);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < args->num_resolutions; i++)
+    {
+        if (args->resolutions[i].window_size > args->buffer_size)
+        {
+            spectrel_print_error("Resolution window must fit in a buffer");
+            spectrel_free_args(args);
+            return NULL;
+        }
+    }
+
+    // The zoom interval must lie within the band at every centre frequency,
+    // which is that of each job, if there are any.
+    size_t num_frequencies = args->num_jobs > 0 ? args->num_jobs : 1;
+    for (size_t i = 0; i < num_frequencies && args->zoom_num_bins > 0; i++)
+    {
+        double frequency =
+            args->num_jobs > 0 ? args->jobs[i].frequency : args->frequency;
+        if (args->zoom_start - frequency < -args->sample_rate / 2 ||
+            args->zoom_stop - frequency > args->sample_rate / 2)
+        {
+            spectrel_print_error("Zoom interval must lie within half the "
+                                 "sample rate of %.1f [Hz]",
+                                 frequency);
+            spectrel_free_args(args);
+            return NULL;
+        }
+    }
+
+    if (args->track_hop < 1)
+    {
+        spectrel_print_error("Track hop must be at least one sample");
+        spectrel_free_args(args);
+        return NULL;
+    }
+
+    // Pyramids and subscribers expect every spectral component, so they can't
+    // be used with the half spectrums of real-valued inputs.
+    if (args->is_real_input &&
+        (args->num_pyramid_levels > 0 || args->socket_path))
+    {
+        spectrel_print_error(
+            "Real input is not supported with pyramids or streaming");
+        spectrel_free_args(args);
+        return NULL;
+    }
+
     return args;
 }
 
@@ -168,6 +656,38 @@ int spectrel_free_args(spectrel_args_t *args)
         if (args->driver)
             free(args->driver);
         args->driver = NULL;
+        if (args->socket_path)
+            free(args->socket_path);
+        args->socket_path = NULL;
+        if (args->shm_name)
+            free(args->shm_name);
+        args->shm_name = NULL;
+        if (args->control_path)
+            free(args->control_path);
+        args->control_path = NULL;
+        if (args->config_path)
+            free(args->config_path);
+        args->config_path = NULL;
+        if (args->metrics_path)
+            free(args->metrics_path);
+        args->metrics_path = NULL;
+        if (args->tune_path)
+            free(args->tune_path);
+        args->tune_path = NULL;
+        if (args->cpus)
+            free(args->cpus);
+        args->cpus = NULL;
+        if (args->background_cpus)
+            free(args->background_cpus);
+        args->background_cpus = NULL;
+        if (args->jobs)
+        {
+            for (size_t i = 0; i < args->num_jobs; i++)
+                free(args->jobs[i].name);
+            free(args->jobs);
+        }
+        args->jobs = NULL;
+        args->num_jobs = 0;
         free(args);
     }
     return SPECTREL_SUCCESS;
@@ -188,4 +708,94 @@ void spectrel_describe_args(spectrel_args_t *args)
     printf("  Window size: %d [#samples]\n", args->window_size);
     printf("  Window hop:  %d [#samples]\n", args->window_hop);
     printf("  Buffer size: %d [#samples]\n", args->buffer_size);
-}
\ No newline at end of file
+    printf("  Encoding:    %s\n", spectrel_get_encoding_name(args->encoding));
+    printf("  Layout:      %s\n", spectrel_get_layout_name(args->layout));
+    printf("  Input:       %s\n", args->is_real_input ? "real" : "complex");
+    printf("  Pyramid:     %d [#levels]\n", args->num_pyramid_levels);
+    printf("  Writer:      %s", spectrel_get_writer_backend_name(args->writer));
+    if (args->writer != SPECTREL_WRITER_STDIO)
+        printf(", %d [#writes in flight]", args->writes_in_flight);
+    printf("\n");
+    if (args->dm_max > 0)
+    {
+        printf("  DM range:    %.2f to %.2f [pc cm^-3]\n",
+               args->dm_min,
+               args->dm_max);
+        printf("  SNR:         %.1f, %d [#threads]\n",
+               args->snr_threshold,
+               args->dedisp_threads);
+    }
+    if (args->stats_interval > 0)
+        printf("  Statistics:  %.2f [s]\n", args->stats_interval);
+    for (size_t i = 0; i < args->num_resolutions; i++)
+        printf("  Resolution:  %d [#samples], %d [#samples hop]\n",
+               args->resolutions[i].window_size,
+               args->resolutions[i].window_hop);
+    if (args->zoom_num_bins > 0)
+        printf("  Zoom:        %.1f to %.1f [Hz], %d [#bins]\n",
+               args->zoom_start,
+               args->zoom_stop,
+               args->zoom_num_bins);
+    if (args->num_track_frequencies > 0)
+    {
+        printf("  Tracking:    ");
+        for (size_t i = 0; i < args->num_track_frequencies; i++)
+            printf("%s%.1f", i ? ", " : "", args->track_frequencies[i]);
+        printf(" [Hz], %d [#samples hop]\n", args->track_hop);
+    }
+    if (args->rfi_threshold > 0)
+        printf("  RFI:         %.1f [sigma], %d [#spectrums], %s\n",
+               args->rfi_threshold,
+               args->rfi_block_size,
+               spectrel_get_rfi_action_name(args->rfi_action));
+    if (args->socket_path)
+    {
+        printf("  Socket:      %s\n", args->socket_path);
+        printf("  Decimation:  %d\n", args->stream_decimation);
+    }
+    if (args->shm_name)
+        printf("  Shm:         %s\n", args->shm_name);
+    if (args->control_path)
+        printf("  Control:     %s\n", args->control_path);
+    if (args->metrics_path)
+        printf("  Metrics:     %s\n", args->metrics_path);
+    if (args->metrics_port)
+        printf("  Metrics:     http://127.0.0.1:%d/metrics\n",
+               args->metrics_port);
+    if (args->tune_path)
+        printf("  Autotune:    %s\n", args->tune_path);
+    if (args->lock_memory)
+        printf("  Memory:      locked\n");
+    if (args->realtime_priority)
+        printf("  Priority:    SCHED_FIFO %d\n", args->realtime_priority);
+    if (args->cpus)
+        printf("  CPUs:        %s\n", args->cpus);
+    if (args->background_cpus)
+        printf("  Background:  %s\n", args->background_cpus);
+    if (args->config_path)
+    {
+        printf("  Config:      %s\n", args->config_path);
+        printf("  Repeat:      %s\n", args->repeat_jobs ? "yes" : "no");
+    }
+    for (size_t i = 0; i < args->num_jobs; i++)
+    {
+        const spectrel_job_t *job = &args->jobs[i];
+        printf("  Job %s: %.1f [Hz], %.1f [dB], %d/%d [#samples], %s, ",
+               job->name,
+               job->frequency,
+               job->gain,
+               job->window_size,
+               job->window_hop,
+               spectrel_get_encoding_name(job->encoding));
+        if (job->duration > 0)
+            printf("%.2f [s]", job->duration);
+        else
+            printf("until stopped");
+        if (job->start_time >= 0)
+            printf(", from %02d:%02d:%02d UTC",
+                   job->start_time / 3600,
+                   job->start_time / 60 % 60,
+                   job->start_time % 60);
+        printf("\n");
+    }
+}
@@ -0,0 +1,116 @@
+#include "spconfig.h"
+#include "spconstants.h"
+#include "sperror.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// Strip leading and trailing whitespace, in place.
+static char *spectrel_strip(char *s)
+{
+    while (isspace((unsigned char)*s))
+    {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+    {
+        end--;
+    }
+    *end = '\0';
+    return s;
+}
+
+// Strip a comment which follows a value.
+static void spectrel_strip_comment(char *s)
+{
+    for (char *c = s; *c; c++)
+    {
+        if ((*c == '#' || *c == ';') &&
+            (c == s || isspace((unsigned char)c[-1])))
+        {
+            *c = '\0';
+            return;
+        }
+    }
+}
+
+int spectrel_read_config(const char *path,
+                         spectrel_config_handler_t handler,
+                         void *data)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        spectrel_print_error("fopen failed: %s: %s", path, strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+
+    char buffer[SPECTREL_CONFIG_LINE_SIZE];
+    char section[SPECTREL_CONFIG_LINE_SIZE] = "";
+    size_t line_number = 0;
+    int status = SPECTREL_SUCCESS;
+    while (status == SPECTREL_SUCCESS && fgets(buffer, sizeof(buffer), file))
+    {
+        line_number += 1;
+        if (!strchr(buffer, '\n') && !feof(file))
+        {
+            spectrel_print_error(
+                "Line too long in config: %s:%zu", path, line_number);
+            status = SPECTREL_FAILURE;
+            break;
+        }
+
+        char *line = spectrel_strip(buffer);
+        if (*line == '\0' || *line == '#' || *line == ';')
+        {
+            continue;
+        }
+
+        if (*line == '[')
+        {
+            char *end = strchr(line, ']');
+            if (!end || *spectrel_strip(end + 1) != '\0')
+            {
+                spectrel_print_error(
+                    "Invalid section in config: %s:%zu", path, line_number);
+                status = SPECTREL_FAILURE;
+                break;
+            }
+            *end = '\0';
+            snprintf(section, sizeof(section), "%s", spectrel_strip(line + 1));
+            if (handler(data, section, NULL, NULL) != 0)
+            {
+                spectrel_print_error(
+                    "Invalid section in config: %s:%zu", path, line_number);
+                status = SPECTREL_FAILURE;
+            }
+            continue;
+        }
+
+        char *equals = strchr(line, '=');
+        if (!equals)
+        {
+            spectrel_print_error(
+                "Expected key = value in config: %s:%zu", path, line_number);
+            status = SPECTREL_FAILURE;
+            break;
+        }
+        *equals = '\0';
+        char *key = spectrel_strip(line);
+        char *value = equals + 1;
+        spectrel_strip_comment(value);
+        value = spectrel_strip(value);
+        if (handler(data, section, key, value) != 0)
+        {
+            spectrel_print_error(
+                "Invalid %s in config: %s:%zu", key, path, line_number);
+            status = SPECTREL_FAILURE;
+        }
+    }
+
+    fclose(file);
+    return status;
+}
@@ -0,0 +1,548 @@
+#include "spcontrol.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "sprealtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+    int fd;
+    char line[SPECTREL_CONTROL_LINE_SIZE]; // The line received so far.
+    size_t line_size;
+} spectrel_controller_t;
+
+// The command handed from the control thread to the recording thread.
+typedef enum
+{
+    SPECTREL_MAILBOX_EMPTY,   // No command.
+    SPECTREL_MAILBOX_PENDING, // Waiting to be taken.
+    SPECTREL_MAILBOX_TAKEN,   // Being applied.
+    SPECTREL_MAILBOX_DONE,    // Applied, and the reply is ready.
+} spectrel_mailbox_state_t;
+
+struct spectrel_control_t
+{
+    char *socket_path;
+    int listen_fd;
+    int wake_fd;
+    pthread_t thread;
+    bool has_thread;
+    atomic_bool is_running;
+    spectrel_layout_t layout; // The layout new plans are made in.
+    bool is_real;             // Whether new plans take real-valued inputs.
+
+    spectrel_controller_t controllers[SPECTREL_MAX_CONTROLLERS];
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool has_mutex;
+    spectrel_mailbox_state_t state;
+    spectrel_command_t command;
+    char reply[SPECTREL_CONTROL_LINE_SIZE];
+};
+
+static void spectrel_drop_controller(spectrel_controller_t *controller)
+{
+    if (controller->fd >= 0)
+    {
+        close(controller->fd);
+        controller->fd = -1;
+    }
+    controller->line_size = 0;
+}
+
+static void spectrel_accept_controller(spectrel_control control)
+{
+    int fd = accept(control->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+    {
+        close(fd);
+        return;
+    }
+    for (size_t i = 0; i < SPECTREL_MAX_CONTROLLERS; i++)
+    {
+        if (control->controllers[i].fd < 0)
+        {
+            control->controllers[i].fd = fd;
+            control->controllers[i].line_size = 0;
+            return;
+        }
+    }
+    close(fd);
+}
+
+// Replies are short enough to always fit in the socket buffer.
+static int spectrel_reply(spectrel_controller_t *controller, const char *reply)
+{
+    char line[SPECTREL_CONTROL_LINE_SIZE + 1];
+    int size = snprintf(line, sizeof(line), "%s\n", reply);
+    if (size < 0 || (size_t)size >= sizeof(line))
+    {
+        line[sizeof(line) - 2] = '\n';
+        size = sizeof(line) - 1;
+    }
+    if (send(controller->fd, line, (size_t)size, MSG_NOSIGNAL | MSG_DONTWAIT) !=
+        size)
+    {
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_parse_number(const char *word, double *value)
+{
+    if (!word)
+    {
+        return SPECTREL_FAILURE;
+    }
+    char *endptr;
+    *value = strtod(word, &endptr);
+    return (*endptr != '\0' || endptr == word) ? SPECTREL_FAILURE
+                                               : SPECTREL_SUCCESS;
+}
+
+// Parse a line into a command, making a plan for new window sizes. On failure,
+// the reason is written to the reply.
+static int spectrel_parse_command(char *line,
+                                  const spectrel_layout_t layout,
+                                  const bool is_real,
+                                  spectrel_command_t *command,
+                                  char *reply,
+                                  const size_t reply_size)
+{
+    char *saveptr = NULL;
+    char *name = strtok_r(line, " \t\r", &saveptr);
+    char *first = strtok_r(NULL, " \t\r", &saveptr);
+    char *second = strtok_r(NULL, " \t\r", &saveptr);
+    *command = (spectrel_command_t){0};
+    if (!name)
+    {
+        snprintf(reply, reply_size, "error: empty command");
+        return SPECTREL_FAILURE;
+    }
+
+    if (strcmp(name, "frequency") == 0 || strcmp(name, "gain") == 0)
+    {
+        command->type = name[0] == 'f' ? SPECTREL_COMMAND_FREQUENCY
+                                       : SPECTREL_COMMAND_GAIN;
+        if (spectrel_parse_number(first, &command->value) != 0 || second)
+        {
+            snprintf(reply, reply_size, "error: usage: %s <value>", name);
+            return SPECTREL_FAILURE;
+        }
+        return SPECTREL_SUCCESS;
+    }
+
+    if (strcmp(name, "window") == 0)
+    {
+        double window_size;
+        double window_hop;
+        if (spectrel_parse_number(first, &window_size) != 0 ||
+            window_size < 1 || window_size != (size_t)window_size)
+        {
+            snprintf(reply, reply_size, "error: usage: window <size> [hop]");
+            return SPECTREL_FAILURE;
+        }
+        if (!second)
+        {
+            window_hop = (size_t)window_size / 2 ? (size_t)window_size / 2 : 1;
+        }
+        else if (spectrel_parse_number(second, &window_hop) != 0 ||
+                 window_hop < 1 || window_hop != (size_t)window_hop)
+        {
+            snprintf(reply, reply_size, "error: usage: window <size> [hop]");
+            return SPECTREL_FAILURE;
+        }
+        command->type = SPECTREL_COMMAND_WINDOW;
+        command->window_size = (size_t)window_size;
+        command->window_hop = (size_t)window_hop;
+
+        // Plan here, so that the recording thread only has to swap plans.
+        command->plan =
+            spectrel_make_plan(command->window_size, layout, is_real);
+        command->window = spectrel_make_window(command->window_size);
+        if (!command->plan || !command->window)
+        {
+            spectrel_free_plan(command->plan);
+            spectrel_free_signal(command->window);
+            command->plan = NULL;
+            command->window = NULL;
+            snprintf(reply, reply_size, "error: planning failed");
+            return SPECTREL_FAILURE;
+        }
+        return SPECTREL_SUCCESS;
+    }
+
+    const struct
+    {
+        const char *name;
+        spectrel_command_type_t type;
+    } commands[] = {{"rotate", SPECTREL_COMMAND_ROTATE},
+                    {"pause", SPECTREL_COMMAND_PAUSE},
+                    {"resume", SPECTREL_COMMAND_RESUME},
+                    {"stop", SPECTREL_COMMAND_STOP},
+                    {"status", SPECTREL_COMMAND_STATUS}};
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        if (strcmp(name, commands[i].name) == 0)
+        {
+            if (first)
+            {
+                snprintf(reply, reply_size, "error: usage: %s", name);
+                return SPECTREL_FAILURE;
+            }
+            command->type = commands[i].type;
+            return SPECTREL_SUCCESS;
+        }
+    }
+    snprintf(reply, reply_size, "error: unknown command: %s", name);
+    return SPECTREL_FAILURE;
+}
+
+// Hand a command to the recording thread, and wait for it to be applied.
+static void spectrel_submit_command(spectrel_control control,
+                                    spectrel_command_t *command,
+                                    char *reply,
+                                    const size_t reply_size)
+{
+    pthread_mutex_lock(&control->mutex);
+    control->command = *command;
+    control->state = SPECTREL_MAILBOX_PENDING;
+    pthread_cond_broadcast(&control->cond);
+    while (control->state != SPECTREL_MAILBOX_DONE &&
+           atomic_load_explicit(&control->is_running, memory_order_acquire))
+    {
+        pthread_cond_wait(&control->cond, &control->mutex);
+    }
+
+    if (control->state == SPECTREL_MAILBOX_DONE)
+    {
+        snprintf(reply, reply_size, "%s", control->reply);
+    }
+    else
+    {
+        // Shutting down. If the command was never taken, it is still ours.
+        if (control->state == SPECTREL_MAILBOX_PENDING)
+        {
+            spectrel_free_plan(control->command.plan);
+            spectrel_free_signal(control->command.window);
+        }
+        snprintf(reply, reply_size, "error: stopped");
+    }
+    control->state = SPECTREL_MAILBOX_EMPTY;
+    pthread_mutex_unlock(&control->mutex);
+}
+
+// Read whatever the controller has sent, and act on each complete line.
+static int spectrel_serve_controller(spectrel_control control,
+                                     spectrel_controller_t *controller)
+{
+    char *line = controller->line;
+    ssize_t ret = recv(controller->fd,
+                       line + controller->line_size,
+                       sizeof(controller->line) - controller->line_size,
+                       0);
+    if (ret <= 0)
+    {
+        return (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                   ? SPECTREL_SUCCESS
+                   : SPECTREL_FAILURE;
+    }
+    controller->line_size += (size_t)ret;
+
+    char *newline;
+    while ((newline = memchr(line, '\n', controller->line_size)))
+    {
+        *newline = '\0';
+        size_t consumed = (size_t)(newline - line) + 1;
+
+        char reply[SPECTREL_CONTROL_LINE_SIZE];
+        spectrel_command_t command;
+        if (spectrel_parse_command(line,
+                                   control->layout,
+                                   control->is_real,
+                                   &command,
+                                   reply,
+                                   sizeof(reply)) == 0)
+        {
+            spectrel_submit_command(control, &command, reply, sizeof(reply));
+        }
+        if (spectrel_reply(controller, reply) != 0)
+        {
+            return SPECTREL_FAILURE;
+        }
+
+        memmove(line, line + consumed, controller->line_size - consumed);
+        controller->line_size -= consumed;
+    }
+
+    if (controller->line_size == sizeof(controller->line))
+    {
+        spectrel_reply(controller, "error: line too long");
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static void *spectrel_serve_control(void *arg)
+{
+    spectrel_control control = arg;
+    struct pollfd fds[2 + SPECTREL_MAX_CONTROLLERS];
+    spectrel_controller_t *polled[SPECTREL_MAX_CONTROLLERS];
+
+    while (atomic_load_explicit(&control->is_running, memory_order_acquire))
+    {
+        fds[0].fd = control->listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = control->wake_fd;
+        fds[1].events = POLLIN;
+        nfds_t num_fds = 2;
+        for (size_t i = 0; i < SPECTREL_MAX_CONTROLLERS; i++)
+        {
+            if (control->controllers[i].fd < 0)
+            {
+                continue;
+            }
+            fds[num_fds].fd = control->controllers[i].fd;
+            fds[num_fds].events = POLLIN;
+            polled[num_fds - 2] = &control->controllers[i];
+            num_fds += 1;
+        }
+
+        if (poll(fds, num_fds, SPECTREL_CONTROL_POLL_TIMEOUT) < 0)
+        {
+            continue;
+        }
+
+        for (nfds_t n = 2; n < num_fds; n++)
+        {
+            if ((fds[n].revents & (POLLIN | POLLERR | POLLHUP)) &&
+                spectrel_serve_controller(control, polled[n - 2]) != 0)
+            {
+                spectrel_drop_controller(polled[n - 2]);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            spectrel_accept_controller(control);
+        }
+    }
+    return NULL;
+}
+
+void spectrel_free_control(spectrel_control control)
+{
+    if (control)
+    {
+        if (control->has_thread)
+        {
+            pthread_mutex_lock(&control->mutex);
+            atomic_store_explicit(
+                &control->is_running, false, memory_order_release);
+            pthread_cond_broadcast(&control->cond);
+            pthread_mutex_unlock(&control->mutex);
+            uint64_t one = 1;
+            if (write(control->wake_fd, &one, sizeof(one)) < 0)
+            {
+                // The thread will notice at its next poll timeout.
+            }
+            pthread_join(control->thread, NULL);
+            control->has_thread = false;
+        }
+        for (size_t i = 0; i < SPECTREL_MAX_CONTROLLERS; i++)
+        {
+            spectrel_drop_controller(&control->controllers[i]);
+        }
+        if (control->listen_fd >= 0)
+        {
+            close(control->listen_fd);
+            control->listen_fd = -1;
+            unlink(control->socket_path);
+        }
+        if (control->wake_fd >= 0)
+        {
+            close(control->wake_fd);
+            control->wake_fd = -1;
+        }
+        if (control->has_mutex)
+        {
+            pthread_cond_destroy(&control->cond);
+            pthread_mutex_destroy(&control->mutex);
+            control->has_mutex = false;
+        }
+        if (control->socket_path)
+        {
+            free(control->socket_path);
+            control->socket_path = NULL;
+        }
+        free(control);
+    }
+}
+
+static int spectrel_listen(spectrel_control control)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(control->socket_path) >= sizeof(address.sun_path))
+    {
+        spectrel_print_error("Socket path is too long: %s",
+                             control->socket_path);
+        return SPECTREL_FAILURE;
+    }
+    strcpy(address.sun_path, control->socket_path);
+
+    control->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (control->listen_fd < 0)
+    {
+        spectrel_print_error("socket failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+
+    // Replace a socket left behind by a previous run.
+    unlink(control->socket_path);
+    if (bind(control->listen_fd,
+             (struct sockaddr *)&address,
+             sizeof(address)) != 0 ||
+        listen(control->listen_fd, SPECTREL_MAX_CONTROLLERS) != 0)
+    {
+        spectrel_print_error("bind failed: %s: %s",
+                             control->socket_path,
+                             strerror(errno));
+        close(control->listen_fd);
+        control->listen_fd = -1;
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_control spectrel_make_control(const char *socket_path,
+                                       const spectrel_layout_t layout,
+                                       const bool is_real)
+{
+    // Prepare control structure with safe initial values.
+    spectrel_control control = calloc(1, sizeof(*control));
+    if (!control)
+    {
+        spectrel_print_error("malloc failed: control");
+        return NULL;
+    }
+    control->listen_fd = -1;
+    control->wake_fd = -1;
+    for (size_t i = 0; i < SPECTREL_MAX_CONTROLLERS; i++)
+    {
+        control->controllers[i].fd = -1;
+    }
+    atomic_init(&control->is_running, true);
+    control->layout = layout;
+    control->is_real = is_real;
+    control->state = SPECTREL_MAILBOX_EMPTY;
+
+    control->socket_path = strdup(socket_path);
+    if (!control->socket_path)
+    {
+        spectrel_free_control(control);
+        spectrel_print_error("strdup failed: socket_path");
+        return NULL;
+    }
+
+    // Wait on a monotonic clock, so that commands are not held up if the
+    // system time changes.
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (pthread_mutex_init(&control->mutex, NULL) != 0 ||
+        pthread_cond_init(&control->cond, &attr) != 0)
+    {
+        pthread_condattr_destroy(&attr);
+        spectrel_free_control(control);
+        spectrel_print_error("pthread_mutex_init failed: control");
+        return NULL;
+    }
+    pthread_condattr_destroy(&attr);
+    control->has_mutex = true;
+
+    control->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (control->wake_fd < 0)
+    {
+        spectrel_free_control(control);
+        spectrel_print_error("eventfd failed: %s", strerror(errno));
+        return NULL;
+    }
+    if (spectrel_listen(control) != 0)
+    {
+        spectrel_free_control(control);
+        return NULL;
+    }
+    if (pthread_create(
+            &control->thread, NULL, spectrel_serve_control, control) != 0)
+    {
+        spectrel_free_control(control);
+        spectrel_print_error("pthread_create failed: control");
+        return NULL;
+    }
+    control->has_thread = true;
+    spectrel_demote_thread(control->thread);
+    return control;
+}
+
+bool spectrel_take_command(spectrel_control control,
+                           spectrel_command_t *command,
+                           const int timeout)
+{
+    pthread_mutex_lock(&control->mutex);
+    if (control->state != SPECTREL_MAILBOX_PENDING && timeout > 0)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (control->state != SPECTREL_MAILBOX_PENDING &&
+               pthread_cond_timedwait(
+                   &control->cond, &control->mutex, &deadline) == 0)
+        {
+        }
+    }
+
+    bool has_command = control->state == SPECTREL_MAILBOX_PENDING;
+    if (has_command)
+    {
+        *command = control->command;
+        control->state = SPECTREL_MAILBOX_TAKEN;
+    }
+    pthread_mutex_unlock(&control->mutex);
+    return has_command;
+}
+
+void spectrel_complete_command(spectrel_control control, const char *reply)
+{
+    pthread_mutex_lock(&control->mutex);
+    if (control->state == SPECTREL_MAILBOX_TAKEN)
+    {
+        snprintf(control->reply, sizeof(control->reply), "%s", reply);
+        control->state = SPECTREL_MAILBOX_DONE;
+        pthread_cond_broadcast(&control->cond);
+    }
+    pthread_mutex_unlock(&control->mutex);
+}
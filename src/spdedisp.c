@@ -0,0 +1,1073 @@
+#include "spdedisp.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+#include "sprealtime.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A candidate, along with the DM it was found at.
+typedef struct
+{
+    spectrel_candidate_record_t record;
+    size_t dm_index;
+} spectrel_candidate_t;
+
+// A run of samples above the threshold in one dedispersed series, which may
+// span blocks. It is reported at its peak once it ends.
+typedef struct
+{
+    bool is_active;
+    spectrel_candidate_record_t peak;
+} spectrel_run_t;
+
+typedef struct
+{
+    struct spectrel_dedisperser_t *dedisperser;
+    size_t index;
+    pthread_t thread;
+    bool is_started;
+    float *subbands; // The subband series of the group being searched.
+    float *series;   // The dedispersed series, after the tail of the last.
+    double *sums;    // The running sum of the dedispersed series.
+    spectrel_candidate_t *candidates; // Candidates found in this block.
+    size_t num_candidates;
+} spectrel_dedisp_worker_t;
+
+struct spectrel_dedisperser_t
+{
+    FILE *file;
+    char *path;
+    size_t num_channels; // The number of spectral components.
+    size_t *order;       // The components, highest frequency first.
+    double top_frequency;
+    double spectrum_interval;
+    double snr_threshold;
+
+    // The DMs searched, in groups sharing the same subband sums.
+    size_t num_dms;
+    double dm_min;
+    double dm_step;
+    size_t group_size;
+    size_t num_groups;
+    size_t num_subbands;
+    size_t *subband_starts; // The first component of each subband, and the
+                            // number of components.
+    size_t *channel_delays; // Per group, the delay of each component relative
+                            // to the top of its subband, in spectrums.
+    size_t *subband_delays; // Per DM, the delay of the top of each subband.
+    size_t *group_delays;   // Per group, the largest subband delay.
+    size_t *band_delays;    // Per DM, the delay across the band.
+    size_t subband_size;    // The length of each subband series.
+
+    // The normalised power of each component, for the block being searched
+    // and the history its sweeps reach back into.
+    size_t history;  // The number of spectrums kept from earlier blocks.
+    size_t row_size; // The history, plus a block.
+    size_t num_filled;
+    uint64_t next_index; // The index of the first spectrum of the next block.
+    uint64_t first_index;
+    float *data;
+    int64_t *times;
+    double *mean; // The running baseline of each component.
+    double *var;
+    double *sum;
+    double *scale;
+    float *broadband; // The mean of each normalised spectrum in the block.
+    float *carry; // Per DM, the tail of the last dedispersed series.
+    spectrel_run_t *runs;
+    double *power; // The power of the spectrum being staged.
+
+    // Blocks of spectrums, staged by the recording thread.
+    float *staging[2];
+    int64_t *staging_times[2];
+    uint64_t staging_index[2];
+    size_t num_staged;
+    size_t filling;
+    size_t ready;
+    uint64_t num_spectrums;
+
+    // The threads searching each block, and how they hand off work. The first
+    // thread waits for blocks, and merges what every thread found.
+    size_t num_workers;
+    spectrel_dedisp_worker_t *workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t block_cond;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    bool has_sync;
+    bool is_pending;
+    bool is_stopping;
+    bool is_exiting;
+    bool has_failed;
+    uint64_t generation;
+    size_t num_busy;
+
+    // Candidates from every thread, and those accepted this block and last.
+    spectrel_candidate_t *merged;
+    spectrel_candidate_t *accepted;
+    size_t num_accepted;
+    spectrel_candidate_t *recent;
+    size_t num_recent;
+    spectrel_candidate_record_t *records;
+};
+
+// The dispersion delay of a frequency, relative to the top of the band, in
+// spectrums.
+static size_t spectrel_get_delay(const struct spectrel_dedisperser_t *d,
+                                 const double frequency,
+                                 const double dm)
+{
+    double f = frequency * 1e-6;
+    double f_top = d->top_frequency * 1e-6;
+    double delay = SPECTREL_DISPERSION_CONSTANT * dm *
+                   (1 / (f * f) - 1 / (f_top * f_top));
+    return (size_t)llround(delay / d->spectrum_interval);
+}
+
+static double spectrel_get_dm(const struct spectrel_dedisperser_t *d,
+                              const size_t k)
+{
+    return d->dm_min + k * d->dm_step;
+}
+
+static void spectrel_stop_workers(spectrel_dedisperser d)
+{
+    // The first thread finishes any staged block, then releases the others.
+    pthread_mutex_lock(&d->mutex);
+    d->is_stopping = true;
+    pthread_cond_signal(&d->block_cond);
+    if (!d->workers[0].is_started)
+    {
+        d->is_exiting = true;
+        d->generation++;
+        pthread_cond_broadcast(&d->work_cond);
+    }
+    pthread_mutex_unlock(&d->mutex);
+    for (size_t i = 0; i < d->num_workers; i++)
+    {
+        if (d->workers[i].is_started)
+        {
+            pthread_join(d->workers[i].thread, NULL);
+            d->workers[i].is_started = false;
+        }
+    }
+}
+
+void spectrel_free_dedisperser(spectrel_dedisperser d)
+{
+    if (d)
+    {
+        if (d->workers)
+        {
+            if (d->has_sync)
+            {
+                spectrel_stop_workers(d);
+            }
+            for (size_t i = 0; i < d->num_workers; i++)
+            {
+                free(d->workers[i].subbands);
+                free(d->workers[i].series);
+                free(d->workers[i].sums);
+                free(d->workers[i].candidates);
+            }
+            free(d->workers);
+            d->workers = NULL;
+        }
+        if (d->has_sync)
+        {
+            pthread_cond_destroy(&d->done_cond);
+            pthread_cond_destroy(&d->work_cond);
+            pthread_cond_destroy(&d->block_cond);
+            pthread_mutex_destroy(&d->mutex);
+            d->has_sync = false;
+        }
+        if (d->file)
+        {
+            fclose(d->file);
+            d->file = NULL;
+        }
+        free(d->path);
+        free(d->order);
+        free(d->subband_starts);
+        free(d->channel_delays);
+        free(d->subband_delays);
+        free(d->group_delays);
+        free(d->band_delays);
+        free(d->data);
+        free(d->times);
+        free(d->mean);
+        free(d->var);
+        free(d->sum);
+        free(d->scale);
+        free(d->broadband);
+        free(d->carry);
+        free(d->runs);
+        free(d->power);
+        for (size_t i = 0; i < 2; i++)
+        {
+            free(d->staging[i]);
+            free(d->staging_times[i]);
+        }
+        free(d->merged);
+        free(d->accepted);
+        free(d->recent);
+        free(d->records);
+        free(d);
+    }
+}
+
+// A spectral component, for sorting by frequency.
+typedef struct
+{
+    double frequency;
+    size_t index;
+} spectrel_channel_t;
+
+// Sort components by frequency, highest first.
+static int spectrel_compare_channels(const void *a, const void *b)
+{
+    double fa = ((const spectrel_channel_t *)a)->frequency;
+    double fb = ((const spectrel_channel_t *)b)->frequency;
+    return (fa < fb) - (fa > fb);
+}
+
+// Choose the DMs, subbands and groups, and tabulate every delay.
+static int spectrel_plan_dedisperser(spectrel_dedisperser d,
+                                     const spectrel_dedisp_params_t *params)
+{
+    size_t C = d->num_channels;
+    double *frequencies = malloc(sizeof(*frequencies) * C);
+    spectrel_channel_t *channels = malloc(sizeof(*channels) * C);
+    if (!frequencies || !channels)
+    {
+        free(frequencies);
+        free(channels);
+        spectrel_print_error("malloc failed: frequencies");
+        return SPECTREL_FAILURE;
+    }
+    spectrel_compute_frequencies(frequencies,
+                                 params->window_size,
+                                 params->sample_rate,
+                                 params->is_real);
+    for (size_t c = 0; c < C; c++)
+    {
+        channels[c].frequency = frequencies[c] + params->frequency;
+        channels[c].index = c;
+    }
+    qsort(channels, C, sizeof(*channels), spectrel_compare_channels);
+    for (size_t c = 0; c < C; c++)
+    {
+        d->order[c] = channels[c].index;
+        frequencies[c] = channels[c].frequency;
+    }
+    free(channels);
+    d->top_frequency = frequencies[0];
+    double bottom_frequency = frequencies[C - 1];
+    if (bottom_frequency <= 0)
+    {
+        free(frequencies);
+        spectrel_print_error("Dedispersion needs positive frequencies");
+        return SPECTREL_FAILURE;
+    }
+
+    // Space the DMs so that the sweeps of neighbouring DMs differ by a
+    // spectrum across the band, unless that needs too many.
+    double f_top = d->top_frequency * 1e-6;
+    double f_bottom = bottom_frequency * 1e-6;
+    double sweep = SPECTREL_DISPERSION_CONSTANT *
+                   (1 / (f_bottom * f_bottom) - 1 / (f_top * f_top));
+    double dm_range = params->dm_max - params->dm_min;
+    d->dm_min = params->dm_min;
+    d->dm_step = sweep > 0 ? d->spectrum_interval / sweep : dm_range;
+    d->num_dms = d->dm_step > 0 ? (size_t)(dm_range / d->dm_step) + 1 : 1;
+    if (d->num_dms > SPECTREL_MAX_DM_TRIALS)
+    {
+        d->num_dms = SPECTREL_MAX_DM_TRIALS;
+        d->dm_step = dm_range / (SPECTREL_MAX_DM_TRIALS - 1);
+    }
+
+    // With sqrt(C) subbands of sqrt(C) components, and as many DMs in each
+    // group, both stages cost the same, and the smearing from summing each
+    // subband at the DM of its group is within half a spectrum.
+    d->num_subbands = (size_t)llround(sqrt((double)C));
+    d->group_size = C / d->num_subbands;
+    d->num_groups = (d->num_dms + d->group_size - 1) / d->group_size;
+
+    size_t S = d->num_subbands;
+    d->subband_starts = malloc(sizeof(*d->subband_starts) * (S + 1));
+    d->channel_delays =
+        malloc(sizeof(*d->channel_delays) * d->num_groups * C);
+    d->subband_delays = malloc(sizeof(*d->subband_delays) * d->num_dms * S);
+    d->group_delays = calloc(d->num_groups, sizeof(*d->group_delays));
+    d->band_delays = malloc(sizeof(*d->band_delays) * d->num_dms);
+    if (!d->subband_starts || !d->channel_delays || !d->subband_delays ||
+        !d->group_delays || !d->band_delays)
+    {
+        free(frequencies);
+        spectrel_print_error("malloc failed: delays");
+        return SPECTREL_FAILURE;
+    }
+    for (size_t s = 0; s <= S; s++)
+    {
+        d->subband_starts[s] = s * C / S;
+    }
+
+    d->history = 0;
+    d->subband_size = 0;
+    for (size_t g = 0; g < d->num_groups; g++)
+    {
+        size_t first = g * d->group_size;
+        size_t last = first + d->group_size < d->num_dms
+                          ? first + d->group_size
+                          : d->num_dms;
+        double group_dm = spectrel_get_dm(d, (first + last - 1) / 2);
+        size_t max_channel_delay = 0;
+        for (size_t s = 0; s < S; s++)
+        {
+            double f_subband = frequencies[d->subband_starts[s]];
+            size_t top_delay = spectrel_get_delay(d, f_subband, group_dm);
+            for (size_t c = d->subband_starts[s];
+                 c < d->subband_starts[s + 1];
+                 c++)
+            {
+                size_t delay =
+                    spectrel_get_delay(d, frequencies[c], group_dm);
+                delay = delay > top_delay ? delay - top_delay : 0;
+                d->channel_delays[g * C + c] = delay;
+                if (delay > max_channel_delay)
+                    max_channel_delay = delay;
+            }
+            for (size_t k = first; k < last; k++)
+            {
+                size_t delay =
+                    spectrel_get_delay(d, f_subband, spectrel_get_dm(d, k));
+                d->subband_delays[k * S + s] = delay;
+                if (delay > d->group_delays[g])
+                    d->group_delays[g] = delay;
+            }
+        }
+        for (size_t k = first; k < last; k++)
+        {
+            d->band_delays[k] = spectrel_get_delay(
+                d, bottom_frequency, spectrel_get_dm(d, k));
+        }
+        if (d->group_delays[g] + max_channel_delay > d->history)
+            d->history = d->group_delays[g] + max_channel_delay;
+        if (d->group_delays[g] > d->subband_size)
+            d->subband_size = d->group_delays[g];
+    }
+    d->subband_size += SPECTREL_DEDISP_BLOCK_SIZE;
+    d->row_size = d->history + SPECTREL_DEDISP_BLOCK_SIZE;
+    free(frequencies);
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_open_candidates(spectrel_dedisperser d, const char *path)
+{
+    // Append to the path of the spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".cand") + 1;
+    d->path = malloc(num_chars_path);
+    if (!d->path)
+    {
+        spectrel_print_error("malloc failed: path");
+        return SPECTREL_FAILURE;
+    }
+    snprintf(d->path, num_chars_path, "%s.cand", path);
+
+    d->file = fopen(d->path, "wb");
+    if (!d->file)
+    {
+        spectrel_print_error("fopen failed: %s", d->path);
+        return SPECTREL_FAILURE;
+    }
+
+    spectrel_candidates_header_t header = {0};
+    memcpy(header.magic,
+           SPECTREL_CANDIDATES_MAGIC,
+           sizeof(SPECTREL_CANDIDATES_MAGIC));
+    header.dm_min = d->dm_min;
+    header.dm_step = d->dm_step;
+    header.num_dms = d->num_dms;
+    header.frequency = d->top_frequency;
+    header.spectrum_interval = d->spectrum_interval;
+    header.snr_threshold = d->snr_threshold;
+    if (fwrite(&header, sizeof(header), 1, d->file) != 1 ||
+        fflush(d->file) != 0)
+    {
+        spectrel_print_error("fwrite failed: %s", d->path);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_allocate_dedisperser(spectrel_dedisperser d)
+{
+    size_t B = SPECTREL_DEDISP_BLOCK_SIZE;
+    size_t W = SPECTREL_DEDISP_MAX_WIDTH;
+    size_t C = d->num_channels;
+    size_t num_candidates = d->num_workers * SPECTREL_DEDISP_MAX_CANDIDATES;
+    d->data = calloc(C * d->row_size, sizeof(*d->data));
+    d->times = calloc(d->row_size, sizeof(*d->times));
+    d->mean = calloc(C, sizeof(*d->mean));
+    d->var = calloc(C, sizeof(*d->var));
+    d->sum = malloc(sizeof(*d->sum) * C);
+    d->scale = malloc(sizeof(*d->scale) * C);
+    d->broadband = malloc(sizeof(*d->broadband) * B);
+    d->carry = calloc(d->num_dms * (W - 1), sizeof(*d->carry));
+    d->runs = calloc(d->num_dms, sizeof(*d->runs));
+    d->power = malloc(sizeof(*d->power) * C);
+    d->merged = malloc(sizeof(*d->merged) * num_candidates);
+    d->accepted = malloc(sizeof(*d->accepted) * num_candidates);
+    d->recent = malloc(sizeof(*d->recent) * num_candidates);
+    d->records = malloc(sizeof(*d->records) * num_candidates);
+    if (!d->data || !d->times || !d->mean || !d->var || !d->sum || !d->scale ||
+        !d->broadband ||
+        !d->carry || !d->runs || !d->power || !d->merged || !d->accepted ||
+        !d->recent || !d->records)
+    {
+        spectrel_print_error("malloc failed: dedisperser");
+        return SPECTREL_FAILURE;
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        d->staging[i] = malloc(sizeof(*d->staging[i]) * B * C);
+        d->staging_times[i] = malloc(sizeof(*d->staging_times[i]) * B);
+        if (!d->staging[i] || !d->staging_times[i])
+        {
+            spectrel_print_error("malloc failed: dedisperser staging");
+            return SPECTREL_FAILURE;
+        }
+    }
+
+    d->workers = calloc(d->num_workers, sizeof(*d->workers));
+    if (!d->workers)
+    {
+        spectrel_print_error("malloc failed: dedisperser workers");
+        return SPECTREL_FAILURE;
+    }
+    for (size_t i = 0; i < d->num_workers; i++)
+    {
+        spectrel_dedisp_worker_t *worker = &d->workers[i];
+        worker->dedisperser = d;
+        worker->index = i;
+        worker->subbands = malloc(sizeof(*worker->subbands) *
+                                  d->num_subbands * d->subband_size);
+        worker->series = malloc(sizeof(*worker->series) * (W - 1 + B));
+        worker->sums = malloc(sizeof(*worker->sums) * (W + B));
+        worker->candidates = malloc(sizeof(*worker->candidates) *
+                                    SPECTREL_DEDISP_MAX_CANDIDATES);
+        if (!worker->subbands || !worker->series || !worker->sums ||
+            !worker->candidates)
+        {
+            spectrel_print_error("malloc failed: dedisperser worker");
+            return SPECTREL_FAILURE;
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Copy a staged block into the history, transposed so that each component is
+// contiguous in time, and normalised against the running baseline.
+static void spectrel_load_block(spectrel_dedisperser d,
+                                const float *staged,
+                                const int64_t *times,
+                                const uint64_t first_index)
+{
+    size_t B = SPECTREL_DEDISP_BLOCK_SIZE;
+    size_t W = SPECTREL_DEDISP_MAX_WIDTH;
+    size_t C = d->num_channels;
+    size_t H = d->history;
+    size_t R = d->row_size;
+
+    // After a dropped block, the sweeps would span the gap, so start again.
+    if (first_index != d->next_index)
+    {
+        d->num_filled = 0;
+        memset(d->carry, 0, sizeof(*d->carry) * d->num_dms * (W - 1));
+        memset(d->runs, 0, sizeof(*d->runs) * d->num_dms);
+        d->num_recent = 0;
+    }
+    d->first_index = first_index;
+    d->next_index = first_index + B;
+
+    for (size_t c = 0; c < C; c++)
+    {
+        memmove(d->data + c * R, d->data + c * R + B, sizeof(*d->data) * H);
+    }
+    memmove(d->times, d->times + B, sizeof(*d->times) * H);
+    memcpy(d->times + H, times, sizeof(*d->times) * B);
+
+    // Track the baseline of each component, block by block.
+    for (size_t c = 0; c < C; c++)
+    {
+        d->sum[c] = 0;
+        d->scale[c] = 0;
+    }
+    for (size_t t = 0; t < B; t++)
+    {
+        const float *spectrum = staged + t * C;
+        for (size_t c = 0; c < C; c++)
+        {
+            d->sum[c] += spectrum[c];
+            d->scale[c] += (double)spectrum[c] * spectrum[c];
+        }
+    }
+    double weight = d->num_filled ? SPECTREL_DEDISP_BASELINE_WEIGHT : 1;
+    for (size_t c = 0; c < C; c++)
+    {
+        double mean = d->sum[c] / B;
+        double var = d->scale[c] / B - mean * mean;
+        d->mean[c] += weight * (mean - d->mean[c]);
+        d->var[c] += weight * (var - d->var[c]);
+        d->scale[c] = d->var[c] > 0 ? 1 / sqrt(d->var[c]) : 0;
+    }
+
+    // Subtract the mean of each normalised spectrum, so that broadband
+    // interference, which is undispersed, cancels out of every DM.
+    for (size_t t = 0; t < B; t++)
+    {
+        const float *spectrum = staged + t * C;
+        double sum = 0;
+        for (size_t c = 0; c < C; c++)
+        {
+            sum += (spectrum[c] - d->mean[c]) * d->scale[c];
+        }
+        d->broadband[t] = (float)(sum / C);
+    }
+
+    // Transpose a cache line of each row at a time.
+    size_t tile = SPECTREL_CACHE_LINE_SIZE / sizeof(*d->data);
+    for (size_t t0 = 0; t0 < B; t0 += tile)
+    {
+        for (size_t c = 0; c < C; c++)
+        {
+            float *row = d->data + c * R + H;
+            float mean = (float)d->mean[c];
+            float scale = (float)d->scale[c];
+            for (size_t t = t0; t < t0 + tile; t++)
+            {
+                row[t] =
+                    (staged[t * C + c] - mean) * scale - d->broadband[t];
+            }
+        }
+    }
+    d->num_filled = d->num_filled + B < R ? d->num_filled + B : R;
+}
+
+static void spectrel_add_candidate(spectrel_dedisp_worker_t *worker,
+                                   const spectrel_run_t *run,
+                                   const size_t dm_index)
+{
+    if (worker->num_candidates < SPECTREL_DEDISP_MAX_CANDIDATES)
+    {
+        spectrel_candidate_t *candidate =
+            &worker->candidates[worker->num_candidates++];
+        candidate->record = run->peak;
+        candidate->dm_index = dm_index;
+    }
+}
+
+// Search a dedispersed series with boxcars of each width, tracking runs above
+// the threshold.
+static void spectrel_search_series(spectrel_dedisp_worker_t *worker,
+                                   const size_t dm_index)
+{
+    struct spectrel_dedisperser_t *d = worker->dedisperser;
+    size_t B = SPECTREL_DEDISP_BLOCK_SIZE;
+    size_t W = SPECTREL_DEDISP_MAX_WIDTH;
+    float *carry = d->carry + dm_index * (W - 1);
+    float *x = worker->series;
+    double *sums = worker->sums;
+
+    // Boxcars reach back into the tail of the last block.
+    memcpy(x, carry, sizeof(*x) * (W - 1));
+    sums[0] = 0;
+    for (size_t i = 0; i < W - 1 + B; i++)
+    {
+        sums[i + 1] = sums[i] + x[i];
+    }
+    memcpy(carry, x + B, sizeof(*x) * (W - 1));
+
+    // The series sums normalised components, so its variance is their number.
+    double norm = 1 / sqrt((double)d->num_channels);
+    spectrel_run_t *run = &d->runs[dm_index];
+    size_t first_valid = d->row_size - d->num_filled;
+    for (size_t t = 0; t < B; t++)
+    {
+        size_t end = W + t;
+        double snr = 0;
+        size_t width = 1;
+        for (size_t w = 1; w <= W; w *= 2)
+        {
+            double boxcar = (sums[end] - sums[end - w]) * norm / sqrt(w);
+            if (boxcar > snr)
+            {
+                snr = boxcar;
+                width = w;
+            }
+        }
+        if (t >= first_valid && snr >= d->snr_threshold)
+        {
+            if (!run->is_active || snr > run->peak.snr)
+            {
+                int64_t index =
+                    (int64_t)(d->first_index + t) - (int64_t)d->history;
+                index -= (int64_t)width - 1;
+                int64_t time = d->times[t];
+                run->peak.index = index > 0 ? (uint64_t)index : 0;
+                run->peak.time =
+                    time ? time - llround((width - 1) * d->spectrum_interval *
+                                          1e9)
+                         : 0;
+                run->peak.dm = (float)spectrel_get_dm(d, dm_index);
+                run->peak.snr = (float)snr;
+                run->peak.width = (uint32_t)width;
+                run->peak.num_merged = 1;
+            }
+            run->is_active = true;
+        }
+        else if (run->is_active)
+        {
+            spectrel_add_candidate(worker, run, dm_index);
+            run->is_active = false;
+        }
+    }
+}
+
+// Dedisperse every DM in a group: sum the components of each subband at the
+// DM of the group, then sum the subbands at each DM in it. Both stages work
+// through time a tile at a time, so that the partial sums stay in cache while
+// the rows they sum stream through.
+static void spectrel_dedisperse_group(spectrel_dedisp_worker_t *worker,
+                                      const size_t g)
+{
+    struct spectrel_dedisperser_t *d = worker->dedisperser;
+    size_t B = SPECTREL_DEDISP_BLOCK_SIZE;
+    size_t W = SPECTREL_DEDISP_MAX_WIDTH;
+    size_t T = SPECTREL_DEDISP_TILE_SIZE;
+    size_t C = d->num_channels;
+    size_t S = d->num_subbands;
+    size_t R = d->row_size;
+    size_t length = B + d->group_delays[g];
+    const size_t *channel_delays = d->channel_delays + g * C;
+
+    for (size_t t0 = 0; t0 < length; t0 += T)
+    {
+        size_t n = t0 + T < length ? T : length - t0;
+        for (size_t s = 0; s < S; s++)
+        {
+            float *restrict out = worker->subbands + s * d->subband_size + t0;
+            memset(out, 0, sizeof(*out) * n);
+            for (size_t c = d->subband_starts[s]; c < d->subband_starts[s + 1];
+                 c++)
+            {
+                const float *restrict in =
+                    d->data + c * R + t0 + channel_delays[c];
+                for (size_t t = 0; t < n; t++)
+                {
+                    out[t] += in[t];
+                }
+            }
+        }
+    }
+
+    size_t first = g * d->group_size;
+    size_t last = first + d->group_size < d->num_dms ? first + d->group_size
+                                                      : d->num_dms;
+    for (size_t k = first; k < last; k++)
+    {
+        const size_t *subband_delays = d->subband_delays + k * S;
+        float *restrict series = worker->series + W - 1;
+        for (size_t t0 = 0; t0 < B; t0 += T)
+        {
+            float *restrict out = series + t0;
+            memset(out, 0, sizeof(*out) * T);
+            for (size_t s = 0; s < S; s++)
+            {
+                const float *restrict in = worker->subbands +
+                                           s * d->subband_size + t0 +
+                                           subband_delays[s];
+                for (size_t t = 0; t < T; t++)
+                {
+                    out[t] += in[t];
+                }
+            }
+        }
+        spectrel_search_series(worker, k);
+    }
+}
+
+static void spectrel_dedisperse_groups(spectrel_dedisp_worker_t *worker)
+{
+    struct spectrel_dedisperser_t *d = worker->dedisperser;
+    for (size_t g = worker->index; g < d->num_groups; g += d->num_workers)
+    {
+        spectrel_dedisperse_group(worker, g);
+    }
+}
+
+static int spectrel_compare_snr(const void *a, const void *b)
+{
+    float snr_a = ((const spectrel_candidate_t *)a)->record.snr;
+    float snr_b = ((const spectrel_candidate_t *)b)->record.snr;
+    return (snr_a < snr_b) - (snr_a > snr_b);
+}
+
+static int spectrel_compare_index(const void *a, const void *b)
+{
+    uint64_t index_a = ((const spectrel_candidate_t *)a)->record.index;
+    uint64_t index_b = ((const spectrel_candidate_t *)b)->record.index;
+    return (index_a > index_b) - (index_a < index_b);
+}
+
+// Whether two detections are of the same pulse. Away from its DM, a pulse is
+// smeared across up to the difference in the sweeps of the two DMs.
+static bool spectrel_is_same_pulse(const struct spectrel_dedisperser_t *d,
+                                   const spectrel_candidate_t *a,
+                                   const spectrel_candidate_t *b)
+{
+    size_t delay_a = d->band_delays[a->dm_index];
+    size_t delay_b = d->band_delays[b->dm_index];
+    uint64_t span = a->record.width > b->record.width ? a->record.width
+                                                      : b->record.width;
+    span += delay_a > delay_b ? delay_a - delay_b : delay_b - delay_a;
+    uint64_t distance = a->record.index > b->record.index
+                            ? a->record.index - b->record.index
+                            : b->record.index - a->record.index;
+    return distance <= span;
+}
+
+// Merge the detections of every thread, strongest first, then write the
+// candidates in the order they arrived.
+static int spectrel_merge_candidates(spectrel_dedisperser d)
+{
+    size_t num_merged = 0;
+    for (size_t i = 0; i < d->num_workers; i++)
+    {
+        spectrel_dedisp_worker_t *worker = &d->workers[i];
+        memcpy(d->merged + num_merged,
+               worker->candidates,
+               sizeof(*d->merged) * worker->num_candidates);
+        num_merged += worker->num_candidates;
+        worker->num_candidates = 0;
+    }
+    qsort(d->merged, num_merged, sizeof(*d->merged), spectrel_compare_snr);
+
+    d->num_accepted = 0;
+    for (size_t i = 0; i < num_merged; i++)
+    {
+        const spectrel_candidate_t *candidate = &d->merged[i];
+        bool is_duplicate = false;
+        for (size_t j = 0; j < d->num_accepted && !is_duplicate; j++)
+        {
+            if (spectrel_is_same_pulse(d, candidate, &d->accepted[j]))
+            {
+                d->accepted[j].record.num_merged++;
+                is_duplicate = true;
+            }
+        }
+        // Those already written only hide weaker detections.
+        for (size_t j = 0; j < d->num_recent && !is_duplicate; j++)
+        {
+            is_duplicate =
+                spectrel_is_same_pulse(d, candidate, &d->recent[j]) &&
+                d->recent[j].record.snr >= candidate->record.snr;
+        }
+        if (!is_duplicate)
+        {
+            d->accepted[d->num_accepted++] = *candidate;
+        }
+    }
+    qsort(d->accepted,
+          d->num_accepted,
+          sizeof(*d->accepted),
+          spectrel_compare_index);
+
+    // Pulses which end early in the next block are compared against these.
+    spectrel_candidate_t *recent = d->recent;
+    d->recent = d->accepted;
+    d->num_recent = d->num_accepted;
+    d->accepted = recent;
+
+    if (d->num_recent == 0)
+    {
+        return SPECTREL_SUCCESS;
+    }
+    for (size_t i = 0; i < d->num_recent; i++)
+    {
+        d->records[i] = d->recent[i].record;
+    }
+    if (fwrite(d->records, sizeof(*d->records), d->num_recent, d->file) !=
+            d->num_recent ||
+        fflush(d->file) != 0)
+    {
+        spectrel_print_error("fwrite failed: %s", d->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_CANDIDATES, d->num_recent);
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         d->num_recent * sizeof(*d->records));
+    return SPECTREL_SUCCESS;
+}
+
+// Wait for a staged block and load it. Returns false once stopping.
+static bool spectrel_take_block(spectrel_dedisperser d)
+{
+    pthread_mutex_lock(&d->mutex);
+    while (!d->is_pending && !d->is_stopping)
+    {
+        pthread_cond_wait(&d->block_cond, &d->mutex);
+    }
+    bool is_pending = d->is_pending;
+    size_t ready = d->ready;
+    pthread_mutex_unlock(&d->mutex);
+    if (!is_pending)
+    {
+        return false;
+    }
+
+    spectrel_load_block(d,
+                        d->staging[ready],
+                        d->staging_times[ready],
+                        d->staging_index[ready]);
+
+    // The staged block has been copied, so the next may be staged.
+    pthread_mutex_lock(&d->mutex);
+    d->is_pending = false;
+    pthread_mutex_unlock(&d->mutex);
+    return true;
+}
+
+static void spectrel_lead_search(spectrel_dedisp_worker_t *worker)
+{
+    struct spectrel_dedisperser_t *d = worker->dedisperser;
+    while (spectrel_take_block(d))
+    {
+        uint64_t start = spectrel_get_time_ns();
+
+        // Hand the groups out, search this thread's share, then wait for
+        // the rest.
+        pthread_mutex_lock(&d->mutex);
+        d->num_busy = d->num_workers - 1;
+        d->generation++;
+        pthread_cond_broadcast(&d->work_cond);
+        pthread_mutex_unlock(&d->mutex);
+
+        spectrel_dedisperse_groups(worker);
+
+        pthread_mutex_lock(&d->mutex);
+        while (d->num_busy > 0)
+        {
+            pthread_cond_wait(&d->done_cond, &d->mutex);
+        }
+        pthread_mutex_unlock(&d->mutex);
+
+        if (spectrel_merge_candidates(d) != 0)
+        {
+            pthread_mutex_lock(&d->mutex);
+            d->has_failed = true;
+            pthread_mutex_unlock(&d->mutex);
+        }
+        spectrel_observe(SPECTREL_HISTOGRAM_DEDISP,
+                         spectrel_get_time_ns() - start);
+    }
+
+    // Release the other threads.
+    pthread_mutex_lock(&d->mutex);
+    d->is_exiting = true;
+    d->generation++;
+    pthread_cond_broadcast(&d->work_cond);
+    pthread_mutex_unlock(&d->mutex);
+}
+
+static void spectrel_follow_search(spectrel_dedisp_worker_t *worker)
+{
+    struct spectrel_dedisperser_t *d = worker->dedisperser;
+    uint64_t generation = 0;
+    while (true)
+    {
+        pthread_mutex_lock(&d->mutex);
+        while (d->generation == generation)
+        {
+            pthread_cond_wait(&d->work_cond, &d->mutex);
+        }
+        generation = d->generation;
+        bool is_exiting = d->is_exiting;
+        pthread_mutex_unlock(&d->mutex);
+        if (is_exiting)
+        {
+            return;
+        }
+
+        spectrel_dedisperse_groups(worker);
+
+        pthread_mutex_lock(&d->mutex);
+        if (--d->num_busy == 0)
+        {
+            pthread_cond_signal(&d->done_cond);
+        }
+        pthread_mutex_unlock(&d->mutex);
+    }
+}
+
+static void *spectrel_run_dedisp_worker(void *arg)
+{
+    spectrel_dedisp_worker_t *worker = arg;
+    if (worker->index == 0)
+    {
+        spectrel_lead_search(worker);
+    }
+    else
+    {
+        spectrel_follow_search(worker);
+    }
+    return NULL;
+}
+
+spectrel_dedisperser
+spectrel_make_dedisperser(const char *path,
+                          const spectrel_dedisp_params_t *params)
+{
+    if (params->dm_min < 0 || params->dm_max < params->dm_min)
+    {
+        spectrel_print_error("Invalid DM range: %.2f to %.2f",
+                             params->dm_min,
+                             params->dm_max);
+        return NULL;
+    }
+    if (params->num_threads < 1 ||
+        params->num_threads > SPECTREL_MAX_DEDISP_THREADS)
+    {
+        spectrel_print_error("Dedispersion threads must be from 1 to %d",
+                             SPECTREL_MAX_DEDISP_THREADS);
+        return NULL;
+    }
+
+    // Prepare dedisperser structure with safe initial values.
+    spectrel_dedisperser d = calloc(1, sizeof(*d));
+    if (!d)
+    {
+        spectrel_print_error("malloc failed: dedisperser");
+        return NULL;
+    }
+    d->num_channels =
+        spectrel_get_num_bins(params->window_size, params->is_real);
+    d->spectrum_interval = params->window_hop / params->sample_rate;
+    d->snr_threshold = params->snr_threshold;
+    d->order = malloc(sizeof(*d->order) * d->num_channels);
+    if (!d->order)
+    {
+        spectrel_free_dedisperser(d);
+        spectrel_print_error("malloc failed: dedisperser");
+        return NULL;
+    }
+    if (spectrel_plan_dedisperser(d, params) != 0)
+    {
+        spectrel_free_dedisperser(d);
+        return NULL;
+    }
+    d->num_workers = params->num_threads < d->num_groups ? params->num_threads
+                                                         : d->num_groups;
+    if (spectrel_allocate_dedisperser(d) != 0 ||
+        spectrel_open_candidates(d, path) != 0)
+    {
+        spectrel_free_dedisperser(d);
+        return NULL;
+    }
+
+    pthread_mutex_init(&d->mutex, NULL);
+    pthread_cond_init(&d->block_cond, NULL);
+    pthread_cond_init(&d->work_cond, NULL);
+    pthread_cond_init(&d->done_cond, NULL);
+    d->has_sync = true;
+
+    // Start the first thread last, so that the others are all waiting.
+    for (size_t i = d->num_workers; i-- > 0;)
+    {
+        spectrel_dedisp_worker_t *worker = &d->workers[i];
+        if (pthread_create(
+                &worker->thread, NULL, spectrel_run_dedisp_worker, worker) !=
+            0)
+        {
+            spectrel_free_dedisperser(d);
+            spectrel_print_error("pthread_create failed: dedisperser");
+            return NULL;
+        }
+        worker->is_started = true;
+        spectrel_demote_thread(worker->thread);
+    }
+    return d;
+}
+
+int spectrel_dedisperse(spectrel_dedisperser d,
+                        const spectrel_spectrogram_t *s)
+{
+    size_t C = d->num_channels;
+    if (s->num_samples_per_spectrum != C)
+    {
+        spectrel_print_error("Spectrogram does not match the dedisperser");
+        return SPECTREL_FAILURE;
+    }
+
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        // Stage the power of each component, highest frequency first.
+        spectrel_compute_spectrum_power(s, n, d->power);
+        float *spectrum = d->staging[d->filling] + d->num_staged * C;
+        for (size_t c = 0; c < C; c++)
+        {
+            spectrum[c] = (float)d->power[d->order[c]];
+        }
+        d->staging_times[d->filling][d->num_staged] =
+            s->time ? spectrel_get_spectrum_time(s, n) : 0;
+        if (d->num_staged == 0)
+        {
+            d->staging_index[d->filling] = d->num_spectrums;
+        }
+        d->num_spectrums++;
+        if (++d->num_staged < SPECTREL_DEDISP_BLOCK_SIZE)
+        {
+            continue;
+        }
+
+        // Hand the block over, unless the last is still waiting, in which
+        // case this one is dropped.
+        d->num_staged = 0;
+        pthread_mutex_lock(&d->mutex);
+        bool is_dropped = d->is_pending;
+        if (!is_dropped)
+        {
+            d->ready = d->filling;
+            d->filling = 1 - d->filling;
+            d->is_pending = true;
+            pthread_cond_signal(&d->block_cond);
+        }
+        pthread_mutex_unlock(&d->mutex);
+        if (is_dropped)
+        {
+            spectrel_add_counter(SPECTREL_COUNTER_DEDISP_DROPS, 1);
+        }
+    }
+
+    pthread_mutex_lock(&d->mutex);
+    bool has_failed = d->has_failed;
+    pthread_mutex_unlock(&d->mutex);
+    return has_failed ? SPECTREL_FAILURE : SPECTREL_SUCCESS;
+}
+
+void spectrel_describe_dedisperser(spectrel_dedisperser d)
+{
+    printf("Dedispersion: %zu DMs from %.3f to %.3f [pc cm^-3], %zu "
+           "subbands, %zu threads, %.3f [s] sweep\n",
+           d->num_dms,
+           d->dm_min,
+           spectrel_get_dm(d, d->num_dms - 1),
+           d->num_subbands,
+           d->num_workers,
+           d->band_delays[d->num_dms - 1] * d->spectrum_interval);
+}
@@ -0,0 +1,278 @@
+#include "spengine.h"
+#include "sparena.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+struct spectrel_engine_t
+{
+    spectrel_receiver receiver;
+    spectrel_receiver_params_t params;
+    spectrel_arena arena;
+    spectrel_signal_t *buffer;
+    size_t frame_mark; // Where each spectrogram is allocated from the arena.
+    spectrel_plan plan;
+    spectrel_signal_t *window;
+    size_t window_hop;
+    spectrel_frame_callback_t callback;
+    void *user_data;
+    uint64_t num_spectrums; // The number of spectrums handed over so far.
+    atomic_bool is_stopping;
+};
+
+struct spectrel_frame_t
+{
+    const spectrel_spectrogram_t *spectrogram;
+    uint64_t index; // The index of the first spectrum.
+    double frequency;
+    double sample_rate;
+    size_t window_hop;
+};
+
+int spectrel_get_engine_api_version(void)
+{
+    return SPECTREL_ENGINE_API_VERSION;
+}
+
+void spectrel_free_engine(spectrel_engine engine)
+{
+    if (engine)
+    {
+        if (engine->window)
+        {
+            spectrel_free_signal(engine->window);
+            engine->window = NULL;
+        }
+        if (engine->plan)
+        {
+            spectrel_free_plan(engine->plan);
+            engine->plan = NULL;
+        }
+        if (engine->buffer)
+        {
+            spectrel_free_signal(engine->buffer);
+            engine->buffer = NULL;
+        }
+        if (engine->arena)
+        {
+            spectrel_free_arena(engine->arena);
+            engine->arena = NULL;
+        }
+        if (engine->receiver)
+        {
+            spectrel_free_receiver(engine->receiver);
+            engine->receiver = NULL;
+        }
+        free(engine);
+    }
+}
+
+spectrel_engine spectrel_make_engine(const spectrel_engine_params_t *params)
+{
+    if (!params->driver || params->window_size < 1 ||
+        params->window_hop < 1 || params->window_size > params->buffer_size)
+    {
+        spectrel_print_error("Engine needs a driver, and a window which fits "
+                             "in a buffer");
+        return NULL;
+    }
+
+    // Prepare engine structure with safe initial values.
+    spectrel_engine engine = calloc(1, sizeof(*engine));
+    if (!engine)
+    {
+        spectrel_print_error("malloc failed: engine");
+        return NULL;
+    }
+    atomic_init(&engine->is_stopping, false);
+    engine->params = params->receiver;
+    engine->window_hop = params->window_hop;
+
+    engine->receiver =
+        spectrel_make_receiver(params->driver, &engine->params);
+    if (!engine->receiver)
+    {
+        spectrel_free_engine(engine);
+        return NULL;
+    }
+
+    // Size the arena to hold the stream buffer, whatever its format, and the
+    // spectrogram of each buffer along with the scratch space to copy it.
+    size_t stfft_size = spectrel_get_stfft_size(params->buffer_size,
+                                                params->window_size,
+                                                params->window_hop,
+                                                params->layout,
+                                                params->is_real);
+    engine->arena = spectrel_make_arena(
+        spectrel_get_arena_size(sizeof(fftw_complex) * params->buffer_size) +
+        2 * stfft_size);
+    if (!engine->arena)
+    {
+        spectrel_free_engine(engine);
+        return NULL;
+    }
+    engine->buffer = spectrel_make_stream_buffer(
+        engine->receiver, params->buffer_size, engine->arena);
+    if (!engine->buffer)
+    {
+        spectrel_free_engine(engine);
+        return NULL;
+    }
+    engine->frame_mark = spectrel_get_arena_used(engine->arena);
+
+    engine->plan = spectrel_make_plan(
+        params->window_size, params->layout, params->is_real);
+    engine->window = spectrel_make_window(params->window_size);
+    if (!engine->plan || !engine->window)
+    {
+        spectrel_free_engine(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void spectrel_set_frame_callback(spectrel_engine engine,
+                                 spectrel_frame_callback_t callback,
+                                 void *user_data)
+{
+    engine->callback = callback;
+    engine->user_data = user_data;
+}
+
+void spectrel_stop_engine(spectrel_engine engine)
+{
+    atomic_store_explicit(&engine->is_stopping, true, memory_order_release);
+}
+
+int spectrel_run_engine(spectrel_engine engine, const size_t num_buffers)
+{
+    if (spectrel_activate_stream(engine->receiver) != 0)
+        return SPECTREL_FAILURE;
+    spectrel_set_gauge(SPECTREL_GAUGE_STREAMING, 1);
+
+    int status = SPECTREL_SUCCESS;
+    for (size_t n = 0; num_buffers == 0 || n < num_buffers; n++)
+    {
+        if (atomic_load_explicit(&engine->is_stopping, memory_order_acquire))
+            break;
+
+        uint64_t start = spectrel_get_time_ns();
+        int64_t buffer_time;
+        if (spectrel_read_stream(
+                engine->receiver, engine->buffer, &buffer_time) != 0)
+        {
+            status = SPECTREL_FAILURE;
+            break;
+        }
+        uint64_t read = spectrel_get_time_ns();
+        spectrel_observe(SPECTREL_HISTOGRAM_READ, read - start);
+
+        spectrel_spectrogram_t *spectrogram =
+            spectrel_stfft(engine->plan,
+                           engine->window,
+                           engine->buffer,
+                           engine->window_hop,
+                           engine->params.sample_rate,
+                           engine->arena);
+        if (!spectrogram)
+        {
+            status = SPECTREL_FAILURE;
+            break;
+        }
+        spectrogram->time = buffer_time;
+        spectrel_observe(SPECTREL_HISTOGRAM_STFFT,
+                         spectrel_get_time_ns() - read);
+        spectrel_add_counter(SPECTREL_COUNTER_FRAMES,
+                             spectrogram->num_spectrums);
+
+        // Hand the spectrogram over where it lies, then reclaim it.
+        struct spectrel_frame_t frame = {
+            .spectrogram = spectrogram,
+            .index = engine->num_spectrums,
+            .frequency = engine->params.frequency,
+            .sample_rate = engine->params.sample_rate,
+            .window_hop = engine->window_hop};
+        int is_done = engine->callback
+                          ? engine->callback(&frame, engine->user_data)
+                          : 0;
+        engine->num_spectrums += spectrogram->num_spectrums;
+        spectrel_free_spectrogram(spectrogram);
+        spectrel_rewind_arena(engine->arena, engine->frame_mark);
+        if (is_done)
+            break;
+    }
+
+    if (spectrel_deactivate_stream(engine->receiver) != 0)
+        status = SPECTREL_FAILURE;
+    spectrel_set_gauge(SPECTREL_GAUGE_STREAMING, 0);
+    atomic_store_explicit(&engine->is_stopping, false, memory_order_release);
+    return status;
+}
+
+uint64_t spectrel_get_frame_index(spectrel_frame frame)
+{
+    return frame->index;
+}
+
+int64_t spectrel_get_frame_time(spectrel_frame frame)
+{
+    return frame->spectrogram->time;
+}
+
+double spectrel_get_frame_frequency(spectrel_frame frame)
+{
+    return frame->frequency;
+}
+
+double spectrel_get_frame_sample_rate(spectrel_frame frame)
+{
+    return frame->sample_rate;
+}
+
+size_t spectrel_get_frame_window_hop(spectrel_frame frame)
+{
+    return frame->window_hop;
+}
+
+size_t spectrel_get_frame_num_spectrums(spectrel_frame frame)
+{
+    return frame->spectrogram->num_spectrums;
+}
+
+size_t spectrel_get_frame_num_samples_per_spectrum(spectrel_frame frame)
+{
+    return frame->spectrogram->num_samples_per_spectrum;
+}
+
+spectrel_layout_t spectrel_get_frame_layout(spectrel_frame frame)
+{
+    return frame->spectrogram->layout;
+}
+
+const fftw_complex *spectrel_get_frame_samples(spectrel_frame frame)
+{
+    return (const fftw_complex *)frame->spectrogram->samples;
+}
+
+const double *spectrel_get_frame_real(spectrel_frame frame)
+{
+    return frame->spectrogram->real;
+}
+
+const double *spectrel_get_frame_imag(spectrel_frame frame)
+{
+    return frame->spectrogram->imag;
+}
+
+const double *spectrel_get_frame_times(spectrel_frame frame)
+{
+    return frame->spectrogram->times;
+}
+
+const double *spectrel_get_frame_frequencies(spectrel_frame frame)
+{
+    return frame->spectrogram->frequencies;
+}
@@ -0,0 +1,431 @@
+#include "spgen.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How far each component has got, and what it needs to pick up from there.
+typedef struct
+{
+    double amplitude;
+    uint64_t cycle;    // The number of samples before the component repeats,
+                       // or zero if it never does.
+    uint64_t active;   // The number of samples it is on for, each cycle.
+    uint64_t position; // The position of the next sample in the cycle.
+    double phase;      // The phase of the next sample of a tone or pulse,
+                       // which is carried over from one pulse to the next,
+                       // in cycles.
+} spectrel_component_state_t;
+
+struct spectrel_generator_t
+{
+    double frequency;
+    double sample_rate;
+    double noise_scale; // The scale each part of the noise is drawn with.
+    uint64_t key;
+    uint64_t index; // The index of the next sample.
+    double *table;
+    spectrel_component_t components[SPECTREL_MAX_COMPONENTS];
+    spectrel_component_state_t states[SPECTREL_MAX_COMPONENTS];
+    size_t num_components;
+};
+
+// Add the chirp over a chunk short enough that its phase may be carried by
+// recurrence from the phase of the first sample.
+static void spectrel_add_chirp_chunk(fftw_complex *samples,
+                                     const size_t num_samples,
+                                     const double amplitude,
+                                     const double phase,
+                                     const double frequency,
+                                     const double rate)
+{
+    const size_t L = SPECTREL_GENERATOR_LANES;
+    double lane_real[SPECTREL_GENERATOR_LANES];
+    double lane_imag[SPECTREL_GENERATOR_LANES];
+    double turn_real[SPECTREL_GENERATOR_LANES];
+    double turn_imag[SPECTREL_GENERATOR_LANES];
+
+    // The phase of sample j is 2 pi (phase + frequency j + rate j^2 / 2). The
+    // lanes hold the phase of each sample of a block relative to its first,
+    // which, as the frequency changes, is turned from block to block.
+    double complex w = 1;
+    double complex d = cexp(2 * M_PI * I * (frequency + rate / 2));
+    double complex e = cexp(2 * M_PI * I * rate);
+    double complex t = 1;
+    double complex u = cexp(2 * M_PI * I * rate * L);
+    for (size_t l = 0; l < L; l++)
+    {
+        lane_real[l] = creal(w);
+        lane_imag[l] = cimag(w);
+        turn_real[l] = creal(t);
+        turn_imag[l] = cimag(t);
+        w *= d;
+        d *= e;
+        t *= u;
+    }
+
+    double complex phasor = cexp(2 * M_PI * I * phase);
+    double complex step = cexp(2 * M_PI * I * (frequency + rate * L / 2) * L);
+    if (rate == 0)
+    {
+        spectrel_add_tone_blocks(samples,
+                                 lane_real,
+                                 lane_imag,
+                                 phasor,
+                                 step,
+                                 amplitude,
+                                 num_samples);
+    }
+    else
+    {
+        spectrel_add_chirp_blocks(samples,
+                                  lane_real,
+                                  lane_imag,
+                                  turn_real,
+                                  turn_imag,
+                                  phasor,
+                                  step,
+                                  cexp(2 * M_PI * I * rate * L * L),
+                                  amplitude,
+                                  num_samples);
+    }
+}
+
+void spectrel_add_chirp(fftw_complex *samples,
+                        const size_t num_samples,
+                        const double amplitude,
+                        const double phase,
+                        const double frequency,
+                        const double rate)
+{
+    for (size_t n = 0; n < num_samples; n += SPECTREL_GENERATOR_CHUNK)
+    {
+        size_t count = num_samples - n < SPECTREL_GENERATOR_CHUNK
+                           ? num_samples - n
+                           : SPECTREL_GENERATOR_CHUNK;
+        double t = (double)n;
+        double chunk_phase = phase + frequency * t + rate * t * t / 2;
+        spectrel_add_chirp_chunk(&samples[n],
+                                 count,
+                                 amplitude,
+                                 chunk_phase - floor(chunk_phase),
+                                 frequency + rate * t,
+                                 rate);
+    }
+}
+
+// Get the phase of a component at a position in its cycle, in cycles, and
+// its first three derivatives, in cycles per sample (per sample, ...).
+static void spectrel_get_phase(const spectrel_generator g,
+                               const size_t k,
+                               double *phase,
+                               double *frequency,
+                               double *rate,
+                               double *curvature)
+{
+    const spectrel_component_t *c = &g->components[k];
+    const spectrel_component_state_t *s = &g->states[k];
+    double fs = g->sample_rate;
+    double fc = g->frequency;
+    double t = (double)s->position / fs;
+    *rate = 0;
+    *curvature = 0;
+    switch (c->type)
+    {
+    case SPECTREL_LINEAR_CHIRP:
+    {
+        double slope = (c->stop_frequency - c->frequency) / c->duration;
+        *phase = c->frequency * t + slope * t * t / 2;
+        *frequency = (c->frequency + slope * t) / fs;
+        *rate = slope / (fs * fs);
+        break;
+    }
+    case SPECTREL_EXPONENTIAL_CHIRP:
+    {
+        // The absolute frequency is f0 exp(lambda t).
+        double f0 = fc + c->frequency;
+        double lambda = log((fc + c->stop_frequency) / f0) / c->duration;
+        double x = lambda * t;
+        double growth = exp(x);
+        *phase = (x != 0 ? f0 * t * expm1(x) / x : f0 * t) - fc * t;
+        *frequency = (f0 * growth - fc) / fs;
+        *rate = f0 * lambda * growth / (fs * fs);
+        *curvature = f0 * lambda * lambda * growth / (fs * fs * fs);
+        break;
+    }
+    case SPECTREL_DISPERSED_PULSE:
+    {
+        // The absolute frequency, in MHz, is (a + t / b)^(-1/2), so that the
+        // dispersion delay of each frequency below the top is t.
+        double f_top = (fc + fs / 2) * 1e-6;
+        double a = 1 / (f_top * f_top);
+        double b = SPECTREL_DISPERSION_CONSTANT * c->dm;
+        double u = a + t / b;
+        double root = sqrt(u);
+        *phase = 2e6 * t / (root + sqrt(a)) - fc * t;
+        *frequency = (1e6 / root - fc) / fs;
+        *rate = -1e6 / (2 * b * u * root) / (fs * fs);
+        *curvature = 3e6 / (4 * b * b * u * u * root) / (fs * fs * fs);
+        break;
+    }
+    default:
+        // Tones and pulses carry their phase from one sample to the next.
+        *phase = s->phase;
+        *frequency = c->frequency / fs;
+        break;
+    }
+}
+
+// Get the longest chunk over which a component's frequency may be taken to
+// change linearly, given the rate its rate changes at.
+static size_t spectrel_get_chunk_size(const double curvature)
+{
+    // The phase error of the quadratic is about 2 pi |curvature| n^3 / 6.
+    double size = SPECTREL_GENERATOR_CHUNK;
+    if (curvature != 0)
+    {
+        size = cbrt(6 * SPECTREL_GENERATOR_PHASE_TOLERANCE /
+                    (2 * M_PI * fabs(curvature)));
+    }
+    if (size > SPECTREL_GENERATOR_CHUNK)
+        return SPECTREL_GENERATOR_CHUNK;
+    if (size < SPECTREL_GENERATOR_MIN_CHUNK)
+        return SPECTREL_GENERATOR_MIN_CHUNK;
+    return (size_t)size;
+}
+
+static void spectrel_generate_component(spectrel_generator g,
+                                        const size_t k,
+                                        fftw_complex *samples,
+                                        const size_t num_samples)
+{
+    spectrel_component_state_t *s = &g->states[k];
+    bool is_coherent = g->components[k].type == SPECTREL_TONE ||
+                       g->components[k].type == SPECTREL_PULSE;
+    size_t n = 0;
+    while (n < num_samples)
+    {
+        size_t count = num_samples - n;
+        bool is_on = true;
+        if (s->cycle)
+        {
+            // Stop at the end of the pulse, or the start of the next.
+            is_on = s->position < s->active;
+            uint64_t left =
+                is_on ? s->active - s->position : s->cycle - s->position;
+            count = left < count ? left : count;
+        }
+
+        if (is_on)
+        {
+            double phase, frequency, rate, curvature;
+            spectrel_get_phase(g, k, &phase, &frequency, &rate, &curvature);
+            size_t chunk = spectrel_get_chunk_size(curvature);
+            count = chunk < count ? chunk : count;
+            spectrel_add_chirp_chunk(&samples[n],
+                                     count,
+                                     s->amplitude,
+                                     phase - floor(phase),
+                                     frequency,
+                                     rate);
+        }
+
+        if (is_coherent)
+        {
+            s->phase += g->components[k].frequency / g->sample_rate * count;
+            s->phase -= floor(s->phase);
+        }
+        s->position += count;
+        if (s->position == s->cycle)
+            s->position = 0;
+        n += count;
+    }
+}
+
+// The finaliser of SplitMix64.
+static uint64_t spectrel_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+// Fill the table the noise is drawn from with Gaussian values, by the
+// Box-Muller transform, then set their mean and variance exactly.
+static void spectrel_fill_noise_table(double *table)
+{
+    const size_t N = SPECTREL_NOISE_TABLE_SIZE;
+    uint64_t state = 0;
+    for (size_t n = 0; n < N; n += 2)
+    {
+        state += 0x9e3779b97f4a7c15u;
+        double u1 = ((spectrel_mix(state) >> 11) + 1) * 0x1.0p-53;
+        state += 0x9e3779b97f4a7c15u;
+        double u2 = (spectrel_mix(state) >> 11) * 0x1.0p-53;
+        double r = sqrt(-2 * log(u1));
+        table[n] = r * cos(2 * M_PI * u2);
+        table[n + 1] = r * sin(2 * M_PI * u2);
+    }
+
+    double mean = 0, variance = 0;
+    for (size_t n = 0; n < N; n++)
+        mean += table[n] / N;
+    for (size_t n = 0; n < N; n++)
+        variance += (table[n] - mean) * (table[n] - mean) / N;
+    for (size_t n = 0; n < N; n++)
+        table[n] = (table[n] - mean) / sqrt(variance);
+}
+
+// Check a component can be generated, and work out how often it repeats.
+static int spectrel_init_component(spectrel_generator g, const size_t k)
+{
+    const spectrel_component_t *c = &g->components[k];
+    spectrel_component_state_t *s = &g->states[k];
+    double fs = g->sample_rate;
+    double fc = g->frequency;
+    switch (c->type)
+    {
+    case SPECTREL_TONE:
+        return SPECTREL_SUCCESS;
+    case SPECTREL_LINEAR_CHIRP:
+    case SPECTREL_EXPONENTIAL_CHIRP:
+        if (c->duration <= 0 ||
+            (c->type == SPECTREL_EXPONENTIAL_CHIRP &&
+             (fc + c->frequency <= 0 || fc + c->stop_frequency <= 0)))
+        {
+            spectrel_print_error("Chirps need a duration, and exponential "
+                                 "chirps positive absolute frequencies");
+            return SPECTREL_FAILURE;
+        }
+        s->cycle = (uint64_t)ceil(c->duration * fs);
+        s->active = s->cycle;
+        return SPECTREL_SUCCESS;
+    case SPECTREL_PULSE:
+    case SPECTREL_DISPERSED_PULSE:
+    {
+        double duration = c->duration;
+        if (c->type == SPECTREL_DISPERSED_PULSE)
+        {
+            // The pulse lasts as long as it takes to sweep down the band.
+            double f_top = (fc + fs / 2) * 1e-6;
+            double f_bottom = (fc - fs / 2) * 1e-6;
+            if (c->dm <= 0 || f_bottom <= 0)
+            {
+                spectrel_print_error("Dispersed pulses need a dispersion "
+                                     "measure, and a band above zero");
+                return SPECTREL_FAILURE;
+            }
+            duration = SPECTREL_DISPERSION_CONSTANT * c->dm *
+                       (1 / (f_bottom * f_bottom) - 1 / (f_top * f_top));
+        }
+        if (c->period <= 0 || duration <= 0)
+        {
+            spectrel_print_error("Pulses need a period, and a duration");
+            return SPECTREL_FAILURE;
+        }
+        s->cycle = (uint64_t)ceil(c->period * fs);
+        s->active = (uint64_t)ceil(duration * fs);
+        s->active = s->active < s->cycle ? s->active : s->cycle;
+        return SPECTREL_SUCCESS;
+    }
+    default:
+        spectrel_print_error("Unrecognised component type: %d", c->type);
+        return SPECTREL_FAILURE;
+    }
+}
+
+void spectrel_free_generator(spectrel_generator generator)
+{
+    if (generator)
+    {
+        if (generator->table)
+        {
+            free(generator->table);
+            generator->table = NULL;
+        }
+        free(generator);
+    }
+}
+
+spectrel_generator
+spectrel_make_generator(const spectrel_generator_params_t *params)
+{
+    if (params->sample_rate <= 0 || params->noise_power < 0 ||
+        params->num_components > SPECTREL_MAX_COMPONENTS)
+    {
+        spectrel_print_error("Generators need a sample rate, and at most %d "
+                             "components",
+                             SPECTREL_MAX_COMPONENTS);
+        return NULL;
+    }
+
+    // Prepare generator structure with safe initial values.
+    spectrel_generator g = calloc(1, sizeof(*g));
+    if (!g)
+    {
+        spectrel_print_error("malloc failed: generator");
+        return NULL;
+    }
+    g->frequency = params->frequency;
+    g->sample_rate = params->sample_rate;
+    g->noise_scale = sqrt(params->noise_power) / 2;
+    g->key = spectrel_mix(params->seed);
+    g->table = malloc(sizeof(*g->table) * SPECTREL_NOISE_TABLE_SIZE);
+    if (!g->table)
+    {
+        spectrel_free_generator(g);
+        spectrel_print_error("malloc failed: noise table");
+        return NULL;
+    }
+    spectrel_fill_noise_table(g->table);
+
+    // The power of each component is relative to the noise, if there is any.
+    double reference = params->noise_power > 0 ? params->noise_power : 1;
+    g->num_components = params->num_components;
+    for (size_t k = 0; k < g->num_components; k++)
+    {
+        g->components[k] = params->components[k];
+        g->states[k].amplitude =
+            sqrt(reference * pow(10, g->components[k].snr / 10));
+        if (spectrel_init_component(g, k) != 0)
+        {
+            spectrel_free_generator(g);
+            return NULL;
+        }
+    }
+    return g;
+}
+
+int spectrel_generate(spectrel_generator generator, spectrel_signal_t *signal)
+{
+    if (signal->format != SPECTREL_FORMAT_CF64)
+    {
+        spectrel_print_error("Synthetic signals must be held as CF64");
+        return SPECTREL_FAILURE;
+    }
+
+    size_t N = signal->num_samples;
+    if (generator->noise_scale > 0)
+    {
+        spectrel_fill_noise(signal->samples,
+                            generator->table,
+                            generator->key,
+                            generator->index,
+                            generator->noise_scale,
+                            N);
+    }
+    else
+    {
+        memset(signal->samples, 0, sizeof(*signal->samples) * N);
+    }
+    for (size_t k = 0; k < generator->num_components; k++)
+    {
+        spectrel_generate_component(generator, k, signal->samples, N);
+    }
+    generator->index += N;
+    return SPECTREL_SUCCESS;
+}
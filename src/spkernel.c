@@ -0,0 +1,439 @@
+#include "spkernel.h"
+#include "spconstants.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+void spectrel_multiply_window(const fftw_complex *samples,
+                              const fftw_complex *window,
+                              fftw_complex *out,
+                              const size_t num_samples)
+{
+    // Multiply component-wise, rather than as complex numbers, to skip the
+    // checks for infinities that C requires of complex multiplication.
+    const double *x = (const double *)samples;
+    const double *w = (const double *)window;
+    double *y = (double *)out;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        double re = x[2 * n] * w[2 * n] - x[2 * n + 1] * w[2 * n + 1];
+        double im = x[2 * n] * w[2 * n + 1] + x[2 * n + 1] * w[2 * n];
+        y[2 * n] = re;
+        y[2 * n + 1] = im;
+    }
+}
+
+void spectrel_multiply_window_real(const fftw_complex *samples,
+                                   const fftw_complex *window,
+                                   double *out,
+                                   const size_t num_samples)
+{
+    const double *x = (const double *)samples;
+    const double *w = (const double *)window;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        out[n] = x[2 * n] * w[2 * n] - x[2 * n + 1] * w[2 * n + 1];
+    }
+}
+
+void spectrel_multiply_window_split(const fftw_complex *samples,
+                                    const fftw_complex *window,
+                                    double *real,
+                                    double *imag,
+                                    const size_t num_samples)
+{
+    const double *x = (const double *)samples;
+    const double *w = (const double *)window;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        real[n] = x[2 * n] * w[2 * n] - x[2 * n + 1] * w[2 * n + 1];
+        imag[n] = x[2 * n] * w[2 * n + 1] + x[2 * n + 1] * w[2 * n];
+    }
+}
+
+// Define kernels which convert samples of the given type to doubles, scale
+// them and multiply them by a window, in a single pass. The loops are the same
+// as for double-precision samples, so they vectorise in the same way.
+#define SPECTREL_DEFINE_CONVERT_WINDOW(suffix, type)                           \
+    static void spectrel_convert_window_##suffix(const type *x,               \
+                                                 const double scale,          \
+                                                 const double *w,             \
+                                                 double *y,                   \
+                                                 const size_t num_samples)    \
+    {                                                                          \
+        for (size_t n = 0; n < num_samples; n++)                               \
+        {                                                                      \
+            double re = scale * x[2 * n];                                      \
+            double im = scale * x[2 * n + 1];                                  \
+            y[2 * n] = re * w[2 * n] - im * w[2 * n + 1];                      \
+            y[2 * n + 1] = re * w[2 * n + 1] + im * w[2 * n];                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void spectrel_convert_window_split_##suffix(                        \
+        const type *x,                                                         \
+        const double scale,                                                    \
+        const double *w,                                                       \
+        double *real,                                                          \
+        double *imag,                                                          \
+        const size_t num_samples)                                              \
+    {                                                                          \
+        for (size_t n = 0; n < num_samples; n++)                               \
+        {                                                                      \
+            double re = scale * x[2 * n];                                      \
+            double im = scale * x[2 * n + 1];                                  \
+            real[n] = re * w[2 * n] - im * w[2 * n + 1];                       \
+            imag[n] = re * w[2 * n + 1] + im * w[2 * n];                       \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static void spectrel_convert_window_real_##suffix(                         \
+        const type *x,                                                         \
+        const double scale,                                                    \
+        const double *w,                                                       \
+        double *out,                                                           \
+        const size_t num_samples)                                              \
+    {                                                                          \
+        for (size_t n = 0; n < num_samples; n++)                               \
+        {                                                                      \
+            double re = scale * x[2 * n];                                      \
+            double im = scale * x[2 * n + 1];                                  \
+            out[n] = re * w[2 * n] - im * w[2 * n + 1];                        \
+        }                                                                      \
+    }
+
+SPECTREL_DEFINE_CONVERT_WINDOW(cf32, float)
+SPECTREL_DEFINE_CONVERT_WINDOW(cs16, int16_t)
+SPECTREL_DEFINE_CONVERT_WINDOW(cs8, int8_t)
+
+void spectrel_convert_window(const void *samples,
+                             const spectrel_format_t format,
+                             const double scale,
+                             const fftw_complex *window,
+                             fftw_complex *out,
+                             const size_t num_samples)
+{
+    const double *w = (const double *)window;
+    double *y = (double *)out;
+    switch (format)
+    {
+    case SPECTREL_FORMAT_CF32:
+        spectrel_convert_window_cf32(samples, scale, w, y, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS16:
+        spectrel_convert_window_cs16(samples, scale, w, y, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS8:
+        spectrel_convert_window_cs8(samples, scale, w, y, num_samples);
+        break;
+    default:
+        spectrel_multiply_window(samples, window, out, num_samples);
+        break;
+    }
+}
+
+void spectrel_convert_window_split(const void *samples,
+                                   const spectrel_format_t format,
+                                   const double scale,
+                                   const fftw_complex *window,
+                                   double *real,
+                                   double *imag,
+                                   const size_t num_samples)
+{
+    const double *w = (const double *)window;
+    switch (format)
+    {
+    case SPECTREL_FORMAT_CF32:
+        spectrel_convert_window_split_cf32(
+            samples, scale, w, real, imag, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS16:
+        spectrel_convert_window_split_cs16(
+            samples, scale, w, real, imag, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS8:
+        spectrel_convert_window_split_cs8(
+            samples, scale, w, real, imag, num_samples);
+        break;
+    default:
+        spectrel_multiply_window_split(
+            samples, window, real, imag, num_samples);
+        break;
+    }
+}
+
+void spectrel_convert_window_real(const void *samples,
+                                  const spectrel_format_t format,
+                                  const double scale,
+                                  const fftw_complex *window,
+                                  double *out,
+                                  const size_t num_samples)
+{
+    const double *w = (const double *)window;
+    switch (format)
+    {
+    case SPECTREL_FORMAT_CF32:
+        spectrel_convert_window_real_cf32(samples, scale, w, out, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS16:
+        spectrel_convert_window_real_cs16(samples, scale, w, out, num_samples);
+        break;
+    case SPECTREL_FORMAT_CS8:
+        spectrel_convert_window_real_cs8(samples, scale, w, out, num_samples);
+        break;
+    default:
+        spectrel_multiply_window_real(samples, window, out, num_samples);
+        break;
+    }
+}
+
+void spectrel_compute_power(const fftw_complex *samples,
+                            double *power,
+                            const size_t num_samples)
+{
+    // View the samples as interleaved real and imaginary components, so the
+    // compiler is free to vectorise the loop.
+    const double *components = (const double *)samples;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        double re = components[2 * n];
+        double im = components[2 * n + 1];
+        power[n] = re * re + im * im;
+    }
+}
+
+// Branch-free natural logarithm, valid for normal, positive inputs.
+//
+// The input is split into an exponent e and mantissa m in [sqrt(1/2),
+// sqrt(2)), such that ln(x) = e ln(2) + ln(m). Then ln(m) is evaluated with
+// the series 2 (t + t^3/3 + t^5/5 + ...) where t = (m - 1) / (m + 1). Since
+// |t| < 0.172, truncating after t^9 leaves an absolute error below 1e-9 (at
+// most about 7e-10, or 3e-9 dB).
+static inline double spectrel_fast_log(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    // A 32-bit exponent keeps the int-to-double conversion vectorisable.
+    int32_t biased_exponent = (int32_t)((bits >> 52) & 0x7ff);
+    double exponent = (double)(biased_exponent - 1023);
+    bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+
+    double is_large = m > M_SQRT2 ? 1.0 : 0.0;
+    m = m * (1.0 - 0.5 * is_large);
+    exponent += is_large;
+
+    double t = (m - 1) / (m + 1);
+    double t2 = t * t;
+    double series =
+        t * (2.0 +
+             t2 * (2.0 / 3 + t2 * (2.0 / 5 + t2 * (2.0 / 7 + t2 * 2.0 / 9))));
+    return exponent * M_LN2 + series;
+}
+
+void spectrel_compute_power_db(const fftw_complex *samples,
+                               float *power_db,
+                               const size_t num_samples)
+{
+    const double *components = (const double *)samples;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        double re = components[2 * n];
+        double im = components[2 * n + 1];
+        double power = re * re + im * im;
+        power = power < SPECTREL_MIN_POWER ? SPECTREL_MIN_POWER : power;
+        power_db[n] = (float)((10 / M_LN10) * spectrel_fast_log(power));
+    }
+}
+
+void spectrel_compute_split_power(const double *real,
+                                  const double *imag,
+                                  double *power,
+                                  const size_t num_samples)
+{
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        power[n] = real[n] * real[n] + imag[n] * imag[n];
+    }
+}
+
+void spectrel_compute_split_power_db(const double *real,
+                                     const double *imag,
+                                     float *power_db,
+                                     const size_t num_samples)
+{
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        double power = real[n] * real[n] + imag[n] * imag[n];
+        power = power < SPECTREL_MIN_POWER ? SPECTREL_MIN_POWER : power;
+        power_db[n] = (float)((10 / M_LN10) * spectrel_fast_log(power));
+    }
+}
+
+// The arrays never overlap, and saying so spares the loop a runtime check for
+// each pair of them, which is too many for it to be vectorised.
+void spectrel_accumulate_moments(const double *restrict power,
+                                 const size_t count,
+                                 double *restrict mean,
+                                 double *restrict m2,
+                                 double *restrict m3,
+                                 double *restrict m4,
+                                 double *restrict min,
+                                 double *restrict max,
+                                 const size_t num_samples)
+{
+    // The coefficients depend only on the count, so are hoisted out of the
+    // loop (Pebay, 2008).
+    double n = (double)count;
+    double inv_n = 1 / n;
+    double c3 = n - 2;
+    double c4 = n * n - 3 * n + 3;
+    if (count == 1)
+    {
+        memcpy(min, power, sizeof(*min) * num_samples);
+        memcpy(max, power, sizeof(*max) * num_samples);
+    }
+    for (size_t k = 0; k < num_samples; k++)
+    {
+        double x = power[k];
+        double delta = x - mean[k];
+        double delta_n = delta * inv_n;
+        double delta_n2 = delta_n * delta_n;
+        double term = delta * delta_n * (n - 1);
+        m4[k] += term * delta_n2 * c4 + 6 * delta_n2 * m2[k] -
+                 4 * delta_n * m3[k];
+        m3[k] += term * delta_n * c3 - 3 * delta_n * m2[k];
+        m2[k] += term;
+        mean[k] += delta_n;
+        min[k] = x < min[k] ? x : min[k];
+        max[k] = x > max[k] ? x : max[k];
+    }
+}
+
+void spectrel_accumulate_power_sums(const double *power,
+                                    double *sum,
+                                    double *sum_squares,
+                                    const size_t num_samples)
+{
+    for (size_t k = 0; k < num_samples; k++)
+    {
+        sum[k] += power[k];
+        sum_squares[k] += power[k] * power[k];
+    }
+}
+
+void spectrel_slide_dft(const double *restrict delta_real,
+                        const double *restrict delta_imag,
+                        const double *restrict twiddle_real,
+                        const double *restrict twiddle_imag,
+                        double *restrict acc_real,
+                        double *restrict acc_imag,
+                        const size_t num_bins,
+                        const size_t num_samples)
+{
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        double dr = delta_real[n];
+        double di = delta_imag[n];
+        const double *wr = &twiddle_real[n * num_bins];
+        const double *wi = &twiddle_imag[n * num_bins];
+        for (size_t k = 0; k < num_bins; k++)
+        {
+            acc_real[k] += dr * wr[k] - di * wi[k];
+            acc_imag[k] += dr * wi[k] + di * wr[k];
+        }
+    }
+}
+
+void spectrel_add_tone_blocks(fftw_complex *restrict samples,
+                              const double *restrict lane_real,
+                              const double *restrict lane_imag,
+                              const fftw_complex phasor,
+                              const fftw_complex step,
+                              const double amplitude,
+                              const size_t num_samples)
+{
+    const size_t L = SPECTREL_GENERATOR_LANES;
+    double *y = (double *)samples;
+    double pr = amplitude * creal(phasor), pi = amplitude * cimag(phasor);
+    double sr = creal(step), si = cimag(step);
+    for (size_t n = 0; n < num_samples; n += L)
+    {
+        size_t num_lanes = num_samples - n < L ? num_samples - n : L;
+        double *block = &y[2 * n];
+        for (size_t l = 0; l < num_lanes; l++)
+        {
+            block[2 * l] += pr * lane_real[l] - pi * lane_imag[l];
+            block[2 * l + 1] += pr * lane_imag[l] + pi * lane_real[l];
+        }
+        double re = pr * sr - pi * si;
+        double im = pr * si + pi * sr;
+        pr = re;
+        pi = im;
+    }
+}
+
+void spectrel_add_chirp_blocks(fftw_complex *restrict samples,
+                               double *restrict lane_real,
+                               double *restrict lane_imag,
+                               const double *restrict turn_real,
+                               const double *restrict turn_imag,
+                               const fftw_complex phasor,
+                               const fftw_complex step,
+                               const fftw_complex curve,
+                               const double amplitude,
+                               const size_t num_samples)
+{
+    const size_t L = SPECTREL_GENERATOR_LANES;
+    double *y = (double *)samples;
+    double pr = amplitude * creal(phasor), pi = amplitude * cimag(phasor);
+    double sr = creal(step), si = cimag(step);
+    double cr = creal(curve), ci = cimag(curve);
+    for (size_t n = 0; n < num_samples; n += L)
+    {
+        size_t num_lanes = num_samples - n < L ? num_samples - n : L;
+        double *block = &y[2 * n];
+        for (size_t l = 0; l < num_lanes; l++)
+        {
+            double wr = lane_real[l], wi = lane_imag[l];
+            block[2 * l] += pr * wr - pi * wi;
+            block[2 * l + 1] += pr * wi + pi * wr;
+            lane_real[l] = wr * turn_real[l] - wi * turn_imag[l];
+            lane_imag[l] = wr * turn_imag[l] + wi * turn_real[l];
+        }
+        double re = pr * sr - pi * si;
+        double im = pr * si + pi * sr;
+        pr = re;
+        pi = im;
+        re = sr * cr - si * ci;
+        im = sr * ci + si * cr;
+        sr = re;
+        si = im;
+    }
+}
+
+void spectrel_fill_noise(fftw_complex *restrict samples,
+                         const double *restrict table,
+                         const uint64_t key,
+                         const uint64_t index,
+                         const double scale,
+                         const size_t num_samples)
+{
+    // The finaliser of SplitMix64, which maps consecutive indices to
+    // independent-looking bits. Each 64-bit hash indexes the table four times.
+    const uint64_t mask = SPECTREL_NOISE_TABLE_SIZE - 1;
+    double *y = (double *)samples;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        uint64_t z = (key + index + n) * 0x9e3779b97f4a7c15u;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+        z ^= z >> 31;
+        y[2 * n] = scale * (table[z & mask] + table[(z >> 16) & mask]);
+        y[2 * n + 1] =
+            scale * (table[(z >> 32) & mask] + table[(z >> 48) & mask]);
+    }
+}
@@ -0,0 +1,522 @@
+#include "spmetrics.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "sprealtime.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+    // The number of durations in each bucket, plus one for durations over
+    // the largest bound.
+    atomic_uint_fast64_t buckets[SPECTREL_METRICS_NUM_BUCKETS + 1];
+    atomic_uint_fast64_t sum; // The sum of the durations, in nanoseconds.
+} spectrel_histogram_data_t;
+
+static atomic_uint_fast64_t spectrel_counters[SPECTREL_NUM_COUNTERS];
+static atomic_int_fast64_t spectrel_gauges[SPECTREL_NUM_GAUGES];
+static spectrel_histogram_data_t spectrel_histograms[SPECTREL_NUM_HISTOGRAMS];
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} spectrel_counter_info[SPECTREL_NUM_COUNTERS] = {
+    {"spectrel_samples_read_total", "Samples read from the receiver."},
+    {"spectrel_overflows_total", "Times the receiver dropped samples."},
+    {"spectrel_frames_total", "Spectrums computed."},
+    {"spectrel_bytes_written_total", "Bytes written to recordings."},
+    {"spectrel_arena_misses_total",
+     "Buffers allocated from the heap, since the arena was full."},
+    {"spectrel_writer_stalls_total",
+     "Times the recording thread waited for a free writer buffer."},
+    {"spectrel_candidates_total", "Transient candidates found."},
+    {"spectrel_dedisp_dropped_blocks_total",
+     "Blocks of spectrums not dedispersed, since the search fell behind."},
+};
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} spectrel_gauge_info[SPECTREL_NUM_GAUGES] = {
+    {"spectrel_streaming", "Whether samples are being read."},
+    {"spectrel_subscribers", "Subscribers to the stream socket."},
+    {"spectrel_subscriber_lag", "The most records queued for a subscriber."},
+    {"spectrel_arena_bytes", "The size of the arena."},
+    {"spectrel_arena_used_bytes", "The most bytes allocated from the arena."},
+    {"spectrel_arena_hugepages",
+     "2 if the arena is backed by reserved hugepages, 1 if transparent."},
+    {"spectrel_arena_node", "The NUMA node the arena is bound to, or -1."},
+    {"spectrel_read_interval_max_nanoseconds",
+     "The longest time between successive reads from the receiver."},
+    {"spectrel_writes_in_flight", "Writer buffers being written."},
+    {"spectrel_rfi_flagged_samples",
+     "Spectral components flagged as interference in the last block."},
+};
+
+// Histograms with the same name are labelled by stage, and must be adjacent.
+static const struct
+{
+    const char *name;
+    const char *stage;
+    const char *help;
+} spectrel_histogram_info[SPECTREL_NUM_HISTOGRAMS] = {
+    {"spectrel_stage_seconds", "read", "Time spent in each stage, per buffer."},
+    {"spectrel_stage_seconds", "stfft", NULL},
+    {"spectrel_stage_seconds", "write", NULL},
+    {"spectrel_stage_seconds", "publish", NULL},
+    {"spectrel_fft_seconds", NULL, "Time spent computing each spectrum."},
+    {"spectrel_read_interval_seconds",
+     NULL,
+     "Time between successive reads from the receiver."},
+    {"spectrel_dedisp_seconds", NULL, "Time spent dedispersing each block."},
+};
+
+// The upper bound of a bucket, in nanoseconds. Bounds grow by a factor of
+// four from a microsecond.
+static uint64_t spectrel_get_bucket_bound(const size_t bucket)
+{
+    return (uint64_t)1000 << (2 * bucket);
+}
+
+void spectrel_add_counter(const spectrel_counter_t counter,
+                          const uint64_t value)
+{
+    atomic_fetch_add_explicit(
+        &spectrel_counters[counter], value, memory_order_relaxed);
+}
+
+void spectrel_set_gauge(const spectrel_gauge_t gauge, const int64_t value)
+{
+    atomic_store_explicit(&spectrel_gauges[gauge], value, memory_order_relaxed);
+}
+
+void spectrel_observe(const spectrel_histogram_t histogram,
+                      const uint64_t duration)
+{
+    size_t bucket = 0;
+    while (bucket < SPECTREL_METRICS_NUM_BUCKETS &&
+           duration > spectrel_get_bucket_bound(bucket))
+    {
+        bucket++;
+    }
+    spectrel_histogram_data_t *data = &spectrel_histograms[histogram];
+    atomic_fetch_add_explicit(&data->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&data->sum, duration, memory_order_relaxed);
+}
+
+uint64_t spectrel_get_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Append formatted text to the buffer, tracking the length it would have if
+// the buffer were large enough.
+static void spectrel_append(char *buffer,
+                            const size_t size,
+                            size_t *length,
+                            const char *fmt,
+                            ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    size_t offset = *length < size ? *length : size;
+    int ret = vsnprintf(buffer + offset, size - offset, fmt, args);
+    va_end(args);
+    if (ret > 0)
+    {
+        *length += (size_t)ret;
+    }
+}
+
+size_t spectrel_format_metrics(char *buffer, const size_t size)
+{
+    size_t length = 0;
+    if (size > 0)
+    {
+        buffer[0] = '\0';
+    }
+
+    for (size_t i = 0; i < SPECTREL_NUM_COUNTERS; i++)
+    {
+        spectrel_append(buffer,
+                        size,
+                        &length,
+                        "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                        spectrel_counter_info[i].name,
+                        spectrel_counter_info[i].help,
+                        spectrel_counter_info[i].name,
+                        spectrel_counter_info[i].name,
+                        (unsigned long long)atomic_load_explicit(
+                            &spectrel_counters[i], memory_order_relaxed));
+    }
+
+    for (size_t i = 0; i < SPECTREL_NUM_GAUGES; i++)
+    {
+        spectrel_append(buffer,
+                        size,
+                        &length,
+                        "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n",
+                        spectrel_gauge_info[i].name,
+                        spectrel_gauge_info[i].help,
+                        spectrel_gauge_info[i].name,
+                        spectrel_gauge_info[i].name,
+                        (long long)atomic_load_explicit(&spectrel_gauges[i],
+                                                        memory_order_relaxed));
+    }
+
+    for (size_t i = 0; i < SPECTREL_NUM_HISTOGRAMS; i++)
+    {
+        const char *name = spectrel_histogram_info[i].name;
+        const char *stage = spectrel_histogram_info[i].stage;
+        if (spectrel_histogram_info[i].help)
+        {
+            spectrel_append(buffer,
+                            size,
+                            &length,
+                            "# HELP %s %s\n# TYPE %s histogram\n",
+                            name,
+                            spectrel_histogram_info[i].help,
+                            name);
+        }
+
+        // The stage label, alone and to go before the bucket label.
+        char labels[64] = "";
+        char bucket_labels[64] = "";
+        if (stage)
+        {
+            snprintf(labels, sizeof(labels), "{stage=\"%s\"}", stage);
+            snprintf(bucket_labels,
+                     sizeof(bucket_labels),
+                     "stage=\"%s\",",
+                     stage);
+        }
+
+        spectrel_histogram_data_t *data = &spectrel_histograms[i];
+        uint64_t count = 0;
+        for (size_t bucket = 0; bucket <= SPECTREL_METRICS_NUM_BUCKETS;
+             bucket++)
+        {
+            count += atomic_load_explicit(&data->buckets[bucket],
+                                          memory_order_relaxed);
+            if (bucket < SPECTREL_METRICS_NUM_BUCKETS)
+            {
+                spectrel_append(buffer,
+                                size,
+                                &length,
+                                "%s_bucket{%sle=\"%.9g\"} %llu\n",
+                                name,
+                                bucket_labels,
+                                spectrel_get_bucket_bound(bucket) * 1e-9,
+                                (unsigned long long)count);
+            }
+            else
+            {
+                spectrel_append(buffer,
+                                size,
+                                &length,
+                                "%s_bucket{%sle=\"+Inf\"} %llu\n",
+                                name,
+                                bucket_labels,
+                                (unsigned long long)count);
+            }
+        }
+        double sum = atomic_load_explicit(&data->sum, memory_order_relaxed);
+        spectrel_append(buffer,
+                        size,
+                        &length,
+                        "%s_sum%s %.9f\n%s_count%s %llu\n",
+                        name,
+                        labels,
+                        sum * 1e-9,
+                        name,
+                        labels,
+                        (unsigned long long)count);
+    }
+    return length;
+}
+
+struct spectrel_exporter_t
+{
+    char *textfile_path;
+    char *temp_path; // Written first, then renamed over the textfile.
+    int listen_fd;
+    int wake_fd;
+    pthread_t thread;
+    bool has_thread;
+    atomic_bool is_running;
+    char *buffer;
+};
+
+static void spectrel_write_textfile(spectrel_exporter exporter)
+{
+    size_t length =
+        spectrel_format_metrics(exporter->buffer, SPECTREL_METRICS_BUFFER_SIZE);
+    if (length >= SPECTREL_METRICS_BUFFER_SIZE)
+    {
+        length = SPECTREL_METRICS_BUFFER_SIZE - 1;
+    }
+
+    FILE *file = fopen(exporter->temp_path, "w");
+    if (!file)
+    {
+        spectrel_print_error(
+            "fopen failed: %s: %s", exporter->temp_path, strerror(errno));
+        return;
+    }
+    bool is_written = fwrite(exporter->buffer, 1, length, file) == length;
+    if (fclose(file) != 0 || !is_written)
+    {
+        spectrel_print_error("fwrite failed: %s", exporter->temp_path);
+        return;
+    }
+    if (rename(exporter->temp_path, exporter->textfile_path) != 0)
+    {
+        spectrel_print_error(
+            "rename failed: %s: %s", exporter->textfile_path, strerror(errno));
+    }
+}
+
+// Answer one HTTP request with the metrics, whatever was asked for.
+static void spectrel_serve_scrape(spectrel_exporter exporter)
+{
+    int fd = accept(exporter->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    // Don't let a slow client hold up the exporter.
+    struct timeval timeout = {.tv_sec = SPECTREL_METRICS_CLIENT_TIMEOUT};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char request[1024];
+    if (recv(fd, request, sizeof(request), 0) <= 0)
+    {
+        close(fd);
+        return;
+    }
+
+    size_t length =
+        spectrel_format_metrics(exporter->buffer, SPECTREL_METRICS_BUFFER_SIZE);
+    if (length >= SPECTREL_METRICS_BUFFER_SIZE)
+    {
+        length = SPECTREL_METRICS_BUFFER_SIZE - 1;
+    }
+    char header[128];
+    int header_length =
+        snprintf(header,
+                 sizeof(header),
+                 "HTTP/1.0 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %zu\r\n\r\n",
+                 length);
+    if (send(fd, header, (size_t)header_length, MSG_NOSIGNAL) ==
+        header_length)
+    {
+        size_t num_sent = 0;
+        while (num_sent < length)
+        {
+            ssize_t ret = send(fd,
+                               exporter->buffer + num_sent,
+                               length - num_sent,
+                               MSG_NOSIGNAL);
+            if (ret <= 0)
+            {
+                break;
+            }
+            num_sent += (size_t)ret;
+        }
+    }
+    close(fd);
+}
+
+static void *spectrel_export(void *arg)
+{
+    spectrel_exporter exporter = arg;
+    uint64_t next_write = 0;
+    while (atomic_load_explicit(&exporter->is_running, memory_order_acquire))
+    {
+        uint64_t now = spectrel_get_time_ns();
+        if (exporter->textfile_path && now >= next_write)
+        {
+            spectrel_write_textfile(exporter);
+            next_write = now + (uint64_t)SPECTREL_METRICS_INTERVAL * 1000000;
+        }
+
+        struct pollfd fds[2] = {{.fd = exporter->wake_fd, .events = POLLIN},
+                                {.fd = exporter->listen_fd, .events = POLLIN}};
+        nfds_t num_fds = exporter->listen_fd >= 0 ? 2 : 1;
+        if (poll(fds, num_fds, SPECTREL_METRICS_INTERVAL) < 0)
+        {
+            continue;
+        }
+        if (num_fds == 2 && (fds[1].revents & POLLIN))
+        {
+            spectrel_serve_scrape(exporter);
+        }
+    }
+    return NULL;
+}
+
+void spectrel_free_exporter(spectrel_exporter exporter)
+{
+    if (exporter)
+    {
+        if (exporter->has_thread)
+        {
+            atomic_store_explicit(
+                &exporter->is_running, false, memory_order_release);
+            uint64_t one = 1;
+            if (write(exporter->wake_fd, &one, sizeof(one)) < 0)
+            {
+                // The thread will notice at its next poll timeout.
+            }
+            pthread_join(exporter->thread, NULL);
+            exporter->has_thread = false;
+
+            // Leave the final values behind for the collector.
+            if (exporter->textfile_path)
+            {
+                spectrel_write_textfile(exporter);
+            }
+        }
+        if (exporter->listen_fd >= 0)
+        {
+            close(exporter->listen_fd);
+            exporter->listen_fd = -1;
+        }
+        if (exporter->wake_fd >= 0)
+        {
+            close(exporter->wake_fd);
+            exporter->wake_fd = -1;
+        }
+        if (exporter->textfile_path)
+        {
+            free(exporter->textfile_path);
+            exporter->textfile_path = NULL;
+        }
+        if (exporter->temp_path)
+        {
+            free(exporter->temp_path);
+            exporter->temp_path = NULL;
+        }
+        if (exporter->buffer)
+        {
+            free(exporter->buffer);
+            exporter->buffer = NULL;
+        }
+        free(exporter);
+    }
+}
+
+static int spectrel_listen_http(spectrel_exporter exporter, const int port)
+{
+    if (port < 1 || port > 65535)
+    {
+        spectrel_print_error("Invalid metrics port: %d", port);
+        return SPECTREL_FAILURE;
+    }
+    exporter->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (exporter->listen_fd < 0)
+    {
+        spectrel_print_error("socket failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+    int one = 1;
+    setsockopt(
+        exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    // Only serve local scrapes, so that the station isn't exposed.
+    struct sockaddr_in address = {.sin_family = AF_INET,
+                                  .sin_port = htons((uint16_t)port),
+                                  .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    if (bind(exporter->listen_fd,
+             (struct sockaddr *)&address,
+             sizeof(address)) != 0 ||
+        listen(exporter->listen_fd, SPECTREL_METRICS_BACKLOG) != 0)
+    {
+        spectrel_print_error("bind failed: port %d: %s", port, strerror(errno));
+        close(exporter->listen_fd);
+        exporter->listen_fd = -1;
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_exporter spectrel_make_exporter(const char *textfile_path,
+                                         const int port)
+{
+    // Prepare exporter structure with safe initial values.
+    spectrel_exporter exporter = calloc(1, sizeof(*exporter));
+    if (!exporter)
+    {
+        spectrel_print_error("malloc failed: exporter");
+        return NULL;
+    }
+    exporter->listen_fd = -1;
+    exporter->wake_fd = -1;
+    atomic_init(&exporter->is_running, true);
+
+    exporter->buffer = malloc(SPECTREL_METRICS_BUFFER_SIZE);
+    if (!exporter->buffer)
+    {
+        spectrel_free_exporter(exporter);
+        spectrel_print_error("malloc failed: buffer");
+        return NULL;
+    }
+    if (textfile_path)
+    {
+        exporter->textfile_path = strdup(textfile_path);
+        exporter->temp_path =
+            malloc(strlen(textfile_path) + strlen(".tmp") + 1);
+        if (!exporter->textfile_path || !exporter->temp_path)
+        {
+            spectrel_free_exporter(exporter);
+            spectrel_print_error("malloc failed: textfile_path");
+            return NULL;
+        }
+        sprintf(exporter->temp_path, "%s.tmp", textfile_path);
+    }
+
+    exporter->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (exporter->wake_fd < 0)
+    {
+        spectrel_free_exporter(exporter);
+        spectrel_print_error("eventfd failed: %s", strerror(errno));
+        return NULL;
+    }
+    if (port != 0 && spectrel_listen_http(exporter, port) != 0)
+    {
+        spectrel_free_exporter(exporter);
+        return NULL;
+    }
+    if (pthread_create(&exporter->thread, NULL, spectrel_export, exporter) !=
+        0)
+    {
+        spectrel_free_exporter(exporter);
+        spectrel_print_error("pthread_create failed: exporter");
+        return NULL;
+    }
+    exporter->has_thread = true;
+    spectrel_demote_thread(exporter->thread);
+    return exporter;
+}
@@ -29,6 +29,45 @@ int spectrel_make_dir(const char *dir)
     return SPECTREL_SUCCESS;
 }
 
+int spectrel_parse_encoding(const char *name, spectrel_encoding_t *encoding)
+{
+    if (strcmp(name, "cf64") == 0)
+    {
+        *encoding = SPECTREL_ENCODING_CF64;
+    }
+    else if (strcmp(name, "q8") == 0)
+    {
+        *encoding = SPECTREL_ENCODING_Q8;
+    }
+    else if (strcmp(name, "q16") == 0)
+    {
+        *encoding = SPECTREL_ENCODING_Q16;
+    }
+    else
+    {
+        spectrel_print_error("Unrecognised encoding: %s", name);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+const char *spectrel_get_encoding_name(const spectrel_encoding_t encoding)
+{
+    switch (encoding)
+    {
+    case SPECTREL_ENCODING_CF64:
+        return "cf64";
+    case SPECTREL_ENCODING_Q8:
+        return "q8";
+    case SPECTREL_ENCODING_Q16:
+        return "q16";
+    case SPECTREL_ENCODING_PYRAMID:
+        return "pyramid";
+    default:
+        return NULL;
+    }
+}
+
 static char *spectrel_join(const char *dir, const char *file_name)
 {
     size_t dir_len = strlen(dir);
@@ -51,9 +90,18 @@ static char *spectrel_join(const char *dir, const char *file_name)
     return path;
 }
 
-spectrel_file_t *
-spectrel_open_file(const char *dir, const time_t *t, const char *driver)
+spectrel_file_t *spectrel_open_file(const char *dir,
+                                    const time_t *t,
+                                    const char *driver,
+                                    const spectrel_encoding_t encoding)
 {
+    const char *extension = spectrel_get_encoding_name(encoding);
+    if (!extension)
+    {
+        spectrel_print_error("Unrecognised encoding: %d", encoding);
+        return NULL;
+    }
+
     // Convert time to UTC and format as ISO 8601
     struct tm *ut_time = gmtime(t);
     char datetime[SPECTREL_NUM_CHARS_ISO_8601 + 1];
@@ -68,16 +116,21 @@ spectrel_open_file(const char *dir, const time_t *t, const char *driver)
     }
 
     // Allocate and format the filename
-    const size_t num_chars_file_name =
-        strlen(datetime) + strlen("_") + strlen(driver) + strlen(".cf64") + 1;
+    const size_t num_chars_file_name = strlen(datetime) + strlen("_") +
+                                       strlen(driver) + strlen(".") +
+                                       strlen(extension) + 1;
     char *file_name = malloc(num_chars_file_name * sizeof(char));
     if (!file_name)
     {
         spectrel_print_error("malloc failed: file_name");
         return NULL;
     }
-    int ret = snprintf(
-        file_name, num_chars_file_name, "%s_%s.cf64", datetime, driver);
+    int ret = snprintf(file_name,
+                       num_chars_file_name,
+                       "%s_%s.%s",
+                       datetime,
+                       driver,
+                       extension);
     if (ret < 0)
     {
         spectrel_print_error("snprintf failed: file_name");
@@ -116,6 +169,8 @@ spectrel_open_file(const char *dir, const time_t *t, const char *driver)
     }
     spfile->file = file;
     spfile->path = strdup(file_path);
+    spfile->encoding = encoding;
+    spfile->writer = NULL;
 
     // Clean up temporary allocations.
     free(file_name);
@@ -128,6 +183,12 @@ void spectrel_close_file(spectrel_file_t *file)
 {
     if (file)
     {
+        // Wait for every write to the file before closing it.
+        if (file->writer)
+        {
+            spectrel_free_writer(file->writer);
+            file->writer = NULL;
+        }
         if (file->file)
         {
             fclose(file->file);
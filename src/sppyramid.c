@@ -0,0 +1,267 @@
+#include "sppyramid.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    FILE *file;
+    char *path;
+    size_t num_samples_per_spectrum;
+    size_t num_pooled; // The number of spectrums pooled into mean and max.
+    double *mean;      // The mean power of the spectrums pooled so far.
+    double *max;       // The max power of the spectrums pooled so far.
+    float *record;     // The record written for each decimated spectrum.
+} spectrel_pyramid_level_t;
+
+struct spectrel_pyramid_t
+{
+    size_t num_levels;
+    size_t num_samples_per_spectrum;
+    spectrel_pyramid_level_t *levels;
+    double *power;
+};
+
+static void spectrel_clear_pyramid_level(spectrel_pyramid_level_t *level)
+{
+    if (level->file)
+    {
+        fclose(level->file);
+        level->file = NULL;
+    }
+    if (level->path)
+    {
+        free(level->path);
+        level->path = NULL;
+    }
+    if (level->mean)
+    {
+        free(level->mean);
+        level->mean = NULL;
+    }
+    if (level->max)
+    {
+        free(level->max);
+        level->max = NULL;
+    }
+    if (level->record)
+    {
+        free(level->record);
+        level->record = NULL;
+    }
+}
+
+void spectrel_free_pyramid(spectrel_pyramid pyramid)
+{
+    if (pyramid)
+    {
+        if (pyramid->levels)
+        {
+            for (size_t k = 0; k < pyramid->num_levels; k++)
+            {
+                spectrel_clear_pyramid_level(&pyramid->levels[k]);
+            }
+            free(pyramid->levels);
+            pyramid->levels = NULL;
+        }
+        if (pyramid->power)
+        {
+            free(pyramid->power);
+            pyramid->power = NULL;
+        }
+        free(pyramid);
+    }
+}
+
+static int spectrel_open_pyramid_level(spectrel_pyramid_level_t *level,
+                                       const char *path,
+                                       const size_t level_index,
+                                       const size_t num_samples_per_spectrum)
+{
+    size_t M = num_samples_per_spectrum;
+    level->num_samples_per_spectrum = M;
+    level->num_pooled = 0;
+    level->mean = malloc(sizeof(*level->mean) * M);
+    level->max = malloc(sizeof(*level->max) * M);
+    level->record = malloc(sizeof(*level->record) * 2 * M);
+    if (!level->mean || !level->max || !level->record)
+    {
+        spectrel_print_error("malloc failed: pyramid level");
+        return SPECTREL_FAILURE;
+    }
+
+    // Append the level to the path of the full resolution spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".p") + 20 + 1;
+    level->path = malloc(num_chars_path);
+    if (!level->path)
+    {
+        spectrel_print_error("malloc failed: path");
+        return SPECTREL_FAILURE;
+    }
+    snprintf(level->path, num_chars_path, "%s.p%zu", path, level_index);
+
+    level->file = fopen(level->path, "wb");
+    if (!level->file)
+    {
+        spectrel_print_error("fopen failed: %s", level->path);
+        return SPECTREL_FAILURE;
+    }
+
+    spectrel_pyramid_header_t header = {0};
+    memcpy(
+        header.magic, SPECTREL_PYRAMID_MAGIC, sizeof(SPECTREL_PYRAMID_MAGIC));
+    header.level = (uint32_t)level_index;
+    header.decimation = (uint32_t)1 << level_index;
+    header.num_samples_per_spectrum = M;
+    if (fwrite(&header, sizeof(header), 1, level->file) != 1)
+    {
+        spectrel_print_error("fwrite failed: %s", level->path);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_pyramid spectrel_make_pyramid(const char *path,
+                                       const size_t num_samples_per_spectrum,
+                                       const size_t num_levels)
+{
+    if (num_levels < 1 || num_levels > SPECTREL_MAX_PYRAMID_LEVELS)
+    {
+        spectrel_print_error("Number of pyramid levels must be between 1 and "
+                             "%d",
+                             SPECTREL_MAX_PYRAMID_LEVELS);
+        return NULL;
+    }
+    if (num_samples_per_spectrum % ((size_t)1 << num_levels) != 0)
+    {
+        spectrel_print_error("Window size must be divisible by 2^%zu",
+                             num_levels);
+        return NULL;
+    }
+
+    // Prepare pyramid structure with safe initial values.
+    spectrel_pyramid pyramid = malloc(sizeof(*pyramid));
+    if (!pyramid)
+    {
+        spectrel_print_error("malloc failed: pyramid");
+        return NULL;
+    }
+    pyramid->num_levels = num_levels;
+    pyramid->num_samples_per_spectrum = num_samples_per_spectrum;
+    pyramid->levels = calloc(num_levels, sizeof(*pyramid->levels));
+    pyramid->power =
+        malloc(sizeof(*pyramid->power) * num_samples_per_spectrum);
+    if (!pyramid->levels || !pyramid->power)
+    {
+        spectrel_free_pyramid(pyramid);
+        spectrel_print_error("malloc failed: pyramid levels");
+        return NULL;
+    }
+
+    for (size_t k = 0; k < num_levels; k++)
+    {
+        if (spectrel_open_pyramid_level(&pyramid->levels[k],
+                                        path,
+                                        k + 1,
+                                        num_samples_per_spectrum >> (k + 1)) !=
+            0)
+        {
+            spectrel_free_pyramid(pyramid);
+            return NULL;
+        }
+    }
+    return pyramid;
+}
+
+static int spectrel_write_pyramid_level(spectrel_pyramid_level_t *level)
+{
+    size_t M = level->num_samples_per_spectrum;
+    for (size_t m = 0; m < M; m++)
+    {
+        double mean = fmax(level->mean[m], SPECTREL_MIN_POWER);
+        double max = fmax(level->max[m], SPECTREL_MIN_POWER);
+        level->record[m] = (float)(10 * log10(mean));
+        level->record[M + m] = (float)(10 * log10(max));
+    }
+    if (fwrite(level->record, sizeof(*level->record), 2 * M, level->file) !=
+        2 * M)
+    {
+        spectrel_print_error("fwrite failed: %s", level->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         2 * M * sizeof(*level->record));
+    return SPECTREL_SUCCESS;
+}
+
+// Pool one spectrum, given at the resolution of the level below, into each
+// level in turn. A level passes its pooled spectrum up once it has pooled two.
+static int spectrel_pool_pyramid(spectrel_pyramid pyramid,
+                                 const double *mean,
+                                 const double *max)
+{
+    for (size_t k = 0; k < pyramid->num_levels; k++)
+    {
+        spectrel_pyramid_level_t *level = &pyramid->levels[k];
+        size_t M = level->num_samples_per_spectrum;
+
+        // Pool adjacent samples in frequency, then adjacent spectrums in time.
+        if (level->num_pooled == 0)
+        {
+            for (size_t m = 0; m < M; m++)
+            {
+                level->mean[m] = 0.5 * (mean[2 * m] + mean[2 * m + 1]);
+                level->max[m] =
+                    max[2 * m] > max[2 * m + 1] ? max[2 * m] : max[2 * m + 1];
+            }
+            level->num_pooled = 1;
+            return SPECTREL_SUCCESS;
+        }
+        for (size_t m = 0; m < M; m++)
+        {
+            double pooled_mean = 0.5 * (mean[2 * m] + mean[2 * m + 1]);
+            double pooled_max =
+                max[2 * m] > max[2 * m + 1] ? max[2 * m] : max[2 * m + 1];
+            level->mean[m] = 0.5 * (level->mean[m] + pooled_mean);
+            level->max[m] =
+                pooled_max > level->max[m] ? pooled_max : level->max[m];
+        }
+        level->num_pooled = 0;
+
+        if (spectrel_write_pyramid_level(level) != 0)
+        {
+            return SPECTREL_FAILURE;
+        }
+        mean = level->mean;
+        max = level->max;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_update_pyramid(spectrel_pyramid pyramid,
+                            const spectrel_spectrogram_t *s)
+{
+    size_t M = pyramid->num_samples_per_spectrum;
+    if (s->num_samples_per_spectrum != M)
+    {
+        spectrel_print_error("Spectrogram does not match the pyramid");
+        return SPECTREL_FAILURE;
+    }
+
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        spectrel_compute_spectrum_power(s, n, pyramid->power);
+        if (spectrel_pool_pyramid(pyramid, pyramid->power, pyramid->power) !=
+            0)
+        {
+            return SPECTREL_FAILURE;
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
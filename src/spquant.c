@@ -0,0 +1,199 @@
+#include "spquant.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Choose the offset and scale such that the codes span the full range of the
+// log-power values.
+static void spectrel_compute_quantised_header(
+    const float *power_db,
+    const size_t num_samples,
+    const float max_code,
+    spectrel_quantised_header_t *header)
+{
+    float lo = power_db[0];
+    float hi = power_db[0];
+    for (size_t n = 1; n < num_samples; n++)
+    {
+        lo = power_db[n] < lo ? power_db[n] : lo;
+        hi = power_db[n] > hi ? power_db[n] : hi;
+    }
+    header->offset = lo;
+    // If the spectrum is flat, any non-zero scale will do.
+    header->scale = (hi > lo) ? (hi - lo) / max_code : 1.0f;
+}
+
+void spectrel_quantise_u8(const float *power_db,
+                          const size_t num_samples,
+                          spectrel_quantised_header_t *header,
+                          uint8_t *codes)
+{
+    spectrel_compute_quantised_header(
+        power_db, num_samples, (float)UINT8_MAX, header);
+    const float offset = header->offset;
+    const float inverse_scale = 1.0f / header->scale;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        codes[n] = (uint8_t)((power_db[n] - offset) * inverse_scale + 0.5f);
+    }
+}
+
+void spectrel_quantise_u16(const float *power_db,
+                           const size_t num_samples,
+                           spectrel_quantised_header_t *header,
+                           uint16_t *codes)
+{
+    spectrel_compute_quantised_header(
+        power_db, num_samples, (float)UINT16_MAX, header);
+    const float offset = header->offset;
+    const float inverse_scale = 1.0f / header->scale;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        codes[n] = (uint16_t)((power_db[n] - offset) * inverse_scale + 0.5f);
+    }
+}
+
+void spectrel_dequantise_u8(const spectrel_quantised_header_t *header,
+                            const uint8_t *codes,
+                            const size_t num_samples,
+                            float *power_db)
+{
+    const float offset = header->offset;
+    const float scale = header->scale;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        power_db[n] = offset + scale * (float)codes[n];
+    }
+}
+
+void spectrel_dequantise_u16(const spectrel_quantised_header_t *header,
+                             const uint16_t *codes,
+                             const size_t num_samples,
+                             float *power_db)
+{
+    const float offset = header->offset;
+    const float scale = header->scale;
+    for (size_t n = 0; n < num_samples; n++)
+    {
+        power_db[n] = offset + scale * (float)codes[n];
+    }
+}
+
+size_t spectrel_get_quantised_spectrum_size(
+    const spectrel_encoding_t encoding, const size_t num_samples_per_spectrum)
+{
+    switch (encoding)
+    {
+    case SPECTREL_ENCODING_Q8:
+        return sizeof(spectrel_quantised_header_t) +
+               sizeof(uint8_t) * num_samples_per_spectrum;
+    case SPECTREL_ENCODING_Q16:
+        return sizeof(spectrel_quantised_header_t) +
+               sizeof(uint16_t) * num_samples_per_spectrum;
+    default:
+        return 0;
+    }
+}
+
+int spectrel_write_quantised_spectrogram(spectrel_spectrogram_t *s,
+                                         spectrel_file_t *f)
+{
+    size_t N = s->num_spectrums;
+    size_t M = s->num_samples_per_spectrum;
+    size_t spectrum_size = spectrel_get_quantised_spectrum_size(f->encoding, M);
+    if (spectrum_size == 0)
+    {
+        spectrel_print_error("Encoding is not quantised: %d", f->encoding);
+        return SPECTREL_FAILURE;
+    }
+
+    // Scratch space comes from the spectrogram's arena if there is room,
+    // since it is released as soon as the spectrogram is written.
+    size_t used = spectrel_get_arena_used(s->arena);
+    float *power_db = spectrel_arena_alloc(s->arena, sizeof(*power_db) * M);
+    bool is_power_db_on_heap = !power_db;
+    if (is_power_db_on_heap)
+        power_db = malloc(sizeof(*power_db) * M);
+    if (!power_db)
+    {
+        spectrel_print_error("malloc failed: power_db");
+        return SPECTREL_FAILURE;
+    }
+
+    // Encode every spectrum into one contiguous block, so that the spectrogram
+    // is written with a single call. With a writer, each spectrum is encoded
+    // straight into its buffers instead.
+    uint8_t *block = NULL;
+    bool is_block_on_heap = false;
+    if (!f->writer)
+    {
+        block = spectrel_arena_alloc(s->arena, spectrum_size * N);
+        is_block_on_heap = !block;
+        if (is_block_on_heap)
+            block = malloc(spectrum_size * N);
+        if (!block)
+        {
+            if (is_power_db_on_heap)
+                free(power_db);
+            power_db = NULL;
+            spectrel_rewind_arena(s->arena, used);
+            spectrel_print_error("malloc failed: block");
+            return SPECTREL_FAILURE;
+        }
+    }
+
+    bool is_written = true;
+    for (size_t n = 0; n < N; n++)
+    {
+        uint8_t *record = f->writer
+                              ? spectrel_reserve_write(f->writer, spectrum_size)
+                              : block + n * spectrum_size;
+        if (!record)
+        {
+            is_written = false;
+            break;
+        }
+        spectrel_quantised_header_t header;
+        spectrel_compute_spectrum_power_db(s, n, power_db);
+        if (f->encoding == SPECTREL_ENCODING_Q8)
+        {
+            spectrel_quantise_u8(
+                power_db, M, &header, record + sizeof(header));
+        }
+        else
+        {
+            spectrel_quantise_u16(
+                power_db, M, &header, (uint16_t *)(record + sizeof(header)));
+        }
+        memcpy(record, &header, sizeof(header));
+    }
+
+    if (f->writer)
+    {
+        is_written = is_written && spectrel_commit_writes(f->writer) == 0;
+    }
+    else if (fwrite(block, spectrum_size, N, f->file) != N)
+    {
+        spectrel_print_error("fwrite failed: %s", f->path);
+        is_written = false;
+    }
+    if (is_block_on_heap)
+        free(block);
+    block = NULL;
+    if (is_power_db_on_heap)
+        free(power_db);
+    power_db = NULL;
+    spectrel_rewind_arena(s->arena, used);
+    if (!is_written)
+    {
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN, N * spectrum_size);
+    return SPECTREL_SUCCESS;
+}
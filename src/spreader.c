@@ -0,0 +1,616 @@
+#include "spreader.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "sppyramid.h"
+#include "spquant.h"
+#include "sptimes.h"
+
+#include <complex.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct spectrel_reader_t
+{
+    int fd;
+    void *data;
+    size_t num_bytes;
+    const uint8_t *spectrums; // The first spectrum, after any header.
+    spectrel_encoding_t encoding;
+    size_t decimation;
+    bool is_real; // Whether spectrums hold only the non-negative frequencies.
+    double sample_rate; // From the timestamp file, or zero without one.
+    size_t window_hop;  // From the timestamp file, or zero without one.
+    spectrel_times_record_t *records; // The records of the timestamp file.
+    size_t *record_starts; // The index of the first spectrum in each record.
+    size_t num_records;
+    size_t num_spectrums;
+    size_t num_samples_per_spectrum;
+    size_t spectrum_size;
+    float *scratch;
+};
+
+void spectrel_close_reader(spectrel_reader reader)
+{
+    if (reader)
+    {
+        if (reader->data)
+        {
+            munmap(reader->data, reader->num_bytes);
+            reader->data = NULL;
+        }
+        if (reader->fd >= 0)
+        {
+            close(reader->fd);
+            reader->fd = -1;
+        }
+        if (reader->scratch)
+        {
+            free(reader->scratch);
+            reader->scratch = NULL;
+        }
+        if (reader->records)
+        {
+            free(reader->records);
+            reader->records = NULL;
+        }
+        if (reader->record_starts)
+        {
+            free(reader->record_starts);
+            reader->record_starts = NULL;
+        }
+        free(reader);
+    }
+}
+
+static size_t spectrel_get_spectrum_size(const spectrel_encoding_t encoding,
+                                         const size_t num_samples_per_spectrum)
+{
+    switch (encoding)
+    {
+    case SPECTREL_ENCODING_CF64:
+        return sizeof(fftw_complex) * num_samples_per_spectrum;
+    case SPECTREL_ENCODING_PYRAMID:
+        return 2 * sizeof(float) * num_samples_per_spectrum;
+    default:
+        return spectrel_get_quantised_spectrum_size(encoding,
+                                                    num_samples_per_spectrum);
+    }
+}
+
+// Pyramid levels are named <path>.p<k>.
+static bool spectrel_is_pyramid_extension(const char *extension)
+{
+    if (extension[0] != 'p' || extension[1] == '\0')
+    {
+        return false;
+    }
+    for (const char *c = extension + 1; *c != '\0'; c++)
+    {
+        if (!isdigit((unsigned char)*c))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read the header of a pyramid level, which describes its spectrums.
+static int spectrel_read_pyramid_header(spectrel_reader reader)
+{
+    spectrel_pyramid_header_t header;
+    if (pread(reader->fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic,
+               SPECTREL_PYRAMID_MAGIC,
+               sizeof(SPECTREL_PYRAMID_MAGIC)) != 0)
+    {
+        spectrel_print_error("Invalid pyramid header");
+        return SPECTREL_FAILURE;
+    }
+    reader->decimation = header.decimation;
+    reader->num_samples_per_spectrum = header.num_samples_per_spectrum;
+    return SPECTREL_SUCCESS;
+}
+
+// Read the timestamp file of a recording, <path>.times, along with whether
+// its input was real-valued. Recordings without one are taken to be of
+// complex-valued inputs, with unknown times.
+static int spectrel_read_times(spectrel_reader reader,
+                               const char *path,
+                               bool *is_real)
+{
+    *is_real = false;
+    size_t num_chars_path = strlen(path) + strlen(".times") + 1;
+    char *times_path = malloc(num_chars_path);
+    if (!times_path)
+    {
+        spectrel_print_error("malloc failed: path");
+        return SPECTREL_FAILURE;
+    }
+    snprintf(times_path, num_chars_path, "%s.times", path);
+    FILE *file = fopen(times_path, "rb");
+    free(times_path);
+    times_path = NULL;
+    if (!file)
+    {
+        return SPECTREL_SUCCESS;
+    }
+
+    spectrel_times_header_t header;
+    bool is_valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                    memcmp(header.magic,
+                           SPECTREL_TIMES_MAGIC,
+                           sizeof(SPECTREL_TIMES_MAGIC)) == 0;
+    struct stat st;
+    is_valid = is_valid && fstat(fileno(file), &st) == 0;
+    if (!is_valid)
+    {
+        fclose(file);
+        spectrel_print_error("Invalid timestamp header: %s.times", path);
+        return SPECTREL_FAILURE;
+    }
+    *is_real = header.is_real != 0;
+    reader->sample_rate = header.sample_rate;
+    reader->window_hop = header.window_hop;
+
+    // Only complete records are read, since the last may still be being
+    // written.
+    size_t num_records =
+        ((size_t)st.st_size - sizeof(header)) / sizeof(*reader->records);
+    if (num_records == 0)
+    {
+        fclose(file);
+        return SPECTREL_SUCCESS;
+    }
+    reader->records = malloc(sizeof(*reader->records) * num_records);
+    reader->record_starts =
+        malloc(sizeof(*reader->record_starts) * num_records);
+    if (!reader->records || !reader->record_starts)
+    {
+        fclose(file);
+        spectrel_print_error("malloc failed: records");
+        return SPECTREL_FAILURE;
+    }
+    reader->num_records =
+        fread(reader->records, sizeof(*reader->records), num_records, file);
+    fclose(file);
+    size_t start = 0;
+    for (size_t k = 0; k < reader->num_records; k++)
+    {
+        reader->record_starts[k] = start;
+        start += reader->records[k].num_spectrums;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_reader spectrel_open_reader(const char *path,
+                                     const size_t window_size)
+{
+    // Infer the encoding from the file extension.
+    const char *extension = strrchr(path, '.');
+    spectrel_encoding_t encoding;
+    if (extension && spectrel_is_pyramid_extension(extension + 1))
+    {
+        encoding = SPECTREL_ENCODING_PYRAMID;
+    }
+    else if (!extension ||
+             spectrel_parse_encoding(extension + 1, &encoding) != 0)
+    {
+        spectrel_print_error("Could not infer encoding: %s", path);
+        return NULL;
+    }
+
+    // Prepare reader structure with safe initial values.
+    spectrel_reader reader = malloc(sizeof(*reader));
+    if (!reader)
+    {
+        spectrel_print_error("malloc failed: reader");
+        return NULL;
+    }
+    reader->fd = -1;
+    reader->data = NULL;
+    reader->num_bytes = 0;
+    reader->spectrums = NULL;
+    reader->encoding = encoding;
+    reader->decimation = 1;
+    reader->is_real = false;
+    reader->sample_rate = 0;
+    reader->window_hop = 0;
+    reader->records = NULL;
+    reader->record_starts = NULL;
+    reader->num_records = 0;
+    reader->num_samples_per_spectrum = window_size;
+    reader->scratch = NULL;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("open failed: %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t header_size = 0;
+    if (encoding == SPECTREL_ENCODING_PYRAMID)
+    {
+        if (spectrel_read_pyramid_header(reader) != 0)
+        {
+            spectrel_close_reader(reader);
+            return NULL;
+        }
+        header_size = sizeof(spectrel_pyramid_header_t);
+
+        // Pyramid levels share the timestamp file of the recording they were
+        // made from, whose path is theirs without the level extension.
+        char *base_path = strndup(path, (size_t)(extension - path));
+        bool is_real;
+        if (!base_path)
+        {
+            spectrel_close_reader(reader);
+            spectrel_print_error("malloc failed: path");
+            return NULL;
+        }
+        int status = spectrel_read_times(reader, base_path, &is_real);
+        free(base_path);
+        base_path = NULL;
+        if (status != 0)
+        {
+            spectrel_close_reader(reader);
+            return NULL;
+        }
+    }
+    else
+    {
+        // Recordings of real-valued inputs hold half spectrums.
+        if (spectrel_read_times(reader, path, &reader->is_real) != 0)
+        {
+            spectrel_close_reader(reader);
+            return NULL;
+        }
+        if (reader->is_real && window_size > 0)
+        {
+            reader->num_samples_per_spectrum =
+                spectrel_get_num_bins(window_size, true);
+        }
+    }
+
+    size_t M = reader->num_samples_per_spectrum;
+    if (M < 1)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("Number of samples per spectrum must be at least "
+                             "one");
+        return NULL;
+    }
+    reader->spectrum_size = spectrel_get_spectrum_size(encoding, M);
+    reader->scratch = malloc(sizeof(*reader->scratch) * M);
+    if (!reader->scratch)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("malloc failed: scratch");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("fstat failed: %s", strerror(errno));
+        return NULL;
+    }
+    size_t num_bytes = (size_t)st.st_size;
+    reader->num_spectrums = num_bytes > header_size
+                                ? (num_bytes - header_size) /
+                                      reader->spectrum_size
+                                : 0;
+    if (reader->num_spectrums == 0)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("No complete spectrums in %s", path);
+        return NULL;
+    }
+
+    // Map only the complete spectrums. Pages are faulted in as they are read.
+    reader->num_bytes =
+        header_size + reader->num_spectrums * reader->spectrum_size;
+    void *data =
+        mmap(NULL, reader->num_bytes, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        spectrel_close_reader(reader);
+        spectrel_print_error("mmap failed: %s", strerror(errno));
+        return NULL;
+    }
+    reader->data = data;
+    reader->spectrums = (const uint8_t *)data + header_size;
+    return reader;
+}
+
+size_t spectrel_get_num_spectrums(spectrel_reader reader)
+{
+    return reader->num_spectrums;
+}
+
+size_t spectrel_get_num_samples_per_spectrum(spectrel_reader reader)
+{
+    return reader->num_samples_per_spectrum;
+}
+
+spectrel_encoding_t spectrel_get_reader_encoding(spectrel_reader reader)
+{
+    return reader->encoding;
+}
+
+size_t spectrel_get_reader_decimation(spectrel_reader reader)
+{
+    return reader->decimation;
+}
+
+bool spectrel_is_reader_real(spectrel_reader reader)
+{
+    return reader->is_real;
+}
+
+double spectrel_get_reader_sample_rate(spectrel_reader reader)
+{
+    return reader->sample_rate;
+}
+
+size_t spectrel_get_reader_window_hop(spectrel_reader reader)
+{
+    return reader->window_hop;
+}
+
+bool spectrel_has_reader_times(spectrel_reader reader)
+{
+    return reader->num_records > 0 && reader->sample_rate > 0;
+}
+
+int64_t spectrel_get_reader_time(spectrel_reader reader, const size_t index)
+{
+    if (!spectrel_has_reader_times(reader))
+    {
+        return 0;
+    }
+
+    // Find the last record which starts at or before the spectrum, in the
+    // recording it was made from. Spectrums past the last complete record
+    // are timed as if they followed on from it.
+    size_t n = index * reader->decimation;
+    size_t lo = 0;
+    size_t hi = reader->num_records;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->record_starts[mid] <= n)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    const spectrel_times_record_t *record = &reader->records[lo];
+    size_t offset = n - reader->record_starts[lo];
+    return record->time + llround((double)(offset * reader->window_hop) *
+                                  1e9 / reader->sample_rate);
+}
+
+const void *spectrel_get_spectrum(spectrel_reader reader, const size_t index)
+{
+    if (index >= reader->num_spectrums)
+    {
+        return NULL;
+    }
+    return reader->spectrums + index * reader->spectrum_size;
+}
+
+// Decode a spectrum in order of increasing frequency. For pyramid levels,
+// the max log-power is decoded if requested, otherwise the mean.
+static int spectrel_decode_power_db(spectrel_reader reader,
+                                    const size_t index,
+                                    const bool use_max,
+                                    float *power_db)
+{
+    const uint8_t *spectrum = spectrel_get_spectrum(reader, index);
+    if (!spectrum)
+    {
+        spectrel_print_error("Spectrum index out of range: %zu", index);
+        return SPECTREL_FAILURE;
+    }
+
+    // Decode the spectrum in the order it is stored.
+    size_t M = reader->num_samples_per_spectrum;
+    float *decoded = reader->scratch;
+    spectrel_quantised_header_t header;
+    switch (reader->encoding)
+    {
+    case SPECTREL_ENCODING_CF64:
+        spectrel_compute_power_db((const fftw_complex *)spectrum, decoded, M);
+        break;
+    case SPECTREL_ENCODING_Q8:
+        memcpy(&header, spectrum, sizeof(header));
+        spectrel_dequantise_u8(
+            &header, spectrum + sizeof(header), M, decoded);
+        break;
+    case SPECTREL_ENCODING_Q16:
+        memcpy(&header, spectrum, sizeof(header));
+        spectrel_dequantise_u16(&header,
+                                (const uint16_t *)(spectrum + sizeof(header)),
+                                M,
+                                decoded);
+        break;
+    case SPECTREL_ENCODING_PYRAMID:
+        memcpy(decoded,
+               spectrum + (use_max ? sizeof(float) * M : 0),
+               sizeof(float) * M);
+        break;
+    default:
+        spectrel_print_error("Unrecognised encoding: %d", reader->encoding);
+        return SPECTREL_FAILURE;
+    }
+
+    // The half spectrums of real-valued inputs are already in order of
+    // increasing frequency.
+    if (reader->is_real)
+    {
+        memcpy(power_db, decoded, sizeof(float) * M);
+        return SPECTREL_SUCCESS;
+    }
+
+    // Rotate the negative frequencies to the front, so that the samples are in
+    // order of increasing frequency.
+    size_t num_positive = M / 2;
+    size_t num_negative = M - num_positive;
+    memcpy(power_db, decoded + num_positive, sizeof(float) * num_negative);
+    memcpy(power_db + num_negative, decoded, sizeof(float) * num_positive);
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_read_power_db(spectrel_reader reader,
+                           const size_t index,
+                           float *power_db)
+{
+    return spectrel_decode_power_db(reader, index, false, power_db);
+}
+
+// Reduce the samples [start, end) to a single value.
+static float spectrel_pool(const float *values,
+                           const size_t start,
+                           const size_t end,
+                           const spectrel_preview_mode_t mode)
+{
+    float result = values[start];
+    switch (mode)
+    {
+    case SPECTREL_PREVIEW_MEAN:
+        for (size_t n = start + 1; n < end; n++)
+        {
+            result += values[n];
+        }
+        return result / (float)(end - start);
+    case SPECTREL_PREVIEW_MAX:
+        for (size_t n = start + 1; n < end; n++)
+        {
+            result = values[n] > result ? values[n] : result;
+        }
+        return result;
+    default:
+        return result;
+    }
+}
+
+int spectrel_read_preview(spectrel_reader reader,
+                          const spectrel_slice_t *slice,
+                          float *preview)
+{
+    size_t M = reader->num_samples_per_spectrum;
+    if (slice->start_spectrum >= slice->end_spectrum ||
+        slice->end_spectrum > reader->num_spectrums)
+    {
+        spectrel_print_error("Invalid spectrum range: [%zu, %zu)",
+                             slice->start_spectrum,
+                             slice->end_spectrum);
+        return SPECTREL_FAILURE;
+    }
+    if (slice->start_sample >= slice->end_sample || slice->end_sample > M)
+    {
+        spectrel_print_error("Invalid sample range: [%zu, %zu)",
+                             slice->start_sample,
+                             slice->end_sample);
+        return SPECTREL_FAILURE;
+    }
+    if (slice->num_rows < 1 || slice->num_columns < 1)
+    {
+        spectrel_print_error("Preview must have at least one row and column");
+        return SPECTREL_FAILURE;
+    }
+
+    float *power_db = malloc(sizeof(*power_db) * M);
+    if (!power_db)
+    {
+        spectrel_print_error("malloc failed: power_db");
+        return SPECTREL_FAILURE;
+    }
+
+    // Sampling jumps between spectrums, pooling sweeps through them in order.
+    madvise(reader->data,
+            reader->num_bytes,
+            slice->mode == SPECTREL_PREVIEW_SAMPLE ? MADV_RANDOM
+                                                   : MADV_SEQUENTIAL);
+
+    size_t num_spectrums = slice->end_spectrum - slice->start_spectrum;
+    size_t num_samples = slice->end_sample - slice->start_sample;
+    for (size_t i = 0; i < slice->num_rows; i++)
+    {
+        // The spectrums which fall in this row. Each row has at least one.
+        size_t first =
+            slice->start_spectrum + (i * num_spectrums) / slice->num_rows;
+        size_t last =
+            slice->start_spectrum + ((i + 1) * num_spectrums) / slice->num_rows;
+        if (last <= first || slice->mode == SPECTREL_PREVIEW_SAMPLE)
+        {
+            last = first + 1;
+        }
+
+        float *row = preview + i * slice->num_columns;
+        for (size_t n = first; n < last; n++)
+        {
+            if (spectrel_decode_power_db(reader,
+                                         n,
+                                         slice->mode == SPECTREL_PREVIEW_MAX,
+                                         power_db) != 0)
+            {
+                free(power_db);
+                power_db = NULL;
+                return SPECTREL_FAILURE;
+            }
+
+            for (size_t j = 0; j < slice->num_columns; j++)
+            {
+                size_t start = slice->start_sample +
+                               (j * num_samples) / slice->num_columns;
+                size_t end = slice->start_sample +
+                             ((j + 1) * num_samples) / slice->num_columns;
+                if (end <= start || slice->mode == SPECTREL_PREVIEW_SAMPLE)
+                {
+                    end = start + 1;
+                }
+                float value = spectrel_pool(power_db, start, end, slice->mode);
+
+                // Combine with the spectrums already seen in this row.
+                if (n == first)
+                {
+                    row[j] = value;
+                }
+                else if (slice->mode == SPECTREL_PREVIEW_MAX)
+                {
+                    row[j] = value > row[j] ? value : row[j];
+                }
+                else
+                {
+                    row[j] += value;
+                }
+            }
+        }
+
+        if (slice->mode == SPECTREL_PREVIEW_MEAN)
+        {
+            for (size_t j = 0; j < slice->num_columns; j++)
+            {
+                row[j] /= (float)(last - first);
+            }
+        }
+    }
+
+    free(power_db);
+    power_db = NULL;
+    return SPECTREL_SUCCESS;
+}
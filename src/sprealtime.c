@@ -0,0 +1,172 @@
+// For cpu_set_t and pthread_setaffinity_np.
+#define _GNU_SOURCE
+
+#include "sprealtime.h"
+#include "spconstants.h"
+#include "sperror.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The CPUs background threads are moved onto, if any were given.
+static cpu_set_t spectrel_background_cpus;
+static bool spectrel_has_background_cpus = false;
+
+// Parse a single CPU number, returning a pointer to the character after it.
+static const char *spectrel_parse_cpu(const char *s, long *cpu)
+{
+    char *endptr;
+    *cpu = strtol(s, &endptr, 10);
+    return endptr == s ? NULL : endptr;
+}
+
+// Parse a list of CPUs, comma-separated CPUs or ranges of CPUs.
+static int spectrel_parse_cpus(const char *cpus, cpu_set_t *set)
+{
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    CPU_ZERO(set);
+    const char *s = cpus;
+    while (*s != '\0')
+    {
+        long first, last;
+        s = spectrel_parse_cpu(s, &first);
+        if (s && *s == '-')
+            s = spectrel_parse_cpu(s + 1, &last);
+        else
+            last = first;
+        if (!s || (*s != ',' && *s != '\0') || first < 0 || last < first)
+        {
+            spectrel_print_error("Could not parse %s as a list of CPUs", cpus);
+            return SPECTREL_FAILURE;
+        }
+        if (last >= num_cpus || last >= CPU_SETSIZE)
+        {
+            spectrel_print_error("No such CPU: %ld", last);
+            return SPECTREL_FAILURE;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+        if (*s == ',')
+            s++;
+    }
+    if (CPU_COUNT(set) == 0)
+    {
+        spectrel_print_error("Could not parse %s as a list of CPUs", cpus);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_check_cpus(const char *cpus)
+{
+    cpu_set_t set;
+    return spectrel_parse_cpus(cpus, &set);
+}
+
+int spectrel_pin_thread(const char *cpus)
+{
+    cpu_set_t set;
+    if (spectrel_parse_cpus(cpus, &set) != 0)
+        return SPECTREL_FAILURE;
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0)
+    {
+        spectrel_print_error("pthread_setaffinity_np failed: %s",
+                             strerror(error));
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_set_realtime_priority(const int priority)
+{
+    int min = sched_get_priority_min(SCHED_FIFO);
+    int max = sched_get_priority_max(SCHED_FIFO);
+    if (priority < min || priority > max)
+    {
+        spectrel_print_error(
+            "Real-time priority must be from %d to %d", min, max);
+        return SPECTREL_FAILURE;
+    }
+    struct sched_param param = {.sched_priority = priority};
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+    {
+        spectrel_print_error("pthread_setschedparam failed: %s",
+                             strerror(error));
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_lock_memory(void)
+{
+    // Large allocations are served from the heap rather than by mmap, and the
+    // heap is never trimmed, so that memory stays locked once it has been
+    // faulted in.
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        spectrel_print_error("mlockall failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+void spectrel_prefault_stack(void)
+{
+    volatile char stack[SPECTREL_PREFAULT_STACK_SIZE];
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page_size)
+        stack[i] = 0;
+}
+
+int spectrel_set_background_cpus(const char *cpus)
+{
+    if (!cpus)
+    {
+        if (sched_getaffinity(
+                0, sizeof(spectrel_background_cpus), &spectrel_background_cpus)
+            != 0)
+        {
+            spectrel_print_error("sched_getaffinity failed: %s",
+                                 strerror(errno));
+            return SPECTREL_FAILURE;
+        }
+    }
+    else if (spectrel_parse_cpus(cpus, &spectrel_background_cpus) != 0)
+    {
+        return SPECTREL_FAILURE;
+    }
+    spectrel_has_background_cpus = true;
+    return SPECTREL_SUCCESS;
+}
+
+void spectrel_demote_thread(pthread_t thread)
+{
+    // Threads inherit the policy of the thread which started them.
+    struct sched_param param = {.sched_priority = 0};
+    int error = pthread_setschedparam(thread, SCHED_OTHER, &param);
+    if (error != 0)
+    {
+        spectrel_print_error("pthread_setschedparam failed: %s",
+                             strerror(error));
+    }
+    if (!spectrel_has_background_cpus)
+        return;
+    error = pthread_setaffinity_np(
+        thread, sizeof(spectrel_background_cpus), &spectrel_background_cpus);
+    if (error != 0)
+    {
+        spectrel_print_error("pthread_setaffinity_np failed: %s",
+                             strerror(error));
+    }
+}
@@ -2,25 +2,95 @@
 #include "spreceiver.h"
 #include "spconstants.h"
 #include "sperror.h"
+#include "spmetrics.h"
 #include "spsignal.h"
 
 #include <SoapySDR/Constants.h>
 #include <SoapySDR/Device.h>
+#include <SoapySDR/Errors.h>
 #include <SoapySDR/Formats.h>
 
 #include <complex.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 struct spectrel_receiver_t
 {
     SoapySDRDevice *device;
     SoapySDRStream *rx_stream;
-    char *format;
+    spectrel_format_t format; // The format samples are streamed in.
+    double scale;             // Converts streamed samples to sample values.
+
+    // The times of samples are anchored to the system clock when the stream
+    // is activated, unless the hardware clock already reads UTC. Without a
+    // hardware clock, samples are counted from the anchor instead.
+    int64_t utc_anchor;            // The system time at the anchor [ns].
+    long long hardware_anchor;     // The hardware time at the anchor [ns].
+    bool is_hardware_utc;          // Whether the hardware clock reads UTC.
+    int64_t count_anchor;          // The system time counting started [ns].
+    uint64_t num_samples_anchored; // Samples read since counting started.
+    double sample_rate;
 };
 
+static int64_t spectrel_get_utc_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void spectrel_anchor_time(spectrel_receiver receiver)
+{
+    receiver->utc_anchor = spectrel_get_utc_ns();
+    receiver->hardware_anchor = 0;
+    if (SoapySDRDevice_hasHardwareTime(receiver->device, NULL))
+    {
+        receiver->hardware_anchor =
+            SoapySDRDevice_getHardwareTime(receiver->device, NULL);
+    }
+
+    // A hardware clock set to UTC (say, disciplined by GPS) is trusted over
+    // the system clock. Otherwise, it only measures time since the anchor.
+    receiver->is_hardware_utc =
+        llabs(receiver->hardware_anchor - receiver->utc_anchor) <
+        (long long)SPECTREL_SECONDS_PER_DAY * 1000000000;
+    receiver->count_anchor = receiver->utc_anchor;
+    receiver->num_samples_anchored = 0;
+}
+
+// Get the time of the next sample read, given the time the device attached
+// to it (if any).
+static int64_t spectrel_get_sample_time(spectrel_receiver receiver,
+                                        const int flags,
+                                        const long long time_ns)
+{
+    if (flags & SOAPY_SDR_HAS_TIME)
+    {
+        if (receiver->is_hardware_utc)
+        {
+            return time_ns;
+        }
+        return receiver->utc_anchor + (time_ns - receiver->hardware_anchor);
+    }
+    return receiver->count_anchor +
+           llround(receiver->num_samples_anchored * 1e9 /
+                   receiver->sample_rate);
+}
+
+// Dropped samples can't be counted, so counting starts again, as close as
+// possible to the next sample read. The hardware clock is unaffected.
+static void spectrel_handle_overflow(spectrel_receiver receiver)
+{
+    spectrel_add_counter(SPECTREL_COUNTER_OVERFLOWS, 1);
+    receiver->count_anchor = spectrel_get_utc_ns();
+    receiver->num_samples_anchored = 0;
+}
+
 int spectrel_free_receiver(spectrel_receiver receiver)
 {
     if (!receiver)
@@ -28,11 +98,6 @@ int spectrel_free_receiver(spectrel_receiver receiver)
         return SPECTREL_SUCCESS;
     }
 
-    if (receiver->format)
-    {
-        free(receiver->format);
-        receiver->format = NULL;
-    }
     if (receiver->device && receiver->rx_stream)
     {
         if (SoapySDRDevice_closeStream(receiver->device, receiver->rx_stream) !=
@@ -86,6 +151,51 @@ static bool is_value_in_range(double value, const SoapySDRRange *range)
     return value >= range->minimum && value <= range->maximum;
 }
 
+int spectrel_set_frequency(spectrel_receiver receiver, const double frequency)
+{
+    size_t range_size = 0;
+    SoapySDRRange *frequency_ranges = SoapySDRDevice_getFrequencyRange(
+        receiver->device, SOAPY_SDR_RX, 0, &range_size);
+    if (!frequency_ranges || range_size == 0)
+    {
+        spectrel_print_error("getFrequencyRange failed: %s",
+                             SoapySDRDevice_lastError());
+        return SPECTREL_FAILURE;
+    }
+    if (!is_value_in_ranges(frequency, frequency_ranges, range_size))
+    {
+        SoapySDR_free(frequency_ranges);
+        spectrel_print_error("Invalid frequency: %lf [Hz]", frequency);
+        return SPECTREL_FAILURE;
+    }
+    SoapySDR_free(frequency_ranges);
+    if (SoapySDRDevice_setFrequency(
+            receiver->device, SOAPY_SDR_RX, 0, frequency, NULL) != 0)
+    {
+        spectrel_print_error("setFrequency failed: %s",
+                             SoapySDRDevice_lastError());
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_set_gain(spectrel_receiver receiver, const double gain)
+{
+    SoapySDRRange gain_range =
+        SoapySDRDevice_getGainRange(receiver->device, SOAPY_SDR_RX, 0);
+    if (!is_value_in_range(gain, &gain_range))
+    {
+        spectrel_print_error("Invalid gain: %lf [dB]", gain);
+        return SPECTREL_FAILURE;
+    }
+    if (SoapySDRDevice_setGain(receiver->device, SOAPY_SDR_RX, 0, gain) != 0)
+    {
+        spectrel_print_error("setGain failed: %s", SoapySDRDevice_lastError());
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
 spectrel_receiver spectrel_make_receiver(const char *driver,
                                          spectrel_receiver_params_t *params)
 {
@@ -101,7 +211,7 @@ spectrel_receiver spectrel_make_receiver(const char *driver,
     receiver->rx_stream = NULL;
 
     // Make the soapy device for the receiver.
-    SoapySDRKwargs args = {};
+    SoapySDRKwargs args = {0};
     if (SoapySDRKwargs_set(&args, "driver", driver) != 0)
     {
         spectrel_print_error("set fail");
@@ -123,32 +233,10 @@ spectrel_receiver spectrel_make_receiver(const char *driver,
     size_t range_size = 0;
 
     // Set the frequency, first checking it's in range.
-    SoapySDRRange *frequency_ranges = SoapySDRDevice_getFrequencyRange(
-        receiver->device, SOAPY_SDR_RX, 0, &range_size);
-    if (!frequency_ranges || range_size == 0)
-    {
-        spectrel_free_receiver(receiver);
-        receiver = NULL;
-        spectrel_print_error("getFrequencyRange failed: %s",
-                             SoapySDRDevice_lastError());
-        return NULL;
-    }
-    if (!is_value_in_ranges(params->frequency, frequency_ranges, range_size))
-    {
-        SoapySDR_free(frequency_ranges);
-        spectrel_free_receiver(receiver);
-        receiver = NULL;
-        spectrel_print_error("Invalid frequency: %lf [Hz]", params->frequency);
-        return NULL;
-    }
-    SoapySDR_free(frequency_ranges);
-    if (SoapySDRDevice_setFrequency(
-            receiver->device, SOAPY_SDR_RX, 0, params->frequency, NULL) != 0)
+    if (spectrel_set_frequency(receiver, params->frequency) != 0)
     {
         spectrel_free_receiver(receiver);
         receiver = NULL;
-        spectrel_print_error("setFrequency failed: %s",
-                             SoapySDRDevice_lastError());
         return NULL;
     }
 
@@ -218,43 +306,39 @@ spectrel_receiver spectrel_make_receiver(const char *driver,
     }
 
     // Set the gain, first checking it's in range.
-    SoapySDRRange gain_range =
-        SoapySDRDevice_getGainRange(receiver->device, SOAPY_SDR_RX, 0);
-    if (!is_value_in_range(params->gain, &gain_range))
-    {
-        spectrel_free_receiver(receiver);
-        receiver = NULL;
-        spectrel_print_error("Invalid gain: %lf [dB]", params->gain);
-        return NULL;
-    }
-    if (SoapySDRDevice_setGain(
-            receiver->device, SOAPY_SDR_RX, 0, params->gain) != 0)
+    if (spectrel_set_gain(receiver, params->gain) != 0)
     {
         spectrel_free_receiver(receiver);
         receiver = NULL;
-        spectrel_print_error("setGain failed: %s", SoapySDRDevice_lastError());
         return NULL;
     }
 
-    // Infer the format from the driver.
-    char *format;
-    if (strcmp(driver, "rtlsdr") == 0)
-    {
-        format = "CF32";
-    }
-    else if (strcmp(driver, "hackrf") == 0)
+    // Stream samples in the native format of the device, so that the driver
+    // doesn't convert them. They are converted as they are windowed instead.
+    // Fall back to the default format if the native format isn't supported.
+    double full_scale = 0;
+    char *native_format = SoapySDRDevice_getNativeStreamFormat(
+        receiver->device, SOAPY_SDR_RX, 0, &full_scale);
+    if (native_format &&
+        spectrel_parse_format(native_format, &receiver->format) == 0)
     {
-        format = "CF64";
+        receiver->scale = full_scale > 0 ? 1 / full_scale : 1;
     }
     else
     {
-        format = SPECTREL_DEFAULT_FORMAT;
+        spectrel_parse_format(SPECTREL_DEFAULT_FORMAT, &receiver->format);
+        receiver->scale = 1;
     }
-    receiver->format = strdup(format);
+    free(native_format);
 
     // Set up the stream.
-    receiver->rx_stream = SoapySDRDevice_setupStream(
-        receiver->device, SOAPY_SDR_RX, receiver->format, NULL, 0, NULL);
+    receiver->rx_stream =
+        SoapySDRDevice_setupStream(receiver->device,
+                                   SOAPY_SDR_RX,
+                                   spectrel_get_format_name(receiver->format),
+                                   NULL,
+                                   0,
+                                   NULL);
     if (!receiver->rx_stream)
     {
         spectrel_free_receiver(receiver);
@@ -266,6 +350,14 @@ spectrel_receiver spectrel_make_receiver(const char *driver,
     return receiver;
 }
 
+spectrel_signal_t *spectrel_make_stream_buffer(spectrel_receiver receiver,
+                                               const size_t num_samples,
+                                               spectrel_arena arena)
+{
+    return spectrel_make_native_signal(
+        num_samples, receiver->format, receiver->scale, arena);
+}
+
 int spectrel_get_parameters(spectrel_receiver receiver,
                             spectrel_receiver_params_t *params)
 {
@@ -292,6 +384,9 @@ int spectrel_activate_stream(spectrel_receiver receiver)
                              SoapySDRDevice_lastError());
         return SPECTREL_FAILURE;
     }
+    receiver->sample_rate =
+        SoapySDRDevice_getSampleRate(receiver->device, SOAPY_SDR_RX, 0);
+    spectrel_anchor_time(receiver);
     return SPECTREL_SUCCESS;
 }
 
@@ -307,26 +402,27 @@ int spectrel_deactivate_stream(spectrel_receiver receiver)
     return SPECTREL_SUCCESS;
 }
 
-int spectrel_read_stream(spectrel_receiver receiver, spectrel_signal_t *buffer)
+int spectrel_read_stream(spectrel_receiver receiver,
+                         spectrel_signal_t *buffer,
+                         int64_t *time)
 {
-    int num_samples_read = 0;
+    size_t num_samples_read = 0;
     void *buffers[] = {NULL};
     int flags;
     long long timeNs;
-    int ret;
 
-    // The buffer passed in by the caller is compatable with the format
-    // SOAPY_SDR_CF64, but not SOAPY_SDR_CF32
-    bool needs_conversion = strcmp(receiver->format, SOAPY_SDR_CF32) == 0;
+    // Samples are read as they are streamed, without conversion.
+    if (buffer->format != receiver->format)
+    {
+        spectrel_print_error("Buffer format must match the stream format");
+        return SPECTREL_FAILURE;
+    }
+    size_t sample_size = spectrel_get_sample_size(buffer->format);
 
-    if (!needs_conversion)
+    while (num_samples_read < buffer->num_samples)
     {
-        // If the buffer format is compatable with the device format, fill it
-        // directly.
-        while (num_samples_read < buffer->num_samples)
-        {
-            buffers[0] = (void *)(buffer->samples + num_samples_read);
-            ret = SoapySDRDevice_readStream(receiver->device,
+        buffers[0] = (char *)buffer->data + num_samples_read * sample_size;
+        int ret = SoapySDRDevice_readStream(receiver->device,
                                             receiver->rx_stream,
                                             buffers,
                                             buffer->num_samples -
@@ -335,69 +431,39 @@ int spectrel_read_stream(spectrel_receiver receiver, spectrel_signal_t *buffer)
                                             &timeNs,
                                             SPECTREL_TIMEOUT);
 
-            if (ret < 1)
-            {
-                spectrel_print_error("readStream failed: %s\n",
-                                     SoapySDRDevice_lastError());
-                return SPECTREL_FAILURE;
-            }
-            num_samples_read += ret;
-        }
-        return SPECTREL_SUCCESS;
-    }
-    else
-    {
-        // Otherwise, fill an intermediate buffer with a compatible format.
-        complex float *buffer_cf32 =
-            malloc(buffer->num_samples * sizeof(complex float));
-        if (!buffer_cf32)
+        if (ret == SOAPY_SDR_OVERFLOW)
         {
-            spectrel_print_error("malloc failed: buffer_cf32");
-            return SPECTREL_FAILURE;
+            // Samples were dropped, but the stream carries on. Start the
+            // buffer again, so that it never spans the gap and every sample
+            // in it follows from the time of the first.
+            spectrel_handle_overflow(receiver);
+            num_samples_read = 0;
+            continue;
         }
-
-        while (num_samples_read < buffer->num_samples)
+        if (ret < 1)
         {
-            buffers[0] = buffer_cf32 + num_samples_read;
-            int ret = SoapySDRDevice_readStream(receiver->device,
-                                                receiver->rx_stream,
-                                                buffers,
-                                                buffer->num_samples -
-                                                    num_samples_read,
-                                                &flags,
-                                                &timeNs,
-                                                SPECTREL_TIMEOUT);
-
-            if (ret < 1)
-            {
-                const char *error = SoapySDRDevice_lastError();
-                spectrel_print_error("readStream failed: %s\n", error);
-                free(buffer_cf32);
-                buffer_cf32 = NULL;
-                return SPECTREL_FAILURE;
-            }
-            num_samples_read += ret;
+            spectrel_print_error("readStream failed: %s\n",
+                                 SoapySDRDevice_lastError());
+            return SPECTREL_FAILURE;
         }
-
-        // Finally, type cast and copy the samples into the buffer passed in by
-        // the caller.
-        for (size_t n = 0; n < buffer->num_samples; n++)
+        if (num_samples_read == 0)
         {
-            buffer->samples[n] = (complex double)buffer_cf32[n];
+            *time = spectrel_get_sample_time(receiver, flags, timeNs);
         }
-        free(buffer_cf32);
-        buffer_cf32 = NULL;
-        return SPECTREL_SUCCESS;
+        num_samples_read += ret;
+        receiver->num_samples_anchored += ret;
     }
+    spectrel_add_counter(SPECTREL_COUNTER_SAMPLES_READ, num_samples_read);
+    return SPECTREL_SUCCESS;
 }
 
 void spectrel_describe_receiver(spectrel_receiver receiver)
 {
-    spectrel_receiver_params_t params = {};
+    spectrel_receiver_params_t params = {0};
     spectrel_get_parameters(receiver, &params);
     printf("Frequency: %.4lf [Hz]\n", params.frequency);
     printf("Sample rate: %.4lf [Hz]\n", params.sample_rate);
     printf("Bandwidth: %.4lf [Hz]\n", params.bandwidth);
     printf("Gain: %.4lf [dB]\n", params.gain);
-    printf("Format: %s\n", receiver->format);
+    printf("Format: %s\n", spectrel_get_format_name(receiver->format));
 }
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "sprfi.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int spectrel_parse_rfi_action(const char *name, spectrel_rfi_action_t *action)
+{
+    if (strcmp(name, "flag") == 0)
+    {
+        *action = SPECTREL_RFI_FLAG;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcmp(name, "zero") == 0)
+    {
+        *action = SPECTREL_RFI_ZERO;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcmp(name, "interpolate") == 0)
+    {
+        *action = SPECTREL_RFI_INTERPOLATE;
+        return SPECTREL_SUCCESS;
+    }
+    spectrel_print_error("Unrecognised RFI action: %s", name);
+    return SPECTREL_FAILURE;
+}
+
+const char *spectrel_get_rfi_action_name(const spectrel_rfi_action_t action)
+{
+    switch (action)
+    {
+    case SPECTREL_RFI_FLAG:
+        return "flag";
+    case SPECTREL_RFI_ZERO:
+        return "zero";
+    case SPECTREL_RFI_INTERPOLATE:
+        return "interpolate";
+    default:
+        return NULL;
+    }
+}
+
+// How a flagged sample is interpolated, from the nearest samples either side
+// in frequency which are not flagged.
+typedef struct
+{
+    size_t index;   // The flagged sample.
+    size_t lower;   // The nearest sample below which is not flagged.
+    size_t upper;   // The nearest sample above which is not flagged.
+    double weight;  // The weight of the upper sample.
+    bool has_lower; // Whether there is a sample below which is not flagged.
+    bool has_upper; // Whether there is a sample above which is not flagged.
+} spectrel_flagged_t;
+
+struct spectrel_rfi_t
+{
+    FILE *file;
+    char *path;
+    size_t num_samples_per_spectrum;
+    bool is_real;
+    size_t num_spectrums_per_block;
+    double threshold;
+    spectrel_rfi_action_t action;
+    uint64_t num_spectrums; // The number of spectrums flagged so far.
+    size_t num_accumulated; // The number of spectrums in the current block.
+    double *power;
+    double *sum;         // The sum of the power of each sample in the block.
+    double *sum_squares; // The sum of the squared power of each sample.
+    uint8_t *mask;       // The packed mask of the last complete block.
+    spectrel_flagged_t *flagged; // The samples flagged in the last block.
+    size_t num_flagged;
+};
+
+void spectrel_free_rfi(spectrel_rfi rfi)
+{
+    if (rfi)
+    {
+        if (rfi->file)
+        {
+            fclose(rfi->file);
+            rfi->file = NULL;
+        }
+        if (rfi->path)
+        {
+            free(rfi->path);
+            rfi->path = NULL;
+        }
+        if (rfi->power)
+        {
+            free(rfi->power);
+            rfi->power = NULL;
+        }
+        if (rfi->sum)
+        {
+            free(rfi->sum);
+            rfi->sum = NULL;
+        }
+        if (rfi->sum_squares)
+        {
+            free(rfi->sum_squares);
+            rfi->sum_squares = NULL;
+        }
+        if (rfi->mask)
+        {
+            free(rfi->mask);
+            rfi->mask = NULL;
+        }
+        if (rfi->flagged)
+        {
+            free(rfi->flagged);
+            rfi->flagged = NULL;
+        }
+        free(rfi);
+    }
+}
+
+spectrel_rfi spectrel_make_rfi(const char *path,
+                               const size_t num_samples_per_spectrum,
+                               const bool is_real,
+                               const size_t num_spectrums_per_block,
+                               const double threshold,
+                               const spectrel_rfi_action_t action)
+{
+    if (num_spectrums_per_block < 2)
+    {
+        spectrel_print_error("RFI blocks must hold at least 2 spectrums");
+        return NULL;
+    }
+
+    // Prepare flagger structure with safe initial values.
+    spectrel_rfi rfi = calloc(1, sizeof(*rfi));
+    if (!rfi)
+    {
+        spectrel_print_error("malloc failed: rfi");
+        return NULL;
+    }
+    size_t M = num_samples_per_spectrum;
+    rfi->num_samples_per_spectrum = M;
+    rfi->is_real = is_real;
+    rfi->num_spectrums_per_block = num_spectrums_per_block;
+    rfi->threshold = threshold;
+    rfi->action = action;
+    rfi->power = malloc(sizeof(*rfi->power) * M);
+    rfi->sum = calloc(M, sizeof(*rfi->sum));
+    rfi->sum_squares = calloc(M, sizeof(*rfi->sum_squares));
+    rfi->mask = calloc((M + 7) / 8, sizeof(*rfi->mask));
+    rfi->flagged = malloc(sizeof(*rfi->flagged) * M);
+    if (!rfi->power || !rfi->sum || !rfi->sum_squares || !rfi->mask ||
+        !rfi->flagged)
+    {
+        spectrel_free_rfi(rfi);
+        spectrel_print_error("malloc failed: rfi buffers");
+        return NULL;
+    }
+
+    // Append the extension to the path of the spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".mask") + 1;
+    rfi->path = malloc(num_chars_path);
+    if (!rfi->path)
+    {
+        spectrel_free_rfi(rfi);
+        spectrel_print_error("malloc failed: path");
+        return NULL;
+    }
+    snprintf(rfi->path, num_chars_path, "%s.mask", path);
+
+    rfi->file = fopen(rfi->path, "wb");
+    if (!rfi->file)
+    {
+        spectrel_print_error("fopen failed: %s", rfi->path);
+        spectrel_free_rfi(rfi);
+        return NULL;
+    }
+
+    spectrel_mask_header_t header = {0};
+    memcpy(header.magic, SPECTREL_MASK_MAGIC, sizeof(SPECTREL_MASK_MAGIC));
+    header.num_samples_per_spectrum = M;
+    header.num_spectrums_per_block = num_spectrums_per_block;
+    header.threshold = threshold;
+    if (fwrite(&header, sizeof(header), 1, rfi->file) != 1)
+    {
+        spectrel_print_error("fwrite failed: %s", rfi->path);
+        spectrel_free_rfi(rfi);
+        return NULL;
+    }
+    return rfi;
+}
+
+// Whether a sample is flagged in a mask.
+static bool spectrel_is_flagged(const uint8_t *mask, const size_t m)
+{
+    return mask[m / 8] & (1u << (m % 8));
+}
+
+// The index of the sample at a position in order of increasing frequency. The
+// spectrums of complex-valued inputs start from DC, and wrap around to the
+// negative frequencies halfway through.
+static size_t spectrel_get_sample_index(const spectrel_rfi rfi,
+                                        const size_t position)
+{
+    size_t M = rfi->num_samples_per_spectrum;
+    return rfi->is_real ? position : (position + M - M / 2) % M;
+}
+
+// The position of a sample in order of increasing frequency.
+static size_t spectrel_get_sample_position(const spectrel_rfi rfi,
+                                           const size_t index)
+{
+    size_t M = rfi->num_samples_per_spectrum;
+    return rfi->is_real ? index : (index + M / 2) % M;
+}
+
+// Flag each sample whose spectral kurtosis over the block strays too far
+// from one, then write the mask and reset the sums for the next block.
+static int spectrel_finish_block(spectrel_rfi rfi)
+{
+    size_t M = rfi->num_samples_per_spectrum;
+    double N = (double)rfi->num_spectrums_per_block;
+
+    // The generalised estimator of Nita & Gary (2010), for spectrums which
+    // are not averaged, and its standard deviation for Gaussian noise.
+    double scale = (N + 1) / (N - 1);
+    double sigma = sqrt(4 * N * N / ((N - 1) * (N + 2) * (N + 3)));
+    double tolerance = rfi->threshold * sigma;
+
+    memset(rfi->mask, 0, (M + 7) / 8);
+    rfi->num_flagged = 0;
+    for (size_t m = 0; m < M; m++)
+    {
+        double s1 = rfi->sum[m];
+        if (s1 <= 0)
+            continue;
+        double kurtosis = scale * (N * rfi->sum_squares[m] / (s1 * s1) - 1);
+        if (fabs(kurtosis - 1) > tolerance)
+        {
+            rfi->mask[m / 8] |= (uint8_t)(1u << (m % 8));
+            rfi->flagged[rfi->num_flagged++].index = m;
+        }
+    }
+
+    // Find the samples each flagged sample is interpolated from, searching
+    // outwards in frequency.
+    for (size_t k = 0; k < rfi->num_flagged; k++)
+    {
+        spectrel_flagged_t *f = &rfi->flagged[k];
+        size_t position = spectrel_get_sample_position(rfi, f->index);
+        size_t lower = position;
+        while (lower > 0 &&
+               spectrel_is_flagged(rfi->mask,
+                                   spectrel_get_sample_index(rfi, lower)))
+            lower--;
+        size_t upper = position;
+        while (upper < M - 1 &&
+               spectrel_is_flagged(rfi->mask,
+                                   spectrel_get_sample_index(rfi, upper)))
+            upper++;
+        f->lower = spectrel_get_sample_index(rfi, lower);
+        f->upper = spectrel_get_sample_index(rfi, upper);
+        f->has_lower = !spectrel_is_flagged(rfi->mask, f->lower);
+        f->has_upper = !spectrel_is_flagged(rfi->mask, f->upper);
+        f->weight = f->has_lower && f->has_upper
+                        ? (double)(position - lower) / (double)(upper - lower)
+                        : (f->has_upper ? 1 : 0);
+    }
+
+    spectrel_mask_record_t record = {
+        .index = rfi->num_spectrums - rfi->num_spectrums_per_block,
+        .num_flagged = (uint32_t)rfi->num_flagged};
+    if (fwrite(&record, sizeof(record), 1, rfi->file) != 1 ||
+        fwrite(rfi->mask, 1, (M + 7) / 8, rfi->file) != (M + 7) / 8)
+    {
+        spectrel_print_error("fwrite failed: %s", rfi->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         sizeof(record) + (M + 7) / 8);
+    spectrel_set_gauge(SPECTREL_GAUGE_RFI_FLAGGED, (int64_t)rfi->num_flagged);
+
+    memset(rfi->sum, 0, sizeof(*rfi->sum) * M);
+    memset(rfi->sum_squares, 0, sizeof(*rfi->sum_squares) * M);
+    rfi->num_accumulated = 0;
+    return SPECTREL_SUCCESS;
+}
+
+// Set a sample of a spectrum, whatever the layout of the spectrogram.
+static void spectrel_scale_sample(spectrel_spectrogram_t *s,
+                                  const size_t offset,
+                                  const double power,
+                                  const double target)
+{
+    double *re, *im;
+    if (s->layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        re = (double *)&s->samples[offset];
+        im = re + 1;
+    }
+    else
+    {
+        re = &s->real[offset];
+        im = &s->imag[offset];
+    }
+
+    // Keep the phase of the sample, where it has one.
+    if (power > 0)
+    {
+        double factor = sqrt(target / power);
+        *re *= factor;
+        *im *= factor;
+    }
+    else
+    {
+        *re = sqrt(target);
+        *im = 0;
+    }
+}
+
+// Mask a spectrum, given the power of each of its samples.
+static void spectrel_mask_spectrum(spectrel_rfi rfi,
+                                   spectrel_spectrogram_t *s,
+                                   const size_t n,
+                                   const double *power)
+{
+    size_t M = rfi->num_samples_per_spectrum;
+    for (size_t k = 0; k < rfi->num_flagged; k++)
+    {
+        const spectrel_flagged_t *f = &rfi->flagged[k];
+        double target = 0;
+        if (rfi->action == SPECTREL_RFI_INTERPOLATE &&
+            (f->has_lower || f->has_upper))
+        {
+            double lower = f->has_lower ? power[f->lower] : power[f->upper];
+            double upper = f->has_upper ? power[f->upper] : power[f->lower];
+            target = (1 - f->weight) * lower + f->weight * upper;
+        }
+        spectrel_scale_sample(s, n * M + f->index, power[f->index], target);
+    }
+}
+
+int spectrel_flag_rfi(spectrel_rfi rfi, spectrel_spectrogram_t *s)
+{
+    size_t M = rfi->num_samples_per_spectrum;
+    if (s->num_samples_per_spectrum != M)
+    {
+        spectrel_print_error("Spectrogram does not match the RFI flagger");
+        return SPECTREL_FAILURE;
+    }
+
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        // Accumulate the spectrum before it is masked, so that a flagged
+        // sample is unflagged once the interference stops.
+        spectrel_compute_spectrum_power(s, n, rfi->power);
+        spectrel_accumulate_power_sums(
+            rfi->power, rfi->sum, rfi->sum_squares, M);
+        rfi->num_accumulated += 1;
+        rfi->num_spectrums += 1;
+
+        if (rfi->action != SPECTREL_RFI_FLAG)
+            spectrel_mask_spectrum(rfi, s, n, rfi->power);
+
+        if (rfi->num_accumulated == rfi->num_spectrums_per_block &&
+            spectrel_finish_block(rfi) != 0)
+        {
+            return SPECTREL_FAILURE;
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
@@ -0,0 +1,708 @@
+#include "spserver.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+#include "sprealtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct
+{
+    int fd;
+    uint64_t next_index; // The index of the next record to send.
+    uint8_t *record;     // A copy of the record being sent.
+    size_t record_size;  // The size of the record being sent.
+    size_t num_sent;     // The number of bytes of the record sent so far.
+    bool has_record;     // Whether a record is being sent.
+    bool has_header;     // Whether the record being sent holds a new header.
+} spectrel_subscriber_t;
+
+struct spectrel_server_t
+{
+    char *socket_path;
+    int listen_fd;
+    int wake_fd;
+    pthread_t thread;
+    bool has_thread;
+    atomic_bool is_running;
+
+    spectrel_subscriber_t subscribers[SPECTREL_MAX_SUBSCRIBERS];
+    atomic_size_t num_subscribers;
+
+    size_t decimation;
+    size_t num_samples_per_spectrum; // Before decimation.
+    size_t num_samples;              // After decimation.
+    double sample_rate;
+    double center_frequency;
+
+    // A ring of the most recently published records. Each slot starts with
+    // the index of the record it holds, which is invalid while it is written.
+    uint8_t *ring;
+    size_t record_size;
+    size_t slot_size;
+    atomic_uint_fast64_t write_index;
+
+    // Spectrums are accumulated here until there are enough to pool.
+    double *power;
+    double *pooled;
+    size_t num_pooled;
+};
+
+#define SPECTREL_INVALID_INDEX UINT64_MAX
+
+static spectrel_server_header_t spectrel_get_header(spectrel_server server)
+{
+    spectrel_server_header_t header = {0};
+    memcpy(header.magic, SPECTREL_SERVER_MAGIC, sizeof(SPECTREL_SERVER_MAGIC));
+    header.decimation = (uint32_t)server->decimation;
+    header.num_samples_per_spectrum = (uint32_t)server->num_samples;
+    header.sample_rate = server->sample_rate;
+    header.center_frequency = server->center_frequency;
+    return header;
+}
+
+static atomic_uint_fast64_t *spectrel_get_slot_index(spectrel_server server,
+                                                     const uint64_t index)
+{
+    size_t slot = index % SPECTREL_SERVER_RING_SIZE;
+    return (atomic_uint_fast64_t *)(server->ring + slot * server->slot_size);
+}
+
+static float *spectrel_get_slot_data(spectrel_server server,
+                                     const uint64_t index)
+{
+    size_t slot = index % SPECTREL_SERVER_RING_SIZE;
+    return (float *)(server->ring + slot * server->slot_size +
+                     sizeof(uint64_t));
+}
+
+static void spectrel_drop_subscriber(spectrel_server server,
+                                     spectrel_subscriber_t *subscriber)
+{
+    if (subscriber->fd >= 0)
+    {
+        close(subscriber->fd);
+        subscriber->fd = -1;
+        atomic_fetch_sub_explicit(
+            &server->num_subscribers, 1, memory_order_relaxed);
+    }
+    subscriber->has_record = false;
+}
+
+static void spectrel_accept_subscriber(spectrel_server server)
+{
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    spectrel_subscriber_t *subscriber = NULL;
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        if (server->subscribers[i].fd < 0)
+        {
+            subscriber = &server->subscribers[i];
+            break;
+        }
+    }
+
+    // The header is small enough to always fit in an empty socket buffer.
+    spectrel_server_header_t header = spectrel_get_header(server);
+    if (!subscriber ||
+        send(fd, &header, sizeof(header), MSG_NOSIGNAL) != sizeof(header))
+    {
+        close(fd);
+        return;
+    }
+
+    // Start from the next record to be published.
+    subscriber->fd = fd;
+    subscriber->next_index =
+        atomic_load_explicit(&server->write_index, memory_order_acquire);
+    subscriber->has_record = false;
+    atomic_fetch_add_explicit(
+        &server->num_subscribers, 1, memory_order_relaxed);
+}
+
+// Copy the next record for the subscriber out of the ring. Fails if the
+// subscriber has fallen so far behind that the record may be overwritten.
+static int spectrel_copy_record(spectrel_server server,
+                                spectrel_subscriber_t *subscriber,
+                                const uint64_t write_index)
+{
+    uint64_t index = subscriber->next_index;
+    if (write_index - index > SPECTREL_SERVER_RING_SIZE / 2)
+    {
+        return SPECTREL_FAILURE;
+    }
+
+    atomic_uint_fast64_t *slot_index = spectrel_get_slot_index(server, index);
+    if (atomic_load_explicit(slot_index, memory_order_acquire) != index)
+    {
+        return SPECTREL_FAILURE;
+    }
+    memcpy(subscriber->record, &index, sizeof(index));
+    memcpy(subscriber->record + sizeof(index),
+           spectrel_get_slot_data(server, index),
+           server->record_size - sizeof(index));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(slot_index, memory_order_relaxed) != index)
+    {
+        return SPECTREL_FAILURE;
+    }
+
+    subscriber->has_record = true;
+    subscriber->record_size = server->record_size;
+    subscriber->num_sent = 0;
+    return SPECTREL_SUCCESS;
+}
+
+// Send as many records to the subscriber as its socket will take.
+static int spectrel_serve_subscriber(spectrel_server server,
+                                     spectrel_subscriber_t *subscriber)
+{
+    while (true)
+    {
+        if (!subscriber->has_record)
+        {
+            uint64_t write_index = atomic_load_explicit(&server->write_index,
+                                                        memory_order_acquire);
+            if (subscriber->next_index >= write_index)
+            {
+                return SPECTREL_SUCCESS;
+            }
+            if (spectrel_copy_record(server, subscriber, write_index) != 0)
+            {
+                return SPECTREL_FAILURE;
+            }
+        }
+
+        ssize_t ret = send(subscriber->fd,
+                           subscriber->record + subscriber->num_sent,
+                           subscriber->record_size - subscriber->num_sent,
+                           MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? SPECTREL_SUCCESS
+                                                             : SPECTREL_FAILURE;
+        }
+        subscriber->num_sent += (size_t)ret;
+        if (subscriber->num_sent == subscriber->record_size)
+        {
+            // A new header is sent in place of a record, not as one.
+            subscriber->next_index += subscriber->has_header ? 0 : 1;
+            subscriber->has_record = false;
+            subscriber->has_header = false;
+        }
+    }
+}
+
+static void *spectrel_serve(void *arg)
+{
+    spectrel_server server = arg;
+    struct pollfd fds[2 + SPECTREL_MAX_SUBSCRIBERS];
+    spectrel_subscriber_t *polled[SPECTREL_MAX_SUBSCRIBERS];
+
+    while (atomic_load_explicit(&server->is_running, memory_order_acquire))
+    {
+        fds[0].fd = server->listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = server->wake_fd;
+        fds[1].events = POLLIN;
+        nfds_t num_fds = 2;
+
+        // Only wait for subscribers to be writable if there is something to
+        // send them.
+        uint64_t write_index =
+            atomic_load_explicit(&server->write_index, memory_order_acquire);
+        uint64_t lag = 0;
+        for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+        {
+            spectrel_subscriber_t *subscriber = &server->subscribers[i];
+            if (subscriber->fd < 0)
+            {
+                continue;
+            }
+            if (write_index > subscriber->next_index &&
+                write_index - subscriber->next_index > lag)
+            {
+                lag = write_index - subscriber->next_index;
+            }
+            fds[num_fds].fd = subscriber->fd;
+            fds[num_fds].events = POLLIN;
+            if (subscriber->has_record || subscriber->next_index < write_index)
+            {
+                fds[num_fds].events |= POLLOUT;
+            }
+            polled[num_fds - 2] = subscriber;
+            num_fds += 1;
+        }
+        spectrel_set_gauge(SPECTREL_GAUGE_SUBSCRIBERS, (int64_t)num_fds - 2);
+        spectrel_set_gauge(SPECTREL_GAUGE_SUBSCRIBER_LAG, (int64_t)lag);
+
+        if (poll(fds, num_fds, SPECTREL_SERVER_POLL_TIMEOUT) < 0)
+        {
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t value;
+            if (read(server->wake_fd, &value, sizeof(value)) < 0)
+            {
+                // The counter was already drained, nothing to do.
+            }
+        }
+        write_index =
+            atomic_load_explicit(&server->write_index, memory_order_acquire);
+        for (nfds_t n = 2; n < num_fds; n++)
+        {
+            spectrel_subscriber_t *subscriber = polled[n - 2];
+            char discard[64];
+            if ((fds[n].revents & (POLLERR | POLLHUP)) ||
+                ((fds[n].revents & POLLIN) &&
+                 recv(subscriber->fd, discard, sizeof(discard), 0) <= 0))
+            {
+                spectrel_drop_subscriber(server, subscriber);
+                continue;
+            }
+            // A subscriber which has stopped reading never becomes writable
+            // again, so is dropped by its lag alone.
+            if (write_index - subscriber->next_index >
+                SPECTREL_SERVER_RING_SIZE / 2)
+            {
+                spectrel_drop_subscriber(server, subscriber);
+                continue;
+            }
+            if ((fds[n].revents & POLLOUT) &&
+                spectrel_serve_subscriber(server, subscriber) != 0)
+            {
+                spectrel_drop_subscriber(server, subscriber);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            spectrel_accept_subscriber(server);
+        }
+    }
+    return NULL;
+}
+
+static int spectrel_start_serving(spectrel_server server)
+{
+    atomic_store_explicit(&server->is_running, true, memory_order_release);
+    if (pthread_create(&server->thread, NULL, spectrel_serve, server) != 0)
+    {
+        spectrel_print_error("pthread_create failed: server");
+        return SPECTREL_FAILURE;
+    }
+    server->has_thread = true;
+    spectrel_demote_thread(server->thread);
+    return SPECTREL_SUCCESS;
+}
+
+static void spectrel_stop_serving(spectrel_server server)
+{
+    if (server->has_thread)
+    {
+        atomic_store_explicit(&server->is_running, false, memory_order_release);
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0)
+        {
+            // The thread will notice at its next poll timeout.
+        }
+        pthread_join(server->thread, NULL);
+        server->has_thread = false;
+    }
+}
+
+void spectrel_free_server(spectrel_server server)
+{
+    if (server)
+    {
+        spectrel_stop_serving(server);
+        for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+        {
+            spectrel_drop_subscriber(server, &server->subscribers[i]);
+            if (server->subscribers[i].record)
+            {
+                free(server->subscribers[i].record);
+                server->subscribers[i].record = NULL;
+            }
+        }
+        if (server->listen_fd >= 0)
+        {
+            close(server->listen_fd);
+            server->listen_fd = -1;
+            unlink(server->socket_path);
+        }
+        if (server->wake_fd >= 0)
+        {
+            close(server->wake_fd);
+            server->wake_fd = -1;
+        }
+        if (server->socket_path)
+        {
+            free(server->socket_path);
+            server->socket_path = NULL;
+        }
+        if (server->ring)
+        {
+            free(server->ring);
+            server->ring = NULL;
+        }
+        if (server->power)
+        {
+            free(server->power);
+            server->power = NULL;
+        }
+        if (server->pooled)
+        {
+            free(server->pooled);
+            server->pooled = NULL;
+        }
+        free(server);
+    }
+}
+
+static int spectrel_listen(spectrel_server server)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(server->socket_path) >= sizeof(address.sun_path))
+    {
+        spectrel_print_error("Socket path is too long: %s",
+                             server->socket_path);
+        return SPECTREL_FAILURE;
+    }
+    strcpy(address.sun_path, server->socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (server->listen_fd < 0)
+    {
+        spectrel_print_error("socket failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+
+    // Replace a socket left behind by a previous run.
+    unlink(server->socket_path);
+    if (bind(server->listen_fd,
+             (struct sockaddr *)&address,
+             sizeof(address)) != 0 ||
+        listen(server->listen_fd, SPECTREL_MAX_SUBSCRIBERS) != 0)
+    {
+        spectrel_print_error("bind failed: %s: %s",
+                             server->socket_path,
+                             strerror(errno));
+        close(server->listen_fd);
+        server->listen_fd = -1;
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+bool spectrel_is_valid_decimation(const size_t num_samples_per_spectrum,
+                                  const size_t decimation)
+{
+    // The spectrums are pooled in FFT order, where the negative frequencies
+    // start halfway through.
+    size_t M = num_samples_per_spectrum;
+    return decimation >= 1 && M % decimation == 0 &&
+           ((M + 1) / 2) % decimation == 0;
+}
+
+spectrel_server spectrel_make_server(const char *socket_path,
+                                     const size_t num_samples_per_spectrum,
+                                     const size_t decimation,
+                                     const double sample_rate,
+                                     const double center_frequency)
+{
+    if (!spectrel_is_valid_decimation(num_samples_per_spectrum, decimation))
+    {
+        spectrel_print_error(
+            "Window size and half of it must be divisible by the decimation");
+        return NULL;
+    }
+
+    // Prepare server structure with safe initial values.
+    spectrel_server server = calloc(1, sizeof(*server));
+    if (!server)
+    {
+        spectrel_print_error("malloc failed: server");
+        return NULL;
+    }
+    server->listen_fd = -1;
+    server->wake_fd = -1;
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        server->subscribers[i].fd = -1;
+    }
+    atomic_init(&server->is_running, true);
+    atomic_init(&server->num_subscribers, 0);
+    atomic_init(&server->write_index, 0);
+    server->decimation = decimation;
+    server->num_samples_per_spectrum = num_samples_per_spectrum;
+    server->num_samples = num_samples_per_spectrum / decimation;
+    server->sample_rate = sample_rate;
+    server->center_frequency = center_frequency;
+
+    // Pad each slot so that the index at the start of every slot is aligned.
+    server->record_size =
+        sizeof(uint64_t) + sizeof(float) * server->num_samples;
+    server->slot_size =
+        (server->record_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+    server->socket_path = strdup(socket_path);
+    server->ring = malloc(server->slot_size * SPECTREL_SERVER_RING_SIZE);
+    server->power = malloc(sizeof(*server->power) * num_samples_per_spectrum);
+    server->pooled = malloc(sizeof(*server->pooled) * server->num_samples);
+    if (!server->socket_path || !server->ring || !server->power ||
+        !server->pooled)
+    {
+        spectrel_free_server(server);
+        spectrel_print_error("malloc failed: server");
+        return NULL;
+    }
+    for (uint64_t n = 0; n < SPECTREL_SERVER_RING_SIZE; n++)
+    {
+        atomic_init(spectrel_get_slot_index(server, n), SPECTREL_INVALID_INDEX);
+    }
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        server->subscribers[i].record = malloc(server->record_size);
+        if (!server->subscribers[i].record)
+        {
+            spectrel_free_server(server);
+            spectrel_print_error("malloc failed: record");
+            return NULL;
+        }
+    }
+
+    server->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (server->wake_fd < 0)
+    {
+        spectrel_free_server(server);
+        spectrel_print_error("eventfd failed: %s", strerror(errno));
+        return NULL;
+    }
+    if (spectrel_listen(server) != 0)
+    {
+        spectrel_free_server(server);
+        return NULL;
+    }
+    if (spectrel_start_serving(server) != 0)
+    {
+        spectrel_free_server(server);
+        return NULL;
+    }
+    return server;
+}
+
+int spectrel_reconfigure_server(spectrel_server server,
+                                const size_t num_samples_per_spectrum,
+                                const double sample_rate,
+                                const double center_frequency)
+{
+    size_t D = server->decimation;
+    if (!spectrel_is_valid_decimation(num_samples_per_spectrum, D))
+    {
+        spectrel_print_error(
+            "Window size and half of it must be divisible by the decimation");
+        return SPECTREL_FAILURE;
+    }
+    size_t num_samples = num_samples_per_spectrum / D;
+    size_t record_size = sizeof(uint64_t) + sizeof(float) * num_samples;
+    size_t slot_size = (record_size + sizeof(uint64_t) - 1) &
+                       ~(sizeof(uint64_t) - 1);
+
+    // The subscribers are left alone by the server while it is stopped. Each
+    // finishes the record it is part way through (which may itself hold a
+    // header), then is sent the new header, in one go.
+    spectrel_stop_serving(server);
+    size_t buffer_size = record_size;
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        const spectrel_subscriber_t *subscriber = &server->subscribers[i];
+        size_t pending_size =
+            (subscriber->has_record
+                 ? subscriber->record_size - subscriber->num_sent
+                 : 0) +
+            sizeof(uint64_t) + sizeof(spectrel_server_header_t);
+        buffer_size = pending_size > buffer_size ? pending_size : buffer_size;
+    }
+
+    // Allocate everything before changing anything, so that a failure leaves
+    // the server as it was.
+    uint8_t *ring = malloc(slot_size * SPECTREL_SERVER_RING_SIZE);
+    double *power = malloc(sizeof(*power) * num_samples_per_spectrum);
+    double *pooled = malloc(sizeof(*pooled) * num_samples);
+    uint8_t *records[SPECTREL_MAX_SUBSCRIBERS] = {0};
+    bool has_failed = !ring || !power || !pooled;
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        records[i] = malloc(buffer_size);
+        has_failed = has_failed || !records[i];
+    }
+    if (has_failed)
+    {
+        free(ring);
+        free(power);
+        free(pooled);
+        for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+        {
+            free(records[i]);
+        }
+        spectrel_print_error("malloc failed: server");
+        spectrel_start_serving(server);
+        return SPECTREL_FAILURE;
+    }
+
+    free(server->ring);
+    free(server->power);
+    free(server->pooled);
+    server->ring = ring;
+    server->power = power;
+    server->pooled = pooled;
+    server->num_pooled = 0;
+    server->num_samples_per_spectrum = num_samples_per_spectrum;
+    server->num_samples = num_samples;
+    server->sample_rate = sample_rate;
+    server->center_frequency = center_frequency;
+    server->record_size = record_size;
+    server->slot_size = slot_size;
+    for (uint64_t n = 0; n < SPECTREL_SERVER_RING_SIZE; n++)
+    {
+        atomic_init(spectrel_get_slot_index(server, n), SPECTREL_INVALID_INDEX);
+    }
+
+    // Queue the new header for every subscriber, after what is left of the
+    // record it is sending. Record indices carry on from where they were.
+    spectrel_server_header_t header = spectrel_get_header(server);
+    uint64_t header_index = SPECTREL_SERVER_HEADER_INDEX;
+    uint64_t write_index =
+        atomic_load_explicit(&server->write_index, memory_order_relaxed);
+    for (size_t i = 0; i < SPECTREL_MAX_SUBSCRIBERS; i++)
+    {
+        spectrel_subscriber_t *subscriber = &server->subscribers[i];
+        size_t num_pending = 0;
+        if (subscriber->fd >= 0)
+        {
+            if (subscriber->has_record)
+            {
+                num_pending = subscriber->record_size - subscriber->num_sent;
+                memcpy(records[i],
+                       subscriber->record + subscriber->num_sent,
+                       num_pending);
+            }
+            memcpy(records[i] + num_pending, &header_index, sizeof(uint64_t));
+            num_pending += sizeof(uint64_t);
+            memcpy(records[i] + num_pending, &header, sizeof(header));
+            num_pending += sizeof(header);
+            subscriber->next_index = write_index;
+        }
+        free(subscriber->record);
+        subscriber->record = records[i];
+        subscriber->record_size = num_pending;
+        subscriber->num_sent = 0;
+        subscriber->has_record = num_pending > 0;
+        subscriber->has_header = num_pending > 0;
+    }
+    return spectrel_start_serving(server);
+}
+
+// Write the pooled spectrum into the next slot of the ring.
+static void spectrel_publish_record(spectrel_server server)
+{
+    uint64_t index =
+        atomic_load_explicit(&server->write_index, memory_order_relaxed);
+    atomic_uint_fast64_t *slot_index = spectrel_get_slot_index(server, index);
+    float *data = spectrel_get_slot_data(server, index);
+
+    atomic_store_explicit(
+        slot_index, SPECTREL_INVALID_INDEX, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    double normalisation =
+        1.0 / (double)(server->decimation * server->decimation);
+    for (size_t m = 0; m < server->num_samples; m++)
+    {
+        double power = server->pooled[m] * normalisation;
+        data[m] = (float)(10 * log10(fmax(power, SPECTREL_MIN_POWER)));
+    }
+    atomic_store_explicit(slot_index, index, memory_order_release);
+    atomic_store_explicit(
+        &server->write_index, index + 1, memory_order_release);
+}
+
+int spectrel_publish_spectrogram(spectrel_server server,
+                                 const spectrel_spectrogram_t *s)
+{
+    // Nobody is listening, so there is nothing to do.
+    if (atomic_load_explicit(&server->num_subscribers, memory_order_relaxed) ==
+        0)
+    {
+        server->num_pooled = 0;
+        return SPECTREL_SUCCESS;
+    }
+
+    size_t M = server->num_samples_per_spectrum;
+    size_t D = server->decimation;
+    if (s->num_samples_per_spectrum != M)
+    {
+        spectrel_print_error("Spectrogram does not match the server");
+        return SPECTREL_FAILURE;
+    }
+
+    bool has_published = false;
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        // Sum the power over each cell, in frequency then time.
+        spectrel_compute_spectrum_power(s, n, server->power);
+        for (size_t m = 0; m < server->num_samples; m++)
+        {
+            double sum = server->num_pooled ? server->pooled[m] : 0;
+            for (size_t d = 0; d < D; d++)
+            {
+                sum += server->power[m * D + d];
+            }
+            server->pooled[m] = sum;
+        }
+
+        server->num_pooled += 1;
+        if (server->num_pooled == D)
+        {
+            spectrel_publish_record(server);
+            server->num_pooled = 0;
+            has_published = true;
+        }
+    }
+
+    // Wake the server, once per spectrogram rather than once per record.
+    if (has_published)
+    {
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0)
+        {
+            // The counter is saturated, so the server is already awake.
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
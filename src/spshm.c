@@ -0,0 +1,446 @@
+// For mremap.
+#define _GNU_SOURCE
+#include "spshm.h"
+#include "spconstants.h"
+#include "sperror.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct spectrel_shm_t
+{
+    char *name;
+    bool is_owner; // Whether the shared memory was made, rather than opened.
+    int fd;        // Kept open, so that the shared memory can be resized.
+    uint8_t *data;
+    size_t num_bytes;
+    spectrel_shm_header_t *header;
+
+    // The layout of the ring, as of the configuration last taken up.
+    uint64_t configuration;
+    size_t num_slots;
+    size_t slots_offset;
+    size_t slot_size;
+};
+
+void spectrel_free_shm(spectrel_shm shm)
+{
+    if (shm)
+    {
+        if (shm->data)
+        {
+            munmap(shm->data, shm->num_bytes);
+            shm->data = NULL;
+            shm->header = NULL;
+        }
+        if (shm->fd >= 0)
+        {
+            close(shm->fd);
+            shm->fd = -1;
+        }
+        if (shm->name)
+        {
+            if (shm->is_owner)
+            {
+                shm_unlink(shm->name);
+            }
+            free(shm->name);
+            shm->name = NULL;
+        }
+        free(shm);
+    }
+}
+
+// Round up to a whole number of cache lines.
+static size_t spectrel_align(const size_t num_bytes)
+{
+    return (num_bytes + SPECTREL_CACHE_LINE_SIZE - 1) &
+           ~((size_t)SPECTREL_CACHE_LINE_SIZE - 1);
+}
+
+// The frequency axis follows the header.
+static size_t spectrel_get_frequencies_offset(void)
+{
+    return spectrel_align(sizeof(spectrel_shm_header_t));
+}
+
+static size_t spectrel_get_slots_offset(const size_t num_samples_per_spectrum)
+{
+    return spectrel_align(spectrel_get_frequencies_offset() +
+                          sizeof(double) * num_samples_per_spectrum);
+}
+
+static size_t spectrel_get_slot_size(const size_t num_samples_per_spectrum)
+{
+    return spectrel_align(sizeof(spectrel_shm_slot_t) +
+                          sizeof(fftw_complex) * num_samples_per_spectrum);
+}
+
+static spectrel_shm_slot_t *spectrel_get_shm_slot(spectrel_shm shm,
+                                                  const uint64_t index)
+{
+    size_t slot = index % shm->num_slots;
+    return (spectrel_shm_slot_t *)(shm->data + shm->slots_offset +
+                                   slot * shm->slot_size);
+}
+
+static fftw_complex *spectrel_get_shm_samples(spectrel_shm shm,
+                                              const uint64_t index)
+{
+    return (fftw_complex *)((uint8_t *)spectrel_get_shm_slot(shm, index) +
+                            sizeof(spectrel_shm_slot_t));
+}
+
+// Map the shared memory behind the file descriptor.
+static int spectrel_map_shm(spectrel_shm shm, const int prot)
+{
+    void *data = mmap(NULL, shm->num_bytes, prot, MAP_SHARED, shm->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        spectrel_print_error("mmap failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+    shm->data = data;
+    shm->header = data;
+    return SPECTREL_SUCCESS;
+}
+
+// Map more of the shared memory, once it has grown. On failure, the old
+// mapping is left in place.
+static int spectrel_remap_shm(spectrel_shm shm, const size_t num_bytes)
+{
+    void *data = mremap(shm->data, shm->num_bytes, num_bytes, MREMAP_MAYMOVE);
+    if (data == MAP_FAILED)
+    {
+        spectrel_print_error("mremap failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+    shm->data = data;
+    shm->header = data;
+    shm->num_bytes = num_bytes;
+    return SPECTREL_SUCCESS;
+}
+
+// Describe a configuration in the header, lay out the ring to match, and
+// invalidate every slot. The shared memory must be large enough to hold it.
+static void spectrel_describe_shm(spectrel_shm shm,
+                                  const size_t window_size,
+                                  const bool is_real,
+                                  const size_t window_hop,
+                                  const double sample_rate,
+                                  const double center_frequency)
+{
+    size_t num_samples_per_spectrum =
+        spectrel_get_num_bins(window_size, is_real);
+    shm->slots_offset = spectrel_get_slots_offset(num_samples_per_spectrum);
+    shm->slot_size = spectrel_get_slot_size(num_samples_per_spectrum);
+
+    spectrel_shm_header_t *header = shm->header;
+    header->num_slots = (uint32_t)shm->num_slots;
+    header->num_samples_per_spectrum = num_samples_per_spectrum;
+    header->window_hop = window_hop;
+    header->sample_rate = sample_rate;
+    header->center_frequency = center_frequency;
+    header->frequencies_offset = spectrel_get_frequencies_offset();
+    header->slots_offset = shm->slots_offset;
+    header->slot_size = shm->slot_size;
+    spectrel_compute_frequencies(
+        (double *)(shm->data + header->frequencies_offset),
+        window_size,
+        sample_rate,
+        is_real);
+    for (uint64_t n = 0; n < shm->num_slots; n++)
+    {
+        atomic_store_explicit(&spectrel_get_shm_slot(shm, n)->index,
+                              SPECTREL_SHM_INVALID_INDEX,
+                              memory_order_relaxed);
+    }
+}
+
+spectrel_shm spectrel_make_shm(const char *name,
+                               const size_t num_slots,
+                               const size_t window_size,
+                               const bool is_real,
+                               const size_t window_hop,
+                               const double sample_rate,
+                               const double center_frequency)
+{
+    size_t num_samples_per_spectrum =
+        spectrel_get_num_bins(window_size, is_real);
+    if (num_slots < 1 || window_size < 1)
+    {
+        spectrel_print_error("Shared memory must hold at least one sample");
+        return NULL;
+    }
+
+    // Prepare shared memory structure with safe initial values.
+    spectrel_shm shm = calloc(1, sizeof(*shm));
+    if (!shm)
+    {
+        spectrel_print_error("malloc failed: shm");
+        return NULL;
+    }
+    shm->fd = -1;
+    shm->num_slots = num_slots;
+    shm->name = strdup(name);
+    if (!shm->name)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("strdup failed: name");
+        return NULL;
+    }
+
+    shm->num_bytes = spectrel_get_slots_offset(num_samples_per_spectrum) +
+                     spectrel_get_slot_size(num_samples_per_spectrum) *
+                         num_slots;
+
+    // Replace shared memory left behind by a previous run.
+    shm_unlink(name);
+    shm->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (shm->fd < 0)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("shm_open failed: %s: %s", name, strerror(errno));
+        return NULL;
+    }
+    shm->is_owner = true;
+    if (ftruncate(shm->fd, (off_t)shm->num_bytes) != 0)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("ftruncate failed: %s", strerror(errno));
+        return NULL;
+    }
+    if (spectrel_map_shm(shm, PROT_READ | PROT_WRITE) != 0)
+    {
+        spectrel_free_shm(shm);
+        return NULL;
+    }
+
+    // Describe the ring. The magic is written last, so readers never see a
+    // partially initialised header.
+    spectrel_shm_header_t *header = shm->header;
+    header->version = SPECTREL_SHM_VERSION;
+    atomic_init(&header->write_index, 0);
+    atomic_init(&header->configuration, 0);
+    spectrel_describe_shm(shm,
+                          window_size,
+                          is_real,
+                          window_hop,
+                          sample_rate,
+                          center_frequency);
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, SPECTREL_SHM_MAGIC, sizeof(SPECTREL_SHM_MAGIC));
+    return shm;
+}
+
+int spectrel_reconfigure_shm(spectrel_shm shm,
+                             const size_t window_size,
+                             const bool is_real,
+                             const size_t window_hop,
+                             const double sample_rate,
+                             const double center_frequency)
+{
+    size_t num_samples_per_spectrum =
+        spectrel_get_num_bins(window_size, is_real);
+    if (!shm->is_owner || window_size < 1)
+    {
+        spectrel_print_error("Shared memory cannot be reconfigured");
+        return SPECTREL_FAILURE;
+    }
+
+    // Grow the shared memory first, if it must, so that a failure leaves the
+    // configuration as it was. Readers still mapping the old size are
+    // unaffected until the configuration changes.
+    size_t num_bytes = spectrel_get_slots_offset(num_samples_per_spectrum) +
+                       spectrel_get_slot_size(num_samples_per_spectrum) *
+                           shm->num_slots;
+    if (num_bytes > shm->num_bytes)
+    {
+        if (ftruncate(shm->fd, (off_t)num_bytes) != 0)
+        {
+            spectrel_print_error("ftruncate failed: %s", strerror(errno));
+            return SPECTREL_FAILURE;
+        }
+        if (spectrel_remap_shm(shm, num_bytes) != 0)
+            return SPECTREL_FAILURE;
+    }
+
+    // Readers see an odd count until the new configuration is consistent.
+    spectrel_shm_header_t *header = shm->header;
+    atomic_store_explicit(
+        &header->configuration, shm->configuration + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    spectrel_describe_shm(shm,
+                          window_size,
+                          is_real,
+                          window_hop,
+                          sample_rate,
+                          center_frequency);
+    shm->configuration += 2;
+    atomic_store_explicit(
+        &header->configuration, shm->configuration, memory_order_release);
+    return SPECTREL_SUCCESS;
+}
+
+int spectrel_publish_shm(spectrel_shm shm, const spectrel_spectrogram_t *s)
+{
+    size_t M = shm->header->num_samples_per_spectrum;
+    if (s->num_samples_per_spectrum != M)
+    {
+        spectrel_print_error("Spectrogram does not match the shared memory");
+        return SPECTREL_FAILURE;
+    }
+
+    uint64_t index =
+        atomic_load_explicit(&shm->header->write_index, memory_order_relaxed);
+    for (size_t n = 0; n < s->num_spectrums; n++, index++)
+    {
+        spectrel_shm_slot_t *slot = spectrel_get_shm_slot(shm, index);
+        atomic_store_explicit(
+            &slot->index, SPECTREL_SHM_INVALID_INDEX, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot->time = s->time ? spectrel_get_spectrum_time(s, n) : 0;
+        spectrel_copy_spectrum(s, n, spectrel_get_shm_samples(shm, index));
+        atomic_store_explicit(&slot->index, index, memory_order_release);
+    }
+    atomic_store_explicit(
+        &shm->header->write_index, index, memory_order_release);
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_shm spectrel_open_shm(const char *name)
+{
+    spectrel_shm shm = calloc(1, sizeof(*shm));
+    if (!shm)
+    {
+        spectrel_print_error("malloc failed: shm");
+        return NULL;
+    }
+
+    shm->fd = shm_open(name, O_RDONLY, 0);
+    if (shm->fd < 0)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("shm_open failed: %s: %s", name, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(shm->fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(spectrel_shm_header_t))
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("Shared memory is too small: %s", name);
+        return NULL;
+    }
+    shm->num_bytes = (size_t)st.st_size;
+    if (spectrel_map_shm(shm, PROT_READ) != 0)
+    {
+        spectrel_free_shm(shm);
+        return NULL;
+    }
+
+    const spectrel_shm_header_t *header = shm->header;
+    if (memcmp(header->magic, SPECTREL_SHM_MAGIC, sizeof(SPECTREL_SHM_MAGIC)) !=
+            0 ||
+        header->version != SPECTREL_SHM_VERSION)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("Invalid shared memory header: %s", name);
+        return NULL;
+    }
+
+    // An odd count is never taken up, so the first refresh reads the layout.
+    shm->configuration = 1;
+    if (spectrel_refresh_shm(shm) != 0)
+    {
+        spectrel_free_shm(shm);
+        spectrel_print_error("Shared memory is unreadable: %s", name);
+        return NULL;
+    }
+    return shm;
+}
+
+int spectrel_refresh_shm(spectrel_shm shm)
+{
+    uint64_t configuration = atomic_load_explicit(&shm->header->configuration,
+                                                  memory_order_acquire);
+    if (configuration == shm->configuration)
+        return SPECTREL_SUCCESS;
+    if (configuration % 2 != 0)
+        return SPECTREL_FAILURE;
+
+    // The shared memory only grows, and it grows before the count changes,
+    // so it is now at least as large as the new configuration needs.
+    struct stat st;
+    if (fstat(shm->fd, &st) != 0)
+    {
+        spectrel_print_error("fstat failed: %s", strerror(errno));
+        return SPECTREL_FAILURE;
+    }
+    if ((size_t)st.st_size > shm->num_bytes &&
+        spectrel_remap_shm(shm, (size_t)st.st_size) != 0)
+        return SPECTREL_FAILURE;
+
+    const spectrel_shm_header_t *header = shm->header;
+    size_t num_slots = header->num_slots;
+    size_t slots_offset = header->slots_offset;
+    size_t slot_size = header->slot_size;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&header->configuration, memory_order_relaxed) !=
+        configuration)
+        return SPECTREL_FAILURE;
+    if (num_slots < 1 || slots_offset + slot_size * num_slots > shm->num_bytes)
+    {
+        spectrel_print_error("Invalid shared memory header");
+        return SPECTREL_FAILURE;
+    }
+    shm->configuration = configuration;
+    shm->num_slots = num_slots;
+    shm->slots_offset = slots_offset;
+    shm->slot_size = slot_size;
+    return SPECTREL_SUCCESS;
+}
+
+const spectrel_shm_header_t *spectrel_get_shm_header(spectrel_shm shm)
+{
+    return shm->header;
+}
+
+uint64_t spectrel_get_shm_write_index(spectrel_shm shm)
+{
+    return atomic_load_explicit(&shm->header->write_index,
+                                memory_order_acquire);
+}
+
+const fftw_complex *spectrel_begin_shm_read(spectrel_shm shm,
+                                            const uint64_t index)
+{
+    if (atomic_load_explicit(&shm->header->configuration,
+                             memory_order_acquire) != shm->configuration)
+    {
+        return NULL;
+    }
+    spectrel_shm_slot_t *slot = spectrel_get_shm_slot(shm, index);
+    if (atomic_load_explicit(&slot->index, memory_order_acquire) != index)
+    {
+        return NULL;
+    }
+    return spectrel_get_shm_samples(shm, index);
+}
+
+bool spectrel_end_shm_read(spectrel_shm shm, const uint64_t index)
+{
+    atomic_thread_fence(memory_order_acquire);
+    spectrel_shm_slot_t *slot = spectrel_get_shm_slot(shm, index);
+    return atomic_load_explicit(&slot->index, memory_order_relaxed) == index &&
+           atomic_load_explicit(&shm->header->configuration,
+                                memory_order_relaxed) == shm->configuration;
+}
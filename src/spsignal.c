@@ -2,18 +2,105 @@
 #include "spsignal.h"
 #include "spconstants.h"
 #include "sperror.h"
+#include "spgen.h"
+#include "spkernel.h"
+#include "spmetrics.h"
 #include "sppath.h"
+#include "spquant.h"
 
 #include <complex.h>
 #include <fftw3.h>
 #include <math.h>
 #include <memory.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+int spectrel_parse_format(const char *name, spectrel_format_t *format)
+{
+    const spectrel_format_t formats[] = {SPECTREL_FORMAT_CF64,
+                                         SPECTREL_FORMAT_CF32,
+                                         SPECTREL_FORMAT_CS16,
+                                         SPECTREL_FORMAT_CS8};
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (strcmp(name, spectrel_get_format_name(formats[i])) == 0)
+        {
+            *format = formats[i];
+            return SPECTREL_SUCCESS;
+        }
+    }
+    return SPECTREL_FAILURE;
+}
+
+const char *spectrel_get_format_name(const spectrel_format_t format)
+{
+    switch (format)
+    {
+    case SPECTREL_FORMAT_CF64:
+        return "CF64";
+    case SPECTREL_FORMAT_CF32:
+        return "CF32";
+    case SPECTREL_FORMAT_CS16:
+        return "CS16";
+    case SPECTREL_FORMAT_CS8:
+        return "CS8";
+    default:
+        return NULL;
+    }
+}
+
+size_t spectrel_get_sample_size(const spectrel_format_t format)
+{
+    switch (format)
+    {
+    case SPECTREL_FORMAT_CF64:
+        return 2 * sizeof(double);
+    case SPECTREL_FORMAT_CF32:
+        return 2 * sizeof(float);
+    case SPECTREL_FORMAT_CS16:
+        return 2 * sizeof(int16_t);
+    case SPECTREL_FORMAT_CS8:
+        return 2 * sizeof(int8_t);
+    default:
+        return 0;
+    }
+}
+
+// Get the value of a sample, whatever the format of the signal.
+static fftw_complex spectrel_get_sample(const spectrel_signal_t *signal,
+                                        const size_t n)
+{
+    double s = signal->scale;
+    switch (signal->format)
+    {
+    case SPECTREL_FORMAT_CF32:
+    {
+        const float *x = signal->data;
+        return s * x[2 * n] + s * x[2 * n + 1] * I;
+    }
+    case SPECTREL_FORMAT_CS16:
+    {
+        const int16_t *x = signal->data;
+        return s * x[2 * n] + s * x[2 * n + 1] * I;
+    }
+    case SPECTREL_FORMAT_CS8:
+    {
+        const int8_t *x = signal->data;
+        return s * x[2 * n] + s * x[2 * n + 1] * I;
+    }
+    default:
+        return signal->samples[n];
+    }
+}
+
 void spectrel_describe_signal(const spectrel_signal_t *signal)
 {
     printf("Number of samples: %zu\n", signal->num_samples);
+    printf("Format: %s\n", spectrel_get_format_name(signal->format));
 
     // If there's no samples, early return since we don't have anything more to
     // print.
@@ -25,9 +112,8 @@ void spectrel_describe_signal(const spectrel_signal_t *signal)
     printf("Samples:\n");
     for (size_t n = 0; n < signal->num_samples; n++)
     {
-        printf("  %f + %fi\n",
-               creal(signal->samples[n]),
-               cimag(signal->samples[n]));
+        fftw_complex sample = spectrel_get_sample(signal, n);
+        printf("  %f + %fi\n", creal(sample), cimag(sample));
     }
 }
 
@@ -35,9 +121,15 @@ void spectrel_free_signal(spectrel_signal_t *signal)
 {
     if (signal)
     {
-        if (signal->samples)
+        // In the CF64 format, the samples are the data. Samples in an arena
+        // are released by rewinding it.
+        if (signal->data)
         {
-            fftw_free(signal->samples);
+            if (!signal->arena)
+            {
+                fftw_free(signal->data);
+            }
+            signal->data = NULL;
             signal->samples = NULL;
         }
 
@@ -74,13 +166,19 @@ static void spectrel_cosine_signal_generator(fftw_complex *samples,
     spectrel_cosine_params_t *cosine_params =
         params ? (spectrel_cosine_params_t *)params : &default_params;
 
+    // Generate the complex tone by recurrence, rather than evaluating a
+    // cosine per sample, then keep its real part.
+    memset(samples, 0, sizeof(*samples) * num_samples);
+    spectrel_add_chirp(samples,
+                       num_samples,
+                       cosine_params->amplitude,
+                       cosine_params->phase / (2 * M_PI),
+                       cosine_params->frequency / cosine_params->sample_rate,
+                       0);
+    double *y = (double *)samples;
     for (size_t n = 0; n < num_samples; n++)
     {
-        double arg =
-            2 * M_PI * (cosine_params->frequency / cosine_params->sample_rate) *
-                (double)(n) +
-            cosine_params->phase;
-        samples[n] = cosine_params->amplitude * cos(arg) + 0 * I;
+        y[2 * n + 1] = 0;
     }
 }
 
@@ -124,6 +222,10 @@ spectrel_generate_signal(const size_t num_samples,
 
     signal->num_samples = num_samples;
     signal->samples = samples;
+    signal->format = SPECTREL_FORMAT_CF64;
+    signal->data = samples;
+    signal->scale = 1.0;
+    signal->arena = NULL;
     return signal;
 }
 
@@ -152,139 +254,555 @@ spectrel_make_signal(const size_t num_samples,
     return spectrel_generate_signal(num_samples, signal_generator, params);
 }
 
+spectrel_signal_t *spectrel_make_window(const size_t window_size)
+{
+    // TODO: Generalise the window (right now, the boxcar window is enforced).
+    spectrel_constant_params_t window_params = {1.0};
+    return spectrel_make_signal(
+        window_size, SPECTREL_CONSTANT_SIGNAL, (void *)&window_params);
+}
+
+spectrel_signal_t *spectrel_make_native_signal(const size_t num_samples,
+                                               const spectrel_format_t format,
+                                               const double scale,
+                                               spectrel_arena arena)
+{
+    size_t sample_size = spectrel_get_sample_size(format);
+    if (sample_size == 0)
+    {
+        spectrel_print_error("Unrecognised format: %d", format);
+        return NULL;
+    }
+
+    spectrel_signal_t *signal = calloc(1, sizeof(*signal));
+    if (!signal)
+    {
+        spectrel_print_error("malloc failed: signal");
+        return NULL;
+    }
+    signal->data = spectrel_arena_alloc(arena, sample_size * num_samples);
+    if (signal->data)
+    {
+        signal->arena = arena;
+    }
+    else
+    {
+        signal->data = fftw_malloc(sample_size * num_samples);
+        if (!signal->data)
+        {
+            spectrel_free_signal(signal);
+            spectrel_print_error("malloc failed: data");
+            return NULL;
+        }
+    }
+    memset(signal->data, 0, sample_size * num_samples);
+    signal->num_samples = num_samples;
+    signal->format = format;
+    if (format == SPECTREL_FORMAT_CF64)
+    {
+        signal->samples = signal->data;
+        signal->scale = 1;
+    }
+    else
+    {
+        signal->scale = scale;
+    }
+    return signal;
+}
+
 static spectrel_signal_t *spectrel_make_buffer(const size_t num_samples)
 {
     return spectrel_make_signal(num_samples, SPECTREL_EMPTY_SIGNAL, NULL);
 }
 
+// FFTW's planner is not thread-safe, so plans are made and destroyed under a
+// lock. Executing plans needs no lock.
+static pthread_mutex_t spectrel_planner_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 struct spectrel_plan_t
 {
-    spectrel_signal_t *buffer;
+    spectrel_layout_t layout;
+    bool is_real;
+    size_t num_samples;
+    size_t num_bins;           // The number of spectral components output.
+    double *input;             // The real-valued input, if is_real.
+    spectrel_signal_t *buffer; // The output, in the interleaved layout.
+    double *real;              // The output, in the split layout.
+    double *imag;
     fftw_plan plan;
+    size_t zoom_size;        // The length of the DFTs of a zoom plan, or zero.
+    fftw_complex *chirp;     // Multiplies each window, for a zoom plan.
+    fftw_complex *filter;    // The DFT of the chirp each window is convolved
+                             // with, scaled for the inverse DFT.
+    fftw_complex *post;      // Multiplies the output of the convolution.
+    double *zoom_frequencies; // The baseband frequency of each output.
+    fftw_plan inverse;       // Completes the convolution.
 };
 
+int spectrel_parse_layout(const char *name, spectrel_layout_t *layout)
+{
+    if (strcmp(name, "interleaved") == 0)
+    {
+        *layout = SPECTREL_LAYOUT_INTERLEAVED;
+    }
+    else if (strcmp(name, "split") == 0)
+    {
+        *layout = SPECTREL_LAYOUT_SPLIT;
+    }
+    else
+    {
+        spectrel_print_error("Unrecognised layout: %s", name);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+const char *spectrel_get_layout_name(const spectrel_layout_t layout)
+{
+    switch (layout)
+    {
+    case SPECTREL_LAYOUT_INTERLEAVED:
+        return "interleaved";
+    case SPECTREL_LAYOUT_SPLIT:
+        return "split";
+    default:
+        return NULL;
+    }
+}
+
 void spectrel_free_plan(spectrel_plan p)
 {
     if (p)
     {
         if (p->plan)
         {
+            pthread_mutex_lock(&spectrel_planner_mutex);
             fftw_destroy_plan(p->plan);
+            pthread_mutex_unlock(&spectrel_planner_mutex);
             p->plan = NULL;
         }
+        if (p->inverse)
+        {
+            pthread_mutex_lock(&spectrel_planner_mutex);
+            fftw_destroy_plan(p->inverse);
+            pthread_mutex_unlock(&spectrel_planner_mutex);
+            p->inverse = NULL;
+        }
+        fftw_free(p->chirp);
+        fftw_free(p->filter);
+        fftw_free(p->post);
+        free(p->zoom_frequencies);
 
+        if (p->input)
+        {
+            fftw_free(p->input);
+            p->input = NULL;
+        }
         if (p->buffer)
         {
             spectrel_free_signal(p->buffer);
             p->buffer = NULL;
         }
+        if (p->real)
+        {
+            fftw_free(p->real);
+            p->real = NULL;
+        }
+        if (p->imag)
+        {
+            fftw_free(p->imag);
+            p->imag = NULL;
+        }
         free(p);
     }
 }
 
-spectrel_plan spectrel_make_plan(const size_t buffer_size)
+size_t spectrel_get_num_bins(const size_t window_size, const bool is_real)
 {
-    spectrel_signal_t *buffer = spectrel_make_buffer(buffer_size);
-    if (!buffer)
+    return is_real ? window_size / 2 + 1 : window_size;
+}
+
+spectrel_plan spectrel_make_plan(const size_t buffer_size,
+                                 const spectrel_layout_t layout,
+                                 const bool is_real)
+{
+    if (!spectrel_get_layout_name(layout))
     {
-        spectrel_print_error("make_buffer failed");
+        spectrel_print_error("Unrecognised layout: %d", layout);
         return NULL;
     }
 
-    fftw_plan p = fftw_plan_dft_1d(buffer->num_samples,
-                                   buffer->samples,
-                                   buffer->samples,
-                                   FFTW_FORWARD,
-                                   FFTW_ESTIMATE);
+    // Prepare plan structure with safe initial values.
+    struct spectrel_plan_t *spectrel_plan =
+        calloc(1, sizeof(*spectrel_plan));
+    if (!spectrel_plan)
+    {
+        spectrel_print_error("malloc failed: spectrel_plan");
+        return NULL;
+    }
+    spectrel_plan->layout = layout;
+    spectrel_plan->is_real = is_real;
+    spectrel_plan->num_samples = buffer_size;
+    spectrel_plan->num_bins = spectrel_get_num_bins(buffer_size, is_real);
+
+    // Real-valued inputs are transformed out-of-place, from a separate input
+    // buffer.
+    if (is_real)
+    {
+        spectrel_plan->input = fftw_malloc(sizeof(double) * buffer_size);
+        if (!spectrel_plan->input)
+        {
+            spectrel_free_plan(spectrel_plan);
+            spectrel_print_error("malloc failed: input");
+            return NULL;
+        }
+    }
 
-    if (!p)
+    size_t num_bins = spectrel_plan->num_bins;
+    if (layout == SPECTREL_LAYOUT_INTERLEAVED)
     {
-        spectrel_free_signal(buffer);
-        buffer = NULL;
+        spectrel_plan->buffer = spectrel_make_buffer(num_bins);
+        if (!spectrel_plan->buffer)
+        {
+            spectrel_free_plan(spectrel_plan);
+            spectrel_print_error("make_buffer failed");
+            return NULL;
+        }
+
+        pthread_mutex_lock(&spectrel_planner_mutex);
+        if (is_real)
+        {
+            spectrel_plan->plan =
+                fftw_plan_dft_r2c_1d(buffer_size,
+                                     spectrel_plan->input,
+                                     spectrel_plan->buffer->samples,
+                                     FFTW_ESTIMATE);
+        }
+        else
+        {
+            spectrel_plan->plan =
+                fftw_plan_dft_1d(buffer_size,
+                                 spectrel_plan->buffer->samples,
+                                 spectrel_plan->buffer->samples,
+                                 FFTW_FORWARD,
+                                 FFTW_ESTIMATE);
+        }
+        pthread_mutex_unlock(&spectrel_planner_mutex);
+    }
+    else
+    {
+        spectrel_plan->real = fftw_malloc(sizeof(double) * num_bins);
+        spectrel_plan->imag = fftw_malloc(sizeof(double) * num_bins);
+        if (!spectrel_plan->real || !spectrel_plan->imag)
+        {
+            spectrel_free_plan(spectrel_plan);
+            spectrel_print_error("malloc failed: buffer");
+            return NULL;
+        }
+
+        // The split interface has no sign, the forward DFT is taken from
+        // (real, imag). Swapping them would give the backward DFT.
+        fftw_iodim dim = {.n = (int)buffer_size, .is = 1, .os = 1};
+        pthread_mutex_lock(&spectrel_planner_mutex);
+        if (is_real)
+        {
+            spectrel_plan->plan =
+                fftw_plan_guru_split_dft_r2c(1,
+                                             &dim,
+                                             0,
+                                             NULL,
+                                             spectrel_plan->input,
+                                             spectrel_plan->real,
+                                             spectrel_plan->imag,
+                                             FFTW_ESTIMATE);
+        }
+        else
+        {
+            spectrel_plan->plan =
+                fftw_plan_guru_split_dft(1,
+                                         &dim,
+                                         0,
+                                         NULL,
+                                         spectrel_plan->real,
+                                         spectrel_plan->imag,
+                                         spectrel_plan->real,
+                                         spectrel_plan->imag,
+                                         FFTW_ESTIMATE);
+        }
+        pthread_mutex_unlock(&spectrel_planner_mutex);
+    }
+
+    if (!spectrel_plan->plan)
+    {
+        spectrel_free_plan(spectrel_plan);
         spectrel_print_error("plan_dft_1d failed");
         return NULL;
     }
+    return spectrel_plan;
+}
 
-    struct spectrel_plan_t *spectrel_plan = malloc(sizeof(*spectrel_plan));
-
-    if (!spectrel_plan)
+// The smallest size at least n with no prime factors above 7, which FFTW
+// transforms as efficiently as a power of two of about the same size.
+static size_t spectrel_get_zoom_size(const size_t n)
+{
+    for (size_t size = n;; size++)
     {
-        fftw_destroy_plan(p);
-        p = NULL;
+        size_t m = size;
+        const size_t factors[] = {2, 3, 5, 7};
+        for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++)
+        {
+            while (m % factors[i] == 0)
+                m /= factors[i];
+        }
+        if (m == 1)
+            return size;
+    }
+}
 
-        spectrel_free_signal(buffer);
-        buffer = NULL;
+// The chirp e^(i pi r n^2), with the phase reduced before it is scaled so
+// that it stays accurate for large n.
+static double complex spectrel_chirp(const double r, const size_t n)
+{
+    double phase = fmod(r * ((double)n * (double)n), 2.0);
+    return cexp(I * M_PI * phase);
+}
+
+spectrel_plan spectrel_make_zoom_plan(const size_t window_size,
+                                      const spectrel_layout_t layout,
+                                      const bool is_real,
+                                      const double sample_rate,
+                                      const double start_frequency,
+                                      const double stop_frequency,
+                                      const size_t num_bins)
+{
+    if (!spectrel_get_layout_name(layout))
+    {
+        spectrel_print_error("Unrecognised layout: %d", layout);
+        return NULL;
+    }
+    if (window_size < 1 || num_bins < 1 || stop_frequency <= start_frequency)
+    {
+        spectrel_print_error("Zoom needs a window, bins and an interval");
+        return NULL;
+    }
 
+    // Prepare plan structure with safe initial values.
+    struct spectrel_plan_t *p = calloc(1, sizeof(*p));
+    if (!p)
+    {
         spectrel_print_error("malloc failed: spectrel_plan");
         return NULL;
     }
+    size_t N = window_size;
+    size_t M = num_bins;
+    size_t L = spectrel_get_zoom_size(N + M - 1);
+    p->layout = layout;
+    p->is_real = is_real;
+    p->num_samples = N;
+    p->num_bins = M;
+    p->zoom_size = L;
+    p->buffer = spectrel_make_buffer(L);
+    p->chirp = fftw_malloc(sizeof(*p->chirp) * N);
+    p->filter = fftw_malloc(sizeof(*p->filter) * L);
+    p->post = fftw_malloc(sizeof(*p->post) * M);
+    p->zoom_frequencies = malloc(sizeof(*p->zoom_frequencies) * M);
+    if (!p->buffer || !p->chirp || !p->filter || !p->post ||
+        !p->zoom_frequencies)
+    {
+        spectrel_free_plan(p);
+        spectrel_print_error("malloc failed: zoom buffers");
+        return NULL;
+    }
 
-    spectrel_plan->buffer = buffer;
-    spectrel_plan->plan = p;
-    return spectrel_plan;
+    pthread_mutex_lock(&spectrel_planner_mutex);
+    p->plan = fftw_plan_dft_1d(L,
+                               p->buffer->samples,
+                               p->buffer->samples,
+                               FFTW_FORWARD,
+                               FFTW_ESTIMATE);
+    p->inverse = fftw_plan_dft_1d(L,
+                                  p->buffer->samples,
+                                  p->buffer->samples,
+                                  FFTW_BACKWARD,
+                                  FFTW_ESTIMATE);
+    pthread_mutex_unlock(&spectrel_planner_mutex);
+    if (!p->plan || !p->inverse)
+    {
+        spectrel_free_plan(p);
+        spectrel_print_error("plan_dft_1d failed");
+        return NULL;
+    }
+
+    // With nk = (n^2 + k^2 - (k - n)^2) / 2, the DFT at frequency a + rk, in
+    // cycles per sample, is a convolution with a chirp (Rabiner et al., 1969).
+    double a = start_frequency / sample_rate;
+    double r = (stop_frequency - start_frequency) / (M * sample_rate);
+    for (size_t n = 0; n < N; n++)
+    {
+        double phase = fmod(a * (double)n, 1.0);
+        p->chirp[n] = cexp(-2 * I * M_PI * phase) * conj(spectrel_chirp(r, n));
+    }
+    for (size_t k = 0; k < M; k++)
+    {
+        p->post[k] = conj(spectrel_chirp(r, k)) / (double)L;
+        p->zoom_frequencies[k] = start_frequency + (double)k * r * sample_rate;
+    }
+
+    // The chirp is wrapped around, so that the convolution is circular.
+    fftw_complex *buffer = p->buffer->samples;
+    memset(buffer, 0, sizeof(*buffer) * L);
+    for (size_t m = 0; m < M; m++)
+        buffer[m] = spectrel_chirp(r, m);
+    for (size_t n = 1; n < N; n++)
+        buffer[L - n] = spectrel_chirp(r, n);
+    fftw_execute(p->plan);
+    memcpy(p->filter, buffer, sizeof(*buffer) * L);
+    return p;
+}
+
+// Evaluate the zoom DFT of the window in the buffer of a zoom plan, leaving
+// the output, less the final chirp, at the start of the buffer.
+static void spectrel_execute_zoom(spectrel_plan p)
+{
+    fftw_complex *buffer = p->buffer->samples;
+    if (p->is_real)
+    {
+        for (size_t n = 0; n < p->num_samples; n++)
+            buffer[n] = creal(buffer[n]);
+    }
+    spectrel_multiply_window(buffer, p->chirp, buffer, p->num_samples);
+    memset(buffer + p->num_samples,
+           0,
+           sizeof(*buffer) * (p->zoom_size - p->num_samples));
+    fftw_execute(p->plan);
+    spectrel_multiply_window(buffer, p->filter, buffer, p->zoom_size);
+    fftw_execute(p->inverse);
+}
+
+// Allocate a spectrogram, and each of its members, from the arena. Either
+// everything is allocated, or nothing is and the arena is left as it was.
+static spectrel_spectrogram_t *
+spectrel_alloc_from_arena(const size_t num_spectrums,
+                          const size_t num_samples_per_spectrum,
+                          const spectrel_layout_t layout,
+                          spectrel_arena arena)
+{
+    size_t used = spectrel_get_arena_used(arena);
+    spectrel_spectrogram_t *s = spectrel_arena_alloc(arena, sizeof(*s));
+    if (!s)
+    {
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->num_spectrums = num_spectrums;
+    s->num_samples_per_spectrum = num_samples_per_spectrum;
+    s->layout = layout;
+
+    size_t num_samples = num_samples_per_spectrum * num_spectrums;
+    s->times =
+        spectrel_arena_alloc(arena, sizeof(*s->times) * s->num_spectrums);
+    s->frequencies = spectrel_arena_alloc(
+        arena, sizeof(*s->frequencies) * s->num_samples_per_spectrum);
+    if (s->layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        s->samples =
+            spectrel_arena_alloc(arena, sizeof(*s->samples) * num_samples);
+    }
+    else
+    {
+        s->real = spectrel_arena_alloc(arena, sizeof(*s->real) * num_samples);
+        s->imag = spectrel_arena_alloc(arena, sizeof(*s->imag) * num_samples);
+    }
+    if (s->times && s->frequencies &&
+        (s->layout == SPECTREL_LAYOUT_INTERLEAVED ? s->samples != NULL
+                                                  : s->real && s->imag))
+    {
+        s->arena = arena;
+        return s;
+    }
+
+    spectrel_rewind_arena(arena, used);
+    return NULL;
 }
 
 static spectrel_spectrogram_t *
 spectrel_make_empty_spectrogram(const size_t num_spectrums,
-                                const size_t num_samples_per_spectrum)
+                                const size_t num_samples_per_spectrum,
+                                const spectrel_layout_t layout,
+                                spectrel_arena arena)
 {
-    spectrel_spectrogram_t *spectrogram = malloc(sizeof(*spectrogram));
+    // Fall back to the heap if there is no arena, or it is full.
+    spectrel_spectrogram_t *spectrogram = spectrel_alloc_from_arena(
+        num_spectrums, num_samples_per_spectrum, layout, arena);
+    if (spectrogram)
+    {
+        return spectrogram;
+    }
+
+    spectrogram = calloc(1, sizeof(*spectrogram));
     if (!spectrogram)
     {
         spectrel_print_error("malloc failed: spectrogram");
         return NULL;
     }
+    spectrogram->num_spectrums = num_spectrums;
+    spectrogram->num_samples_per_spectrum = num_samples_per_spectrum;
+    spectrogram->layout = layout;
 
-    double *times = malloc(sizeof(*times) * num_spectrums);
-    if (!times)
+    spectrogram->times = malloc(sizeof(*spectrogram->times) * num_spectrums);
+    if (!spectrogram->times)
     {
-        free(spectrogram);
-        spectrogram = NULL;
+        spectrel_free_spectrogram(spectrogram);
         spectrel_print_error("malloc failed: times");
         return NULL;
     }
 
-    double *frequencies =
-        malloc(sizeof(*frequencies) * num_samples_per_spectrum);
-    if (!frequencies)
+    spectrogram->frequencies =
+        malloc(sizeof(*spectrogram->frequencies) * num_samples_per_spectrum);
+    if (!spectrogram->frequencies)
     {
-
-        free(spectrogram);
-        spectrogram = NULL;
-
-        free(times);
-        times = NULL;
+        spectrel_free_spectrogram(spectrogram);
         spectrel_print_error("malloc failed: frequencies");
         return NULL;
     }
 
-    fftw_complex *samples = fftw_malloc(
-        sizeof(*samples) * num_samples_per_spectrum * num_spectrums);
-    if (!samples)
+    size_t num_samples = num_samples_per_spectrum * num_spectrums;
+    if (layout == SPECTREL_LAYOUT_INTERLEAVED)
     {
-        free(spectrogram);
-        spectrogram = NULL;
-
-        free(times);
-        times = NULL;
-
-        free(frequencies);
-        frequencies = NULL;
-
+        spectrogram->samples =
+            fftw_malloc(sizeof(*spectrogram->samples) * num_samples);
+    }
+    else
+    {
+        spectrogram->real =
+            fftw_malloc(sizeof(*spectrogram->real) * num_samples);
+        spectrogram->imag =
+            fftw_malloc(sizeof(*spectrogram->imag) * num_samples);
+    }
+    if (layout == SPECTREL_LAYOUT_INTERLEAVED
+            ? !spectrogram->samples
+            : !spectrogram->real || !spectrogram->imag)
+    {
+        spectrel_free_spectrogram(spectrogram);
         spectrel_print_error("malloc failed: samples");
         return NULL;
     }
-
-    spectrogram->num_spectrums = num_spectrums;
-    spectrogram->num_samples_per_spectrum = num_samples_per_spectrum;
-    spectrogram->samples = samples;
-    spectrogram->times = times;
-    spectrogram->frequencies = frequencies;
     return spectrogram;
 }
 
 void spectrel_free_spectrogram(spectrel_spectrogram_t *spectrogram)
 {
+    bool is_in_arena = spectrogram && spectrogram->arena;
+    if (is_in_arena)
+    {
+        // A spectrogram in an arena, and its members, are released by
+        // rewinding it.
+        spectrogram->samples = NULL;
+        spectrogram->real = NULL;
+        spectrogram->imag = NULL;
+        spectrogram->times = NULL;
+        spectrogram->frequencies = NULL;
+    }
     if (spectrogram)
     {
         if (spectrogram->samples)
@@ -293,6 +811,18 @@ void spectrel_free_spectrogram(spectrel_spectrogram_t *spectrogram)
             spectrogram->samples = NULL;
         }
 
+        if (spectrogram->real)
+        {
+            fftw_free(spectrogram->real);
+            spectrogram->real = NULL;
+        }
+
+        if (spectrogram->imag)
+        {
+            fftw_free(spectrogram->imag);
+            spectrogram->imag = NULL;
+        }
+
         if (spectrogram->times)
         {
             free(spectrogram->times);
@@ -315,7 +845,10 @@ void spectrel_free_spectrogram(spectrel_spectrogram_t *spectrogram)
             spectrogram->num_spectrums = 0;
         }
 
-        free(spectrogram);
+        if (!is_in_arena)
+        {
+            free(spectrogram);
+        }
     }
 }
 
@@ -330,11 +863,80 @@ static void spectrel_compute_times(double *times,
     }
 }
 
-static void spectrel_compute_frequencies(double *frequencies,
-                                         const size_t num_samples_per_spectrum,
-                                         const double sample_rate)
+void spectrel_copy_spectrum(const spectrel_spectrogram_t *s,
+                            const size_t n,
+                            fftw_complex *samples)
 {
-    size_t M = num_samples_per_spectrum;
+    size_t M = s->num_samples_per_spectrum;
+    if (s->layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        memcpy(samples, s->samples + n * M, sizeof(fftw_complex) * M);
+        return;
+    }
+    double *components = (double *)samples;
+    for (size_t m = 0; m < M; m++)
+    {
+        components[2 * m] = s->real[n * M + m];
+        components[2 * m + 1] = s->imag[n * M + m];
+    }
+}
+
+void spectrel_compute_spectrum_power(const spectrel_spectrogram_t *s,
+                                     const size_t n,
+                                     double *power)
+{
+    size_t M = s->num_samples_per_spectrum;
+    if (s->layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        spectrel_compute_power(s->samples + n * M, power, M);
+    }
+    else
+    {
+        spectrel_compute_split_power(
+            s->real + n * M, s->imag + n * M, power, M);
+    }
+}
+
+void spectrel_compute_spectrum_power_db(const spectrel_spectrogram_t *s,
+                                        const size_t n,
+                                        float *power_db)
+{
+    size_t M = s->num_samples_per_spectrum;
+    if (s->layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        spectrel_compute_power_db(s->samples + n * M, power_db, M);
+    }
+    else
+    {
+        spectrel_compute_split_power_db(
+            s->real + n * M, s->imag + n * M, power_db, M);
+    }
+}
+
+int64_t spectrel_get_spectrum_time(const spectrel_spectrogram_t *s,
+                                   const size_t n)
+{
+    return s->time + llround(s->times[n] * 1e9);
+}
+
+void spectrel_compute_frequencies(double *frequencies,
+                                  const size_t window_size,
+                                  const double sample_rate,
+                                  const bool is_real)
+{
+    size_t M = window_size;
+    if (is_real)
+    {
+        // The spectrum of a real signal is conjugate symmetric, so only the
+        // non-negative frequencies are kept, in ascending order.
+        size_t num_bins = spectrel_get_num_bins(M, is_real);
+        for (size_t m = 0; m < num_bins; m++)
+        {
+            frequencies[m] = ((double)m / M) * sample_rate;
+        }
+        return;
+    }
+
     for (size_t m = 0; m < M; m++)
     {
         if (m < M / 2)
@@ -363,6 +965,7 @@ void spectrel_describe_spectrogram(const spectrel_spectrogram_t *spectrogram)
 
     size_t N = spectrogram->num_spectrums;
     size_t M = spectrogram->num_samples_per_spectrum;
+    bool is_split = spectrogram->layout == SPECTREL_LAYOUT_SPLIT;
     for (size_t n = 0; n < N; n++)
     {
         printf("Time %.2f [s]:\n", spectrogram->times[n]);
@@ -370,22 +973,67 @@ void spectrel_describe_spectrogram(const spectrel_spectrogram_t *spectrogram)
         {
             printf("  %.2f [Hz]: %.2f + %.2fi\n",
                    spectrogram->frequencies[m],
-                   creal(spectrogram->samples[n * M + m]),
-                   cimag(spectrogram->samples[n * M + m]));
+                   is_split ? spectrogram->real[n * M + m]
+                            : creal(spectrogram->samples[n * M + m]),
+                   is_split ? spectrogram->imag[n * M + m]
+                            : cimag(spectrogram->samples[n * M + m]));
         }
     }
 }
 
+// The number of spectrums is determined by the hop and window size.
+static size_t spectrel_count_spectrums(const size_t signal_size,
+                                       const size_t window_size,
+                                       const size_t window_hop)
+{
+    return ((signal_size - (size_t)ceil(window_size / 2)) / window_hop) + 1;
+}
+
+size_t spectrel_get_stfft_size(const size_t signal_size,
+                               const size_t window_size,
+                               const size_t window_hop,
+                               const spectrel_layout_t layout,
+                               const bool is_real)
+{
+    return spectrel_get_zoom_stfft_size(signal_size,
+                                        window_size,
+                                        window_hop,
+                                        spectrel_get_num_bins(window_size,
+                                                              is_real),
+                                        layout);
+}
+
+size_t spectrel_get_zoom_stfft_size(const size_t signal_size,
+                                    const size_t window_size,
+                                    const size_t window_hop,
+                                    const size_t num_bins,
+                                    const spectrel_layout_t layout)
+{
+    size_t num_spectrums =
+        spectrel_count_spectrums(signal_size, window_size, window_hop);
+    size_t num_samples = num_spectrums * num_bins;
+    size_t size = spectrel_get_arena_size(sizeof(spectrel_spectrogram_t)) +
+                  spectrel_get_arena_size(sizeof(double) * num_spectrums) +
+                  spectrel_get_arena_size(sizeof(double) * num_bins);
+    if (layout == SPECTREL_LAYOUT_INTERLEAVED)
+    {
+        return size +
+               spectrel_get_arena_size(sizeof(fftw_complex) * num_samples);
+    }
+    return size + 2 * spectrel_get_arena_size(sizeof(double) * num_samples);
+}
+
 spectrel_spectrogram_t *spectrel_stfft(spectrel_plan p,
                                        const spectrel_signal_t *window,
                                        const spectrel_signal_t *signal,
                                        const size_t window_hop,
-                                       const double sample_rate)
+                                       const double sample_rate,
+                                       spectrel_arena arena)
 {
 
     size_t window_size = window->num_samples;
     size_t window_midpoint = window_size / 2;
-    size_t buffer_size = p->buffer->num_samples;
+    size_t buffer_size = p->num_samples;
     size_t signal_size = signal->num_samples;
 
     if (buffer_size != window_size)
@@ -406,17 +1054,23 @@ spectrel_spectrogram_t *spectrel_stfft(spectrel_plan p,
         return NULL;
     }
 
-    // The number of spectrums is determined by the hop and window size.
+    if (window->format != SPECTREL_FORMAT_CF64)
+    {
+        spectrel_print_error("Window must be in the CF64 format");
+        return NULL;
+    }
+    size_t sample_size = spectrel_get_sample_size(signal->format);
+
     size_t num_spectrums =
-        ((signal_size - (size_t)ceil(window_size / 2)) / window_hop) + 1;
+        spectrel_count_spectrums(signal_size, window_size, window_hop);
 
     // The number of samples in the spectrum is the same number of samples in
-    // each window.
-    size_t num_samples_per_spectrum = window_size;
+    // each window, unless the redundant half of a real DFT is discarded.
+    size_t num_samples_per_spectrum = p->num_bins;
 
     // Allocate memory for an empty spectrogram.
     spectrel_spectrogram_t *s = spectrel_make_empty_spectrogram(
-        num_spectrums, num_samples_per_spectrum);
+        num_spectrums, num_samples_per_spectrum, p->layout, arena);
 
     // Handle if the memory allocation fails
     if (!s)
@@ -426,53 +1080,198 @@ spectrel_spectrogram_t *spectrel_stfft(spectrel_plan p,
     }
 
     // Assign baseband frequencies to each spectral component.
-    spectrel_compute_frequencies(
-        s->frequencies, num_samples_per_spectrum, sample_rate);
+    if (p->zoom_size)
+    {
+        memcpy(s->frequencies,
+               p->zoom_frequencies,
+               sizeof(*s->frequencies) * num_samples_per_spectrum);
+    }
+    else
+    {
+        spectrel_compute_frequencies(
+            s->frequencies, window_size, sample_rate, p->is_real);
+    }
 
     // Assign physical times to each spectrum in the spectrogram.
     spectrel_compute_times(s->times, num_spectrums, sample_rate, window_hop);
 
     // Initialise the window such that it's mid-point is at signal index 0.
-    int signal_index = -1 * window_midpoint;
+    ptrdiff_t signal_index = -1 * (ptrdiff_t)window_midpoint;
 
     for (size_t n = 0; n < num_spectrums; n++)
     {
-        // Copy the samples for the current window into the buffer.
-        // (The signal is assumed to be zero if the window dangles).
-        for (size_t m = 0; m < window_size; m++)
+        // Window the samples into the buffer. The signal is assumed to be zero
+        // where the window dangles, outside [start, end).
+        ptrdiff_t start = signal_index < 0 ? -signal_index : 0;
+        ptrdiff_t end = (ptrdiff_t)signal_size - signal_index;
+        end = end > (ptrdiff_t)window_size ? (ptrdiff_t)window_size : end;
+        end = end < start ? start : end;
+        const void *samples =
+            (const char *)signal->data + (signal_index + start) * sample_size;
+        size_t offset = n * num_samples_per_spectrum;
+
+        if (p->zoom_size)
         {
-            if (signal_index < 0 || signal_index >= signal_size)
-            {
-                p->buffer->samples[m] = 0;
-            }
-            else
-            {
-                p->buffer->samples[m] =
-                    signal->samples[signal_index] * window->samples[m];
-            }
-
-            signal_index += 1;
+            // Zoom plans window the samples into their own buffer, whatever
+            // the layout, and complete the chirp as they copy the result.
+            fftw_complex *buffer = p->buffer->samples;
+            memset(buffer, 0, sizeof(*buffer) * start);
+            spectrel_convert_window(samples,
+                                    signal->format,
+                                    signal->scale,
+                                    window->samples + start,
+                                    buffer + start,
+                                    end - start);
+            memset(buffer + end, 0, sizeof(*buffer) * (window_size - end));
+            spectrel_execute_zoom(p);
+        }
+        else if (p->is_real)
+        {
+            memset(p->input, 0, sizeof(*p->input) * start);
+            spectrel_convert_window_real(samples,
+                                         signal->format,
+                                         signal->scale,
+                                         window->samples + start,
+                                         p->input + start,
+                                         end - start);
+            memset(p->input + end, 0, sizeof(*p->input) * (window_size - end));
+            fftw_execute(p->plan);
+        }
+        else if (p->layout == SPECTREL_LAYOUT_INTERLEAVED)
+        {
+            fftw_complex *buffer = p->buffer->samples;
+            memset(buffer, 0, sizeof(*buffer) * start);
+            spectrel_convert_window(samples,
+                                    signal->format,
+                                    signal->scale,
+                                    window->samples + start,
+                                    buffer + start,
+                                    end - start);
+            memset(buffer + end, 0, sizeof(*buffer) * (window_size - end));
+
+            fftw_execute(p->plan);
+        }
+        else
+        {
+            memset(p->real, 0, sizeof(*p->real) * start);
+            memset(p->imag, 0, sizeof(*p->imag) * start);
+            spectrel_convert_window_split(samples,
+                                          signal->format,
+                                          signal->scale,
+                                          window->samples + start,
+                                          p->real + start,
+                                          p->imag + start,
+                                          end - start);
+            memset(p->real + end, 0, sizeof(*p->real) * (window_size - end));
+            memset(p->imag + end, 0, sizeof(*p->imag) * (window_size - end));
+
+            fftw_execute(p->plan);
         }
 
-        // Execute the DFT.
-        fftw_execute(p->plan);
-
-        // Copy the result into the spectrogram.
-        memcpy(s->samples + n * num_samples_per_spectrum,
-               p->buffer->samples,
-               sizeof(fftw_complex) * buffer_size);
+        // Copy the result of the DFT into the spectrogram.
+        if (p->zoom_size && p->layout == SPECTREL_LAYOUT_INTERLEAVED)
+        {
+            spectrel_multiply_window(p->buffer->samples,
+                                     p->post,
+                                     s->samples + offset,
+                                     num_samples_per_spectrum);
+        }
+        else if (p->zoom_size)
+        {
+            spectrel_multiply_window_split(p->buffer->samples,
+                                           p->post,
+                                           s->real + offset,
+                                           s->imag + offset,
+                                           num_samples_per_spectrum);
+        }
+        else if (p->layout == SPECTREL_LAYOUT_INTERLEAVED)
+        {
+            memcpy(s->samples + offset,
+                   p->buffer->samples,
+                   sizeof(fftw_complex) * num_samples_per_spectrum);
+        }
+        else
+        {
+            memcpy(s->real + offset,
+                   p->real,
+                   sizeof(double) * num_samples_per_spectrum);
+            memcpy(s->imag + offset,
+                   p->imag,
+                   sizeof(double) * num_samples_per_spectrum);
+        }
 
-        // Reset the signal index then hop the window forward.
-        signal_index = (signal_index - window_size) + window_hop;
+        // Hop the window forward.
+        signal_index += window_hop;
     }
     return s;
 }
 
 int spectrel_write_spectrogram(spectrel_spectrogram_t *s, spectrel_file_t *file)
 {
-    fwrite(s->samples,
-           sizeof(*s->samples),
-           s->num_samples_per_spectrum,
-           file->file);
+    if (file->encoding != SPECTREL_ENCODING_CF64)
+    {
+        return spectrel_write_quantised_spectrogram(s, file);
+    }
+
+    // Recordings are always interleaved.
+    size_t num_samples = s->num_spectrums * s->num_samples_per_spectrum;
+
+    // With a writer, each spectrum is copied straight into its buffers.
+    if (file->writer)
+    {
+        size_t spectrum_size =
+            sizeof(fftw_complex) * s->num_samples_per_spectrum;
+        for (size_t n = 0; n < s->num_spectrums; n++)
+        {
+            void *record = spectrel_reserve_write(file->writer, spectrum_size);
+            if (!record)
+            {
+                return SPECTREL_FAILURE;
+            }
+            spectrel_copy_spectrum(s, n, record);
+        }
+        spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                             num_samples * sizeof(fftw_complex));
+        return spectrel_commit_writes(file->writer);
+    }
+
+    fftw_complex *samples = s->samples;
+    size_t used = spectrel_get_arena_used(s->arena);
+    bool is_scratch_on_heap = false;
+    if (s->layout == SPECTREL_LAYOUT_SPLIT)
+    {
+        samples =
+            spectrel_arena_alloc(s->arena, sizeof(*samples) * num_samples);
+        if (!samples)
+        {
+            samples = fftw_malloc(sizeof(*samples) * num_samples);
+            is_scratch_on_heap = true;
+        }
+        if (!samples)
+        {
+            spectrel_print_error("malloc failed: samples");
+            return SPECTREL_FAILURE;
+        }
+        for (size_t n = 0; n < s->num_spectrums; n++)
+        {
+            spectrel_copy_spectrum(
+                s, n, samples + n * s->num_samples_per_spectrum);
+        }
+    }
+    size_t num_written =
+        fwrite(samples, sizeof(*samples), num_samples, file->file);
+    if (is_scratch_on_heap)
+    {
+        fftw_free(samples);
+        samples = NULL;
+    }
+    spectrel_rewind_arena(s->arena, used);
+    if (num_written != num_samples)
+    {
+        spectrel_print_error("fwrite failed: %s", file->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         num_samples * sizeof(*s->samples));
     return SPECTREL_SUCCESS;
 }
\ No newline at end of file
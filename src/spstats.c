@@ -0,0 +1,222 @@
+#include "spstats.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct spectrel_stats_t
+{
+    FILE *file;
+    char *path;
+    size_t num_samples_per_spectrum;
+    size_t num_spectrums_per_frame;
+    uint64_t num_spectrums; // The number of spectrums accumulated so far.
+    spectrel_stats_frame_t frame; // The frame being accumulated.
+    double *power;
+    double *moments; // The running mean, central moments (M2, M3 and M4),
+                     // min and max of each sample, one array after another.
+    float *record;   // The statistics written for each frame.
+};
+
+// The number of running moments kept for each sample.
+#define SPECTREL_STATS_NUM_MOMENTS 6
+
+// The number of statistics written for each sample.
+#define SPECTREL_STATS_NUM_FIELDS 5
+
+static void spectrel_clear_stats(spectrel_stats stats)
+{
+    if (stats->file)
+    {
+        fclose(stats->file);
+        stats->file = NULL;
+    }
+    if (stats->path)
+    {
+        free(stats->path);
+        stats->path = NULL;
+    }
+    if (stats->power)
+    {
+        free(stats->power);
+        stats->power = NULL;
+    }
+    if (stats->moments)
+    {
+        free(stats->moments);
+        stats->moments = NULL;
+    }
+    if (stats->record)
+    {
+        free(stats->record);
+        stats->record = NULL;
+    }
+}
+
+static int spectrel_write_stats_frame(spectrel_stats stats)
+{
+    size_t M = stats->num_samples_per_spectrum;
+    size_t count = stats->frame.num_spectrums;
+    const double *mean = stats->moments;
+    const double *m2 = mean + M;
+    const double *m4 = m2 + 2 * M;
+    const double *min = m4 + M;
+    const double *max = min + M;
+
+    float *record = stats->record;
+    for (size_t m = 0; m < M; m++)
+    {
+        // The kurtosis is 3 for Gaussian power, and 9 for the exponentially
+        // distributed power of Gaussian noise.
+        double variance = count > 1 ? m2[m] / (double)(count - 1) : 0;
+        double kurtosis =
+            m2[m] > 0 ? (double)count * m4[m] / (m2[m] * m2[m]) : 0;
+        record[m] = (float)mean[m];
+        record[M + m] = (float)variance;
+        record[2 * M + m] = (float)min[m];
+        record[3 * M + m] = (float)max[m];
+        record[4 * M + m] = (float)kurtosis;
+    }
+
+    size_t num_values = SPECTREL_STATS_NUM_FIELDS * M;
+    if (fwrite(&stats->frame, sizeof(stats->frame), 1, stats->file) != 1 ||
+        fwrite(record, sizeof(*record), num_values, stats->file) !=
+            num_values)
+    {
+        spectrel_print_error("fwrite failed: %s", stats->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         sizeof(stats->frame) + num_values * sizeof(*record));
+
+    memset(stats->moments,
+           0,
+           sizeof(*stats->moments) * SPECTREL_STATS_NUM_MOMENTS * M);
+    stats->frame.num_spectrums = 0;
+    return SPECTREL_SUCCESS;
+}
+
+void spectrel_free_stats(spectrel_stats stats)
+{
+    if (stats)
+    {
+        // A failure to write is reported, but the resources are still freed.
+        if (stats->file && stats->frame.num_spectrums > 0)
+        {
+            spectrel_write_stats_frame(stats);
+        }
+        spectrel_clear_stats(stats);
+        free(stats);
+    }
+}
+
+spectrel_stats spectrel_make_stats(const char *path,
+                                   const size_t num_samples_per_spectrum,
+                                   const size_t num_spectrums_per_frame,
+                                   const double spectrum_interval)
+{
+    if (num_spectrums_per_frame < 1)
+    {
+        spectrel_print_error("Statistics interval must hold a spectrum");
+        return NULL;
+    }
+
+    // Prepare statistics structure with safe initial values.
+    spectrel_stats stats = calloc(1, sizeof(*stats));
+    if (!stats)
+    {
+        spectrel_print_error("malloc failed: stats");
+        return NULL;
+    }
+    size_t M = num_samples_per_spectrum;
+    stats->num_samples_per_spectrum = M;
+    stats->num_spectrums_per_frame = num_spectrums_per_frame;
+    stats->power = malloc(sizeof(*stats->power) * M);
+    stats->moments =
+        calloc(SPECTREL_STATS_NUM_MOMENTS * M, sizeof(*stats->moments));
+    stats->record =
+        malloc(sizeof(*stats->record) * SPECTREL_STATS_NUM_FIELDS * M);
+    if (!stats->power || !stats->moments || !stats->record)
+    {
+        spectrel_free_stats(stats);
+        spectrel_print_error("malloc failed: stats buffers");
+        return NULL;
+    }
+
+    // Append the extension to the path of the spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".stats") + 1;
+    stats->path = malloc(num_chars_path);
+    if (!stats->path)
+    {
+        spectrel_free_stats(stats);
+        spectrel_print_error("malloc failed: path");
+        return NULL;
+    }
+    snprintf(stats->path, num_chars_path, "%s.stats", path);
+
+    stats->file = fopen(stats->path, "wb");
+    if (!stats->file)
+    {
+        spectrel_print_error("fopen failed: %s", stats->path);
+        spectrel_free_stats(stats);
+        return NULL;
+    }
+
+    spectrel_stats_header_t header = {0};
+    memcpy(header.magic, SPECTREL_STATS_MAGIC, sizeof(SPECTREL_STATS_MAGIC));
+    header.num_samples_per_spectrum = M;
+    header.num_spectrums_per_frame = num_spectrums_per_frame;
+    header.spectrum_interval = spectrum_interval;
+    if (fwrite(&header, sizeof(header), 1, stats->file) != 1)
+    {
+        spectrel_print_error("fwrite failed: %s", stats->path);
+        spectrel_free_stats(stats);
+        return NULL;
+    }
+    return stats;
+}
+
+int spectrel_update_stats(spectrel_stats stats,
+                          const spectrel_spectrogram_t *s)
+{
+    size_t M = stats->num_samples_per_spectrum;
+    if (s->num_samples_per_spectrum != M)
+    {
+        spectrel_print_error("Spectrogram does not match the statistics");
+        return SPECTREL_FAILURE;
+    }
+
+    double *mean = stats->moments;
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        if (stats->frame.num_spectrums == 0)
+        {
+            stats->frame.time = s->time ? spectrel_get_spectrum_time(s, n) : 0;
+            stats->frame.index = stats->num_spectrums;
+        }
+        stats->frame.num_spectrums += 1;
+        stats->num_spectrums += 1;
+
+        spectrel_compute_spectrum_power(s, n, stats->power);
+        spectrel_accumulate_moments(stats->power,
+                                    stats->frame.num_spectrums,
+                                    mean,
+                                    mean + M,
+                                    mean + 2 * M,
+                                    mean + 3 * M,
+                                    mean + 4 * M,
+                                    mean + 5 * M,
+                                    M);
+
+        if (stats->frame.num_spectrums == stats->num_spectrums_per_frame &&
+            spectrel_write_stats_frame(stats) != 0)
+        {
+            return SPECTREL_FAILURE;
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "sptimes.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct spectrel_times_t
+{
+    FILE *file;
+    char *path;
+};
+
+void spectrel_free_times(spectrel_times times)
+{
+    if (times)
+    {
+        if (times->file)
+        {
+            fclose(times->file);
+            times->file = NULL;
+        }
+        if (times->path)
+        {
+            free(times->path);
+            times->path = NULL;
+        }
+        free(times);
+    }
+}
+
+spectrel_times spectrel_make_times(const char *path,
+                                   const size_t window_hop,
+                                   const double sample_rate,
+                                   const bool is_real)
+{
+    // Prepare timestamp structure with safe initial values.
+    spectrel_times times = calloc(1, sizeof(*times));
+    if (!times)
+    {
+        spectrel_print_error("malloc failed: times");
+        return NULL;
+    }
+
+    // Append to the path of the spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".times") + 1;
+    times->path = malloc(num_chars_path);
+    if (!times->path)
+    {
+        spectrel_free_times(times);
+        spectrel_print_error("malloc failed: path");
+        return NULL;
+    }
+    snprintf(times->path, num_chars_path, "%s.times", path);
+
+    times->file = fopen(times->path, "wb");
+    if (!times->file)
+    {
+        spectrel_print_error("fopen failed: %s", times->path);
+        spectrel_free_times(times);
+        return NULL;
+    }
+
+    spectrel_times_header_t header = {0};
+    memcpy(header.magic, SPECTREL_TIMES_MAGIC, sizeof(SPECTREL_TIMES_MAGIC));
+    header.window_hop = window_hop;
+    header.sample_rate = sample_rate;
+    header.is_real = is_real;
+    if (fwrite(&header, sizeof(header), 1, times->file) != 1)
+    {
+        spectrel_print_error("fwrite failed: %s", times->path);
+        spectrel_free_times(times);
+        return NULL;
+    }
+    return times;
+}
+
+int spectrel_write_times(spectrel_times times, const spectrel_spectrogram_t *s)
+{
+    spectrel_times_record_t record = {.time = s->time,
+                                      .num_spectrums = s->num_spectrums};
+    if (fwrite(&record, sizeof(record), 1, times->file) != 1)
+    {
+        spectrel_print_error("fwrite failed: %s", times->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN, sizeof(record));
+    return SPECTREL_SUCCESS;
+}
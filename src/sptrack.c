@@ -0,0 +1,373 @@
+#include "sptrack.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spkernel.h"
+#include "spmetrics.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of samples converted from the buffer at a time.
+#define SPECTREL_TRACK_CHUNK_SIZE 4096
+
+// The number of windows between each time the accumulators are recomputed
+// from the window, which discards the rounding errors they have gathered.
+#define SPECTREL_TRACK_RESYNC_WINDOWS 64
+
+struct spectrel_tracker_t
+{
+    FILE *file;
+    char *path;
+    size_t num_bins;
+    size_t window_size;
+    size_t window_hop;
+    size_t buffer_size;
+    double sample_rate;
+    bool is_real;
+    size_t position;      // The position of the next sample in the window.
+    size_t num_pending;   // The number of samples tracked since the last
+                          // output.
+    size_t num_windows;   // The number of windows tracked since the
+                          // accumulators were last recomputed.
+    uint64_t num_outputs; // The number of outputs written so far.
+    double *twiddle_real; // The twiddle of each bin, for each position in the
+    double *twiddle_imag; // window, one row per position.
+    double *acc_real;     // The modulated DFT of each bin.
+    double *acc_imag;
+    double *window_real;  // The samples in the window, by their position.
+    double *window_imag;
+    double *input_real;   // The samples of the chunk being tracked.
+    double *input_imag;
+    double *delta_real;   // The change in the window at each sample.
+    double *delta_imag;
+    spectrel_signal_t *ones; // The window samples are converted with.
+    float *outputs;          // The outputs for each buffer.
+};
+
+void spectrel_free_tracker(spectrel_tracker tracker)
+{
+    if (tracker)
+    {
+        if (tracker->file)
+        {
+            fclose(tracker->file);
+            tracker->file = NULL;
+        }
+        if (tracker->path)
+        {
+            free(tracker->path);
+            tracker->path = NULL;
+        }
+        if (tracker->ones)
+        {
+            spectrel_free_signal(tracker->ones);
+            tracker->ones = NULL;
+        }
+        free(tracker->twiddle_real);
+        free(tracker->twiddle_imag);
+        free(tracker->acc_real);
+        free(tracker->acc_imag);
+        free(tracker->window_real);
+        free(tracker->window_imag);
+        free(tracker->input_real);
+        free(tracker->input_imag);
+        free(tracker->delta_real);
+        free(tracker->delta_imag);
+        free(tracker->outputs);
+        free(tracker);
+    }
+}
+
+// Find the bin nearest each frequency, and fill in the twiddles of each bin.
+static int spectrel_plan_tracker(spectrel_tracker tracker,
+                                 const spectrel_track_params_t *params,
+                                 double *bin_frequencies)
+{
+    size_t N = tracker->window_size;
+    size_t K = tracker->num_bins;
+    double resolution = params->sample_rate / (double)N;
+    for (size_t b = 0; b < K; b++)
+    {
+        long long k =
+            llround((params->frequencies[b] - params->frequency) / resolution);
+        long long lowest = params->is_real ? 0 : -(long long)(N / 2);
+        long long highest = params->is_real ? (long long)(N / 2)
+                                            : (long long)((N - 1) / 2);
+        if (k < lowest || k > highest)
+        {
+            spectrel_print_error("Tracked frequency is outside the band: %.1f",
+                                 params->frequencies[b]);
+            return SPECTREL_FAILURE;
+        }
+        bin_frequencies[b] = params->frequency + (double)k * resolution;
+
+        // Reduce the phase of each twiddle exactly, in integers, so that it
+        // stays accurate however large the window.
+        size_t bin = (size_t)(k < 0 ? k + (long long)N : k);
+        for (size_t m = 0; m < N; m++)
+        {
+            double angle = -2 * M_PI * (double)((bin * m) % N) / (double)N;
+            tracker->twiddle_real[m * K + b] = cos(angle);
+            tracker->twiddle_imag[m * K + b] = sin(angle);
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_tracker spectrel_make_tracker(const char *path,
+                                       const spectrel_track_params_t *params)
+{
+    if (params->num_frequencies < 1 ||
+        params->num_frequencies > SPECTREL_MAX_TRACKED_FREQUENCIES ||
+        params->window_size < 1 || params->window_hop < 1)
+    {
+        spectrel_print_error("Tracker must have from 1 to %d frequencies, a "
+                             "window and a hop",
+                             SPECTREL_MAX_TRACKED_FREQUENCIES);
+        return NULL;
+    }
+
+    // Prepare tracker structure with safe initial values.
+    spectrel_tracker tracker = calloc(1, sizeof(*tracker));
+    if (!tracker)
+    {
+        spectrel_print_error("malloc failed: tracker");
+        return NULL;
+    }
+    size_t N = params->window_size;
+    size_t K = params->num_frequencies;
+    size_t C = SPECTREL_TRACK_CHUNK_SIZE;
+    size_t max_outputs = params->buffer_size / params->window_hop + 1;
+    tracker->num_bins = K;
+    tracker->window_size = N;
+    tracker->window_hop = params->window_hop;
+    tracker->buffer_size = params->buffer_size;
+    tracker->sample_rate = params->sample_rate;
+    tracker->is_real = params->is_real;
+    tracker->twiddle_real = malloc(sizeof(double) * N * K);
+    tracker->twiddle_imag = malloc(sizeof(double) * N * K);
+    tracker->acc_real = calloc(K, sizeof(double));
+    tracker->acc_imag = calloc(K, sizeof(double));
+    tracker->window_real = calloc(N, sizeof(double));
+    tracker->window_imag = calloc(N, sizeof(double));
+    tracker->input_real = malloc(sizeof(double) * C);
+    tracker->input_imag = malloc(sizeof(double) * C);
+    tracker->delta_real = malloc(sizeof(double) * C);
+    tracker->delta_imag = malloc(sizeof(double) * C);
+    tracker->outputs = malloc(sizeof(float) * 2 * K * max_outputs);
+    if (!tracker->twiddle_real || !tracker->twiddle_imag ||
+        !tracker->acc_real || !tracker->acc_imag || !tracker->window_real ||
+        !tracker->window_imag || !tracker->input_real ||
+        !tracker->input_imag || !tracker->delta_real ||
+        !tracker->delta_imag || !tracker->outputs)
+    {
+        spectrel_free_tracker(tracker);
+        spectrel_print_error("malloc failed: tracker buffers");
+        return NULL;
+    }
+
+    // Samples are only converted, not windowed, since a sliding DFT is always
+    // over a boxcar window, so this is not made with spectrel_make_window.
+    spectrel_constant_params_t ones_params = {1.0};
+    tracker->ones =
+        spectrel_make_signal(C, SPECTREL_CONSTANT_SIGNAL, &ones_params);
+    if (!tracker->ones)
+    {
+        spectrel_free_tracker(tracker);
+        return NULL;
+    }
+
+    double bin_frequencies[SPECTREL_MAX_TRACKED_FREQUENCIES];
+    if (spectrel_plan_tracker(tracker, params, bin_frequencies) != 0)
+    {
+        spectrel_free_tracker(tracker);
+        return NULL;
+    }
+
+    // Append the extension to the path of the spectrogram.
+    size_t num_chars_path = strlen(path) + strlen(".track") + 1;
+    tracker->path = malloc(num_chars_path);
+    if (!tracker->path)
+    {
+        spectrel_free_tracker(tracker);
+        spectrel_print_error("malloc failed: path");
+        return NULL;
+    }
+    snprintf(tracker->path, num_chars_path, "%s.track", path);
+
+    tracker->file = fopen(tracker->path, "wb");
+    if (!tracker->file)
+    {
+        spectrel_print_error("fopen failed: %s", tracker->path);
+        spectrel_free_tracker(tracker);
+        return NULL;
+    }
+
+    spectrel_track_header_t header = {0};
+    memcpy(header.magic, SPECTREL_TRACK_MAGIC, sizeof(SPECTREL_TRACK_MAGIC));
+    header.num_bins = K;
+    header.window_size = N;
+    header.window_hop = params->window_hop;
+    header.sample_rate = params->sample_rate;
+    if (fwrite(&header, sizeof(header), 1, tracker->file) != 1 ||
+        fwrite(bin_frequencies, sizeof(double), K, tracker->file) != K)
+    {
+        spectrel_print_error("fwrite failed: %s", tracker->path);
+        spectrel_free_tracker(tracker);
+        return NULL;
+    }
+    return tracker;
+}
+
+// Recompute the accumulators from the samples in the window.
+static void spectrel_resync_tracker(spectrel_tracker tracker)
+{
+    memset(tracker->acc_real, 0, sizeof(double) * tracker->num_bins);
+    memset(tracker->acc_imag, 0, sizeof(double) * tracker->num_bins);
+    spectrel_slide_dft(tracker->window_real,
+                       tracker->window_imag,
+                       tracker->twiddle_real,
+                       tracker->twiddle_imag,
+                       tracker->acc_real,
+                       tracker->acc_imag,
+                       tracker->num_bins,
+                       tracker->window_size);
+}
+
+// Demodulate the accumulators into the DFT of the window ending at the last
+// sample tracked.
+static void spectrel_output_tracker(spectrel_tracker tracker, float *output)
+{
+    size_t K = tracker->num_bins;
+    size_t m = tracker->position;
+    const double *wr = &tracker->twiddle_real[m * K];
+    const double *wi = &tracker->twiddle_imag[m * K];
+    for (size_t b = 0; b < K; b++)
+    {
+        double ar = tracker->acc_real[b];
+        double ai = tracker->acc_imag[b];
+        output[2 * b] = (float)(ar * wr[b] + ai * wi[b]);
+        output[2 * b + 1] = (float)(ai * wr[b] - ar * wi[b]);
+    }
+}
+
+// Track a chunk of converted samples, returning the number of outputs
+// written.
+static size_t spectrel_track_chunk(spectrel_tracker tracker,
+                                   const size_t num_samples,
+                                   float *outputs)
+{
+    size_t N = tracker->window_size;
+    size_t K = tracker->num_bins;
+    size_t H = tracker->window_hop;
+    size_t num_outputs = 0;
+    size_t i = 0;
+    while (i < num_samples)
+    {
+        // Each run stops at the next output, and before the position in the
+        // window wraps, so that its twiddles are consecutive rows.
+        size_t m = tracker->position;
+        size_t run = num_samples - i;
+        run = H - tracker->num_pending < run ? H - tracker->num_pending : run;
+        run = N - m < run ? N - m : run;
+
+        for (size_t j = 0; j < run; j++)
+        {
+            tracker->delta_real[j] =
+                tracker->input_real[i + j] - tracker->window_real[m + j];
+            tracker->delta_imag[j] =
+                tracker->input_imag[i + j] - tracker->window_imag[m + j];
+        }
+        memcpy(&tracker->window_real[m],
+               &tracker->input_real[i],
+               sizeof(double) * run);
+        memcpy(&tracker->window_imag[m],
+               &tracker->input_imag[i],
+               sizeof(double) * run);
+        spectrel_slide_dft(tracker->delta_real,
+                           tracker->delta_imag,
+                           &tracker->twiddle_real[m * K],
+                           &tracker->twiddle_imag[m * K],
+                           tracker->acc_real,
+                           tracker->acc_imag,
+                           K,
+                           run);
+        i += run;
+
+        // Counters are kept rather than dividing the number of samples, which
+        // would cost more than the update itself when the hop is short.
+        tracker->position += run;
+        if (tracker->position == N)
+        {
+            tracker->position = 0;
+            tracker->num_windows += 1;
+            if (tracker->num_windows == SPECTREL_TRACK_RESYNC_WINDOWS)
+            {
+                spectrel_resync_tracker(tracker);
+                tracker->num_windows = 0;
+            }
+        }
+        tracker->num_pending += run;
+        if (tracker->num_pending == H)
+        {
+            spectrel_output_tracker(tracker, &outputs[2 * K * num_outputs]);
+            tracker->num_pending = 0;
+            num_outputs += 1;
+        }
+    }
+    return num_outputs;
+}
+
+int spectrel_track(spectrel_tracker tracker,
+                   const spectrel_signal_t *buffer,
+                   const int64_t buffer_time)
+{
+    if (buffer->num_samples != tracker->buffer_size)
+    {
+        spectrel_print_error("Buffer does not match the tracker");
+        return SPECTREL_FAILURE;
+    }
+
+    // The first output in the buffer is made once the hop is next complete.
+    size_t offset = tracker->window_hop - 1 - tracker->num_pending;
+    spectrel_track_record_t record = {.index = tracker->num_outputs};
+    if (buffer_time)
+        record.time =
+            buffer_time + llround((double)offset / tracker->sample_rate * 1e9);
+
+    size_t sample_size = spectrel_get_sample_size(buffer->format);
+    const char *data = buffer->data;
+    for (size_t i = 0; i < buffer->num_samples; i += SPECTREL_TRACK_CHUNK_SIZE)
+    {
+        size_t n = buffer->num_samples - i;
+        n = n < SPECTREL_TRACK_CHUNK_SIZE ? n : SPECTREL_TRACK_CHUNK_SIZE;
+        spectrel_convert_window_split(&data[i * sample_size],
+                                      buffer->format,
+                                      buffer->scale,
+                                      tracker->ones->samples,
+                                      tracker->input_real,
+                                      tracker->input_imag,
+                                      n);
+        if (tracker->is_real)
+            memset(tracker->input_imag, 0, sizeof(double) * n);
+        record.num_outputs += spectrel_track_chunk(
+            tracker,
+            n,
+            &tracker->outputs[2 * tracker->num_bins * record.num_outputs]);
+    }
+    tracker->num_outputs += record.num_outputs;
+
+    size_t num_values = 2 * tracker->num_bins * record.num_outputs;
+    if (fwrite(&record, sizeof(record), 1, tracker->file) != 1 ||
+        fwrite(tracker->outputs, sizeof(float), num_values, tracker->file) !=
+            num_values)
+    {
+        spectrel_print_error("fwrite failed: %s", tracker->path);
+        return SPECTREL_FAILURE;
+    }
+    spectrel_add_counter(SPECTREL_COUNTER_BYTES_WRITTEN,
+                         sizeof(record) + num_values * sizeof(float));
+    return SPECTREL_SUCCESS;
+}
@@ -0,0 +1,323 @@
+#include "sptune.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+#include "sppath.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Hold a signal in a given format, as a receiver would stream it, scaled so
+// that the largest sample is at full scale.
+static spectrel_signal_t *
+spectrel_make_native_source(const spectrel_signal_t *signal,
+                            const spectrel_format_t format)
+{
+    double max = 0;
+    for (size_t n = 0; n < signal->num_samples; n++)
+    {
+        max = fmax(max, fabs(creal(signal->samples[n])));
+        max = fmax(max, fabs(cimag(signal->samples[n])));
+    }
+    double full_scale = format == SPECTREL_FORMAT_CS16  ? INT16_MAX
+                        : format == SPECTREL_FORMAT_CS8 ? INT8_MAX
+                                                        : 1;
+    double scale = max > 0 ? max / full_scale : 1;
+
+    spectrel_signal_t *source =
+        spectrel_make_native_signal(signal->num_samples, format, scale, NULL);
+    if (!source)
+        return NULL;
+    for (size_t n = 0; n < signal->num_samples; n++)
+    {
+        double real = creal(signal->samples[n]) / source->scale;
+        double imag = cimag(signal->samples[n]) / source->scale;
+        switch (format)
+        {
+        case SPECTREL_FORMAT_CF32:
+            ((float *)source->data)[2 * n] = (float)real;
+            ((float *)source->data)[2 * n + 1] = (float)imag;
+            break;
+        case SPECTREL_FORMAT_CS16:
+            ((int16_t *)source->data)[2 * n] = (int16_t)lround(real);
+            ((int16_t *)source->data)[2 * n + 1] = (int16_t)lround(imag);
+            break;
+        case SPECTREL_FORMAT_CS8:
+            ((int8_t *)source->data)[2 * n] = (int8_t)lround(real);
+            ((int8_t *)source->data)[2 * n + 1] = (int8_t)lround(imag);
+            break;
+        default:
+            source->samples[n] = signal->samples[n];
+            break;
+        }
+    }
+    return source;
+}
+
+// Time the DSP chain for one buffer size and layout. The headroom is the rate
+// samples were processed at, as a multiple of the sample rate.
+static int spectrel_time_chain(const spectrel_args_t *args,
+                               const spectrel_signal_t *source,
+                               spectrel_file_t *file,
+                               const size_t buffer_size,
+                               const spectrel_layout_t layout,
+                               double *headroom)
+{
+    int status = SPECTREL_FAILURE;
+    spectrel_spectrogram_t *spectrogram = NULL;
+    spectrel_signal_t *buffer = NULL;
+    spectrel_signal_t *window = NULL;
+    spectrel_plan plan = spectrel_make_plan(
+        (size_t)args->window_size, layout, args->is_real_input);
+    if (!plan)
+        goto cleanup;
+
+    // The buffer holds samples in the format they are streamed in, as
+    // spectrel_make_stream_buffer does, so that they are converted as they
+    // are windowed, just as when recording.
+    window = spectrel_make_window(args->window_size);
+    buffer = spectrel_make_native_signal(
+        buffer_size, source->format, source->scale, NULL);
+    if (!window || !buffer)
+        goto cleanup;
+
+    // Process enough buffers to cover a stretch of the signal, so that the
+    // time is not dominated by the first, cold, buffer.
+    size_t num_buffers = (size_t)(args->sample_rate *
+                                  SPECTREL_AUTOTUNE_DURATION / buffer_size);
+    num_buffers = num_buffers < SPECTREL_AUTOTUNE_MIN_BUFFERS
+                      ? SPECTREL_AUTOTUNE_MIN_BUFFERS
+                      : num_buffers;
+
+    // Start each candidate from an empty file, so that they are timed alike.
+    rewind(file->file);
+    if (ftruncate(fileno(file->file), 0) != 0)
+    {
+        spectrel_print_error("ftruncate failed: %s", file->path);
+        goto cleanup;
+    }
+
+    uint64_t start = spectrel_get_time_ns();
+    size_t sample_size = spectrel_get_sample_size(source->format);
+    size_t source_index = 0;
+    for (size_t i = 0; i < num_buffers; i++)
+    {
+        // Stand in for reading from the receiver, by copying the next
+        // samples out of the source, unconverted, as the driver would.
+        size_t n = 0;
+        while (n < buffer_size)
+        {
+            size_t count = source->num_samples - source_index;
+            count = count < buffer_size - n ? count : buffer_size - n;
+            memcpy((char *)buffer->data + n * sample_size,
+                   (const char *)source->data + source_index * sample_size,
+                   sample_size * count);
+            n += count;
+            source_index = (source_index + count) % source->num_samples;
+        }
+
+        spectrogram = spectrel_stfft(plan,
+                                     window,
+                                     buffer,
+                                     (size_t)args->window_hop,
+                                     args->sample_rate,
+                                     NULL);
+        if (!spectrogram)
+            goto cleanup;
+        if (spectrel_write_spectrogram(spectrogram, file) != 0)
+            goto cleanup;
+        spectrel_free_spectrogram(spectrogram);
+        spectrogram = NULL;
+    }
+    if (fflush(file->file) != 0)
+    {
+        spectrel_print_error("fflush failed: %s", file->path);
+        goto cleanup;
+    }
+    uint64_t elapsed = spectrel_get_time_ns() - start;
+
+    double rate = (double)(num_buffers * buffer_size) / (elapsed * 1e-9);
+    *headroom = rate / args->sample_rate;
+    status = SPECTREL_SUCCESS;
+
+cleanup:
+    if (spectrogram)
+        spectrel_free_spectrogram(spectrogram);
+    spectrel_free_signal(buffer);
+    spectrel_free_signal(window);
+    spectrel_free_plan(plan);
+    return status;
+}
+
+int spectrel_autotune(const spectrel_args_t *args, spectrel_tuning_t *tuning)
+{
+    if (args->sample_rate <= 0 || args->window_size < 1 ||
+        args->window_hop < 1)
+    {
+        spectrel_print_error("Autotune needs a sample rate, window and hop");
+        return SPECTREL_FAILURE;
+    }
+
+    // Every buffer size which holds at least one window is a candidate, in
+    // each layout.
+    const spectrel_layout_t layouts[] = {SPECTREL_LAYOUT_INTERLEAVED,
+                                         SPECTREL_LAYOUT_SPLIT};
+    const size_t num_layouts = sizeof(layouts) / sizeof(layouts[0]);
+    size_t num_candidates = 0;
+    for (size_t buffer_size = SPECTREL_AUTOTUNE_MIN_BUFFER_SIZE;
+         buffer_size <= SPECTREL_AUTOTUNE_MAX_BUFFER_SIZE;
+         buffer_size *= 2)
+    {
+        if (buffer_size >= (size_t)args->window_size)
+            num_candidates += num_layouts;
+    }
+    if (num_candidates == 0)
+    {
+        spectrel_print_error("Window size exceeds the largest buffer size");
+        return SPECTREL_FAILURE;
+    }
+    spectrel_tuning_t *candidates =
+        calloc(num_candidates, sizeof(spectrel_tuning_t));
+    if (!candidates)
+    {
+        spectrel_print_error("malloc failed: candidates");
+        return SPECTREL_FAILURE;
+    }
+    size_t c = 0;
+    for (size_t buffer_size = SPECTREL_AUTOTUNE_MIN_BUFFER_SIZE;
+         buffer_size <= SPECTREL_AUTOTUNE_MAX_BUFFER_SIZE;
+         buffer_size *= 2)
+    {
+        if (buffer_size < (size_t)args->window_size)
+            continue;
+        for (size_t j = 0; j < num_layouts; j++)
+        {
+            candidates[c].buffer_size = buffer_size;
+            candidates[c].layout = layouts[j];
+            c++;
+        }
+    }
+
+    int status = SPECTREL_FAILURE;
+    spectrel_signal_t *tone = NULL;
+    spectrel_signal_t *source = NULL;
+    spectrel_file_t *file = NULL;
+
+    // A synthetic source: a tone at an eighth of the sample rate, held in the
+    // format samples are streamed in.
+    spectrel_format_t format;
+    spectrel_parse_format(SPECTREL_AUTOTUNE_FORMAT, &format);
+    spectrel_cosine_params_t source_params = {.sample_rate = args->sample_rate,
+                                              .frequency =
+                                                  args->sample_rate / 8,
+                                              .amplitude = 1.0,
+                                              .phase = 0.0};
+    tone = spectrel_make_signal(SPECTREL_AUTOTUNE_MAX_BUFFER_SIZE,
+                                SPECTREL_COSINE_SIGNAL,
+                                (void *)&source_params);
+    if (!tone)
+        goto cleanup;
+    source = spectrel_make_native_source(tone, format);
+    if (!source)
+        goto cleanup;
+
+    // Spectrograms are written to a scratch file, to include the cost of
+    // encoding and writing them.
+    if (spectrel_make_dir(args->dir) != 0)
+        goto cleanup;
+    time_t now = time(NULL);
+    file = spectrel_open_file(args->dir, &now, "autotune", args->encoding);
+    if (!file)
+        goto cleanup;
+
+    double best_headroom = 0;
+    printf("Format: %s\n", spectrel_get_format_name(format));
+    printf("%-12s %-12s %10s\n", "Buffer size", "Layout", "Headroom");
+    for (c = 0; c < num_candidates; c++)
+    {
+        if (spectrel_time_chain(args,
+                                source,
+                                file,
+                                candidates[c].buffer_size,
+                                candidates[c].layout,
+                                &candidates[c].headroom) != 0)
+            goto cleanup;
+        printf("%-12zu %-12s %9.1fx\n",
+               candidates[c].buffer_size,
+               spectrel_get_layout_name(candidates[c].layout),
+               candidates[c].headroom);
+        if (candidates[c].headroom > best_headroom)
+            best_headroom = candidates[c].headroom;
+    }
+
+    // Choose the smallest buffer within tolerance of the best headroom,
+    // preferring the faster layout.
+    const spectrel_tuning_t *chosen = NULL;
+    for (c = 0; c < num_candidates; c++)
+    {
+        const spectrel_tuning_t *candidate = &candidates[c];
+        if (candidate->headroom <
+            (1 - SPECTREL_AUTOTUNE_TOLERANCE) * best_headroom)
+            continue;
+        if (!chosen || candidate->buffer_size < chosen->buffer_size ||
+            (candidate->buffer_size == chosen->buffer_size &&
+             candidate->headroom > chosen->headroom))
+            chosen = candidate;
+    }
+    *tuning = *chosen;
+    status = SPECTREL_SUCCESS;
+
+cleanup:
+    if (file)
+    {
+        if (remove(file->path) != 0)
+            spectrel_print_error("remove failed: %s", file->path);
+        spectrel_close_file(file);
+    }
+    spectrel_free_signal(source);
+    spectrel_free_signal(tone);
+    free(candidates);
+    return status;
+}
+
+int spectrel_write_tuning(const char *path,
+                          const spectrel_args_t *args,
+                          const spectrel_tuning_t *tuning)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        spectrel_print_error("fopen failed: %s", path);
+        return SPECTREL_FAILURE;
+    }
+
+    time_t now = time(NULL);
+    char datetime[SPECTREL_NUM_CHARS_ISO_8601 + 1];
+    strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(file,
+            "# Tuned by spectrel on %s, for a sample rate of %.1f [Hz], a "
+            "window size of %d and a window hop of %d, encoding %s and %s "
+            "input.\n",
+            datetime,
+            args->sample_rate,
+            args->window_size,
+            args->window_hop,
+            spectrel_get_encoding_name(args->encoding),
+            args->is_real_input ? "real" : "complex");
+    fprintf(file,
+            "# The DSP chain ran at %.1fx the sample rate.\n",
+            tuning->headroom);
+    fprintf(file, "buffer_size = %zu\n", tuning->buffer_size);
+    fprintf(file, "layout = %s\n", spectrel_get_layout_name(tuning->layout));
+    if (fclose(file) != 0)
+    {
+        spectrel_print_error("fclose failed: %s", path);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
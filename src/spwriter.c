@@ -0,0 +1,644 @@
+#include "spwriter.h"
+#include "spconstants.h"
+#include "sperror.h"
+#include "spmetrics.h"
+#include "sprealtime.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int spectrel_parse_writer_backend(const char *name,
+                                  spectrel_writer_backend_t *backend)
+{
+    if (strcmp(name, "stdio") == 0)
+    {
+        *backend = SPECTREL_WRITER_STDIO;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcmp(name, "thread") == 0)
+    {
+        *backend = SPECTREL_WRITER_THREAD;
+        return SPECTREL_SUCCESS;
+    }
+    if (strcmp(name, "io_uring") == 0)
+    {
+        *backend = SPECTREL_WRITER_IO_URING;
+        return SPECTREL_SUCCESS;
+    }
+    spectrel_print_error("Unrecognised writer: %s", name);
+    return SPECTREL_FAILURE;
+}
+
+const char *
+spectrel_get_writer_backend_name(const spectrel_writer_backend_t backend)
+{
+    switch (backend)
+    {
+    case SPECTREL_WRITER_STDIO:
+        return "stdio";
+    case SPECTREL_WRITER_THREAD:
+        return "thread";
+    case SPECTREL_WRITER_IO_URING:
+        return "io_uring";
+    default:
+        return NULL;
+    }
+}
+
+// The kernel's side of an io_uring: the submission and completion rings, and
+// the submission queue entries, mapped into this process.
+typedef struct
+{
+    int fd;
+    bool is_registered; // Whether the pool is registered with the ring.
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+} spectrel_ring_t;
+
+struct spectrel_writer_t
+{
+    int fd;
+    spectrel_writer_backend_t backend;
+    size_t num_buffers;   // The number of buffers in the pool.
+    char *pool;           // Every buffer, one after another.
+    size_t *lengths;      // The number of bytes to write from each buffer.
+    size_t *num_written;  // The number of bytes written from each buffer.
+    off_t *offsets;       // Where in the file each buffer is written.
+    size_t *free_buffers; // A stack of the buffers which are not in use.
+    size_t num_free;
+    size_t num_in_flight; // Buffers submitted, but not yet written.
+    bool has_current;     // Whether a buffer is being filled.
+    size_t current;       // The buffer being filled.
+    uint64_t current_time; // When the buffer being filled was taken.
+    off_t offset;         // Where the next buffer will be written.
+    int error;            // The first error, as an errno value, or zero.
+
+    // The io_uring backend.
+    spectrel_ring_t ring;
+
+    // The thread backend. The free buffers, the queue and the error are
+    // shared with the thread, under the mutex.
+    pthread_t thread;
+    bool has_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t *queue; // A ring of the buffers submitted, in order.
+    size_t queue_head;
+    size_t queue_count;
+    bool is_stopping;
+};
+
+static char *spectrel_get_buffer(spectrel_writer writer, const size_t buffer)
+{
+    return writer->pool + buffer * SPECTREL_WRITER_BUFFER_SIZE;
+}
+
+// Map the rings of a new io_uring, and register the pool with it so that the
+// kernel does not have to map each buffer on every write.
+static int spectrel_make_ring(spectrel_writer writer)
+{
+    spectrel_ring_t *ring = &writer->ring;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(SYS_io_uring_setup, writer->num_buffers, &params);
+    if (ring->fd < 0)
+    {
+        return SPECTREL_FAILURE;
+    }
+
+    ring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool is_single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (is_single_mmap)
+    {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL,
+                         ring->sq_ring_size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE,
+                         ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        return SPECTREL_FAILURE;
+    }
+    if (is_single_mmap)
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else
+    {
+        ring->cq_ring = mmap(NULL,
+                             ring->cq_ring_size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE,
+                             ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED)
+        {
+            ring->cq_ring = NULL;
+            return SPECTREL_FAILURE;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL,
+                      ring->sqes_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        return SPECTREL_FAILURE;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Registering counts against the locked memory limit, so may fail. The
+    // buffers are then written as normal buffers.
+    struct iovec *iovecs = calloc(writer->num_buffers, sizeof(*iovecs));
+    if (iovecs)
+    {
+        for (size_t i = 0; i < writer->num_buffers; i++)
+        {
+            iovecs[i].iov_base = spectrel_get_buffer(writer, i);
+            iovecs[i].iov_len = SPECTREL_WRITER_BUFFER_SIZE;
+        }
+        ring->is_registered = syscall(SYS_io_uring_register,
+                                      ring->fd,
+                                      IORING_REGISTER_BUFFERS,
+                                      iovecs,
+                                      writer->num_buffers) == 0;
+        free(iovecs);
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static void spectrel_free_ring(spectrel_ring_t *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    ring->sqes = NULL;
+    ring->cq_ring = NULL;
+    ring->sq_ring = NULL;
+    ring->fd = -1;
+}
+
+static int spectrel_enter_ring(spectrel_ring_t *ring,
+                               const unsigned to_submit,
+                               const unsigned min_complete,
+                               const unsigned flags)
+{
+    while (syscall(SYS_io_uring_enter,
+                   ring->fd,
+                   to_submit,
+                   min_complete,
+                   flags,
+                   NULL,
+                   0) < 0)
+    {
+        if (errno != EINTR)
+            return errno;
+    }
+    return 0;
+}
+
+// Queue the rest of a buffer on the ring, and submit it without waiting.
+static void spectrel_submit_to_ring(spectrel_writer writer, const size_t buffer)
+{
+    spectrel_ring_t *ring = &writer->ring;
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    size_t num_written = writer->num_written[buffer];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode =
+        ring->is_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = writer->fd;
+    sqe->addr = (uintptr_t)(spectrel_get_buffer(writer, buffer) + num_written);
+    sqe->len = writer->lengths[buffer] - num_written;
+    sqe->off = writer->offsets[buffer] + num_written;
+    sqe->buf_index = ring->is_registered ? buffer : 0;
+    sqe->user_data = buffer;
+    ring->sq_array[index] = index;
+
+    // Publish the entry before the tail, for the kernel to see.
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    int error = spectrel_enter_ring(ring, 1, 0, 0);
+    if (error != 0 && writer->error == 0)
+        writer->error = error;
+}
+
+// Return completed buffers to the pool, resubmitting any short writes.
+// Returns an errno value if the ring could not be waited on, or zero.
+static int spectrel_reap_ring(spectrel_writer writer, const bool is_waiting)
+{
+    spectrel_ring_t *ring = &writer->ring;
+    if (is_waiting)
+    {
+        int error = spectrel_enter_ring(ring, 0, 1, IORING_ENTER_GETEVENTS);
+        if (error != 0)
+        {
+            if (writer->error == 0)
+                writer->error = error;
+            return error;
+        }
+    }
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        size_t buffer = (size_t)cqe->user_data;
+        if (cqe->res > 0)
+        {
+            writer->num_written[buffer] += (size_t)cqe->res;
+            if (writer->num_written[buffer] < writer->lengths[buffer])
+            {
+                spectrel_submit_to_ring(writer, buffer);
+                continue;
+            }
+        }
+        else if (writer->error == 0)
+        {
+            // Writing nothing at all is an error, rather than a short write.
+            writer->error = cqe->res < 0 ? -cqe->res : EIO;
+        }
+        writer->free_buffers[writer->num_free++] = buffer;
+        writer->num_in_flight -= 1;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    spectrel_set_gauge(SPECTREL_GAUGE_WRITES_IN_FLIGHT,
+                       (int64_t)writer->num_in_flight);
+    return 0;
+}
+
+// Write each submitted buffer in turn, then return it to the pool.
+static void *spectrel_write_buffers(void *arg)
+{
+    spectrel_writer writer = arg;
+    pthread_mutex_lock(&writer->mutex);
+    while (true)
+    {
+        while (writer->queue_count == 0 && !writer->is_stopping)
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+        if (writer->queue_count == 0)
+            break;
+        size_t buffer = writer->queue[writer->queue_head];
+        writer->queue_head = (writer->queue_head + 1) % writer->num_buffers;
+        writer->queue_count -= 1;
+        pthread_mutex_unlock(&writer->mutex);
+
+        const char *data = spectrel_get_buffer(writer, buffer);
+        size_t length = writer->lengths[buffer];
+        off_t offset = writer->offsets[buffer];
+        int error = 0;
+        size_t num_written = 0;
+        while (num_written < length)
+        {
+            ssize_t n = pwrite(writer->fd,
+                               data + num_written,
+                               length - num_written,
+                               offset + num_written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                error = n < 0 ? errno : EIO;
+                break;
+            }
+            num_written += (size_t)n;
+        }
+
+        pthread_mutex_lock(&writer->mutex);
+        if (error != 0 && writer->error == 0)
+            writer->error = error;
+        writer->free_buffers[writer->num_free++] = buffer;
+        writer->num_in_flight -= 1;
+        spectrel_set_gauge(SPECTREL_GAUGE_WRITES_IN_FLIGHT,
+                           (int64_t)writer->num_in_flight);
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+// Hand the buffer being filled over to be written.
+static void spectrel_submit_current(spectrel_writer writer, const size_t used)
+{
+    size_t buffer = writer->current;
+    writer->has_current = false;
+    writer->lengths[buffer] = used;
+    writer->num_written[buffer] = 0;
+    writer->offsets[buffer] = writer->offset;
+    writer->offset += (off_t)used;
+
+    if (writer->backend == SPECTREL_WRITER_IO_URING)
+    {
+        writer->num_in_flight += 1;
+        spectrel_submit_to_ring(writer, buffer);
+        return;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    size_t tail =
+        (writer->queue_head + writer->queue_count) % writer->num_buffers;
+    writer->queue[tail] = buffer;
+    writer->queue_count += 1;
+    writer->num_in_flight += 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+// Get the first error, which the writer thread may have set.
+static int spectrel_get_writer_error(spectrel_writer writer)
+{
+    if (!writer->has_thread)
+        return writer->error;
+    pthread_mutex_lock(&writer->mutex);
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->mutex);
+    return error;
+}
+
+// Take a buffer from the pool to fill, waiting for one to be written if every
+// buffer is in flight. Returns the first error, as an errno value, or zero.
+static int spectrel_take_buffer(spectrel_writer writer)
+{
+    if (writer->backend == SPECTREL_WRITER_IO_URING)
+    {
+        spectrel_reap_ring(writer, false);
+        if (writer->num_free == 0)
+        {
+            spectrel_add_counter(SPECTREL_COUNTER_WRITER_STALLS, 1);
+            while (writer->num_free == 0 && writer->error == 0)
+                spectrel_reap_ring(writer, true);
+        }
+        if (writer->error == 0)
+        {
+            writer->current = writer->free_buffers[--writer->num_free];
+            writer->has_current = true;
+        }
+        return writer->error;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    if (writer->num_free == 0)
+    {
+        spectrel_add_counter(SPECTREL_COUNTER_WRITER_STALLS, 1);
+        while (writer->num_free == 0 && writer->error == 0)
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+    }
+    int error = writer->error;
+    if (error == 0)
+    {
+        writer->current = writer->free_buffers[--writer->num_free];
+        writer->has_current = true;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return error;
+}
+
+// Wait for every buffer in flight to be written.
+static void spectrel_drain_writer(spectrel_writer writer)
+{
+    if (writer->backend == SPECTREL_WRITER_IO_URING)
+    {
+        while (writer->num_in_flight > 0)
+        {
+            // Give up if the ring itself has failed, rather than spinning.
+            if (spectrel_reap_ring(writer, true) != 0)
+                break;
+        }
+        return;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->num_in_flight > 0)
+        pthread_cond_wait(&writer->cond, &writer->mutex);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+int spectrel_free_writer(spectrel_writer writer)
+{
+    if (!writer)
+    {
+        return SPECTREL_SUCCESS;
+    }
+
+    // Write out whatever is left, then stop.
+    if (writer->has_current && writer->lengths[writer->current] > 0)
+        spectrel_submit_current(writer, writer->lengths[writer->current]);
+    if (writer->has_thread || writer->ring.fd >= 0)
+        spectrel_drain_writer(writer);
+    int error = spectrel_get_writer_error(writer);
+    if (writer->has_thread)
+    {
+        pthread_mutex_lock(&writer->mutex);
+        writer->is_stopping = true;
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->mutex);
+        pthread_join(writer->thread, NULL);
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->mutex);
+    }
+    spectrel_free_ring(&writer->ring);
+    if (writer->pool)
+        munmap(writer->pool, writer->num_buffers * SPECTREL_WRITER_BUFFER_SIZE);
+    free(writer->lengths);
+    free(writer->num_written);
+    free(writer->offsets);
+    free(writer->free_buffers);
+    free(writer->queue);
+    free(writer);
+    spectrel_set_gauge(SPECTREL_GAUGE_WRITES_IN_FLIGHT, 0);
+
+    if (error != 0)
+    {
+        spectrel_print_error("write failed: %s", strerror(error));
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+spectrel_writer spectrel_make_writer(const int fd,
+                                     const spectrel_writer_backend_t backend,
+                                     const size_t num_in_flight)
+{
+    if (backend == SPECTREL_WRITER_STDIO || num_in_flight < 1)
+    {
+        spectrel_print_error("Writer needs an asynchronous backend, and at "
+                             "least one write in flight");
+        return NULL;
+    }
+
+    // Prepare writer structure with safe initial values.
+    spectrel_writer writer = calloc(1, sizeof(*writer));
+    if (!writer)
+    {
+        spectrel_print_error("malloc failed: writer");
+        return NULL;
+    }
+    writer->fd = fd;
+    writer->backend = backend;
+    writer->ring.fd = -1;
+
+    // One buffer is filled while the rest are in flight. The pool is faulted
+    // in up front, so that filling it never faults.
+    writer->num_buffers = num_in_flight + 1;
+    writer->pool = mmap(NULL,
+                        writer->num_buffers * SPECTREL_WRITER_BUFFER_SIZE,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                        -1,
+                        0);
+    if (writer->pool == MAP_FAILED)
+    {
+        writer->pool = NULL;
+        spectrel_free_writer(writer);
+        spectrel_print_error("mmap failed: %s", strerror(errno));
+        return NULL;
+    }
+    writer->lengths = calloc(writer->num_buffers, sizeof(*writer->lengths));
+    writer->num_written =
+        calloc(writer->num_buffers, sizeof(*writer->num_written));
+    writer->offsets = calloc(writer->num_buffers, sizeof(*writer->offsets));
+    writer->free_buffers =
+        calloc(writer->num_buffers, sizeof(*writer->free_buffers));
+    writer->queue = calloc(writer->num_buffers, sizeof(*writer->queue));
+    if (!writer->lengths || !writer->num_written || !writer->offsets ||
+        !writer->free_buffers || !writer->queue)
+    {
+        spectrel_free_writer(writer);
+        spectrel_print_error("malloc failed: writer");
+        return NULL;
+    }
+    for (size_t i = 0; i < writer->num_buffers; i++)
+    {
+        writer->free_buffers[writer->num_free++] = writer->num_buffers - 1 - i;
+    }
+
+    // io_uring may be disabled, or filtered out by a sandbox, so fall back to
+    // writing from a thread.
+    if (backend == SPECTREL_WRITER_IO_URING && spectrel_make_ring(writer) != 0)
+    {
+        spectrel_free_ring(&writer->ring);
+        writer->backend = SPECTREL_WRITER_THREAD;
+    }
+    if (writer->backend == SPECTREL_WRITER_THREAD)
+    {
+        pthread_mutex_init(&writer->mutex, NULL);
+        pthread_cond_init(&writer->cond, NULL);
+        if (pthread_create(
+                &writer->thread, NULL, spectrel_write_buffers, writer) != 0)
+        {
+            pthread_cond_destroy(&writer->cond);
+            pthread_mutex_destroy(&writer->mutex);
+            spectrel_free_writer(writer);
+            spectrel_print_error("pthread_create failed: writer");
+            return NULL;
+        }
+        writer->has_thread = true;
+        spectrel_demote_thread(writer->thread);
+    }
+    return writer;
+}
+
+spectrel_writer_backend_t spectrel_get_writer_backend(spectrel_writer writer)
+{
+    return writer->backend;
+}
+
+void *spectrel_reserve_write(spectrel_writer writer, const size_t num_bytes)
+{
+    if (num_bytes > SPECTREL_WRITER_BUFFER_SIZE)
+    {
+        spectrel_print_error("Write of %zu bytes exceeds the writer buffer",
+                             num_bytes);
+        return NULL;
+    }
+
+    // The length of the buffer being filled is kept up to date, so that it
+    // can be submitted as is.
+    if (writer->has_current &&
+        writer->lengths[writer->current] + num_bytes >
+            SPECTREL_WRITER_BUFFER_SIZE)
+    {
+        spectrel_submit_current(writer, writer->lengths[writer->current]);
+    }
+    if (!writer->has_current)
+    {
+        int error = spectrel_take_buffer(writer);
+        if (error != 0)
+        {
+            spectrel_print_error("write failed: %s", strerror(error));
+            return NULL;
+        }
+        writer->lengths[writer->current] = 0;
+        writer->current_time = spectrel_get_time_ns();
+    }
+    size_t used = writer->lengths[writer->current];
+    writer->lengths[writer->current] += num_bytes;
+    return spectrel_get_buffer(writer, writer->current) + used;
+}
+
+int spectrel_commit_writes(spectrel_writer writer)
+{
+    if (writer->has_current &&
+        spectrel_get_time_ns() - writer->current_time >
+            SPECTREL_WRITER_MAX_AGE * 1000000ULL)
+    {
+        spectrel_submit_current(writer, writer->lengths[writer->current]);
+    }
+    if (writer->backend == SPECTREL_WRITER_IO_URING)
+        spectrel_reap_ring(writer, false);
+
+    int error = spectrel_get_writer_error(writer);
+    if (error != 0)
+    {
+        spectrel_print_error("write failed: %s", strerror(error));
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
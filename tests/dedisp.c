@@ -0,0 +1,166 @@
+// Check that a pulse injected into noise along the dispersion sweep of a
+// known DM is found at that DM, and at the spectrum it started in.
+
+#include "spconstants.h"
+#include "spdedisp.h"
+#include "spsignal.h"
+#include "sptest.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPECTREL_TEST_FREQUENCY 400e6
+#define SPECTREL_TEST_SAMPLE_RATE 1e6
+#define SPECTREL_TEST_WINDOW_SIZE 64
+#define SPECTREL_TEST_NUM_BLOCKS 4
+#define SPECTREL_TEST_DM 12.0
+#define SPECTREL_TEST_PULSE_INDEX 1500
+
+// A uniform deviate in (0, 1), from a xorshift generator, so that the noise
+// is the same on every run.
+static double spectrel_get_test_uniform(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return ((double)(*state >> 11) + 0.5) / (double)(1ull << 53);
+}
+
+// Complex Gaussian noise of unit power.
+static double complex spectrel_get_test_noise(uint64_t *state)
+{
+    double r = sqrt(-log(spectrel_get_test_uniform(state)));
+    double theta = 2 * M_PI * spectrel_get_test_uniform(state);
+    return r * cexp(I * theta);
+}
+
+// Fill a spectrogram with noise, and add a pulse along the sweep of the DM.
+static void spectrel_fill_test_spectrogram(spectrel_spectrogram_t *s,
+                                           const double *frequencies,
+                                           const double spectrum_interval,
+                                           const size_t first_index,
+                                           uint64_t *state)
+{
+    size_t M = s->num_samples_per_spectrum;
+    double f_top = -INFINITY;
+    for (size_t m = 0; m < M; m++)
+        f_top = fmax(f_top, frequencies[m]);
+    f_top *= 1e-6;
+
+    for (size_t n = 0; n < s->num_spectrums; n++)
+    {
+        for (size_t m = 0; m < M; m++)
+        {
+            double f = frequencies[m] * 1e-6;
+            double delay = SPECTREL_DISPERSION_CONSTANT * SPECTREL_TEST_DM *
+                           (1 / (f * f) - 1 / (f_top * f_top));
+            size_t index = SPECTREL_TEST_PULSE_INDEX +
+                           (size_t)llround(delay / spectrum_interval);
+            double complex sample = spectrel_get_test_noise(state);
+            if (first_index + n == index)
+                sample += 3;
+            s->samples[n * M + m] = sample;
+        }
+    }
+}
+
+int main(void)
+{
+    char directory[] = "/tmp/spectrel-test-XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("dedisp: could not make a directory\n");
+        return SPECTREL_FAILURE;
+    }
+    char path[sizeof(directory) + 16];
+    char candidates_path[sizeof(path) + 8];
+    snprintf(path, sizeof(path), "%s/test.cf64", directory);
+    snprintf(candidates_path, sizeof(candidates_path), "%s.cand", path);
+
+    size_t M = SPECTREL_TEST_WINDOW_SIZE;
+    size_t N = SPECTREL_DEDISP_BLOCK_SIZE;
+    spectrel_dedisp_params_t params = {
+        .frequency = SPECTREL_TEST_FREQUENCY,
+        .sample_rate = SPECTREL_TEST_SAMPLE_RATE,
+        .window_size = M,
+        .window_hop = M,
+        .is_real = false,
+        .dm_min = 0,
+        .dm_max = 2 * SPECTREL_TEST_DM,
+        .snr_threshold = SPECTREL_DEFAULT_SNR_THRESHOLD,
+        .num_threads = 2};
+    double spectrum_interval = M / SPECTREL_TEST_SAMPLE_RATE;
+    double frequencies[SPECTREL_TEST_WINDOW_SIZE];
+    spectrel_compute_frequencies(
+        frequencies, M, SPECTREL_TEST_SAMPLE_RATE, false);
+    for (size_t m = 0; m < M; m++)
+        frequencies[m] += SPECTREL_TEST_FREQUENCY;
+
+    fftw_complex *samples = malloc(sizeof(*samples) * N * M);
+    spectrel_dedisperser dedisperser =
+        spectrel_make_dedisperser(path, &params);
+    if (spectrel_check(samples && dedisperser, "make a dedisperser"))
+    {
+        // Hand over a block at a time, giving the search time to take each,
+        // so that none are dropped.
+        spectrel_spectrogram_t s = {.num_spectrums = N,
+                                    .num_samples_per_spectrum = M,
+                                    .layout = SPECTREL_LAYOUT_INTERLEAVED,
+                                    .samples = samples};
+        uint64_t state = 0x9e3779b97f4a7c15ull;
+        for (size_t k = 0; k < SPECTREL_TEST_NUM_BLOCKS; k++)
+        {
+            spectrel_fill_test_spectrogram(
+                &s, frequencies, spectrum_interval, k * N, &state);
+            spectrel_check(spectrel_dedisperse(dedisperser, &s) == 0,
+                           "dedisperse a block");
+            nanosleep(&(struct timespec){.tv_nsec = 200000000}, NULL);
+        }
+    }
+    spectrel_free_dedisperser(dedisperser);
+    dedisperser = NULL;
+    free(samples);
+    samples = NULL;
+
+    // The strongest candidate should be the pulse.
+    FILE *file = fopen(candidates_path, "rb");
+    spectrel_candidates_header_t header;
+    spectrel_candidate_record_t record;
+    spectrel_candidate_record_t strongest = {0};
+    size_t num_candidates = 0;
+    if (spectrel_check(file && fread(&header, sizeof(header), 1, file) == 1,
+                       "read the candidate header"))
+    {
+        while (fread(&record, sizeof(record), 1, file) == 1)
+        {
+            if (num_candidates++ == 0 || record.snr > strongest.snr)
+                strongest = record;
+        }
+        spectrel_check(header.dm_step > 0 && header.num_dms > 1,
+                       "search more than one DM");
+        spectrel_check_close("spectrum interval",
+                             header.spectrum_interval,
+                             spectrum_interval,
+                             1e-12);
+        spectrel_check(num_candidates > 0, "find a candidate");
+        spectrel_check_close(
+            "DM of the pulse", strongest.dm, SPECTREL_TEST_DM, header.dm_step);
+        spectrel_check_close("index of the pulse",
+                             (double)strongest.index,
+                             SPECTREL_TEST_PULSE_INDEX,
+                             1);
+        spectrel_check(strongest.snr >= header.snr_threshold,
+                       "pulse reaches the threshold");
+    }
+    if (file)
+        fclose(file);
+
+    unlink(candidates_path);
+    rmdir(directory);
+    return spectrel_finish_test("dedisp");
+}
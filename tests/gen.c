@@ -0,0 +1,183 @@
+// Check that tones, chirps and pulses carried by recurrence match their phase
+// evaluated directly, over many chunks and across buffers, and that the noise
+// does not depend on how it is split into buffers.
+
+#include "spgen.h"
+#include "spsignal.h"
+#include "sptest.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SPECTREL_TEST_SAMPLE_RATE 1e6
+#define SPECTREL_TEST_NUM_SAMPLES 10000 // Several chunks, and a partial block.
+#define SPECTREL_TEST_BUFFER_SIZE 1000
+#define SPECTREL_TEST_NUM_BUFFERS 5
+
+// The sample at a phase, in cycles.
+static double complex spectrel_get_test_phasor(const double phase)
+{
+    return cexp(2 * M_PI * I * (phase - floor(phase)));
+}
+
+// Check a chirp added to samples, which are not zero to start with.
+static void spectrel_test_chirp(const double frequency,
+                                const double rate,
+                                const char *name)
+{
+    size_t N = SPECTREL_TEST_NUM_SAMPLES;
+    double amplitude = 3;
+    double phase = 0.3;
+    fftw_complex *samples = malloc(sizeof(*samples) * N);
+    if (!spectrel_check(samples != NULL, "allocate samples"))
+        return;
+    for (size_t n = 0; n < N; n++)
+        samples[n] = (double)n;
+    spectrel_add_chirp(samples, N, amplitude, phase, frequency, rate);
+
+    double error = 0;
+    for (size_t n = 0; n < N; n++)
+    {
+        double t = (double)n;
+        double cycles = phase + frequency * t + rate * t * t / 2;
+        double complex expected =
+            (double)n + amplitude * spectrel_get_test_phasor(cycles);
+        error = fmax(error, cabs(samples[n] - expected));
+    }
+    spectrel_check_close(name, error, 0, 1e-9);
+    free(samples);
+    samples = NULL;
+}
+
+// Generate buffer after buffer from a generator, into one long signal.
+static fftw_complex *
+spectrel_generate_test_signal(const spectrel_generator_params_t *params,
+                              const size_t buffer_size)
+{
+    size_t N = SPECTREL_TEST_BUFFER_SIZE * SPECTREL_TEST_NUM_BUFFERS;
+    fftw_complex *samples = malloc(sizeof(*samples) * N);
+    spectrel_signal_t *buffer =
+        spectrel_make_signal(buffer_size, SPECTREL_EMPTY_SIGNAL, NULL);
+    spectrel_generator generator = spectrel_make_generator(params);
+    bool is_generated = samples && buffer && generator;
+    for (size_t n = 0; is_generated && n < N; n += buffer_size)
+    {
+        is_generated = spectrel_generate(generator, buffer) == 0;
+        for (size_t i = 0; i < buffer_size; i++)
+            samples[n + i] = buffer->samples[i];
+    }
+    spectrel_free_generator(generator);
+    generator = NULL;
+    spectrel_free_signal(buffer);
+    buffer = NULL;
+    if (!is_generated)
+    {
+        free(samples);
+        samples = NULL;
+    }
+    return samples;
+}
+
+static void spectrel_test_generator(void)
+{
+    // At 20 dB, and without noise, each component has an amplitude of ten.
+    spectrel_component_t components[] = {
+        {.type = SPECTREL_TONE, .frequency = 123456.7, .snr = 20},
+        {.type = SPECTREL_LINEAR_CHIRP,
+         .frequency = -300e3,
+         .stop_frequency = 200e3,
+         .duration = 2e-3,
+         .snr = 20},
+        {.type = SPECTREL_PULSE,
+         .frequency = -50e3,
+         .duration = 1e-4,
+         .period = 7e-4,
+         .snr = 20}};
+    const char *names[] = {"generated tone",
+                           "generated linear chirp",
+                           "generated pulse"};
+    size_t N = SPECTREL_TEST_BUFFER_SIZE * SPECTREL_TEST_NUM_BUFFERS;
+    double fs = SPECTREL_TEST_SAMPLE_RATE;
+    for (size_t k = 0; k < 3; k++)
+    {
+        spectrel_generator_params_t params = {.frequency = 100e6,
+                                              .sample_rate = fs,
+                                              .components = &components[k],
+                                              .num_components = 1};
+        fftw_complex *samples =
+            spectrel_generate_test_signal(&params, SPECTREL_TEST_BUFFER_SIZE);
+        if (!spectrel_check(samples != NULL, "generate a signal"))
+            continue;
+
+        const spectrel_component_t *c = &components[k];
+        double error = 0;
+        for (size_t n = 0; n < N; n++)
+        {
+            double complex expected = 0;
+            if (c->type == SPECTREL_TONE)
+            {
+                expected = spectrel_get_test_phasor(c->frequency * n / fs);
+            }
+            else if (c->type == SPECTREL_LINEAR_CHIRP)
+            {
+                // The sweep starts over every duration.
+                size_t cycle = (size_t)ceil(c->duration * fs);
+                double t = (double)(n % cycle) / fs;
+                double slope = (c->stop_frequency - c->frequency) / c->duration;
+                expected = spectrel_get_test_phasor(c->frequency * t +
+                                                    slope * t * t / 2);
+            }
+            else if (n % (size_t)ceil(c->period * fs) <
+                     (size_t)ceil(c->duration * fs))
+            {
+                // Pulses keep their phase while they are off.
+                expected = spectrel_get_test_phasor(c->frequency * n / fs);
+            }
+            error = fmax(error, cabs(samples[n] - 10 * expected));
+        }
+        spectrel_check_close(names[k], error, 0, 1e-8);
+        free(samples);
+        samples = NULL;
+    }
+}
+
+static void spectrel_test_noise(void)
+{
+    size_t N = SPECTREL_TEST_BUFFER_SIZE * SPECTREL_TEST_NUM_BUFFERS;
+    spectrel_generator_params_t params = {.frequency = 100e6,
+                                          .sample_rate =
+                                              SPECTREL_TEST_SAMPLE_RATE,
+                                          .noise_power = 2,
+                                          .seed = 7};
+    fftw_complex *whole = spectrel_generate_test_signal(&params, N);
+    fftw_complex *split =
+        spectrel_generate_test_signal(&params, SPECTREL_TEST_BUFFER_SIZE);
+    if (spectrel_check(whole && split, "generate noise"))
+    {
+        double difference = 0;
+        double power = 0;
+        for (size_t n = 0; n < N; n++)
+        {
+            difference = fmax(difference, cabs(whole[n] - split[n]));
+            power += creal(whole[n] * conj(whole[n])) / N;
+        }
+        spectrel_check_close("noise split into buffers", difference, 0, 0);
+        spectrel_check_close("noise power", power, 2, 0.1);
+    }
+    free(whole);
+    whole = NULL;
+    free(split);
+    split = NULL;
+}
+
+int main(void)
+{
+    spectrel_test_chirp(0.1234567, 0, "tone");
+    spectrel_test_chirp(-0.45, 0, "tone near Nyquist");
+    spectrel_test_chirp(-0.2, 4e-5, "linear chirp");
+    spectrel_test_generator();
+    spectrel_test_noise();
+    return spectrel_finish_test("gen");
+}
@@ -0,0 +1,174 @@
+// Check that spectral kurtosis flags a steady carrier and intermittent
+// interference, but not noise, and that flagged samples are interpolated
+// from their neighbours in frequency, across DC.
+
+#include "sprfi.h"
+#include "spsignal.h"
+#include "sptest.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SPECTREL_TEST_NUM_SAMPLES 32
+#define SPECTREL_TEST_BLOCK_SIZE 256
+#define SPECTREL_TEST_THRESHOLD 5.0
+#define SPECTREL_TEST_CARRIER 0       // A steady carrier, at DC.
+#define SPECTREL_TEST_INTERMITTENT 20 // On for one spectrum in ten.
+
+// A uniform deviate in (0, 1), from a xorshift generator, so that the noise
+// is the same on every run.
+static double spectrel_get_test_uniform(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return ((double)(*state >> 11) + 0.5) / (double)(1ull << 53);
+}
+
+// Complex Gaussian noise of unit power.
+static double complex spectrel_get_test_noise(uint64_t *state)
+{
+    double r = sqrt(-log(spectrel_get_test_uniform(state)));
+    double theta = 2 * M_PI * spectrel_get_test_uniform(state);
+    return r * cexp(I * theta);
+}
+
+static void spectrel_fill_test_block(fftw_complex *samples, uint64_t *state)
+{
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    for (size_t n = 0; n < SPECTREL_TEST_BLOCK_SIZE; n++)
+    {
+        for (size_t m = 0; m < M; m++)
+        {
+            samples[n * M + m] = spectrel_get_test_noise(state);
+        }
+        samples[n * M + SPECTREL_TEST_CARRIER] += 10 * cexp(I * 0.1 * n);
+        if (n % 10 == 0)
+            samples[n * M + SPECTREL_TEST_INTERMITTENT] += 10;
+    }
+}
+
+static bool spectrel_is_test_flagged(const uint8_t *mask, const size_t m)
+{
+    return mask[m / 8] & (1u << (m % 8));
+}
+
+// Check the mask of a block flags exactly the carrier and the intermittent
+// interference.
+static void spectrel_test_mask(FILE *file, const size_t index)
+{
+    spectrel_mask_record_t record;
+    uint8_t mask[(SPECTREL_TEST_NUM_SAMPLES + 7) / 8];
+    if (!spectrel_check(fread(&record, sizeof(record), 1, file) == 1 &&
+                            fread(mask, sizeof(mask), 1, file) == 1,
+                        "read a mask"))
+        return;
+    spectrel_check(record.index == index, "mask starts at its block");
+    spectrel_check(record.num_flagged == 2, "two samples flagged");
+    spectrel_check(spectrel_is_test_flagged(mask, SPECTREL_TEST_CARRIER),
+                   "carrier flagged");
+    spectrel_check(spectrel_is_test_flagged(mask, SPECTREL_TEST_INTERMITTENT),
+                   "intermittent interference flagged");
+}
+
+int main(void)
+{
+    char directory[] = "/tmp/spectrel-test-XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("kurtosis: could not make a directory\n");
+        return SPECTREL_FAILURE;
+    }
+    char path[sizeof(directory) + 16];
+    char mask_path[sizeof(path) + 8];
+    snprintf(path, sizeof(path), "%s/test.cf64", directory);
+    snprintf(mask_path, sizeof(mask_path), "%s.mask", path);
+
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    size_t N = SPECTREL_TEST_BLOCK_SIZE;
+    fftw_complex *samples = malloc(sizeof(*samples) * N * M);
+    fftw_complex *original = malloc(sizeof(*original) * N * M);
+    spectrel_rfi rfi = spectrel_make_rfi(path,
+                                         M,
+                                         false,
+                                         N,
+                                         SPECTREL_TEST_THRESHOLD,
+                                         SPECTREL_RFI_INTERPOLATE);
+    if (spectrel_check(samples && original && rfi, "make a flagger"))
+    {
+        spectrel_spectrogram_t s = {.num_spectrums = N,
+                                    .num_samples_per_spectrum = M,
+                                    .layout = SPECTREL_LAYOUT_INTERLEAVED,
+                                    .samples = samples};
+        uint64_t state = 0x9e3779b97f4a7c15ull;
+        spectrel_fill_test_block(samples, &state);
+        spectrel_check(spectrel_flag_rfi(rfi, &s) == 0, "flag a block");
+
+        // The second block is masked with the mask of the first.
+        spectrel_fill_test_block(samples, &state);
+        memcpy(original, samples, sizeof(*samples) * N * M);
+        spectrel_check(spectrel_flag_rfi(rfi, &s) == 0, "mask a block");
+        double interpolation_error = 0;
+        double untouched_error = 0;
+        for (size_t n = 0; n < N; n++)
+        {
+            const fftw_complex *x = original + n * M;
+            const fftw_complex *y = samples + n * M;
+            for (size_t m = 0; m < M; m++)
+            {
+                double power = creal(y[m] * conj(y[m]));
+                double expected = creal(x[m] * conj(x[m]));
+                if (m == SPECTREL_TEST_CARRIER ||
+                    m == SPECTREL_TEST_INTERMITTENT)
+                {
+                    // Halfway between the neighbours, wrapping around at DC.
+                    size_t lower = (m + M - 1) % M;
+                    size_t upper = (m + 1) % M;
+                    expected = (creal(x[lower] * conj(x[lower])) +
+                                creal(x[upper] * conj(x[upper]))) /
+                               2;
+                    interpolation_error = fmax(interpolation_error,
+                                               fabs(power - expected));
+                }
+                else
+                {
+                    untouched_error =
+                        fmax(untouched_error, cabs(y[m] - x[m]));
+                }
+            }
+        }
+        spectrel_check_close(
+            "flagged samples interpolated", interpolation_error, 0, 1e-9);
+        spectrel_check_close("others untouched", untouched_error, 0, 0);
+    }
+    spectrel_free_rfi(rfi);
+    rfi = NULL;
+    free(samples);
+    samples = NULL;
+    free(original);
+    original = NULL;
+
+    FILE *file = fopen(mask_path, "rb");
+    spectrel_mask_header_t header;
+    if (spectrel_check(file && fread(&header, sizeof(header), 1, file) == 1,
+                       "read the mask header"))
+    {
+        spectrel_check(header.num_samples_per_spectrum == M &&
+                           header.num_spectrums_per_block == N,
+                       "mask header");
+        spectrel_test_mask(file, 0);
+        spectrel_test_mask(file, N);
+        spectrel_check(fgetc(file) == EOF, "no more masks");
+    }
+    if (file)
+        fclose(file);
+
+    unlink(mask_path);
+    rmdir(directory);
+    return spectrel_finish_test("kurtosis");
+}
@@ -0,0 +1,220 @@
+// Check the running moments against a two-pass computation, both from the
+// kernel directly and as written to a statistics file.
+
+#include "spkernel.h"
+#include "spsignal.h"
+#include "spstats.h"
+#include "sptest.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SPECTREL_TEST_NUM_SAMPLES 13
+#define SPECTREL_TEST_NUM_SPECTRUMS 250
+#define SPECTREL_TEST_FRAME_SIZE 100
+
+typedef struct
+{
+    double mean;
+    double m2;
+    double m3;
+    double m4;
+    double min;
+    double max;
+} spectrel_test_moments_t;
+
+// The power of a sample, spread over several orders of magnitude so that
+// cancellation in the running update would show.
+static double spectrel_get_test_power(const size_t n, const size_t m)
+{
+    uint64_t x = n * SPECTREL_TEST_NUM_SAMPLES + m + 1;
+    x *= 0x9e3779b97f4a7c15ull;
+    x ^= x >> 31;
+    double u = (double)(x >> 11) / (double)(1ull << 53);
+    return (m + 1) * 1e3 * (1 + u * u * u * 50);
+}
+
+// The moments of a sample over spectrums [start, end), in two passes.
+static spectrel_test_moments_t
+spectrel_compute_test_moments(const size_t m,
+                              const size_t start,
+                              const size_t end)
+{
+    spectrel_test_moments_t moments = {0};
+    moments.min = INFINITY;
+    moments.max = -INFINITY;
+    for (size_t n = start; n < end; n++)
+        moments.mean += spectrel_get_test_power(n, m) / (double)(end - start);
+    for (size_t n = start; n < end; n++)
+    {
+        double x = spectrel_get_test_power(n, m);
+        double d = x - moments.mean;
+        moments.m2 += d * d;
+        moments.m3 += d * d * d;
+        moments.m4 += d * d * d * d;
+        moments.min = fmin(moments.min, x);
+        moments.max = fmax(moments.max, x);
+    }
+    return moments;
+}
+
+static void spectrel_test_kernel(void)
+{
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    double power[SPECTREL_TEST_NUM_SAMPLES];
+    double state[6][SPECTREL_TEST_NUM_SAMPLES] = {{0}};
+    for (size_t n = 0; n < SPECTREL_TEST_NUM_SPECTRUMS; n++)
+    {
+        for (size_t m = 0; m < M; m++)
+            power[m] = spectrel_get_test_power(n, m);
+        spectrel_accumulate_moments(power,
+                                    n + 1,
+                                    state[0],
+                                    state[1],
+                                    state[2],
+                                    state[3],
+                                    state[4],
+                                    state[5],
+                                    M);
+    }
+
+    // The largest error relative to the scale of each moment.
+    double errors[6] = {0};
+    for (size_t m = 0; m < M; m++)
+    {
+        spectrel_test_moments_t expected = spectrel_compute_test_moments(
+            m, 0, SPECTREL_TEST_NUM_SPECTRUMS);
+        double values[6] = {expected.mean,
+                            expected.m2,
+                            expected.m3,
+                            expected.m4,
+                            expected.min,
+                            expected.max};
+        double sigma = sqrt(expected.m2 / SPECTREL_TEST_NUM_SPECTRUMS);
+        double scales[6] = {sigma,
+                            expected.m2,
+                            fabs(expected.m3) + sigma * expected.m2,
+                            expected.m4,
+                            expected.min,
+                            expected.max};
+        for (size_t i = 0; i < 6; i++)
+        {
+            double error = fabs(state[i][m] - values[i]) / scales[i];
+            errors[i] = fmax(errors[i], error);
+        }
+    }
+    spectrel_check_close("mean", errors[0], 0, 1e-10);
+    spectrel_check_close("second moment", errors[1], 0, 1e-10);
+    spectrel_check_close("third moment", errors[2], 0, 1e-10);
+    spectrel_check_close("fourth moment", errors[3], 0, 1e-10);
+    spectrel_check_close("min", errors[4], 0, 0);
+    spectrel_check_close("max", errors[5], 0, 0);
+}
+
+// Check one frame of a statistics file against a two-pass computation over
+// its spectrums. Values are stored as floats.
+static void spectrel_test_frame(FILE *file, const size_t start)
+{
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    spectrel_stats_frame_t frame;
+    float values[5 * SPECTREL_TEST_NUM_SAMPLES];
+    if (!spectrel_check(fread(&frame, sizeof(frame), 1, file) == 1 &&
+                            fread(values, sizeof(values), 1, file) == 1,
+                        "read a frame"))
+        return;
+    size_t end = start + SPECTREL_TEST_FRAME_SIZE;
+    end = end < SPECTREL_TEST_NUM_SPECTRUMS ? end : SPECTREL_TEST_NUM_SPECTRUMS;
+    spectrel_check(frame.index == start && frame.num_spectrums == end - start,
+                   "frame covers its interval");
+
+    double errors[5] = {0};
+    for (size_t m = 0; m < M; m++)
+    {
+        spectrel_test_moments_t moments =
+            spectrel_compute_test_moments(m, start, end);
+        double count = (double)(end - start);
+        double expected[5] = {moments.mean,
+                              moments.m2 / (count - 1),
+                              moments.min,
+                              moments.max,
+                              count * moments.m4 / (moments.m2 * moments.m2)};
+        for (size_t i = 0; i < 5; i++)
+        {
+            double error = fabs(values[i * M + m] - expected[i]) /
+                           fabs(expected[i]);
+            errors[i] = fmax(errors[i], error);
+        }
+    }
+    spectrel_check_close("frame mean", errors[0], 0, 1e-6);
+    spectrel_check_close("frame variance", errors[1], 0, 1e-6);
+    spectrel_check_close("frame min", errors[2], 0, 1e-6);
+    spectrel_check_close("frame max", errors[3], 0, 1e-6);
+    spectrel_check_close("frame kurtosis", errors[4], 0, 1e-6);
+}
+
+static void spectrel_test_stats(const char *path)
+{
+    // Make the spectrogram with amplitudes whose squares are the powers.
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    size_t N = SPECTREL_TEST_NUM_SPECTRUMS;
+    fftw_complex *samples = malloc(sizeof(*samples) * N * M);
+    spectrel_stats stats =
+        spectrel_make_stats(path, M, SPECTREL_TEST_FRAME_SIZE, 1e-3);
+    if (spectrel_check(samples && stats, "make statistics"))
+    {
+        for (size_t n = 0; n < N; n++)
+            for (size_t m = 0; m < M; m++)
+                samples[n * M + m] = sqrt(spectrel_get_test_power(n, m));
+        spectrel_spectrogram_t s = {.num_spectrums = N,
+                                    .num_samples_per_spectrum = M,
+                                    .layout = SPECTREL_LAYOUT_INTERLEAVED,
+                                    .samples = samples};
+        spectrel_check(spectrel_update_stats(stats, &s) == 0,
+                       "update statistics");
+    }
+    spectrel_free_stats(stats);
+    stats = NULL;
+    free(samples);
+    samples = NULL;
+
+    char stats_path[256];
+    snprintf(stats_path, sizeof(stats_path), "%s.stats", path);
+    FILE *file = fopen(stats_path, "rb");
+    spectrel_stats_header_t header;
+    if (spectrel_check(file && fread(&header, sizeof(header), 1, file) == 1,
+                       "read the statistics header"))
+    {
+        spectrel_check(header.num_samples_per_spectrum == M &&
+                           header.num_spectrums_per_frame ==
+                               SPECTREL_TEST_FRAME_SIZE,
+                       "statistics header");
+
+        // Two whole intervals, then the partial one written on closing.
+        for (size_t start = 0; start < N; start += SPECTREL_TEST_FRAME_SIZE)
+            spectrel_test_frame(file, start);
+        spectrel_check(fgetc(file) == EOF, "no more frames");
+    }
+    if (file)
+        fclose(file);
+    unlink(stats_path);
+}
+
+int main(void)
+{
+    spectrel_test_kernel();
+
+    char directory[] = "/tmp/spectrel-test-XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("moments: could not make a directory\n");
+        return SPECTREL_FAILURE;
+    }
+    char path[sizeof(directory) + 16];
+    snprintf(path, sizeof(path), "%s/test.cf64", directory);
+    spectrel_test_stats(path);
+    rmdir(directory);
+    return spectrel_finish_test("moments");
+}
@@ -0,0 +1,217 @@
+// Check that the reader slices and pools a recording as spectrel-read asks it
+// to, and times each spectrum from the timestamp file, across a gap.
+
+#include "spreader.h"
+#include "spsignal.h"
+#include "sptest.h"
+#include "sptimes.h"
+
+#include <complex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SPECTREL_TEST_NUM_SPECTRUMS 12
+#define SPECTREL_TEST_NUM_SAMPLES 8
+#define SPECTREL_TEST_WINDOW_HOP 4
+#define SPECTREL_TEST_SAMPLE_RATE 1000.0
+
+// The log-power, in dB, written to each sample, in the order output by the
+// DFT.
+static double spectrel_get_test_power_db(const size_t n, const size_t m)
+{
+    return (double)(10 * n + m);
+}
+
+// The log-power expected at a position in order of increasing frequency.
+static double spectrel_get_test_position_db(const size_t n,
+                                            const size_t position)
+{
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    return spectrel_get_test_power_db(n, (position + M / 2) % M);
+}
+
+static int spectrel_write_test_recording(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return SPECTREL_FAILURE;
+    for (size_t n = 0; n < SPECTREL_TEST_NUM_SPECTRUMS; n++)
+    {
+        for (size_t m = 0; m < SPECTREL_TEST_NUM_SAMPLES; m++)
+        {
+            double amplitude =
+                sqrt(pow(10, spectrel_get_test_power_db(n, m) / 10));
+            fftw_complex sample = amplitude * cexp(I * (double)m);
+            fwrite(&sample, sizeof(sample), 1, file);
+        }
+    }
+    return fclose(file) == 0 ? SPECTREL_SUCCESS : SPECTREL_FAILURE;
+}
+
+// Record two buffers, the second starting 50ms after the first rather than
+// the 20ms the hop would suggest, as if samples were dropped between them.
+static int spectrel_write_test_times(const char *path, const int64_t time)
+{
+    spectrel_times times = spectrel_make_times(
+        path, SPECTREL_TEST_WINDOW_HOP, SPECTREL_TEST_SAMPLE_RATE, false);
+    if (!times)
+        return SPECTREL_FAILURE;
+    spectrel_spectrogram_t first = {.num_spectrums = 5, .time = time};
+    spectrel_spectrogram_t second = {.num_spectrums = 7,
+                                     .time = time + 50000000};
+    int status = spectrel_write_times(times, &first) != 0 ||
+                         spectrel_write_times(times, &second) != 0
+                     ? SPECTREL_FAILURE
+                     : SPECTREL_SUCCESS;
+    spectrel_free_times(times);
+    return status;
+}
+
+static void spectrel_test_slice(spectrel_reader reader)
+{
+    // Every spectrum and sample, at full resolution, in order of increasing
+    // frequency.
+    size_t N = SPECTREL_TEST_NUM_SPECTRUMS;
+    size_t M = SPECTREL_TEST_NUM_SAMPLES;
+    float preview[SPECTREL_TEST_NUM_SPECTRUMS * SPECTREL_TEST_NUM_SAMPLES];
+    spectrel_slice_t slice = {.start_spectrum = 0,
+                              .end_spectrum = N,
+                              .start_sample = 0,
+                              .end_sample = M,
+                              .num_rows = N,
+                              .num_columns = M,
+                              .mode = SPECTREL_PREVIEW_SAMPLE};
+    double error = INFINITY;
+    if (spectrel_check(spectrel_read_preview(reader, &slice, preview) == 0,
+                       "read the whole recording"))
+    {
+        error = 0;
+        for (size_t n = 0; n < N; n++)
+        {
+            for (size_t j = 0; j < M; j++)
+            {
+                double expected = spectrel_get_test_position_db(n, j);
+                error = fmax(error, fabs(preview[n * M + j] - expected));
+            }
+        }
+    }
+    spectrel_check_close("whole recording, fftshifted", error, 0, 1e-4);
+
+    // Spectrums [3, 9) and samples [2, 6), pooled in cells of two by two.
+    slice = (spectrel_slice_t){.start_spectrum = 3,
+                               .end_spectrum = 9,
+                               .start_sample = 2,
+                               .end_sample = 6,
+                               .num_rows = 3,
+                               .num_columns = 2,
+                               .mode = SPECTREL_PREVIEW_MEAN};
+    error = INFINITY;
+    if (spectrel_check(spectrel_read_preview(reader, &slice, preview) == 0,
+                       "read a region"))
+    {
+        error = 0;
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                double expected = 0;
+                for (size_t n = 3 + 2 * i; n < 5 + 2 * i; n++)
+                    for (size_t k = 2 + 2 * j; k < 4 + 2 * j; k++)
+                        expected += spectrel_get_test_position_db(n, k) / 4;
+                error = fmax(error, fabs(preview[i * 2 + j] - expected));
+            }
+        }
+    }
+    spectrel_check_close("mean over a region", error, 0, 1e-4);
+
+    slice.mode = SPECTREL_PREVIEW_MAX;
+    spectrel_check(spectrel_read_preview(reader, &slice, preview) == 0,
+                   "read the max over a region");
+    spectrel_check_close("max over a region",
+                         preview[5],
+                         spectrel_get_test_position_db(8, 5),
+                         1e-4);
+
+    slice.end_spectrum = N + 1;
+    spectrel_check(spectrel_read_preview(reader, &slice, preview) != 0,
+                   "refuse a region past the end");
+}
+
+static void spectrel_test_times(spectrel_reader reader, const int64_t time)
+{
+    double hop_ns = SPECTREL_TEST_WINDOW_HOP * 1e9 / SPECTREL_TEST_SAMPLE_RATE;
+    spectrel_check(spectrel_has_reader_times(reader), "times are known");
+    spectrel_check_close("sample rate",
+                         spectrel_get_reader_sample_rate(reader),
+                         SPECTREL_TEST_SAMPLE_RATE,
+                         0);
+    spectrel_check_close("window hop",
+                         (double)spectrel_get_reader_window_hop(reader),
+                         SPECTREL_TEST_WINDOW_HOP,
+                         0);
+    spectrel_check_close("time of the first spectrum",
+                         (double)(spectrel_get_reader_time(reader, 0) - time),
+                         0,
+                         0);
+    spectrel_check_close("time within the first buffer",
+                         (double)(spectrel_get_reader_time(reader, 4) - time),
+                         4 * hop_ns,
+                         1);
+    spectrel_check_close("time after the gap",
+                         (double)(spectrel_get_reader_time(reader, 5) - time),
+                         50e6,
+                         1);
+    spectrel_check_close("time within the second buffer",
+                         (double)(spectrel_get_reader_time(reader, 7) - time),
+                         50e6 + 2 * hop_ns,
+                         1);
+}
+
+int main(void)
+{
+    char directory[] = "/tmp/spectrel-test-XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("reader: could not make a directory\n");
+        return SPECTREL_FAILURE;
+    }
+    char path[sizeof(directory) + 16];
+    char times_path[sizeof(path) + 8];
+    snprintf(path, sizeof(path), "%s/test.cf64", directory);
+    snprintf(times_path, sizeof(times_path), "%s.times", path);
+
+    // Without a timestamp file, times are unknown.
+    int64_t time = 1700000000000000000;
+    spectrel_check(spectrel_write_test_recording(path) == 0,
+                   "write a recording");
+    spectrel_reader reader =
+        spectrel_open_reader(path, SPECTREL_TEST_NUM_SAMPLES);
+    if (spectrel_check(reader != NULL, "open a recording"))
+    {
+        spectrel_check(spectrel_get_num_spectrums(reader) ==
+                           SPECTREL_TEST_NUM_SPECTRUMS,
+                       "count the spectrums");
+        spectrel_check(!spectrel_has_reader_times(reader),
+                       "times are unknown without a timestamp file");
+        spectrel_test_slice(reader);
+        spectrel_close_reader(reader);
+        reader = NULL;
+    }
+
+    spectrel_check(spectrel_write_test_times(path, time) == 0,
+                   "write a timestamp file");
+    reader = spectrel_open_reader(path, SPECTREL_TEST_NUM_SAMPLES);
+    if (spectrel_check(reader != NULL, "open a recording with times"))
+    {
+        spectrel_test_times(reader, time);
+        spectrel_close_reader(reader);
+        reader = NULL;
+    }
+
+    unlink(times_path);
+    unlink(path);
+    rmdir(directory);
+    return spectrel_finish_test("reader");
+}
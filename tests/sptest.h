@@ -0,0 +1,73 @@
+#ifndef SPTEST_H
+#define SPTEST_H
+
+#include "spconstants.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Checks shared by the tests. Each test is a program which runs every check,
+// reports those which fail, and exits with a non-zero status if any did.
+
+static size_t spectrel_num_checks = 0;
+static size_t spectrel_num_failed = 0;
+
+/**
+ * @brief Record the outcome of a check, reporting it if it failed.
+ * @param is_passed Whether the check passed.
+ * @param name What was checked.
+ * @return Whether the check passed.
+ */
+static bool spectrel_check(const bool is_passed, const char *name)
+{
+    spectrel_num_checks++;
+    if (!is_passed)
+    {
+        spectrel_num_failed++;
+        printf("  FAIL: %s\n", name);
+    }
+    return is_passed;
+}
+
+/**
+ * @brief Check that a value is within a tolerance of what was expected.
+ * @param name What was checked.
+ * @param value The value.
+ * @param expected The expected value.
+ * @param tolerance The largest absolute error allowed.
+ * @return Whether the check passed.
+ */
+static bool spectrel_check_close(const char *name,
+                                 const double value,
+                                 const double expected,
+                                 const double tolerance)
+{
+    bool is_passed = fabs(value - expected) <= tolerance;
+    if (!spectrel_check(is_passed, name))
+    {
+        printf("        %.9g, expected %.9g (tolerance %.3g)\n",
+               value,
+               expected,
+               tolerance);
+    }
+    return is_passed;
+}
+
+/**
+ * @brief Print a summary of the checks run so far.
+ * @param name The name of the test.
+ * @return Zero if every check passed, or an error code otherwise.
+ */
+static int spectrel_finish_test(const char *name)
+{
+    printf("%s: %zu/%zu checks passed\n",
+           name,
+           spectrel_num_checks - spectrel_num_failed,
+           spectrel_num_checks);
+    return spectrel_num_failed == 0 && spectrel_num_checks > 0
+               ? SPECTREL_SUCCESS
+               : SPECTREL_FAILURE;
+}
+
+#endif // SPTEST_H
@@ -0,0 +1,197 @@
+// Check that the sliding DFT of each tracked bin matches a direct DFT of the
+// window ending at each output, across buffers and past a resync.
+
+#include "spsignal.h"
+#include "sptest.h"
+#include "sptrack.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SPECTREL_TEST_FREQUENCY 100e6
+#define SPECTREL_TEST_SAMPLE_RATE 1e6
+#define SPECTREL_TEST_WINDOW_SIZE 32
+#define SPECTREL_TEST_WINDOW_HOP 8
+#define SPECTREL_TEST_BUFFER_SIZE 500 // Not a multiple of the hop.
+#define SPECTREL_TEST_NUM_BUFFERS 6
+#define SPECTREL_TEST_NUM_BINS 3
+
+// A uniform deviate in (0, 1), from a xorshift generator, so that the noise
+// is the same on every run.
+static double spectrel_get_test_uniform(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return ((double)(*state >> 11) + 0.5) / (double)(1ull << 53);
+}
+
+// Complex Gaussian noise of unit power.
+static double complex spectrel_get_test_noise(uint64_t *state)
+{
+    double r = sqrt(-log(spectrel_get_test_uniform(state)));
+    double theta = 2 * M_PI * spectrel_get_test_uniform(state);
+    return r * cexp(I * theta);
+}
+
+// The DFT, at a bin, of the boxcar window ending at a sample, zero-padded
+// before the start of the recording.
+static double complex spectrel_get_test_dft(const fftw_complex *recording,
+                                            const long long bin,
+                                            const size_t end)
+{
+    long long N = SPECTREL_TEST_WINDOW_SIZE;
+    long long start = (long long)end - N + 1;
+    double complex sum = 0;
+    for (long long j = 0; j < N; j++)
+    {
+        if (start + j >= 0)
+            sum += recording[start + j] * cexp(-2 * I * M_PI * bin * j / N);
+    }
+    return sum;
+}
+
+// Check each record of the track file against a direct DFT of the recording.
+static void spectrel_test_records(FILE *file,
+                                  const fftw_complex *recording,
+                                  const long long *bins,
+                                  const int64_t time)
+{
+    size_t K = SPECTREL_TEST_NUM_BINS;
+    size_t H = SPECTREL_TEST_WINDOW_HOP;
+    size_t num_samples = SPECTREL_TEST_BUFFER_SIZE * SPECTREL_TEST_NUM_BUFFERS;
+    float output[2 * SPECTREL_TEST_NUM_BINS];
+    spectrel_track_record_t record;
+    size_t num_outputs = 0;
+    size_t num_records = 0;
+    double time_error = 0;
+    double error = 0;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        // The first output of each record is the first window to end in its
+        // buffer.
+        size_t end = (record.index + 1) * H - 1;
+        size_t offset = end - num_records * SPECTREL_TEST_BUFFER_SIZE;
+        int64_t buffer_time =
+            time + (int64_t)(num_records * SPECTREL_TEST_BUFFER_SIZE * 1000);
+        time_error = fmax(
+            time_error,
+            fabs((double)(record.time - buffer_time) - (double)offset * 1000));
+        spectrel_check(record.index == num_outputs, "records are contiguous");
+        for (size_t k = 0; k < record.num_outputs; k++)
+        {
+            if (fread(output, sizeof(output), 1, file) != 1)
+                break;
+            end = (record.index + k + 1) * H - 1;
+            for (size_t b = 0; b < K; b++)
+            {
+                double complex expected =
+                    spectrel_get_test_dft(recording, bins[b], end);
+                double complex value = output[2 * b] + I * output[2 * b + 1];
+                error = fmax(error, cabs(value - expected));
+            }
+        }
+        num_outputs += record.num_outputs;
+        num_records += 1;
+    }
+    spectrel_check(num_records == SPECTREL_TEST_NUM_BUFFERS,
+                   "one record per buffer");
+    spectrel_check(num_outputs == num_samples / H, "one output per hop");
+    spectrel_check_close("time of the first output", time_error, 0, 1);
+    spectrel_check_close("sliding DFT", error, 0, 1e-4);
+}
+
+int main(void)
+{
+    char directory[] = "/tmp/spectrel-test-XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("track: could not make a directory\n");
+        return SPECTREL_FAILURE;
+    }
+    char path[sizeof(directory) + 16];
+    char track_path[sizeof(path) + 8];
+    snprintf(path, sizeof(path), "%s/test.cf64", directory);
+    snprintf(track_path, sizeof(track_path), "%s.track", path);
+
+    // A bin above the centre, one below it off the bin centre, and DC.
+    double resolution = SPECTREL_TEST_SAMPLE_RATE / SPECTREL_TEST_WINDOW_SIZE;
+    long long bins[SPECTREL_TEST_NUM_BINS] = {3, -10, 0};
+    double frequencies[SPECTREL_TEST_NUM_BINS] = {
+        SPECTREL_TEST_FREQUENCY + 3 * resolution,
+        SPECTREL_TEST_FREQUENCY - 10.3 * resolution,
+        SPECTREL_TEST_FREQUENCY};
+    spectrel_track_params_t params = {
+        .frequency = SPECTREL_TEST_FREQUENCY,
+        .sample_rate = SPECTREL_TEST_SAMPLE_RATE,
+        .window_size = SPECTREL_TEST_WINDOW_SIZE,
+        .window_hop = SPECTREL_TEST_WINDOW_HOP,
+        .buffer_size = SPECTREL_TEST_BUFFER_SIZE,
+        .is_real = false,
+        .frequencies = frequencies,
+        .num_frequencies = SPECTREL_TEST_NUM_BINS};
+
+    size_t B = SPECTREL_TEST_BUFFER_SIZE;
+    size_t num_samples = B * SPECTREL_TEST_NUM_BUFFERS;
+    int64_t time = 1700000000000000000;
+    fftw_complex *recording = malloc(sizeof(*recording) * num_samples);
+    spectrel_signal_t *buffer =
+        spectrel_make_signal(B, SPECTREL_EMPTY_SIGNAL, NULL);
+    spectrel_tracker tracker = spectrel_make_tracker(path, &params);
+    if (spectrel_check(recording && buffer && tracker, "make a tracker"))
+    {
+        uint64_t state = 0x9e3779b97f4a7c15ull;
+        for (size_t n = 0; n < num_samples; n++)
+            recording[n] = spectrel_get_test_noise(&state);
+        for (size_t k = 0; k < SPECTREL_TEST_NUM_BUFFERS; k++)
+        {
+            for (size_t n = 0; n < B; n++)
+                buffer->samples[n] = recording[k * B + n];
+            int64_t buffer_time = time + (int64_t)(k * B * 1000);
+            spectrel_check(spectrel_track(tracker, buffer, buffer_time) == 0,
+                           "track a buffer");
+        }
+    }
+    spectrel_free_tracker(tracker);
+    tracker = NULL;
+    spectrel_free_signal(buffer);
+    buffer = NULL;
+
+    FILE *file = fopen(track_path, "rb");
+    spectrel_track_header_t header;
+    double bin_frequencies[SPECTREL_TEST_NUM_BINS];
+    if (recording &&
+        spectrel_check(file && fread(&header, sizeof(header), 1, file) == 1 &&
+                           fread(bin_frequencies,
+                                 sizeof(bin_frequencies),
+                                 1,
+                                 file) == 1,
+                       "read the track header"))
+    {
+        spectrel_check(header.num_bins == SPECTREL_TEST_NUM_BINS &&
+                           header.window_size == SPECTREL_TEST_WINDOW_SIZE &&
+                           header.window_hop == SPECTREL_TEST_WINDOW_HOP,
+                       "track header");
+        double frequency_error = 0;
+        for (size_t b = 0; b < SPECTREL_TEST_NUM_BINS; b++)
+        {
+            double expected = SPECTREL_TEST_FREQUENCY + bins[b] * resolution;
+            frequency_error =
+                fmax(frequency_error, fabs(bin_frequencies[b] - expected));
+        }
+        spectrel_check_close("nearest bins", frequency_error, 0, 1e-6);
+        spectrel_test_records(file, recording, bins, time);
+    }
+    if (file)
+        fclose(file);
+    free(recording);
+    recording = NULL;
+
+    unlink(track_path);
+    rmdir(directory);
+    return spectrel_finish_test("track");
+}
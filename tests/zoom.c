@@ -0,0 +1,163 @@
+// Check that the chirp-z zoom evaluates the DFT of each window at the
+// frequencies of its grid, in each layout and for real input, and that the
+// spectrogram takes up the bytes reserved for it.
+
+#include "sparena.h"
+#include "spsignal.h"
+#include "sptest.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SPECTREL_TEST_SAMPLE_RATE 1e6
+#define SPECTREL_TEST_NUM_SAMPLES 1000
+#define SPECTREL_TEST_WINDOW_SIZE 100
+#define SPECTREL_TEST_WINDOW_HOP 40
+#define SPECTREL_TEST_START_FREQUENCY -120e3
+#define SPECTREL_TEST_STOP_FREQUENCY 80e3
+#define SPECTREL_TEST_NUM_BINS 37 // Neither a power of two nor a divisor.
+
+// A uniform deviate in (0, 1), from a xorshift generator, so that the noise
+// is the same on every run.
+static double spectrel_get_test_uniform(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return ((double)(*state >> 11) + 0.5) / (double)(1ull << 53);
+}
+
+// Complex Gaussian noise of unit power.
+static double complex spectrel_get_test_noise(uint64_t *state)
+{
+    double r = sqrt(-log(spectrel_get_test_uniform(state)));
+    double theta = 2 * M_PI * spectrel_get_test_uniform(state);
+    return r * cexp(I * theta);
+}
+
+// The DFT of a window of the signal at a frequency, evaluated directly. The
+// window is centred on the sample at the start of the spectrum, and the
+// signal is zero where it dangles.
+static double complex spectrel_get_test_dft(const spectrel_signal_t *signal,
+                                            const bool is_real,
+                                            const size_t n,
+                                            const double frequency)
+{
+    ptrdiff_t N = SPECTREL_TEST_WINDOW_SIZE;
+    ptrdiff_t start = (ptrdiff_t)(n * SPECTREL_TEST_WINDOW_HOP) - N / 2;
+    double complex sum = 0;
+    for (ptrdiff_t j = 0; j < N; j++)
+    {
+        ptrdiff_t i = start + j;
+        if (i < 0 || i >= (ptrdiff_t)signal->num_samples)
+            continue;
+        double complex x =
+            is_real ? creal(signal->samples[i]) : signal->samples[i];
+        sum += x * cexp(-2 * I * M_PI * frequency * (double)j /
+                        SPECTREL_TEST_SAMPLE_RATE);
+    }
+    return sum;
+}
+
+static void spectrel_test_zoom(const spectrel_signal_t *signal,
+                               const spectrel_signal_t *window,
+                               const spectrel_layout_t layout,
+                               const bool is_real,
+                               const char *name)
+{
+    size_t K = SPECTREL_TEST_NUM_BINS;
+    double spacing =
+        (SPECTREL_TEST_STOP_FREQUENCY - SPECTREL_TEST_START_FREQUENCY) / K;
+    size_t num_bytes = spectrel_get_zoom_stfft_size(SPECTREL_TEST_NUM_SAMPLES,
+                                                    SPECTREL_TEST_WINDOW_SIZE,
+                                                    SPECTREL_TEST_WINDOW_HOP,
+                                                    K,
+                                                    layout);
+    spectrel_arena arena = spectrel_make_arena(num_bytes);
+    spectrel_plan p = spectrel_make_zoom_plan(SPECTREL_TEST_WINDOW_SIZE,
+                                              layout,
+                                              is_real,
+                                              SPECTREL_TEST_SAMPLE_RATE,
+                                              SPECTREL_TEST_START_FREQUENCY,
+                                              SPECTREL_TEST_STOP_FREQUENCY,
+                                              K);
+    spectrel_spectrogram_t *s = NULL;
+    if (spectrel_check(arena && p, "make a zoom plan"))
+    {
+        s = spectrel_stfft(p,
+                           window,
+                           signal,
+                           SPECTREL_TEST_WINDOW_HOP,
+                           SPECTREL_TEST_SAMPLE_RATE,
+                           arena);
+    }
+
+    double frequency_error = INFINITY;
+    double error = INFINITY;
+    if (spectrel_check(s && s->num_samples_per_spectrum == K, name))
+    {
+        spectrel_check(s->arena == arena &&
+                           spectrel_get_arena_used(arena) == num_bytes,
+                       "spectrogram fills its reserved bytes");
+        frequency_error = 0;
+        error = 0;
+        fftw_complex spectrum[SPECTREL_TEST_NUM_BINS];
+        for (size_t k = 0; k < K; k++)
+        {
+            double expected = SPECTREL_TEST_START_FREQUENCY + k * spacing;
+            frequency_error =
+                fmax(frequency_error, fabs(s->frequencies[k] - expected));
+        }
+        for (size_t n = 0; n < s->num_spectrums; n++)
+        {
+            spectrel_copy_spectrum(s, n, spectrum);
+            for (size_t k = 0; k < K; k++)
+            {
+                double complex expected = spectrel_get_test_dft(
+                    signal, is_real, n, s->frequencies[k]);
+                error = fmax(error, cabs(spectrum[k] - expected));
+            }
+        }
+    }
+    spectrel_check_close("zoom frequencies", frequency_error, 0, 1e-6);
+    spectrel_check_close(name, error, 0, 1e-9);
+
+    // The spectrogram is released with the arena.
+    spectrel_free_plan(p);
+    p = NULL;
+    spectrel_free_arena(arena);
+    arena = NULL;
+}
+
+int main(void)
+{
+    spectrel_signal_t *signal = spectrel_make_signal(
+        SPECTREL_TEST_NUM_SAMPLES, SPECTREL_EMPTY_SIGNAL, NULL);
+    spectrel_signal_t *window = spectrel_make_window(SPECTREL_TEST_WINDOW_SIZE);
+    if (spectrel_check(signal && window, "make a signal"))
+    {
+        uint64_t state = 0x9e3779b97f4a7c15ull;
+        for (size_t i = 0; i < SPECTREL_TEST_NUM_SAMPLES; i++)
+            signal->samples[i] = spectrel_get_test_noise(&state);
+        spectrel_test_zoom(signal,
+                           window,
+                           SPECTREL_LAYOUT_INTERLEAVED,
+                           false,
+                           "zoom, interleaved");
+        spectrel_test_zoom(
+            signal, window, SPECTREL_LAYOUT_SPLIT, false, "zoom, split");
+        spectrel_test_zoom(signal,
+                           window,
+                           SPECTREL_LAYOUT_INTERLEAVED,
+                           true,
+                           "zoom of a real signal");
+    }
+    spectrel_free_signal(signal);
+    signal = NULL;
+    spectrel_free_signal(window);
+    window = NULL;
+    return spectrel_finish_test("zoom");
+}
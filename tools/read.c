@@ -0,0 +1,426 @@
+
+#include "spectrel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char *optarg;
+
+/**
+ * @brief Structure to hold configurable parameters for spectrel-read.
+ */
+typedef struct
+{
+    char *path;                   // -f (file)
+    size_t window_size;           // -w (window size) [#samples]
+    double sample_rate;           // -s (sample rate) [Hz]
+    size_t window_hop;            // -h (window hop)  [#samples]
+    char *time_range;             // -t (time range)  [s]
+    char *frequency_range;        // -F (frequency range) [Hz]
+    size_t num_rows;              // -R (preview rows)
+    size_t num_columns;           // -C (preview columns)
+    spectrel_preview_mode_t mode; // -p (pooling)
+    char *output;                 // -o (output file)
+} spectrel_read_args_t;
+
+static void spectrel_print_read_usage(char *argv[])
+{
+    fprintf(stderr,
+            "Usage: %s -f <file> [-w window_size] [-s sample_rate] [-h "
+            "window_hop] [-t start:end] [-F low:high] [-R rows] [-C columns] "
+            "[-p sample|mean|max] [-o output]\n",
+            argv[0]);
+}
+
+static int spectrel_parse_range(const char *range, double *start, double *end)
+{
+    char *endptr;
+    *start = strtod(range, &endptr);
+    if (*endptr != ':')
+    {
+        spectrel_print_error("Could not parse range: %s", range);
+        return SPECTREL_FAILURE;
+    }
+    *end = strtod(endptr + 1, &endptr);
+    if (*endptr != '\0' || *end <= *start)
+    {
+        spectrel_print_error("Could not parse range: %s", range);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_parse_read_args(int argc,
+                                    char *argv[],
+                                    spectrel_read_args_t *args)
+{
+    args->path = NULL;
+    args->window_size = 0;
+    args->sample_rate = 0;
+    args->window_hop = 0;
+    args->time_range = NULL;
+    args->frequency_range = NULL;
+    args->num_rows = SPECTREL_DEFAULT_PREVIEW_SIZE;
+    args->num_columns = SPECTREL_DEFAULT_PREVIEW_SIZE;
+    args->mode = SPECTREL_PREVIEW_SAMPLE;
+    args->output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:w:s:h:t:F:R:C:p:o:")) != -1)
+    {
+        char *endptr = "";
+        switch (opt)
+        {
+        case 'f':
+            args->path = optarg;
+            break;
+        case 'w':
+            args->window_size = strtoul(optarg, &endptr, 10);
+            break;
+        case 's':
+            args->sample_rate = strtod(optarg, &endptr);
+            break;
+        case 'h':
+            args->window_hop = strtoul(optarg, &endptr, 10);
+            break;
+        case 't':
+            args->time_range = optarg;
+            break;
+        case 'F':
+            args->frequency_range = optarg;
+            break;
+        case 'R':
+            args->num_rows = strtoul(optarg, &endptr, 10);
+            break;
+        case 'C':
+            args->num_columns = strtoul(optarg, &endptr, 10);
+            break;
+        case 'p':
+            if (strcmp(optarg, "sample") == 0)
+                args->mode = SPECTREL_PREVIEW_SAMPLE;
+            else if (strcmp(optarg, "mean") == 0)
+                args->mode = SPECTREL_PREVIEW_MEAN;
+            else if (strcmp(optarg, "max") == 0)
+                args->mode = SPECTREL_PREVIEW_MAX;
+            else
+                endptr = optarg;
+            break;
+        case 'o':
+            args->output = optarg;
+            break;
+        default:
+            spectrel_print_read_usage(argv);
+            return SPECTREL_FAILURE;
+        }
+        if (*endptr != '\0')
+        {
+            spectrel_print_error("Could not parse -%c %s", opt, optarg);
+            return SPECTREL_FAILURE;
+        }
+    }
+
+    // Check required arguments
+    if (!args->path || args->num_rows == 0 || args->num_columns == 0)
+    {
+        spectrel_print_read_usage(argv);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Take the sample rate and window hop from the timestamp file of the
+// recording, unless they were given.
+static int spectrel_resolve_read_args(spectrel_read_args_t *args,
+                                      spectrel_reader reader)
+{
+    if (args->sample_rate <= 0)
+    {
+        args->sample_rate = spectrel_get_reader_sample_rate(reader);
+    }
+    if (args->window_hop == 0)
+    {
+        args->window_hop = spectrel_get_reader_window_hop(reader);
+    }
+    if (args->window_hop == 0)
+    {
+        args->window_hop = SPECTREL_DEFAULT_WINDOW_HOP;
+    }
+
+    // Physical units can only be resolved with a sample rate.
+    if ((args->time_range || args->frequency_range) && args->sample_rate <= 0)
+    {
+        spectrel_print_error("A sample rate is required to select ranges");
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+// Select the spectrums captured between two times, in seconds since the
+// first spectrum, using the time of each spectrum in the timestamp file.
+static void spectrel_resolve_times(spectrel_reader reader,
+                                   const double start,
+                                   const double end,
+                                   spectrel_slice_t *slice)
+{
+    size_t N = spectrel_get_num_spectrums(reader);
+    int64_t first_time = spectrel_get_reader_time(reader, 0);
+    slice->start_spectrum = N;
+    slice->end_spectrum = N;
+    for (size_t n = 0; n < N; n++)
+    {
+        double time = (spectrel_get_reader_time(reader, n) - first_time) * 1e-9;
+        if (time > end)
+        {
+            slice->end_spectrum = n;
+            break;
+        }
+        if (time >= start && slice->start_spectrum == N)
+        {
+            slice->start_spectrum = n;
+        }
+    }
+    if (slice->end_spectrum < slice->start_spectrum)
+    {
+        slice->end_spectrum = slice->start_spectrum;
+    }
+}
+
+// Resolve the requested time and frequency ranges to a region of the
+// spectrogram. Without a timestamp file, spectrums are assumed to be spaced
+// by the window hop.
+static int spectrel_resolve_slice(const spectrel_read_args_t *args,
+                                  spectrel_reader reader,
+                                  spectrel_slice_t *slice)
+{
+    size_t N = spectrel_get_num_spectrums(reader);
+    size_t M = spectrel_get_num_samples_per_spectrum(reader);
+    slice->start_spectrum = 0;
+    slice->end_spectrum = N;
+    slice->start_sample = 0;
+    slice->end_sample = M;
+
+    double start, end;
+    if (args->time_range)
+    {
+        if (spectrel_parse_range(args->time_range, &start, &end) != 0)
+            return SPECTREL_FAILURE;
+        if (spectrel_has_reader_times(reader))
+        {
+            spectrel_resolve_times(reader, start, end, slice);
+        }
+        else
+        {
+            double spectrums_per_second =
+                args->sample_rate /
+                (args->window_hop * spectrel_get_reader_decimation(reader));
+            start = fmax(0, ceil(start * spectrums_per_second));
+            end = fmin((double)N, floor(end * spectrums_per_second) + 1);
+            slice->start_spectrum = (size_t)start;
+            slice->end_spectrum = (size_t)fmax(start, end);
+        }
+    }
+    if (args->frequency_range)
+    {
+        if (spectrel_parse_range(args->frequency_range, &start, &end) != 0)
+            return SPECTREL_FAILURE;
+
+        // Samples are read in order of increasing frequency, so select the
+        // contiguous run of samples which fall inside the range. The half
+        // spectrums of real-valued inputs are already in that order.
+        bool is_real = spectrel_is_reader_real(reader);
+        double *frequencies = malloc(sizeof(*frequencies) * M);
+        if (!frequencies)
+        {
+            spectrel_print_error("malloc failed: frequencies");
+            return SPECTREL_FAILURE;
+        }
+        spectrel_compute_frequencies(frequencies,
+                                     is_real ? args->window_size : M,
+                                     args->sample_rate,
+                                     is_real);
+        slice->start_sample = M;
+        slice->end_sample = 0;
+        for (size_t k = 0; k < M; k++)
+        {
+            double frequency = frequencies[is_real ? k : (k + M / 2) % M];
+            if (frequency >= start && frequency <= end)
+            {
+                slice->start_sample =
+                    k < slice->start_sample ? k : slice->start_sample;
+                slice->end_sample = k + 1;
+            }
+        }
+        free(frequencies);
+        frequencies = NULL;
+    }
+
+    if (slice->start_spectrum >= slice->end_spectrum ||
+        slice->start_sample >= slice->end_sample)
+    {
+        spectrel_print_error("The selected range is empty");
+        return SPECTREL_FAILURE;
+    }
+
+    size_t num_spectrums = slice->end_spectrum - slice->start_spectrum;
+    size_t num_samples = slice->end_sample - slice->start_sample;
+    slice->num_rows =
+        args->num_rows < num_spectrums ? args->num_rows : num_spectrums;
+    slice->num_columns =
+        args->num_columns < num_samples ? args->num_columns : num_samples;
+    slice->mode = args->mode;
+    return SPECTREL_SUCCESS;
+}
+
+// Write the preview as an 8-bit greyscale image, scaled between the smallest
+// and largest values.
+static int spectrel_write_pgm(FILE *file,
+                              const float *preview,
+                              const spectrel_slice_t *slice)
+{
+    size_t num_values = slice->num_rows * slice->num_columns;
+    float lo = preview[0];
+    float hi = preview[0];
+    for (size_t n = 1; n < num_values; n++)
+    {
+        lo = preview[n] < lo ? preview[n] : lo;
+        hi = preview[n] > hi ? preview[n] : hi;
+    }
+    float scale = hi > lo ? 255 / (hi - lo) : 0;
+
+    fprintf(file, "P5\n%zu %zu\n255\n", slice->num_columns, slice->num_rows);
+    for (size_t n = 0; n < num_values; n++)
+    {
+        if (fputc((int)((preview[n] - lo) * scale + 0.5f), file) == EOF)
+        {
+            return SPECTREL_FAILURE;
+        }
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static int spectrel_write_preview(const char *path,
+                                  const float *preview,
+                                  const spectrel_slice_t *slice)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        spectrel_print_error("fopen failed: %s", path);
+        return SPECTREL_FAILURE;
+    }
+
+    int status;
+    const char *extension = strrchr(path, '.');
+    if (extension && strcmp(extension, ".pgm") == 0)
+    {
+        status = spectrel_write_pgm(file, preview, slice);
+    }
+    else
+    {
+        size_t num_values = slice->num_rows * slice->num_columns;
+        status = fwrite(preview, sizeof(*preview), num_values, file) ==
+                         num_values
+                     ? SPECTREL_SUCCESS
+                     : SPECTREL_FAILURE;
+    }
+    if (fclose(file) != 0 || status != SPECTREL_SUCCESS)
+    {
+        spectrel_print_error("Failed to write preview: %s", path);
+        return SPECTREL_FAILURE;
+    }
+    return SPECTREL_SUCCESS;
+}
+
+static void spectrel_describe_recording(const spectrel_read_args_t *args,
+                                        spectrel_reader reader)
+{
+    size_t N = spectrel_get_num_spectrums(reader);
+    size_t decimation = spectrel_get_reader_decimation(reader);
+    printf("Recording: \n");
+    printf("  File:        %s\n", args->path);
+    printf("  Encoding:    %s\n",
+           spectrel_get_encoding_name(spectrel_get_reader_encoding(reader)));
+    printf("  Spectrums:   %zu\n", N);
+    printf("  Input:       %s\n",
+           spectrel_is_reader_real(reader) ? "real" : "complex");
+    printf("  Samples:     %zu [#samples per spectrum]\n",
+           spectrel_get_num_samples_per_spectrum(reader));
+    printf("  Decimation:  %zu\n", decimation);
+    if (args->sample_rate > 0)
+    {
+        // Spectrums are timed from the timestamp file where there is one,
+        // so that dropped samples are accounted for.
+        double hop_duration =
+            (double)(args->window_hop * decimation) / args->sample_rate;
+        double duration =
+            spectrel_has_reader_times(reader)
+                ? (spectrel_get_reader_time(reader, N - 1) -
+                   spectrel_get_reader_time(reader, 0)) * 1e-9 +
+                      hop_duration
+                : N * hop_duration;
+        printf("  Sample rate: %.4f [Hz]\n", args->sample_rate);
+        printf("  Hop:         %zu [#samples]\n", args->window_hop);
+        printf("  Duration:    %.2f [s]\n", duration);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    spectrel_read_args_t args;
+    spectrel_reader reader = NULL;
+    float *preview = NULL;
+    int status = SPECTREL_FAILURE;
+
+    if (spectrel_parse_read_args(argc, argv, &args) != 0)
+        goto cleanup;
+
+    reader = spectrel_open_reader(args.path, args.window_size);
+    if (!reader)
+        goto cleanup;
+    if (spectrel_resolve_read_args(&args, reader) != 0)
+        goto cleanup;
+    spectrel_describe_recording(&args, reader);
+
+    // Without an output file, describing the recording is all there is to do.
+    if (!args.output)
+    {
+        status = SPECTREL_SUCCESS;
+        goto cleanup;
+    }
+
+    spectrel_slice_t slice;
+    if (spectrel_resolve_slice(&args, reader, &slice) != 0)
+        goto cleanup;
+
+    preview = malloc(sizeof(*preview) * slice.num_rows * slice.num_columns);
+    if (!preview)
+    {
+        spectrel_print_error("malloc failed: preview");
+        goto cleanup;
+    }
+    if (spectrel_read_preview(reader, &slice, preview) != 0)
+        goto cleanup;
+    if (spectrel_write_preview(args.output, preview, &slice) != 0)
+        goto cleanup;
+    printf("Wrote a %zu x %zu preview to %s\n",
+           slice.num_rows,
+           slice.num_columns,
+           args.output);
+    status = SPECTREL_SUCCESS;
+
+cleanup:
+    if (preview)
+    {
+        free(preview);
+        preview = NULL;
+    }
+    if (reader)
+    {
+        spectrel_close_reader(reader);
+        reader = NULL;
+    }
+    return status;
+}